@@ -0,0 +1,84 @@
+#include <atomic>
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/ip/tcp.hpp>
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <new>
+#include <pichi/api/session.hpp>
+#include <pichi/net/direct.hpp>
+#include <pichi/net/socks5.hpp>
+#include <pichi/slab.hpp>
+#include <pichi/stats.hpp>
+#include <string_view>
+
+using namespace std;
+using namespace pichi;
+namespace asio = boost::asio;
+using asio::ip::tcp;
+using Clock = chrono::steady_clock;
+
+static auto const CONNECTIONS = 1000000;
+
+static atomic<size_t> mallocs = 0;
+
+void* operator new(size_t size)
+{
+  mallocs.fetch_add(1, memory_order_relaxed);
+  if (auto p = malloc(size == 0 ? 1 : size)) return p;
+  throw bad_alloc{};
+}
+
+void operator delete(void* p) noexcept { free(p); }
+void operator delete(void* p, size_t) noexcept { free(p); }
+
+/*
+ * Making and destroying the objects of an accepted connection the same way as the server, which
+ *   are the session and both of its adapters, without running the session.
+ */
+template <typename Make> static void measure(string_view name, int connections, Make&& make)
+{
+  auto io = asio::io_context{};
+  auto& counters = stats::counters("bench");
+  auto& connecting = stats::connecting("bench");
+  auto before = mallocs.load();
+  auto start = Clock::now();
+  for (auto i = 0; i < connections; ++i) {
+    auto ingress = make_unique<net::Socks5Adapter<tcp::socket>>(io);
+    auto egress = make_unique<net::DirectAdapter>(io);
+    make(io, move(ingress), move(egress), counters, connecting, stats::Clock::now());
+  }
+  auto elapsed = chrono::duration<double, nano>(Clock::now() - start).count();
+
+  cout << fixed << setprecision(2) << name << ": "
+       << static_cast<double>(mallocs.load() - before) / connections << " mallocs/connection, "
+       << elapsed / connections << " ns/connection" << endl;
+}
+
+static void makeShared(asio::io_context& io, unique_ptr<net::Ingress> ingress,
+                       unique_ptr<net::Egress> egress, stats::Counters& counters,
+                       stats::Histogram& connecting, stats::Clock::time_point accepted)
+{
+  make_shared<api::Session>(io, move(ingress), move(egress), counters, connecting, accepted);
+}
+
+static void makeSlabbed(asio::io_context& io, unique_ptr<net::Ingress> ingress,
+                        unique_ptr<net::Egress> egress, stats::Counters& counters,
+                        stats::Histogram& connecting, stats::Clock::time_point accepted)
+{
+  slab::makeShared<api::Session>(io, move(ingress), move(egress), counters, connecting, accepted);
+}
+
+/*
+ * Counting the mallocs for each accepted connection, by the first one warming the free lists of
+ *   the slab up, and by the churn afterwards, with the session shared from the heap for contrast.
+ */
+int main()
+{
+  measure("Cold, slab", 1, makeSlabbed);
+  measure("Churn, slab", CONNECTIONS, makeSlabbed);
+  measure("Churn, session on heap", CONNECTIONS, makeShared);
+  return 0;
+}
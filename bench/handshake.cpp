@@ -0,0 +1,158 @@
+#include <array>
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/ip/tcp.hpp>
+#include <boost/asio/read.hpp>
+#include <boost/asio/write.hpp>
+#include <boost/beast/core/flat_buffer.hpp>
+#include <chrono>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <pichi/net/common.hpp>
+#include <pichi/net/helpers.hpp>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+using namespace std;
+using namespace pichi;
+namespace asio = boost::asio;
+namespace beast = boost::beast;
+using asio::ip::tcp;
+using Clock = chrono::steady_clock;
+
+static auto const SOCKS5_HANDSHAKES = 200000;
+static auto const AEAD_HANDSHAKES = 2000000;
+static auto const PAYLOAD_SIZE = size_t{512};
+
+// VER, CMD and RSV of SOCKS5 requests, or nothing for Shadowsocks
+static auto const REQUEST_SIZE = size_t{3};
+
+using Read = function<void(MutableBuffer<uint8_t>)>;
+
+// Reading field by field through the callback, as parseEndpoint did before
+static net::Endpoint readByFields(Read const& read)
+{
+  auto buf = array<uint8_t, net::MAX_ADDRESS_SIZE>{};
+  auto received = size_t{1};
+  read({buf, 1});
+  if (buf[0] == 0x03) read({buf.data() + received++, 1});
+  auto size = net::endpointSize(buf);
+  read({buf.data() + received, size - received});
+  return net::parseEndpoint({buf, size}).first;
+}
+
+static vector<uint8_t> makeRequest(net::Endpoint const& remote)
+{
+  auto request = vector<uint8_t>(REQUEST_SIZE + net::MAX_ADDRESS_SIZE);
+  request[0] = 0x05;
+  request[1] = 0x01;
+  request[2] = 0x00;
+  auto len =
+      net::serializeEndpoint(remote, {request.data() + REQUEST_SIZE, net::MAX_ADDRESS_SIZE});
+  request.resize(REQUEST_SIZE + len);
+  return request;
+}
+
+template <typename Handshake>
+static void report(string_view name, int handshakes, size_t const& reads, Handshake&& handshake)
+{
+  auto start = Clock::now();
+  handshake();
+  auto elapsed = chrono::duration<double>(Clock::now() - start).count();
+
+  cout << fixed << setprecision(2) << name << ": " << handshakes / elapsed / 1e3
+       << " K handshakes/s, " << static_cast<double>(reads) / handshakes << " reads/handshake"
+       << endl;
+}
+
+/*
+ * Reading the SOCKS5 requests from a loopback connection, each of which costs a syscall per read,
+ *   either field by field, or along with the head of the endpoint and then the rest at once.
+ */
+static void socks5(string_view name, net::Endpoint const& remote, bool buffered)
+{
+  auto io = asio::io_context{};
+  auto acceptor = tcp::acceptor{io, {asio::ip::make_address("127.0.0.1"), 0}};
+  auto sender = tcp::socket{io};
+  sender.connect(acceptor.local_endpoint());
+  auto receiver = acceptor.accept();
+
+  auto request = makeRequest(remote);
+  auto t = thread{[&sender, &request]() {
+    for (auto i = 0; i < SOCKS5_HANDSHAKES; ++i) asio::write(sender, asio::buffer(request));
+  }};
+
+  auto reads = size_t{0};
+  auto read = [&receiver, &reads](MutableBuffer<uint8_t> dst) {
+    asio::read(receiver, asio::buffer(dst.data(), dst.size()));
+    ++reads;
+  };
+  report(name, SOCKS5_HANDSHAKES, reads, [&]() {
+    auto buf = array<uint8_t, 512>{};
+    for (auto i = 0; i < SOCKS5_HANDSHAKES; ++i) {
+      if (buffered) {
+        read({buf, REQUEST_SIZE + net::ENDPOINT_HEAD_SIZE});
+        net::readEndpoint({buf.data() + REQUEST_SIZE, buf.size() - REQUEST_SIZE},
+                          net::ENDPOINT_HEAD_SIZE, read);
+      }
+      else {
+        read({buf, REQUEST_SIZE});
+        readByFields(read);
+      }
+    }
+  });
+  t.join();
+}
+
+/*
+ * Taking the endpoint from the first frame of Shadowsocks AEAD, which has been decrypted and is
+ *   followed by the payload, either through the cache of recv field by field, or in place.
+ */
+static void aead(string_view name, net::Endpoint const& remote, bool buffered)
+{
+  auto frame = array<uint8_t, net::MAX_FRAME_SIZE>{};
+  auto len = net::serializeEndpoint(remote, frame) + PAYLOAD_SIZE;
+
+  auto reads = size_t{0};
+  report(name, AEAD_HANDSHAKES, reads, [&]() {
+    auto cache = beast::flat_buffer{};
+    auto copyTo = [&cache, &reads](MutableBuffer<uint8_t> dst) {
+      cache.consume(asio::buffer_copy(asio::buffer(dst.data(), dst.size()), cache.data()));
+      ++reads;
+    };
+    for (auto i = 0; i < AEAD_HANDSHAKES; ++i) {
+      if (buffered) {
+        auto size = net::readEndpoint(frame, len, copyTo).second;
+        cache.commit(asio::buffer_copy(cache.prepare(len - size),
+                                       asio::buffer(frame.data() + size, len - size)));
+      }
+      else {
+        cache.commit(asio::buffer_copy(cache.prepare(len), asio::buffer(frame.data(), len)));
+        readByFields(copyTo);
+      }
+      // The payload is taken by the relay afterwards
+      cache.consume(cache.size());
+    }
+  });
+}
+
+/*
+ * Comparing the handshakes per second on one core, which read the endpoint field by field
+ *   through a callback before, and consume it from the bytes already received now.
+ */
+int main()
+{
+  auto domain = net::makeEndpoint("www.example.com"sv, 443);
+  auto ipv4 = net::makeEndpoint("93.184.216.34"sv, 443);
+
+  socks5("SOCKS5, domain, by fields", domain, false);
+  socks5("SOCKS5, domain, buffered", domain, true);
+  socks5("SOCKS5, IPv4, by fields", ipv4, false);
+  socks5("SOCKS5, IPv4, buffered", ipv4, true);
+  aead("SS AEAD, domain, by fields", domain, false);
+  aead("SS AEAD, domain, in place", domain, true);
+  aead("SS AEAD, IPv4, by fields", ipv4, false);
+  aead("SS AEAD, IPv4, in place", ipv4, true);
+  return 0;
+}
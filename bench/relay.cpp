@@ -0,0 +1,131 @@
+#include <algorithm>
+#include <array>
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/ip/tcp.hpp>
+#include <boost/asio/write.hpp>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <pichi/net/common.hpp>
+#include <pichi/net/helpers.hpp>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+using namespace std;
+namespace asio = boost::asio;
+namespace sys = boost::system;
+using asio::ip::tcp;
+using Clock = chrono::steady_clock;
+using Ring = array<vector<uint8_t>, pichi::net::MAX_RELAY_DEPTH>;
+
+static auto const BULK_SIZE = size_t{1} << 30;
+static auto const BULK_WRITE = size_t{1} << 20;
+static auto const MESSAGES = 2000;
+static auto const MESSAGE_SIZE = size_t{128};
+
+// The relay chunk before being adapted
+struct FixedSizer {
+  size_t size() const { return pichi::net::MAX_FRAME_SIZE; }
+  size_t depth() const { return pichi::net::MAX_RELAY_DEPTH; }
+  void update(size_t) {}
+};
+
+static void bulk(tcp::socket& s)
+{
+  auto buf = vector<uint8_t>(BULK_WRITE, 0xff);
+  for (auto sent = size_t{0}; sent < BULK_SIZE; sent += buf.size())
+    asio::write(s, asio::buffer(buf));
+}
+
+static void interactive(tcp::socket& s)
+{
+  auto buf = vector<uint8_t>(MESSAGE_SIZE, 0xff);
+  for (auto i = 0; i < MESSAGES; ++i) {
+    asio::write(s, asio::buffer(buf));
+    this_thread::sleep_for(100us);
+  }
+}
+
+static size_t held(Ring const& ring)
+{
+  auto sum = size_t{0};
+  for (auto&& buf : ring) sum += buf.capacity();
+  return sum;
+}
+
+/*
+ * Receiving from a loopback connection the same way as the relay pipe, which resizes the chunk
+ *   of its ring before each recv, and reshapes the ring, as the sizer suggests. The session peak
+ *   adds the first chunk of the idle direction to the peak of the relayed one.
+ */
+template <typename Sizer, typename Feed> static void measure(string_view name, Feed&& feed)
+{
+  auto io = asio::io_context{};
+  auto acceptor = tcp::acceptor{io, {asio::ip::make_address("127.0.0.1"), 0}};
+  auto sender = tcp::socket{io};
+  sender.connect(acceptor.local_endpoint());
+  auto receiver = acceptor.accept();
+
+  auto t = thread{[&sender, &feed]() {
+    feed(sender);
+    sender.shutdown(tcp::socket::shutdown_send);
+  }};
+
+  auto sizer = Sizer{};
+  auto ring = Ring();
+  auto depth = sizer.depth();
+  auto bytes = size_t{0};
+  auto reads = size_t{0};
+  auto peak = size_t{0};
+  auto ec = sys::error_code{};
+  auto start = Clock::now();
+  while (!ec) {
+    if (depth != sizer.depth()) {
+      depth = sizer.depth();
+      for (auto i = size_t{0}; i < ring.size(); ++i)
+        if (i >= depth || ring[i].size() > sizer.size()) {
+          ring[i].clear();
+          ring[i].shrink_to_fit();
+        }
+    }
+    auto& buf = ring[reads % depth];
+    if (buf.size() != sizer.size()) {
+      buf.resize(sizer.size());
+      buf.shrink_to_fit();
+    }
+    peak = max(peak, held(ring));
+    auto n = receiver.read_some(asio::buffer(buf), ec);
+    sizer.update(n);
+    bytes += n;
+    ++reads;
+  }
+  auto elapsed = chrono::duration<double>(Clock::now() - start).count();
+  t.join();
+
+  cout << fixed << setprecision(2) << name << ": " << bytes / elapsed / 1e6 << " MB/s, " << reads
+       << " reads, " << bytes / reads << " bytes/read, chunk " << sizer.size() / 1024 << " KiB x "
+       << depth << ", held " << held(ring) / 1024 << " KiB (session peak "
+       << (peak + Sizer{}.size()) / 1024 << " KiB)" << endl;
+}
+
+/*
+ * Comparing the fixed chunk against the adaptive one, by a bulk transfer for the throughput and
+ *   the number of reads, and by small delayed messages for the memory held by an idle session.
+ */
+int main(int argc, char const* argv[])
+{
+  auto mode = argc > 1 ? string_view{argv[1]} : "both"sv;
+
+  if (mode == "bulk" || mode == "both") {
+    measure<FixedSizer>("Bulk, fixed", bulk);
+    measure<pichi::net::ChunkSizer>("Bulk, adaptive", bulk);
+  }
+
+  if (mode == "interactive" || mode == "both") {
+    measure<FixedSizer>("Interactive, fixed", interactive);
+    measure<pichi::net::ChunkSizer>("Interactive, adaptive", interactive);
+  }
+
+  return 0;
+}
@@ -0,0 +1,82 @@
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <pichi/api/router.hpp>
+#include <pichi/api/rule_set.hpp>
+#include <pichi/api/vos.hpp>
+#include <string>
+
+using namespace std;
+using namespace pichi::api;
+using Clock = chrono::steady_clock;
+
+static auto const ENTRIES = 100000;
+static decltype(auto) GEO = "geo.mmdb";
+static decltype(auto) RULES = "bench.rules";
+
+// Resident set size in KiB, or 0 if unavailable
+static size_t rss()
+{
+  auto ifs = ifstream{"/proc/self/statm"};
+  auto size = size_t{0};
+  auto resident = size_t{0};
+  ifs >> size >> resident;
+  return resident * 4;
+}
+
+static string domain(int i) { return "host" + to_string(i) + ".example" + to_string(i % 97) + ".com"; }
+
+static string range(int i)
+{
+  return to_string(1 + i / 65536 % 223) + "." + to_string(i / 256 % 256) + "." +
+         to_string(i % 256) + ".0/24";
+}
+
+template <typename Function> static void measure(string_view name, Function&& f)
+{
+  auto before = rss();
+  auto start = Clock::now();
+  f();
+  auto elapsed = chrono::duration_cast<chrono::milliseconds>(Clock::now() - start);
+  cout << name << ": " << elapsed.count() << " ms, RSS +" << rss() - before << " KiB" << endl;
+}
+
+/*
+ * Comparing the JSON rule against the precompiled rule set with the same domains and ranges,
+ *   from the request body (or the text list) to a router ready for routing.
+ */
+int main(int argc, char const* argv[])
+{
+  auto mode = argc > 1 ? string_view{argv[1]} : "both"sv;
+
+  if (mode == "json" || mode == "both") {
+    auto json = string{"{\"domain\":["};
+    for (auto i = 0; i < ENTRIES; ++i) json += (i > 0 ? ",\"" : "\"") + domain(i) + "\"";
+    json += "],\"range\":[";
+    for (auto i = 0; i < ENTRIES; ++i) json += (i > 0 ? ",\"" : "\"") + range(i) + "\"";
+    json += "]}";
+
+    auto router = Router{GEO};
+    measure("JSON rule", [&]() {
+      router.update("json", parse<RuleVO>(json));
+      router.setRoute({{}, {make_pair("json", "direct")}});
+    });
+  }
+
+  if (mode == "file" || mode == "both") {
+    measure("Compiling rule set", []() {
+      auto builder = RuleSetBuilder{};
+      for (auto i = 0; i < ENTRIES; ++i) builder.add(domain(i));
+      for (auto i = 0; i < ENTRIES; ++i) builder.add(range(i));
+      builder.write(RULES);
+    });
+
+    auto router = Router{GEO};
+    measure("Rule set file", [&]() {
+      router.update("file", parse<RuleVO>("{\"file\":\""s + RULES + "\"}"));
+      router.setRoute({{}, {make_pair("file", "direct")}});
+    });
+  }
+
+  return 0;
+}
@@ -84,4 +84,14 @@ if (BUILD_SERVER)
   check_function_exists("close" HAS_CLOSE)
 endif (BUILD_SERVER)
 
+# Batched UDP I/O, used by the SOCKS5 UDP relay
+include(CheckSymbolExists)
+set(CMAKE_REQUIRED_DEFINITIONS -D_GNU_SOURCE)
+check_symbol_exists("recvmmsg" "sys/socket.h" HAS_RECVMMSG)
+check_symbol_exists("sendmmsg" "sys/socket.h" HAS_SENDMMSG)
+unset(CMAKE_REQUIRED_DEFINITIONS)
+
+# Passing the listening sockets to an upgrading process
+check_symbol_exists("SCM_RIGHTS" "sys/socket.h" HAS_SCM_RIGHTS)
+
 configure_file(${CMAKE_SOURCE_DIR}/include/config.h.in ${CMAKE_BINARY_DIR}/include/config.h)
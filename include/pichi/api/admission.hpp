@@ -0,0 +1,99 @@
+#ifndef PICHI_API_ADMISSION_HPP
+#define PICHI_API_ADMISSION_HPP
+
+#include <array>
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/steady_timer.hpp>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <pichi/api/vos.hpp>
+#include <unordered_set>
+
+namespace pichi::net {
+
+class Adapter;
+class Ingress;
+
+} // namespace pichi::net
+
+namespace pichi::api {
+
+/*
+ * Admission caps the connections accepted by an ingress, or by all of them for the global one.
+ *   The accept rate is limited by a token bucket holding the tokens of one second, so that a burst
+ *   isn't shed as long as the average keeps below the rate. The connections over any limit are
+ *   shed once accepted, rather than left in the backlog, so that the clients fail fast and the
+ *   relaying sessions aren't slowed down. Like the other API objects, it's only accessed by the
+ *   thread running io_context.
+ */
+class Admission : public std::enable_shared_from_this<Admission> {
+public:
+  using Clock = std::chrono::steady_clock;
+
+  /*
+   * Ticket is held by an admitted connection, which counts it as a session of the admissions
+   *   until destroyed, and as a handshake until it's confirmed to relay. The adapter held is
+   *   closed by the admissions if they are still draining at the deadline.
+   */
+  class Ticket {
+  public:
+    Ticket(Ticket const&) = delete;
+    Ticket& operator=(Ticket const&) = delete;
+
+    Ticket(std::shared_ptr<Admission>, std::shared_ptr<Admission>);
+    Ticket(Ticket&&) noexcept;
+    Ticket& operator=(Ticket&&) noexcept;
+    ~Ticket();
+
+    void handshaken();
+    void hold(net::Adapter*);
+
+  private:
+    void release();
+
+    std::array<std::shared_ptr<Admission>, 2> admissions_;
+    bool handshaking_ = true;
+    net::Adapter* adapter_ = nullptr;
+  };
+
+  // The ticket if there's room in both admissions, which takes their tokens of the rate then
+  static std::optional<Ticket> admit(std::shared_ptr<Admission> const&,
+                                     std::shared_ptr<Admission> const&,
+                                     Clock::time_point = Clock::now());
+
+  explicit Admission(AdmissionVO = {});
+
+  void configure(AdmissionVO);
+  AdmissionVO const& limits() const;
+  size_t sessions() const;
+  size_t handshakes() const;
+
+  /*
+   * Waiting for the sessions to end, then done is called. The adapters held are closed if there
+   *   are sessions left at the deadline. It's drained only once, the later calls are ignored.
+   */
+  void drain(boost::asio::io_context&, std::chrono::seconds deadline, std::function<void()> done);
+  bool draining() const;
+
+private:
+  bool full(Clock::time_point);
+  void close();
+
+  AdmissionVO limits_;
+  size_t sessions_ = 0;
+  size_t handshakes_ = 0;
+  double tokens_ = 0.0;
+  Clock::time_point refilled_ = {};
+  std::unordered_set<net::Adapter*> adapters_;
+  // Cancelled once the sessions end, and kept after the deadline to ignore the later drains
+  std::shared_ptr<boost::asio::steady_timer> drain_;
+};
+
+// Wrapping the ingress of an admitted connection, which ends its handshake once confirmed
+extern std::unique_ptr<net::Ingress> admit(std::unique_ptr<net::Ingress>, Admission::Ticket);
+
+} // namespace pichi::api
+
+#endif // PICHI_API_ADMISSION_HPP
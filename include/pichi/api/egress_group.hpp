@@ -0,0 +1,77 @@
+#ifndef PICHI_API_EGRESS_GROUP_HPP
+#define PICHI_API_EGRESS_GROUP_HPP
+
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <pichi/api/vos.hpp>
+#include <pichi/net/common.hpp>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace pichi::net {
+
+class Egress;
+
+} // namespace pichi::net
+
+namespace pichi::api {
+
+/*
+ * EgressLoad is gathered passively from the sessions connected by an egress: the sessions alive,
+ *   and the EWMA of the time to connect in microseconds, which is 0 before the first connection.
+ *   A failed connection counts as FAILURE_PENALTY at least, so that an unreachable egress isn't
+ *   preferred for failing fast.
+ */
+struct EgressLoad {
+  static constexpr auto FAILURE_PENALTY = std::chrono::seconds{1};
+
+  void record(std::chrono::nanoseconds, bool failed = false);
+
+  size_t sessions_ = 0;
+  double latency_ = 0.0;
+};
+
+// Wrapping the egress of a session to update the load
+extern std::unique_ptr<net::Egress> track(std::unique_ptr<net::Egress>,
+                                          std::shared_ptr<EgressLoad>);
+
+/*
+ * EgressGroup picks one of its members for each session:
+ *   - ROUND_ROBIN: in turn,
+ *   - LEAST_SESSIONS: the one with the fewest sessions alive,
+ *   - LATENCY: the one with the least connecting latency weighted by its sessions alive, so that
+ *     the fastest one isn't flooded,
+ *   - HASH: by rendezvous hashing on the remote host, so that a host sticks to the same member
+ *     and only the hosts of the member removed are moved.
+ *   Ties are broken in turn. The members unavailable are skipped unless all of them are. Like the
+ *   other API objects, it's only accessed by the thread running io_context.
+ */
+class EgressGroup {
+private:
+  double cost(size_t) const;
+  bool prefer(size_t, size_t, size_t key) const;
+
+public:
+  struct Member {
+    std::string name_;
+    std::shared_ptr<EgressLoad> load_;
+  };
+
+  using Available = std::function<bool(std::string_view)>;
+
+  EgressGroup(std::vector<Member>, Balance);
+
+  std::string_view pick(net::Endpoint const& remote, Available const& = {});
+
+private:
+  std::vector<Member> members_;
+  std::vector<size_t> hashes_;
+  Balance balance_;
+  size_t next_ = 0;
+};
+
+} // namespace pichi::api
+
+#endif // PICHI_API_EGRESS_GROUP_HPP
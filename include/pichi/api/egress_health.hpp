@@ -0,0 +1,52 @@
+#ifndef PICHI_API_EGRESS_HEALTH_HPP
+#define PICHI_API_EGRESS_HEALTH_HPP
+
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/steady_timer.hpp>
+#include <boost/asio/strand.hpp>
+#include <memory>
+#include <pichi/api/vos.hpp>
+#include <pichi/net/common.hpp>
+#include <string>
+
+namespace pichi::api {
+
+/*
+ * EgressHealth probes the next hop of SS, SOCKS5 or HTTP egress periodically by preconnecting
+ *   it, TLS handshake included, within the timeout. The state flips only after the consecutive
+ *   results reach the thresholds, so that a single lost probe doesn't flap the routing. Like the
+ *   other API objects, it's only accessed by the thread running io_context.
+ */
+class EgressHealth : public std::enable_shared_from_this<EgressHealth> {
+private:
+  template <typename Yield> void probe(Yield);
+  void report(bool succeeded);
+
+public:
+  EgressHealth(EgressHealth const&) = delete;
+  EgressHealth(EgressHealth&&) = delete;
+  EgressHealth& operator=(EgressHealth const&) = delete;
+  EgressHealth& operator=(EgressHealth&&) = delete;
+
+  EgressHealth(boost::asio::io_context&, std::string name, EgressVO const&);
+
+  void start();
+  void stop();
+
+  bool up() const;
+  HealthVO const& status() const;
+
+private:
+  boost::asio::io_context::strand strand_;
+  std::string name_;
+  EgressVO vo_;
+  net::Endpoint next_;
+  boost::asio::steady_timer timer_;
+  HealthVO status_ = {};
+  size_t streak_ = 0;
+  bool stopped_ = false;
+};
+
+} // namespace pichi::api
+
+#endif // PICHI_API_EGRESS_HEALTH_HPP
@@ -1,13 +1,26 @@
 #ifndef PICHI_API_EGRESS_MANAGER_HPP
 #define PICHI_API_EGRESS_MANAGER_HPP
 
+#include <boost/asio/io_context.hpp>
 #include <map>
+#include <memory>
+#include <pichi/api/egress_group.hpp>
 #include <pichi/api/vos.hpp>
 #include <string>
 #include <string_view>
 
+namespace pichi::net {
+
+class Egress;
+class MuxClient;
+
+} // namespace pichi::net
+
 namespace pichi::api {
 
+class EgressHealth;
+class EgressPool;
+
 class EgressManager {
 public:
   using VO = EgressVO;
@@ -15,9 +28,23 @@ public:
 private:
   using Container = std::map<std::string, EgressVO, std::less<>>;
   using ConstIterator = typename Container::const_iterator;
+  using Pools = std::map<std::string, std::shared_ptr<EgressPool>, std::less<>>;
+  using Muxes = std::map<std::string, std::shared_ptr<net::MuxClient>, std::less<>>;
+  using Groups = std::map<std::string, EgressGroup, std::less<>>;
+  using Loads = std::map<std::string, std::shared_ptr<EgressLoad>, std::less<>>;
+  using Healths = std::map<std::string, std::shared_ptr<EgressHealth>, std::less<>>;
+
+  bool isMember(std::string_view) const;
+  void prune();
 
 public:
-  EgressManager() = default;
+  EgressManager(EgressManager const&) = delete;
+  EgressManager(EgressManager&&) = delete;
+  EgressManager& operator=(EgressManager const&) = delete;
+  EgressManager& operator=(EgressManager&&) = delete;
+
+  explicit EgressManager(boost::asio::io_context&);
+  ~EgressManager();
 
   void update(std::string const&, EgressVO);
   void erase(std::string_view);
@@ -25,9 +52,33 @@ public:
   ConstIterator begin() const noexcept;
   ConstIterator end() const noexcept;
   ConstIterator find(std::string_view) const;
+  // Whether the egress is a member of any group or the fallback of any egress
+  bool isUsed(std::string_view) const;
+  // Whether the egress passes its health check, which is always true if not checked
+  bool isUp(std::string_view) const;
+  std::map<std::string, HealthVO> health() const;
+
+  /*
+   * The member picked for the remote if it's a group, skipping the members down, or the egress
+   *   itself. It's replaced by its fallback if down, which is picked again if it's a group.
+   */
+  std::string_view pick(std::string_view, net::Endpoint const& remote);
+
+  /*
+   * The egress for a session, which is preconnected if the pool of the named one has any, or
+   *   a stream over the shared connections for MUX. It's tracked for the load if it's a member of
+   *   any group, or rejecting at once if it's down.
+   */
+  std::unique_ptr<net::Egress> make(std::string_view);
 
 private:
+  boost::asio::io_context& io_;
   Container c_ = {{"direct", {AdapterType::DIRECT}}};
+  Pools pools_ = {};
+  Muxes muxes_ = {};
+  Groups groups_ = {};
+  Loads loads_ = {};
+  Healths healths_ = {};
 };
 
 } // namespace pichi::api
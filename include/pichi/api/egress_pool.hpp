@@ -0,0 +1,69 @@
+#ifndef PICHI_API_EGRESS_POOL_HPP
+#define PICHI_API_EGRESS_POOL_HPP
+
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/steady_timer.hpp>
+#include <boost/asio/strand.hpp>
+#include <chrono>
+#include <deque>
+#include <memory>
+#include <pichi/api/vos.hpp>
+#include <pichi/net/common.hpp>
+
+namespace pichi::net {
+
+class Egress;
+
+} // namespace pichi::net
+
+namespace pichi::api {
+
+/*
+ * EgressPool keeps the egresses of SS, SOCKS5 or HTTP preconnected to the next hop, TLS
+ *   handshake included, so that a session only pays for the handshake of the proxy protocol.
+ *   The refilling coroutine tops the pool up to the configured size, and drops the connections
+ *   idle for too long or closed by the peer. Like the other API objects, it's only accessed by
+ *   the thread running io_context.
+ */
+class EgressPool : public std::enable_shared_from_this<EgressPool> {
+private:
+  using Clock = std::chrono::steady_clock;
+  using EgressPtr = std::unique_ptr<net::Egress>;
+
+  struct Warm {
+    EgressPtr egress_;
+    Clock::time_point expiry_;
+  };
+
+  template <typename Yield> void refill(Yield);
+  template <typename Yield> void wait(Clock::time_point, Yield);
+  void purge();
+  void clear();
+
+public:
+  EgressPool(EgressPool const&) = delete;
+  EgressPool(EgressPool&&) = delete;
+  EgressPool& operator=(EgressPool const&) = delete;
+  EgressPool& operator=(EgressPool&&) = delete;
+
+  EgressPool(boost::asio::io_context&, EgressVO const&);
+  ~EgressPool();
+
+  void start();
+  void stop();
+
+  // The most recently connected egress still alive, or nullptr if none is ready
+  EgressPtr take();
+
+private:
+  boost::asio::io_context::strand strand_;
+  EgressVO vo_;
+  net::Endpoint next_;
+  std::deque<Warm> warm_;
+  boost::asio::steady_timer signal_;
+  bool stopped_ = false;
+};
+
+} // namespace pichi::api
+
+#endif // PICHI_API_EGRESS_POOL_HPP
@@ -3,11 +3,18 @@
 
 #include <boost/asio/io_context.hpp>
 #include <boost/asio/ip/tcp.hpp>
+#include <boost/asio/ip/udp.hpp>
+#include <chrono>
 #include <functional>
 #include <map>
+#include <memory>
+#include <pichi/api/admission.hpp>
 #include <pichi/api/iterator.hpp>
 #include <pichi/api/vos.hpp>
+#include <pichi/net/handoff.hpp>
+#include <tuple>
 #include <utility>
+#include <vector>
 
 namespace pichi::api {
 
@@ -17,11 +24,17 @@ public:
 
 private:
   using Acceptor = boost::asio::ip::tcp::acceptor;
-  using Container = std::map<std::string, std::pair<IngressVO, Acceptor>, std::less<>>;
+  // Bound to the same port for the Shadowsocks ingresses relaying UDP, or null
+  using UdpSocket = std::shared_ptr<boost::asio::ip::udp::socket>;
+  // Kept across the updates, so that the sessions alive are still counted
+  using AdmissionPtr = std::shared_ptr<Admission>;
+  using Container = std::map<std::string, std::tuple<IngressVO, Acceptor, UdpSocket, AdmissionPtr>,
+                             std::less<>>;
   using DelegateIterator = typename Container::const_iterator;
   using ValueType = std::pair<std::string_view, IngressVO const&>;
   using ConstIterator = Iterator<DelegateIterator, ValueType>;
-  using Handler = std::function<void(Acceptor&, std::string_view, IngressVO const&)>;
+  using Handler = std::function<void(Acceptor&, UdpSocket const&, AdmissionPtr const&,
+                                     std::string_view, IngressVO const&)>;
 
   static ValueType generatePair(DelegateIterator);
 
@@ -31,6 +44,16 @@ public:
   void update(std::string const&, IngressVO);
   void erase(std::string_view);
 
+  /*
+   * Closing the listening sockets, and erasing the ingress once its sessions end, or at the
+   *   deadline after closing the sessions left. Updating it during draining listens again and
+   *   cancels erasing, while the sessions accepted before are still drained.
+   */
+  void drain(std::string_view, std::chrono::seconds deadline);
+
+  // The sockets listening, which are handed over to the upgrading process
+  std::vector<net::Listener> listeners();
+
   ConstIterator begin() const noexcept;
   ConstIterator end() const noexcept;
 
@@ -11,6 +11,7 @@
 
 namespace pichi::api {
 
+class Admission;
 class EgressManager;
 class IngressManager;
 class Router;
@@ -21,7 +22,7 @@ public:
   using Request = boost::beast::http::request<HttpBody>;
   using Response = boost::beast::http::response<HttpBody>;
 
-  explicit Rest(IngressManager&, EgressManager&, Router&);
+  explicit Rest(IngressManager&, EgressManager&, Router&, Admission&);
   Response handle(Request const&);
 
   static Response errorResponse(std::exception_ptr);
@@ -30,7 +31,7 @@ private:
   using HttpHandler = std::function<Response(Request const&, std::cmatch const&)>;
   using RouteItem = std::tuple<boost::beast::http::verb, std::regex, HttpHandler>;
 
-  std::array<RouteItem, 18> apis_;
+  std::array<RouteItem, 34> apis_;
 };
 
 } // namespace pichi::api
@@ -3,7 +3,9 @@
 
 #include <map>
 #include <memory>
+#include <optional>
 #include <pichi/api/vos.hpp>
+#include <string_view>
 
 class MMDB_s;
 
@@ -23,6 +25,8 @@ class Endpoint;
 
 namespace pichi::api {
 
+class RuleSet;
+
 extern bool matchPattern(std::string_view remote, std::string_view pattern);
 extern bool matchDomain(std::string_view subdomain, std::string_view domain);
 
@@ -48,25 +52,40 @@ private:
 class Router {
 public:
   using VO = RuleVO;
+  // Names of the matched rule and the egress, the rule name is empty if routed by default
+  using Routing = std::pair<std::string_view, std::string_view>;
 
 private:
   using ResolvedResult = boost::asio::ip::basic_resolver_results<boost::asio::ip::tcp>;
-  using Matcher = std::function<bool(net::Endpoint const&, ResolvedResult const&, std::string_view,
-                                     AdapterType)>;
-  using Container = std::map<std::string, std::pair<RuleVO, std::vector<Matcher>>, std::less<>>;
+  using Container = std::map<std::string, RuleVO, std::less<>>;
+  using RuleSets = std::map<std::string, std::shared_ptr<RuleSet const>, std::less<>>;
   using DelegateIterator = typename Container::const_iterator;
   using ValueType = std::pair<std::string_view, RuleVO const&>;
   using ConstIterator = Iterator<DelegateIterator, ValueType>;
 
+  /*
+   * Program is the route compiled against the current rules, in which every condition is
+   *   represented as a bitset over the indices of route items. It's rebuilt whenever the route or
+   *   any rule is replaced, while patching a rule copies only the lookup tables it touches.
+   */
+  class Program;
+
   static ValueType generatePair(DelegateIterator);
 
 public:
   Router(char const* fn);
 
-  std::string_view route(net::Endpoint const&, std::string_view ingress, AdapterType,
-                         ResolvedResult const&) const;
+  /*
+   * Rules are evaluated in order without any resolved address, and the evaluation stops at the
+   *   first rule containing any address-based condition. Empty result means that the remote
+   *   has to be resolved and routed again by the overload below.
+   */
+  std::optional<Routing> route(net::Endpoint const&, std::string_view ingress, AdapterType) const;
+  Routing route(net::Endpoint const&, std::string_view ingress, AdapterType,
+                ResolvedResult const&) const;
 
   void update(std::string const&, RuleVO);
+  void patch(std::string_view, RulePatchVO);
   void erase(std::string_view);
 
   ConstIterator begin() const noexcept;
@@ -80,8 +99,9 @@ public:
 private:
   Geo geo_;
   Container rules_ = {};
-  bool needResolving_ = false;
+  RuleSets sets_ = {};
   RouteVO route_ = {"direct"};
+  std::shared_ptr<Program> program_;
 };
 
 } // namespace pichi::api
@@ -0,0 +1,67 @@
+#ifndef PICHI_API_RULE_SET_HPP
+#define PICHI_API_RULE_SET_HPP
+
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace boost::asio::ip {
+
+class address;
+
+} // namespace boost::asio::ip
+
+namespace pichi::api {
+
+/*
+ * RuleSet is a read-only view of the precompiled rule set file, which is memory-mapped and
+ *   looked up in place. The file consists of a header, a sorted domain table, sorted and merged
+ *   IPv4/IPv6 intervals, and a string pool referenced by the domain table. All integers are
+ *   stored in little endian.
+ */
+class RuleSet {
+public:
+  explicit RuleSet(char const* fn);
+  ~RuleSet();
+
+  RuleSet(RuleSet const&) = delete;
+  RuleSet& operator=(RuleSet const&) = delete;
+
+  // Matching if the domain or any of its parent domains is in the set
+  bool matchDomain(std::string_view) const;
+  bool matchAddress(boost::asio::ip::address const&) const;
+
+  bool hasDomains() const;
+  bool hasRanges() const;
+
+private:
+  class Mapping;
+
+  std::unique_ptr<Mapping> mapping_;
+};
+
+/*
+ * RuleSetBuilder generates the rule set file from domains, IP addresses and IP ranges, which is
+ *   used by the offline compiler, and by tests.
+ */
+class RuleSetBuilder {
+public:
+  // Each entry is a domain name, an IP address, or an IP range in CIDR notation
+  void add(std::string_view);
+  void write(char const* fn);
+
+private:
+  using V6 = std::array<uint8_t, 16>;
+
+  std::vector<std::string> domains_ = {};
+  std::vector<std::pair<uint32_t, uint32_t>> v4_ = {};
+  std::vector<std::pair<V6, V6>> v6_ = {};
+};
+
+} // namespace pichi::api
+
+#endif // PICHI_API_RULE_SET_HPP
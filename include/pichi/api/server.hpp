@@ -4,28 +4,54 @@
 #include <array>
 #include <boost/asio/io_context.hpp>
 #include <boost/asio/strand.hpp>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <pichi/api/admission.hpp>
 #include <pichi/api/egress_manager.hpp>
 #include <pichi/api/ingress_manager.hpp>
 #include <pichi/api/rest.hpp>
 #include <pichi/api/router.hpp>
+#include <pichi/api/udp_relay.hpp>
 #include <pichi/buffer.hpp>
+#include <pichi/net/handoff.hpp>
 #include <string>
 #include <string_view>
 #include <unordered_set>
 #include <utility>
+#include <vector>
+
+namespace pichi::net {
+
+class Ingress;
+class Mux;
+
+} // namespace pichi::net
 
 namespace pichi::api {
 
 class Server {
 private:
   using Acceptor = boost::asio::basic_socket_acceptor<boost::asio::ip::tcp>;
-  using ResolveResult = boost::asio::ip::tcp::resolver::results_type;
 
-  template <typename Yield> void listen(Acceptor&, std::string_view, IngressVO const&, Yield);
+  using TimePoint = std::chrono::steady_clock::time_point;
+
+  template <typename Yield>
+  void listen(Acceptor&, std::shared_ptr<Admission>, std::string_view, IngressVO const&, Yield);
+  template <typename Yield>
+  void serve(std::unique_ptr<net::Ingress>, std::string_view, AdapterType, TimePoint, Yield);
+  template <typename Yield>
+  void relay(std::unique_ptr<net::Ingress>, net::Endpoint const&, std::string_view, AdapterType,
+             TimePoint, Yield);
+  template <typename Yield>
+  void persist(std::unique_ptr<net::Ingress>, net::Endpoint, std::string_view, AdapterType, Yield);
+  template <typename Yield>
+  void demux(std::shared_ptr<net::Mux>, std::shared_ptr<Admission>, std::string_view, Yield);
   template <typename ExceptionPtr> void removeIngress(ExceptionPtr, std::string_view);
-  EgressVO const& route(net::Endpoint const&, std::string_view ingress, AdapterType,
-                        ResolveResult const&);
+  template <typename Yield>
+  Router::Routing route(net::Endpoint const&, std::string_view ingress, AdapterType, Yield);
   template <typename Yield> bool isDuplicated(ConstBuffer<uint8_t>, Yield);
+  UdpRelay::Route routeUdp(std::string_view ingress, AdapterType);
 
 public:
   Server(Server const&) = delete;
@@ -37,11 +63,25 @@ public:
   ~Server() = default;
 
   void listen(std::string_view, uint16_t);
-  void startIngress(Acceptor&, std::string_view, IngressVO const&);
+  // Stopping accepting the API requests, which might be served by the upgrading process then
+  void unlisten();
+  void startIngress(Acceptor&, std::shared_ptr<boost::asio::ip::udp::socket> const&,
+                    std::shared_ptr<Admission> const&, std::string_view, IngressVO const&);
+
+  // The sockets listening, including the one of API
+  std::vector<net::Listener> listeners();
+
+  /*
+   * Stopping accepting, by API and all ingresses, then done is called once all sessions end, or
+   *   at the deadline after closing the sessions left.
+   */
+  void drain(std::chrono::seconds deadline, std::function<void()> done);
 
 private:
   boost::asio::io_context::strand strand_;
+  Acceptor api_;
   std::unordered_set<std::string> ivs_;
+  std::shared_ptr<Admission> admission_;
   Router router_;
   EgressManager egresses_;
   IngressManager ingresses_;
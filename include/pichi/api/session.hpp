@@ -5,11 +5,13 @@
 #include <boost/asio/strand.hpp>
 #include <memory>
 #include <pichi/net/common.hpp>
+#include <pichi/stats.hpp>
 
 #ifndef _MSC_VER
 
 namespace pichi::net {
 
+class Adapter;
 class Ingress;
 class Egress;
 
@@ -25,6 +27,8 @@ class Egress;
 
 namespace pichi::api {
 
+class Pipe;
+
 class Session : public std::enable_shared_from_this<Session> {
 private:
   using Strand = boost::asio::io_context::strand;
@@ -32,6 +36,10 @@ private:
   using EgressPtr = std::unique_ptr<net::Egress>;
 
   void close();
+  template <typename From>
+  void read(std::shared_ptr<Pipe> const&, From&, net::Adapter const& to);
+  template <typename To, typename Relayed>
+  void write(std::shared_ptr<Pipe> const&, To&, Relayed&&);
 
 public:
   Session(Session const&) = delete;
@@ -41,7 +49,8 @@ public:
 
   // According to Effective Moderm C++, Item 22.
   ~Session();
-  explicit Session(boost::asio::io_context& io, IngressPtr&&, EgressPtr&&);
+  explicit Session(boost::asio::io_context& io, IngressPtr&&, EgressPtr&&, stats::Counters&,
+                   stats::Histogram& connecting, stats::Clock::time_point accepted);
   void start(net::Endpoint const&, net::Endpoint const&);
   void start(net::Endpoint const& = {});
 
@@ -49,6 +58,9 @@ private:
   Strand strand_;
   IngressPtr ingress_;
   EgressPtr egress_;
+  stats::Counters& counters_;
+  stats::Histogram& connecting_;
+  stats::Clock::time_point accepted_;
 };
 
 } // namespace pichi::api
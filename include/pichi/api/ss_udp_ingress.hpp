@@ -0,0 +1,71 @@
+#ifndef PICHI_API_SS_UDP_INGRESS_HPP
+#define PICHI_API_SS_UDP_INGRESS_HPP
+
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/ip/udp.hpp>
+#include <boost/asio/spawn2.hpp>
+#include <boost/asio/steady_timer.hpp>
+#include <boost/asio/strand.hpp>
+#include <map>
+#include <memory>
+#include <pichi/api/udp_relay.hpp>
+#include <pichi/net/udp.hpp>
+#include <pichi/stats.hpp>
+
+namespace pichi::net {
+
+class SSUdpCodec;
+
+} // namespace pichi::net
+
+namespace pichi::api {
+
+/*
+ * SSUdpIngress serves Shadowsocks UDP on the socket bound to the port of a Shadowsocks ingress.
+ *   Each client address gets a session, which is a relay with its own socket, until the session
+ *   is idle for a while. The sessions are limited, and each of them receives the replies by a
+ *   smaller batch, so that the memory is bounded no matter how many clients there are.
+ */
+class SSUdpIngress : public std::enable_shared_from_this<SSUdpIngress> {
+public:
+  using Yield = boost::asio::yield_context;
+  using Socket = boost::asio::ip::udp::socket;
+
+private:
+  using UdpEndpoint = boost::asio::ip::udp::endpoint;
+
+  void upstream(Yield);
+  void sweep(Yield);
+  std::shared_ptr<UdpRelay> session(UdpEndpoint const& client);
+
+public:
+  SSUdpIngress(SSUdpIngress const&) = delete;
+  SSUdpIngress(SSUdpIngress&&) = delete;
+  SSUdpIngress& operator=(SSUdpIngress const&) = delete;
+  SSUdpIngress& operator=(SSUdpIngress&&) = delete;
+
+  SSUdpIngress(boost::asio::io_context&, std::shared_ptr<Socket>, std::shared_ptr<net::SSUdpCodec>,
+               UdpRelay::Route, stats::Counters&);
+  ~SSUdpIngress();
+
+  void start();
+  void close();
+
+private:
+  boost::asio::io_context::strand strand_;
+  std::shared_ptr<Socket> socket_;
+  std::shared_ptr<net::SSUdpCodec> codec_;
+  UdpRelay::Route route_;
+  // Counting the datagrams truncated, of the ingress
+  stats::Counters& counters_;
+  std::map<UdpEndpoint, std::shared_ptr<UdpRelay>> sessions_ = {};
+  net::DatagramBatch up_;
+  // The datagrams of one session forwarded, which are sent by its socket together
+  net::DatagramBatch out_;
+  boost::asio::steady_timer timer_;
+  bool closed_ = false;
+};
+
+} // namespace pichi::api
+
+#endif // PICHI_API_SS_UDP_INGRESS_HPP
@@ -0,0 +1,70 @@
+#ifndef PICHI_API_UDP_ASSOCIATION_HPP
+#define PICHI_API_UDP_ASSOCIATION_HPP
+
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/ip/udp.hpp>
+#include <boost/asio/spawn2.hpp>
+#include <boost/asio/strand.hpp>
+#include <memory>
+#include <optional>
+#include <pichi/api/udp_relay.hpp>
+#include <pichi/net/common.hpp>
+#include <pichi/net/udp.hpp>
+#include <pichi/stats.hpp>
+
+namespace pichi::net {
+
+class Ingress;
+
+} // namespace pichi::net
+
+namespace pichi::api {
+
+/*
+ * UdpAssociation relays the datagrams of one SOCKS5 UDP ASSOCIATE between the client and the
+ *   destinations, as long as the ingress stays open. The datagrams of the client are only
+ *   accepted from the first address and port seen, and then forwarded by the relay.
+ */
+class UdpAssociation : public std::enable_shared_from_this<UdpAssociation> {
+public:
+  using Yield = boost::asio::yield_context;
+  using IngressPtr = std::unique_ptr<net::Ingress>;
+
+private:
+  using Socket = boost::asio::ip::udp::socket;
+  using UdpEndpoint = boost::asio::ip::udp::endpoint;
+
+  void run(Yield);
+  void upstream(Yield);
+  bool accept(UdpEndpoint const& client);
+
+public:
+  UdpAssociation(UdpAssociation const&) = delete;
+  UdpAssociation(UdpAssociation&&) = delete;
+  UdpAssociation& operator=(UdpAssociation const&) = delete;
+  UdpAssociation& operator=(UdpAssociation&&) = delete;
+
+  UdpAssociation(boost::asio::io_context&, IngressPtr&&, net::Endpoint const& client,
+                 UdpRelay::Route, stats::Counters&);
+  ~UdpAssociation();
+
+  void start();
+  void close();
+
+private:
+  boost::asio::io_context::strand strand_;
+  IngressPtr ingress_;
+  net::Endpoint expected_;
+  UdpRelay::Route route_;
+  // Counting the datagrams truncated, of the ingress
+  stats::Counters& counters_;
+  std::shared_ptr<Socket> inbound_;
+  std::shared_ptr<UdpRelay> relay_ = {};
+  std::optional<UdpEndpoint> client_ = {};
+  net::DatagramBatch up_;
+  bool closed_ = false;
+};
+
+} // namespace pichi::api
+
+#endif // PICHI_API_UDP_ASSOCIATION_HPP
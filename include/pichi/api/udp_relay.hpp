@@ -0,0 +1,120 @@
+#ifndef PICHI_API_UDP_RELAY_HPP
+#define PICHI_API_UDP_RELAY_HPP
+
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/ip/udp.hpp>
+#include <boost/asio/spawn2.hpp>
+#include <boost/asio/steady_timer.hpp>
+#include <boost/asio/strand.hpp>
+#include <chrono>
+#include <functional>
+#include <map>
+#include <memory>
+#include <optional>
+#include <pichi/net/common.hpp>
+#include <pichi/net/udp.hpp>
+#include <pichi/stats.hpp>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace pichi::net {
+
+class SSUdpCodec;
+
+} // namespace pichi::net
+
+namespace pichi::api {
+
+/*
+ * UdpRelay is the egress side of one UDP client, which sends the datagrams of the client by its
+ *   own socket, like a NAT does. Each destination is routed once by the router, and then kept in
+ *   the NAT table until it's idle for a while, so that the replies are only accepted from the
+ *   destinations contacted by the client. The direct egresses send the datagrams to the
+ *   destinations, the Shadowsocks ones relaying UDP seal them for their servers, while the others
+ *   drop them.
+ */
+class UdpRelay : public std::enable_shared_from_this<UdpRelay> {
+public:
+  using Yield = boost::asio::yield_context;
+  using Strand = boost::asio::io_context::strand;
+  using Socket = boost::asio::ip::udp::socket;
+  using Clock = std::chrono::steady_clock;
+
+  struct Routed {
+    net::AdapterType type_;
+    stats::Counters* counters_;
+    // Only for the Shadowsocks egresses relaying UDP
+    std::optional<net::Endpoint> server_ = {};
+    std::shared_ptr<net::SSUdpCodec> codec_ = {};
+  };
+  using Route = std::function<Routed(net::Endpoint const&, Yield)>;
+
+  // Turning the reply from the source into the datagram to the client, false if dropped
+  using Reply = std::function<bool(net::Endpoint const& source, net::Datagram&)>;
+
+  // The mappings of NAT are kept for 2 minutes at least, according to RFC 4787
+  static constexpr auto MAPPING_IDLE = std::chrono::minutes{2};
+
+private:
+  using UdpEndpoint = boost::asio::ip::udp::endpoint;
+
+  struct Mapping {
+    net::Endpoint destination_;
+    // Empty if the datagrams to the destination are dropped
+    std::optional<UdpEndpoint> target_;
+    std::shared_ptr<net::SSUdpCodec> codec_;
+    stats::Counters* counters_;
+    Clock::time_point expiry_;
+  };
+
+  void downstream(Yield);
+  void sweep(Yield);
+  Mapping* map(net::Endpoint const&, Yield);
+  void index(Mapping&);
+  static Mapping* match(std::vector<Mapping*> const&, net::Endpoint const& source);
+
+public:
+  UdpRelay(UdpRelay const&) = delete;
+  UdpRelay(UdpRelay&&) = delete;
+  UdpRelay& operator=(UdpRelay const&) = delete;
+  UdpRelay& operator=(UdpRelay&&) = delete;
+
+  /*
+   * The replies are sent to the client by the inbound socket, and received in batches of
+   *   capacity. The replies truncated are counted by the counters of the ingress.
+   */
+  UdpRelay(Strand, std::shared_ptr<Socket> inbound, Route, Reply, stats::Counters&,
+           size_t capacity = net::DatagramBatch::CAPACITY);
+  ~UdpRelay();
+
+  void start();
+  void close();
+
+  // Rewriting the datagram of the client in place for the egress of the destination
+  bool forward(net::Endpoint const& destination, net::Datagram&, Yield);
+  // Sending the datagrams forwarded
+  void send(net::DatagramBatch&, Yield);
+
+  // The relay is idle since then, if no datagram is forwarded or replied
+  Clock::time_point expiry() const;
+
+private:
+  Strand strand_;
+  std::shared_ptr<Socket> inbound_;
+  Route route_;
+  Reply reply_;
+  stats::Counters& counters_;
+  Socket outbound_;
+  std::unordered_map<std::string, Mapping> nat_ = {};
+  // The mappings of each target, which is the destination or the Shadowsocks server
+  std::map<UdpEndpoint, std::vector<Mapping*>> peers_ = {};
+  net::DatagramBatch down_;
+  boost::asio::steady_timer timer_;
+  Clock::time_point expiry_;
+  bool closed_ = false;
+};
+
+} // namespace pichi::api
+
+#endif // PICHI_API_UDP_RELAY_HPP
@@ -2,11 +2,14 @@
 #define PICHI_API_VOS_HPP
 
 #include <algorithm>
+#include <map>
 #include <pichi/api/iterator.hpp>
 #include <pichi/asserts.hpp>
 #include <pichi/crypto/method.hpp>
+#include <pichi/log.hpp>
 #include <pichi/net/common.hpp>
 #include <rapidjson/document.h>
+#include <set>
 #include <string_view>
 #include <vector>
 
@@ -14,9 +17,23 @@ namespace pichi::api {
 
 using AdapterType = net::AdapterType;
 using CryptoMethod = crypto::CryptoMethod;
+using SocketOptions = net::SocketOptions;
 
 enum class DelayMode { RANDOM, FIXED };
 
+// How a group picks one of its members for each session
+enum class Balance { ROUND_ROBIN, LEAST_SESSIONS, LATENCY, HASH };
+
+/*
+ * Caps of the connections accepted, the absent ones are unlimited. sessions_ counts the connections
+ *   alive, handshakes_ the ones not relaying yet, and rate_ is the connections accepted per second.
+ */
+struct AdmissionVO {
+  std::optional<uint32_t> sessions_;
+  std::optional<uint32_t> handshakes_;
+  std::optional<uint32_t> rate_;
+};
+
 struct IngressVO {
   AdapterType type_;
   std::string bind_;
@@ -26,6 +43,28 @@ struct IngressVO {
   std::optional<bool> tls_;
   std::optional<std::string> certFile_;
   std::optional<std::string> keyFile_;
+  std::optional<SocketOptions> socket_;
+  std::optional<bool> udp_;
+  std::optional<AdmissionVO> admission_;
+};
+
+// Connections to the next hop established in advance, idle_ is in seconds
+struct PoolVO {
+  uint16_t size_;
+  uint16_t idle_;
+};
+
+/*
+ * Probing the next hop of an egress, interval_ and timeout_ are in seconds. The egress is down
+ *   after fall_ consecutive failures, and up again after rise_ consecutive successes. The sessions
+ *   routed to it are redirected to fallback_ while it's down, or rejected at once if absent.
+ */
+struct HealthCheckVO {
+  uint16_t interval_;
+  uint16_t timeout_;
+  uint8_t rise_;
+  uint8_t fall_;
+  std::optional<std::string> fallback_;
 };
 
 struct EgressVO {
@@ -39,15 +78,30 @@ struct EgressVO {
   std::optional<bool> tls_;
   std::optional<bool> insecure_;
   std::optional<std::string> caFile_;
+  std::optional<SocketOptions> socket_;
+  std::optional<PoolVO> pool_;
+  std::optional<uint16_t> connections_;
+  std::optional<bool> udp_;
+  std::vector<std::string> members_;
+  std::optional<Balance> balance_;
+  std::optional<HealthCheckVO> health_;
 };
 
+// Ranges, patterns and domains are kept in sets, which are patched entry by entry
 struct RuleVO {
-  std::vector<std::string> range_;
+  std::set<std::string> range_;
   std::vector<std::string> ingress_;
   std::vector<AdapterType> type_;
-  std::vector<std::string> pattern_;
-  std::vector<std::string> domain_;
+  std::set<std::string> pattern_;
+  std::set<std::string> domain_;
   std::vector<std::string> country_;
+  std::optional<std::string> file_;
+};
+
+// Only range, domain and pattern are allowed to be patched
+struct RulePatchVO {
+  RuleVO add_;
+  RuleVO remove_;
 };
 
 struct RouteVO {
@@ -55,6 +109,66 @@ struct RouteVO {
   std::vector<std::pair<std::string, std::string>> rules_;
 };
 
+struct LogVO {
+  std::optional<log::Level> level_;
+  std::optional<log::Format> format_;
+  std::optional<uint32_t> limit_;
+};
+
+// Draining an ingress, deadline_ is in seconds
+struct DrainVO {
+  uint16_t deadline_;
+};
+
+struct CountersVO {
+  uint64_t bytesIn_ = 0;
+  uint64_t bytesOut_ = 0;
+  uint64_t activeSessions_ = 0;
+  uint64_t totalSessions_ = 0;
+  uint64_t handshakeFailures_ = 0;
+  uint64_t duplicatedIvs_ = 0;
+  uint64_t rejectHits_ = 0;
+  uint64_t shedConnections_ = 0;
+  uint64_t truncatedDatagrams_ = 0;
+};
+
+// Results of the health probes, latency_ is of the last succeeded one in microseconds
+struct HealthVO {
+  bool up_ = true;
+  uint64_t probes_ = 0;
+  uint64_t failures_ = 0;
+  uint64_t latency_ = 0;
+};
+
+struct StatsVO {
+  CountersVO total_;
+  std::map<std::string, CountersVO> ingresses_;
+  std::map<std::string, CountersVO> egresses_;
+  std::map<std::string, CountersVO> rules_;
+  std::map<std::string, HealthVO> health_;
+};
+
+// Durations in microseconds
+struct HistogramVO {
+  uint64_t count_ = 0;
+  uint64_t mean_ = 0;
+  uint64_t max_ = 0;
+  uint64_t p50_ = 0;
+  uint64_t p90_ = 0;
+  uint64_t p99_ = 0;
+  uint64_t p999_ = 0;
+};
+
+struct LatencyVO {
+  HistogramVO readIV_;
+  HistogramVO readRemote_;
+  HistogramVO resolve_;
+  HistogramVO route_;
+  std::map<std::string, HistogramVO> connect_;
+  HistogramVO confirm_;
+  HistogramVO firstByte_;
+};
+
 struct ErrorVO {
   std::string_view message_;
 };
@@ -62,11 +176,22 @@ struct ErrorVO {
 extern rapidjson::Value toJson(AdapterType, rapidjson::Document::AllocatorType&);
 extern rapidjson::Value toJson(CryptoMethod, rapidjson::Document::AllocatorType&);
 extern rapidjson::Value toJson(DelayMode, rapidjson::Document::AllocatorType&);
+extern rapidjson::Value toJson(Balance, rapidjson::Document::AllocatorType&);
 extern rapidjson::Value toJson(std::string_view, rapidjson::Document::AllocatorType&);
+extern rapidjson::Value toJson(SocketOptions const&, rapidjson::Document::AllocatorType&);
+extern rapidjson::Value toJson(AdmissionVO const&, rapidjson::Document::AllocatorType&);
+extern rapidjson::Value toJson(PoolVO const&, rapidjson::Document::AllocatorType&);
+extern rapidjson::Value toJson(HealthCheckVO const&, rapidjson::Document::AllocatorType&);
 extern rapidjson::Value toJson(IngressVO const&, rapidjson::Document::AllocatorType&);
 extern rapidjson::Value toJson(EgressVO const&, rapidjson::Document::AllocatorType&);
 extern rapidjson::Value toJson(RuleVO const&, rapidjson::Document::AllocatorType&);
 extern rapidjson::Value toJson(RouteVO const&, rapidjson::Document::AllocatorType&);
+extern rapidjson::Value toJson(LogVO const&, rapidjson::Document::AllocatorType&);
+extern rapidjson::Value toJson(CountersVO const&, rapidjson::Document::AllocatorType&);
+extern rapidjson::Value toJson(HealthVO const&, rapidjson::Document::AllocatorType&);
+extern rapidjson::Value toJson(StatsVO const&, rapidjson::Document::AllocatorType&);
+extern rapidjson::Value toJson(HistogramVO const&, rapidjson::Document::AllocatorType&);
+extern rapidjson::Value toJson(LatencyVO const&, rapidjson::Document::AllocatorType&);
 extern rapidjson::Value toJson(ErrorVO const&, rapidjson::Document::AllocatorType&);
 
 template <typename InputIt>
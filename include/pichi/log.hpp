@@ -0,0 +1,61 @@
+#ifndef PICHI_LOG_HPP
+#define PICHI_LOG_HPP
+
+#include <cstdint>
+#include <initializer_list>
+#include <string_view>
+
+namespace pichi::net {
+
+struct Endpoint;
+
+} // namespace pichi::net
+
+namespace pichi::log {
+
+enum class Level { DEBUG, INFO, WARN, ERR };
+enum class Format { TEXT, JSON };
+
+struct Settings {
+  Level level_ = Level::INFO;
+  Format format_ = Format::TEXT;
+  // Maximum identical WARN/ERR records per second of each thread, 0 means unlimited
+  uint32_t limit_ = 10;
+};
+
+extern Settings settings();
+extern void configure(Settings const&);
+
+/*
+ * Records are pushed into the lock-free ring owned by the calling thread, and formatted and
+ *   written by a background thread. Records are dropped rather than blocking the caller when the
+ *   ring is full.
+ */
+extern bool enabled(Level);
+extern void write(Level, std::initializer_list<std::string_view>);
+extern void access(net::Endpoint const& remote, std::string_view ingress, std::string_view egress,
+                   std::string_view rule);
+
+template <typename... Args> void debug(Args const&... args)
+{
+  if (enabled(Level::DEBUG)) write(Level::DEBUG, {std::string_view{args}...});
+}
+
+template <typename... Args> void info(Args const&... args)
+{
+  if (enabled(Level::INFO)) write(Level::INFO, {std::string_view{args}...});
+}
+
+template <typename... Args> void warn(Args const&... args)
+{
+  if (enabled(Level::WARN)) write(Level::WARN, {std::string_view{args}...});
+}
+
+template <typename... Args> void error(Args const&... args)
+{
+  if (enabled(Level::ERR)) write(Level::ERR, {std::string_view{args}...});
+}
+
+} // namespace pichi::log
+
+#endif // PICHI_LOG_HPP
@@ -2,9 +2,12 @@
 #define PICHI_NET_ADAPTER_HPP
 
 #include <boost/asio/spawn2.hpp>
+#include <pichi/asserts.hpp>
 #include <pichi/buffer.hpp>
 #include <pichi/net/common.hpp>
+#include <pichi/slab.hpp>
 #include <stdint.h>
+#include <string>
 
 namespace pichi::net {
 
@@ -19,6 +22,10 @@ struct Adapter {
   Adapter() = default;
   virtual ~Adapter() = default;
 
+  // Recycled through the slab of the thread, since adapters are made for each connection
+  static void* operator new(size_t size) { return slab::allocate(size); }
+  static void operator delete(void* p, size_t size) noexcept { slab::deallocate(p, size); }
+
   virtual size_t recv(MutableBuffer<uint8_t>, Yield) = 0;
   virtual void send(ConstBuffer<uint8_t>, Yield) = 0;
   virtual void close() = 0;
@@ -26,15 +33,61 @@ struct Adapter {
   virtual bool writable() const = 0;
 };
 
+struct Egress;
+
+// Bytes relayed by an exchange, and whether the egress carries the next request as well
+struct Exchanged {
+  size_t in_ = 0;
+  size_t out_ = 0;
+  bool reusable_ = false;
+};
+
 struct Ingress : public Adapter {
   virtual size_t readIV(MutableBuffer<uint8_t>, Yield) { return 0; };
   virtual Endpoint readRemote(Yield) = 0;
   virtual void confirm(Yield) = 0;
   virtual void disconnect(Yield) = 0;
+
+  /*
+   * UDP ASSOCIATE of SOCKS5, requested instead of a remote to connect. The relay is bound to the
+   *   local address of the ingress, and associate replies its endpoint to the client. The ingress
+   *   is kept open until the association ends.
+   */
+  virtual bool associating() const { return false; }
+  virtual std::string localAddress() const { fail(PichiError::MISC); }
+  virtual void associate(Endpoint const&, Yield) { fail(PichiError::MISC); }
+
+  /*
+   * Keep-alive of HTTP proxy, told after each readRemote. The request read is relayed by exchange
+   *   to the egress connected to its remote, so that the next one is read and routed afterwards,
+   *   instead of bridging both adapters until either closes.
+   */
+  virtual bool persistent() const { return false; }
+  virtual Exchanged exchange(Egress&, Yield) { fail(PichiError::MISC); }
+
+  // The adapter wrapped by a forwarding one, which relays in place of the wrapper
+  virtual Ingress& underlying() { return *this; }
 };
 
 struct Egress : public Adapter {
   virtual void connect(Endpoint const& remote, Endpoint const& server, Yield) = 0;
+
+  /*
+   * Opening the transport to the next hop in advance, TLS handshake included, so that connect
+   *   only does the handshake of the proxy protocol afterwards. It's supported by the egresses
+   *   with a fixed next hop, and alive tells whether the idle transport is still usable.
+   */
+  virtual void preconnect(Endpoint const&, Yield) { fail(PichiError::MISC); }
+  virtual bool alive() { return false; }
+
+  // The adapter wrapped by a forwarding one, which relays in place of the wrapper
+  virtual Egress& underlying() { return *this; }
+
+  // Applied to the socket connecting to the next hop
+  void setOptions(SocketOptions const& options) { options_ = options; }
+
+protected:
+  SocketOptions options_ = {};
 };
 
 } // namespace pichi::net
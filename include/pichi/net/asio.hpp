@@ -54,6 +54,9 @@ namespace pichi::net {
 class Endpoint;
 class Ingress;
 class Egress;
+class SocketOptions;
+class Mux;
+class MuxClient;
 
 template <typename T> struct IsSslStream : public std::false_type {
 };
@@ -63,15 +66,20 @@ template <typename T> struct IsSslStream<boost::asio::ssl::stream<T>> : public s
 
 template <typename T> inline constexpr bool IsSslStreamV = IsSslStream<T>::value;
 
-template <typename Socket, typename Yield> void connect(Endpoint const&, Socket&, Yield);
+template <typename Socket, typename Yield>
+void connect(Endpoint const&, Socket&, SocketOptions const&, Yield);
 template <typename Socket, typename Yield> void read(Socket&, MutableBuffer<uint8_t>, Yield);
 template <typename Socket, typename Yield> size_t readSome(Socket&, MutableBuffer<uint8_t>, Yield);
 template <typename Socket, typename Yield> void write(Socket&, ConstBuffer<uint8_t>, Yield);
 template <typename Socket> void close(Socket&);
 template <typename Socket> bool isOpen(Socket const&);
+template <typename Socket> bool isAlive(Socket&);
+template <typename Socket> void setOptions(Socket&, SocketOptions const&);
 
 template <typename Socket> std::unique_ptr<Ingress> makeIngress(api::IngressVO const&, Socket&&);
 std::unique_ptr<Egress> makeEgress(api::EgressVO const&, boost::asio::io_context&);
+template <typename Socket> std::shared_ptr<Mux> makeMux(api::IngressVO const&, Socket&&);
+std::shared_ptr<MuxClient> makeMuxClient(api::EgressVO const&, boost::asio::io_context&);
 
 } // namespace pichi::net
 
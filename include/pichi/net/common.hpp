@@ -1,21 +1,79 @@
 #ifndef PICHI_NET_COMMON_HPP
 #define PICHI_NET_COMMON_HPP
 
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <optional>
+#include <pichi/buffer.hpp>
 #include <string>
+#include <string_view>
 
 namespace pichi {
 namespace net {
 
-enum class AdapterType { DIRECT, REJECT, SOCKS5, HTTP, SS };
+enum class AdapterType { DIRECT, REJECT, SOCKS5, HTTP, SS, MUX, GROUP };
 
+/*
+ * The address is kept in bytes of network order for IPv4/IPv6, and the domain name as it is, both
+ *   inline with the port in host order, so that endpoints are parsed, routed and serialized
+ *   without any heap string. Text is only formatted for resolving and logging.
+ */
 struct Endpoint {
-  enum class Type { DOMAIN_NAME, IPV4, IPV6 } type_;
-  std::string host_;
-  std::string port_;
+  enum class Type : uint8_t { DOMAIN_NAME, IPV4, IPV6 };
+
+  // The longest domain name carried by SOCKS5 and Shadowsocks
+  static size_t const MAX_HOST_SIZE = 0xff;
+
+  std::string_view domain() const
+  {
+    return {reinterpret_cast<char const*>(host_.data()), size_};
+  }
+
+  ConstBuffer<uint8_t> bytes() const { return {host_.data(), size_}; }
+
+  Type type_ = Type::DOMAIN_NAME;
+  uint8_t size_ = 0;
+  uint16_t port_ = 0;
+  std::array<uint8_t, MAX_HOST_SIZE> host_ = {};
+};
+
+inline bool operator==(Endpoint const& lhs, Endpoint const& rhs)
+{
+  return lhs.type_ == rhs.type_ && lhs.port_ == rhs.port_ && lhs.size_ == rhs.size_ &&
+         std::equal(lhs.host_.data(), lhs.host_.data() + lhs.size_, rhs.host_.data());
+}
+
+inline bool operator!=(Endpoint const& lhs, Endpoint const& rhs) { return !(lhs == rhs); }
+
+// The longest endpoint in SOCKS5 address format, which is ATYP, a domain with its length and PORT
+size_t const MAX_ADDRESS_SIZE = 1 + 1 + Endpoint::MAX_HOST_SIZE + 2;
+
+/*
+ * Options applied to the accepted or connecting TCP sockets, the OS defaults are kept for the
+ *   absent ones. keepAlive_ is the idle time in seconds before probing, and 0 disables it.
+ */
+struct SocketOptions {
+  std::optional<bool> noDelay_;
+  std::optional<uint32_t> recvBuffer_;
+  std::optional<uint32_t> sendBuffer_;
+  std::optional<uint16_t> keepAlive_;
+  std::optional<std::string> congestion_;
+  std::optional<uint32_t> notSentLowat_;
+  std::optional<uint8_t> tos_;
+  std::optional<bool> fastOpen_;
 };
 
 size_t const MAX_FRAME_SIZE = 0x3fff;
 
+// Bounds of the relay chunk, which is adapted to the traffic by ChunkSizer
+size_t const MIN_CHUNK_SIZE = 0x800;
+size_t const MAX_CHUNK_SIZE = 0x40000;
+
+// Bounds of the chunks in flight for each relay direction, and of the memory held by them
+size_t const MAX_RELAY_DEPTH = 4;
+size_t const MAX_RELAY_SIZE = 2 * MAX_CHUNK_SIZE;
+
 } // namespace net
 } // namespace pichi
 
@@ -6,7 +6,7 @@
 
 namespace pichi::net {
 
-class DirectAdapter : public Egress {
+class DirectAdapter final : public Egress {
 private:
   using Socket = boost::asio::ip::tcp::socket;
 
@@ -21,6 +21,7 @@ public:
   bool readable() const override;
   bool writable() const override;
   void connect(Endpoint const&, Endpoint const&, Yield) override;
+  bool alive() override;
 
 private:
   Socket socket_;
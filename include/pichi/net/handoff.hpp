@@ -0,0 +1,43 @@
+#ifndef PICHI_NET_HANDOFF_HPP
+#define PICHI_NET_HANDOFF_HPP
+
+#include <boost/asio/ip/tcp.hpp>
+#include <boost/asio/ip/udp.hpp>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace pichi::net {
+
+/*
+ * The listening sockets are handed over to an upgrading process through a UNIX domain socket by
+ *   SCM_RIGHTS. Each one is keyed by its protocol and the endpoint bound, such as "tcp ::1 8080",
+ *   so that the new process adopts it instead of binding again, which fails while the old one is
+ *   still draining. The sockets are shared by both processes until the old one closes its own.
+ */
+struct Listener {
+  std::string key_;
+  int fd_;
+};
+
+extern std::string listenerKey(boost::asio::ip::tcp::endpoint const&);
+extern std::string listenerKey(boost::asio::ip::udp::endpoint const&);
+
+// Sending over the connected socket, while the descriptors are still owned by the caller
+extern void sendListeners(int socket, std::vector<Listener> const&);
+
+// The descriptors received are owned by the caller
+extern std::vector<Listener> recvListeners(int socket);
+
+/*
+ * The listeners inherited are waiting to be adopted while the configuration is loaded, and the
+ *   ones not adopted, which aren't configured any more, are closed by releaseInherited. Like the
+ *   other sockets, they are only accessed by the thread running io_context.
+ */
+extern void inherit(std::vector<Listener>);
+extern std::optional<int> adopt(std::string const& key);
+extern void releaseInherited();
+
+} // namespace pichi::net
+
+#endif // PICHI_NET_HANDOFF_HPP
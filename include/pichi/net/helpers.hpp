@@ -2,13 +2,16 @@
 #define PICHI_NET_HELPERS_HPP
 
 #include <algorithm>
-#include <functional>
+#include <boost/asio/ip/address.hpp>
 #include <iterator>
+#include <pichi/asserts.hpp>
 #include <pichi/buffer.hpp>
 #include <pichi/net/adapter.hpp>
 #include <pichi/net/common.hpp>
+#include <string>
 #include <string_view>
 #include <type_traits>
+#include <utility>
 
 namespace std {
 
@@ -37,10 +40,67 @@ template <typename Int> Int ntoh(ConstBuffer<uint8_t> src)
 }
 
 extern size_t serializeEndpoint(Endpoint const&, MutableBuffer<uint8_t>);
-extern Endpoint parseEndpoint(std::function<void(MutableBuffer<uint8_t>)>);
+
+/*
+ * Endpoints in SOCKS5 address format are parsed in place from the bytes already received. The
+ *   first ENDPOINT_HEAD_SIZE bytes tell the size of the whole endpoint, so that readEndpoint
+ *   receives the rest of it by one read into the same buffer, rather than a read for each field.
+ */
+size_t const ENDPOINT_HEAD_SIZE = 2;
+
+extern size_t endpointSize(ConstBuffer<uint8_t> head);
+
+// Parsing the endpoint at the beginning of the bytes, along with the number of bytes it occupies
+extern std::pair<Endpoint, size_t> parseEndpoint(ConstBuffer<uint8_t>);
+
+/*
+ * The first received bytes of buf are the beginning of the endpoint, and read(dst) fills dst
+ *   completely. The bytes received beyond the endpoint are left in buf for the caller.
+ */
+template <typename Read>
+std::pair<Endpoint, size_t> readEndpoint(MutableBuffer<uint8_t> buf, size_t received, Read&& read)
+{
+  if (received < ENDPOINT_HEAD_SIZE) {
+    read(MutableBuffer<uint8_t>{buf.data() + received, ENDPOINT_HEAD_SIZE - received});
+    received = ENDPOINT_HEAD_SIZE;
+  }
+  auto size = endpointSize({buf, received});
+  assertTrue(size <= buf.size(), PichiError::MISC);
+  if (received < size) read(MutableBuffer<uint8_t>{buf.data() + received, size - received});
+  return parseEndpoint({buf, size});
+}
 extern Endpoint::Type detectHostType(std::string_view);
 extern Endpoint makeEndpoint(std::string_view, uint16_t);
 extern Endpoint makeEndpoint(std::string_view, std::string_view);
+extern Endpoint makeEndpoint(boost::asio::ip::address const&, uint16_t);
+
+// The address of IPv4/IPv6 endpoint, and the host of any endpoint in text
+extern boost::asio::ip::address toAddress(Endpoint const&);
+extern std::string formatHost(Endpoint const&);
+
+/*
+ * ChunkSizer doubles the relay chunk after reads keep filling it, and halves it after reads keep
+ *   leaving most of it unused. Adapters returning at most one frame by each recv, such as AEAD,
+ *   never fill a chunk larger than their frame, so that their chunk stops growing there.
+ *
+ * The depth suggests how many chunks could be in flight, which shrinks as the chunk grows so that
+ *   a bulk direction holds at most MAX_RELAY_SIZE, while at least 2 chunks keep the next recv
+ *   overlapping the previous send.
+ */
+class ChunkSizer {
+public:
+  static size_t const GROW_AFTER = 2;
+  static size_t const SHRINK_AFTER = 8;
+
+  size_t size() const { return size_; }
+  size_t depth() const;
+  void update(size_t received);
+
+private:
+  size_t size_ = MIN_CHUNK_SIZE;
+  size_t filled_ = 0;
+  size_t sparse_ = 0;
+};
 
 } // namespace pichi::net
 
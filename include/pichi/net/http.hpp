@@ -3,10 +3,13 @@
 
 #include <boost/asio/ip/tcp.hpp>
 #include <boost/beast/core/flat_buffer.hpp>
+#include <boost/beast/http/buffer_body.hpp>
 #include <boost/beast/http/empty_body.hpp>
 #include <boost/beast/http/parser.hpp>
+#include <boost/beast/http/verb.hpp>
+#include <deque>
 #include <limits>
-#include <pichi/asserts.hpp>
+#include <optional>
 #include <pichi/buffer.hpp>
 #include <pichi/net/adapter.hpp>
 #include <pichi/net/common.hpp>
@@ -27,25 +30,23 @@ using Body = boost::beast::http::empty_body;
 template <bool isRequest> using Parser = boost::beast::http::parser<isRequest, Body>;
 using RequestParser = Parser<true>;
 using ResponseParser = Parser<false>;
+template <bool isRequest>
+using RelayParser = boost::beast::http::parser<isRequest, boost::beast::http::buffer_body>;
 
-template <typename R, typename... Args> R badInvoking(Args&&...)
-{
-  using namespace std;
-  fail("Bad invocation"sv);
-}
+/*
+ * What recv and send do after the handshake, which is switched on instead of being bound to a
+ *   std::function, so that the session calling them directly doesn't pay for another
+ *   indirection. HEADER turns into RAW after the header is relayed, and FOLLOWING rewrites the
+ *   header of each request relayed.
+ */
+enum class Relaying { NONE, HEADER, RAW, FOLLOWING };
 
 } // namespace detail
 
-template <typename Stream> class HttpIngress : public Ingress {
+template <typename Stream> class HttpIngress final : public Ingress {
 public:
-  template <typename... Args>
-  HttpIngress(Args&&... args)
-    : stream_{std::forward<Args>(args)...}, confirm_{detail::badInvoking<void, Yield>},
-      send_(detail::badInvoking<void, ConstBuffer<uint8_t>, Yield>),
-      recv_(detail::badInvoking<size_t, MutableBuffer<uint8_t>, Yield>)
+  template <typename... Args> HttpIngress(Args&&... args) : stream_{std::forward<Args>(args)...}
   {
-    reqParser_.header_limit(std::numeric_limits<uint32_t>::max());
-    reqParser_.body_limit(std::numeric_limits<uint64_t>::max());
     respParser_.header_limit(std::numeric_limits<uint32_t>::max());
     respParser_.body_limit(std::numeric_limits<uint64_t>::max());
   }
@@ -67,33 +68,33 @@ public:
 
   Endpoint readRemote(Yield) override;
 
+  bool persistent() const override;
+
+  Exchanged exchange(Egress&, Yield) override;
+
 private:
   Stream stream_;
-  detail::RequestParser reqParser_;
+  // Emplaced for each request, since the parser is consumed by the exchange
+  std::optional<detail::RequestParser> reqParser_;
   detail::Cache reqCache_;
   detail::ResponseParser respParser_;
   detail::Cache respCache_;
-  std::function<void(Yield)> confirm_;
-  std::function<void(ConstBuffer<uint8_t>, Yield)> send_;
-  std::function<size_t(MutableBuffer<uint8_t>, Yield)> recv_;
+  bool persistent_ = false;
+  bool tunnel_ = false;
+  detail::Relaying sending_ = detail::Relaying::NONE;
+  detail::Relaying receiving_ = detail::Relaying::NONE;
 };
 
-template <typename Stream> class HttpEgress : public Egress {
+template <typename Stream> class HttpEgress final : public Egress {
 public:
   template <typename... Args>
   HttpEgress(Args&&... args)
     : origin_{std::forward<Args>(args)...}, backup_{std::forward<Args>(args)...},
-      stream_{std::addressof(origin_)},
-      send_(detail::badInvoking<void, ConstBuffer<uint8_t>, Yield>),
-      recv_(detail::badInvoking<size_t, MutableBuffer<uint8_t>, Yield>)
+      stream_{std::addressof(origin_)}
   {
-    reqParser_.header_limit(std::numeric_limits<uint32_t>::max());
-    reqParser_.body_limit(std::numeric_limits<uint64_t>::max());
-    respParser_.header_limit(std::numeric_limits<uint32_t>::max());
-    respParser_.body_limit(std::numeric_limits<uint64_t>::max());
   }
 
-  ~HttpEgress() override = default;
+  ~HttpEgress() override;
 
   size_t recv(MutableBuffer<uint8_t>, Yield) override;
   void send(ConstBuffer<uint8_t>, Yield) override;
@@ -101,17 +102,34 @@ public:
   bool readable() const override;
   bool writable() const override;
   void connect(Endpoint const&, Endpoint const&, Yield) override;
+  void preconnect(Endpoint const&, Yield) override;
+  bool alive() override;
 
 private:
+  void relay(ConstBuffer<uint8_t>, Yield);
+  size_t receive(MutableBuffer<uint8_t>, Yield);
+  bool idle();
+
   Stream origin_;
   Stream backup_;
+  // Taken from the connections parked by the former egresses relaying to the same upstream
+  std::optional<Stream> parked_;
   std::add_pointer_t<Stream> stream_;
-  std::function<void(ConstBuffer<uint8_t>, Yield)> send_;
-  std::function<size_t(MutableBuffer<uint8_t>, Yield)> recv_;
-  detail::RequestParser reqParser_;
+  detail::Relaying relaying_ = detail::Relaying::NONE;
+
+  /*
+   * HTTP relay follows the messages in both directions, so that the header of each request is
+   *   rewritten, and the connection resting between messages is parked on destruction.
+   */
+  std::optional<Endpoint> upstream_;
+  std::optional<detail::RequestParser> reqParser_;
+  std::optional<detail::RelayParser<true>> request_;
   detail::Cache reqCache_;
-  detail::ResponseParser respParser_;
+  std::optional<detail::RelayParser<false>> response_;
   detail::Cache respCache_;
+  std::deque<boost::beast::http::verb> pending_;
+  bool persistent_ = true;
+  bool raw_ = false;
 };
 
 } // namespace pichi::net
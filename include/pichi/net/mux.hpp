@@ -0,0 +1,195 @@
+#ifndef PICHI_NET_MUX_HPP
+#define PICHI_NET_MUX_HPP
+
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/steady_timer.hpp>
+#include <boost/asio/strand.hpp>
+#include <functional>
+#include <memory>
+#include <pichi/net/adapter.hpp>
+#include <pichi/net/common.hpp>
+#include <unordered_map>
+#include <vector>
+
+namespace pichi::net {
+
+/*
+ * Mux carries many sessions over one connection, like smux or yamux. Each frame starts with a
+ *   header of 8 bytes:
+ *
+ *   +-----+-----+--------+-----------+
+ *   | VER | CMD | LENGTH | STREAM ID |
+ *   +-----+-----+--------+-----------+
+ *   |  1  |  1  |   2    |     4     |
+ *   +-----+-----+--------+-----------+
+ *
+ *   - SYN opens a stream, with the remote endpoint serialized as SOCKS5 in the payload,
+ *   - PSH carries at most MAX_FRAME_SIZE bytes of the stream,
+ *   - UPD grants the peer more credits by the 4-byte increment in the payload,
+ *   - FIN closes the stream in both directions.
+ *
+ * Each direction of a stream is allowed MUX_WINDOW bytes not consumed by the receiver yet, so
+ *   that a slow session never stalls the others sharing the connection. The server keeps at most
+ *   MUX_MAX_STREAMS streams open per connection, and answers any SYN over that with FIN.
+ */
+enum class MuxCommand : uint8_t { SYN = 0, PSH = 1, UPD = 2, FIN = 3 };
+
+struct MuxHeader {
+  MuxCommand cmd_;
+  uint16_t length_;
+  uint32_t id_;
+};
+
+uint8_t const MUX_VERSION = 0;
+size_t const MUX_HEADER_SIZE = 8;
+size_t const MUX_WINDOW = 0x40000;
+size_t const MUX_MAX_STREAMS = 1024;
+
+extern void serializeMuxHeader(MuxHeader const&, MutableBuffer<uint8_t>);
+extern MuxHeader parseMuxHeader(ConstBuffer<uint8_t>);
+
+struct MuxStream;
+
+/*
+ * Mux is one connection shared by the streams, which are only created by the client side. The
+ *   reading coroutine dispatches the frames to the streams, and the writing one sends the frames
+ *   queued by the streams in batches.
+ */
+class Mux : public std::enable_shared_from_this<Mux> {
+public:
+  using Yield = boost::asio::yield_context;
+  using StreamPtr = std::shared_ptr<MuxStream>;
+
+private:
+  void enqueue(MuxHeader const&, ConstBuffer<uint8_t> = {});
+  void readLoop(Yield);
+  void writeLoop(Yield);
+
+protected:
+  bool client() const { return client_; }
+  void dispatch(MuxHeader const&, ConstBuffer<uint8_t>);
+
+  virtual void handshake(Yield) = 0;
+  virtual void read(MutableBuffer<uint8_t>, Yield) = 0;
+  virtual void write(ConstBuffer<uint8_t>, Yield) = 0;
+  virtual void shutdown() = 0;
+
+public:
+  Mux(Mux const&) = delete;
+  Mux(Mux&&) = delete;
+  Mux& operator=(Mux const&) = delete;
+  Mux& operator=(Mux&&) = delete;
+
+  Mux(boost::asio::io_context&, bool client);
+  virtual ~Mux();
+
+  void start();
+  void close();
+  bool closed() const;
+  size_t streams() const;
+
+  StreamPtr open(Endpoint const& remote);
+  // The stream opened by the peer, or nullptr if the connection is closed
+  StreamPtr accept(Yield);
+
+  size_t recv(MuxStream&, MutableBuffer<uint8_t>, Yield);
+  void send(MuxStream&, ConstBuffer<uint8_t>, Yield);
+  void close(MuxStream&);
+
+private:
+  boost::asio::io_context::strand strand_;
+  bool client_;
+  bool closed_ = false;
+  uint32_t nextId_ = 1;
+  std::unordered_map<uint32_t, StreamPtr> streams_ = {};
+  std::vector<StreamPtr> accepted_ = {};
+  std::vector<uint8_t> outbox_ = {};
+  boost::asio::steady_timer writable_;
+  boost::asio::steady_timer acceptable_;
+};
+
+template <typename Socket> class MuxOver : public Mux {
+protected:
+  void handshake(Yield) override;
+  void read(MutableBuffer<uint8_t>, Yield) override;
+  void write(ConstBuffer<uint8_t>, Yield) override;
+  void shutdown() override;
+
+public:
+  template <typename... Args>
+  MuxOver(boost::asio::io_context& io, bool client, Args&&... args)
+    : Mux{io, client}, socket_{std::forward<Args>(args)...}
+  {
+  }
+
+  ~MuxOver() override = default;
+
+  void connect(Endpoint const&, SocketOptions const&, Yield);
+
+private:
+  Socket socket_;
+};
+
+/*
+ * MuxClient keeps at most the configured number of connections to the server, opening a new
+ *   one until reaching it, and then putting a new stream on the least loaded one. Acquiring
+ *   fails once all of them carry MUX_MAX_STREAMS streams, which the server would refuse.
+ */
+class MuxClient {
+public:
+  using Yield = boost::asio::yield_context;
+  using Dial = std::function<std::shared_ptr<Mux>(Yield)>;
+
+  MuxClient(boost::asio::io_context&, size_t connections, Dial);
+
+  std::shared_ptr<Mux> acquire(Yield);
+  void close();
+
+private:
+  size_t connections_;
+  Dial dial_;
+  std::vector<std::shared_ptr<Mux>> muxes_ = {};
+  size_t dialing_ = 0;
+  boost::asio::steady_timer dialed_;
+};
+
+class MuxIngress final : public Ingress {
+public:
+  MuxIngress(std::shared_ptr<Mux>, Mux::StreamPtr);
+  ~MuxIngress() override;
+
+  size_t recv(MutableBuffer<uint8_t>, Yield) override;
+  void send(ConstBuffer<uint8_t>, Yield) override;
+  void close() override;
+  bool readable() const override;
+  bool writable() const override;
+  Endpoint readRemote(Yield) override;
+  void confirm(Yield) override;
+  void disconnect(Yield) override;
+
+private:
+  std::shared_ptr<Mux> mux_;
+  Mux::StreamPtr stream_;
+};
+
+class MuxEgress final : public Egress {
+public:
+  explicit MuxEgress(std::shared_ptr<MuxClient>);
+  ~MuxEgress() override;
+
+  size_t recv(MutableBuffer<uint8_t>, Yield) override;
+  void send(ConstBuffer<uint8_t>, Yield) override;
+  void close() override;
+  bool readable() const override;
+  bool writable() const override;
+  void connect(Endpoint const& remote, Endpoint const& server, Yield) override;
+
+private:
+  std::shared_ptr<MuxClient> client_;
+  std::shared_ptr<Mux> mux_;
+  Mux::StreamPtr stream_;
+};
+
+} // namespace pichi::net
+
+#endif // PICHI_NET_MUX_HPP
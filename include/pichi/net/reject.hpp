@@ -6,7 +6,7 @@
 
 namespace pichi::net {
 
-class RejectEgress : public Egress {
+class RejectEgress final : public Egress {
 private:
   using Timer = boost::asio::system_timer;
 
@@ -6,7 +6,7 @@
 
 namespace pichi::net {
 
-template <typename Stream> class Socks5Adapter : public Ingress, public Egress {
+template <typename Stream> class Socks5Adapter final : public Ingress, public Egress {
 public:
   template <typename... Args> Socks5Adapter(Args&&... args) : stream_{std::forward<Args>(args)...}
   {
@@ -20,11 +20,17 @@ public:
   bool writable() const override;
   Endpoint readRemote(Yield) override;
   void connect(Endpoint const& remote, Endpoint const& next, Yield) override;
+  void preconnect(Endpoint const& next, Yield) override;
+  bool alive() override;
   void confirm(Yield) override;
   void disconnect(Yield) override;
+  bool associating() const override;
+  std::string localAddress() const override;
+  void associate(Endpoint const& relay, Yield) override;
 
 private:
   Stream stream_;
+  bool associating_ = false;
 };
 
 } // namespace pichi::net
@@ -9,7 +9,7 @@
 namespace pichi::net {
 
 template <crypto::CryptoMethod method, typename Stream>
-class SSAeadAdapter : public Ingress, public Egress {
+class SSAeadAdapter final : public Ingress, public Egress {
 private:
   using Cache = boost::beast::basic_flat_buffer<std::allocator<uint8_t>>;
 
@@ -32,6 +32,8 @@ public:
   size_t readIV(MutableBuffer<uint8_t>, Yield) override;
   Endpoint readRemote(Yield) override;
   void connect(Endpoint const& remote, Endpoint const& next, Yield) override;
+  void preconnect(Endpoint const& next, Yield) override;
+  bool alive() override;
   void confirm(Yield) override;
   void disconnect(Yield) override;
 
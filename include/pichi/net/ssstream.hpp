@@ -8,7 +8,7 @@
 namespace pichi::net {
 
 template <crypto::CryptoMethod method, typename Stream>
-class SSStreamAdapter : public Ingress, public Egress {
+class SSStreamAdapter final : public Ingress, public Egress {
 public:
   inline static constexpr crypto::CryptoMethod METHOD = method;
 
@@ -29,6 +29,8 @@ public:
   void confirm(Yield) override;
   void disconnect(Yield) override;
   void connect(Endpoint const& remote, Endpoint const& server, Yield) override;
+  void preconnect(Endpoint const& server, Yield) override;
+  bool alive() override;
 
 private:
   Stream stream_;
@@ -0,0 +1,51 @@
+#ifndef PICHI_NET_SSUDP_HPP
+#define PICHI_NET_SSUDP_HPP
+
+#include <array>
+#include <memory>
+#include <pichi/buffer.hpp>
+#include <pichi/crypto/method.hpp>
+#include <pichi/net/udp.hpp>
+#include <string_view>
+
+namespace pichi::net {
+
+/*
+ * Shadowsocks UDP seals each datagram independently, with its own random salt, so that nothing
+ *   is shared among the datagrams except the key:
+ *
+ *   +------+-----------------------------------+-----+
+ *   | SALT | encrypted [ATYP ADDR PORT] + DATA | TAG |
+ *   +------+-----------------------------------+-----+
+ *
+ * Only AEAD methods are supported, and the datagram is sealed or opened in place.
+ */
+class SSUdpCodec {
+public:
+  virtual ~SSUdpCodec() = default;
+
+  // Encrypting the datagram, and then moving the offset before the salt prepended
+  virtual void seal(Datagram&) = 0;
+  // Decrypting the datagram, leaving the address and the data
+  virtual void open(Datagram&) = 0;
+};
+
+template <crypto::CryptoMethod method> class SSAeadUdpCodec : public SSUdpCodec {
+public:
+  inline static constexpr crypto::CryptoMethod METHOD = method;
+
+  explicit SSAeadUdpCodec(ConstBuffer<uint8_t> psk);
+  ~SSAeadUdpCodec() override = default;
+
+  void seal(Datagram&) override;
+  void open(Datagram&) override;
+
+private:
+  std::array<uint8_t, crypto::KEY_SIZE<method>> psk_;
+};
+
+extern std::shared_ptr<SSUdpCodec> makeSSUdpCodec(crypto::CryptoMethod, std::string_view password);
+
+} // namespace pichi::net
+
+#endif // PICHI_NET_SSUDP_HPP
@@ -0,0 +1,94 @@
+#ifndef PICHI_NET_UDP_HPP
+#define PICHI_NET_UDP_HPP
+
+#include <array>
+#include <boost/asio/ip/udp.hpp>
+#include <boost/asio/spawn2.hpp>
+#include <memory>
+#include <pichi/buffer.hpp>
+#include <pichi/net/common.hpp>
+#include <utility>
+#include <vector>
+
+namespace pichi::net {
+
+/*
+ * The room reserved before each datagram, which is enough for the longest header of SOCKS5 UDP
+ *   requests, or for the salt and the address of Shadowsocks UDP ones, so that the header is
+ *   prepended without moving the payload:
+ *
+ *   +-----+------+------+----------+----------+----------+
+ *   | RSV | FRAG | ATYP | DST.ADDR | DST.PORT |   DATA   |
+ *   +-----+------+------+----------+----------+----------+
+ *   |  2  |  1   |  1   | Variable |    2     | Variable |
+ *   +-----+------+------+----------+----------+----------+
+ *
+ *   +------+------+----------+----------+----------+-----+
+ *   | SALT | ATYP | DST.ADDR | DST.PORT |   DATA   | TAG |
+ *   +------+------+----------+----------+----------+-----+
+ *   | 32-  |  1   | Variable |    2     | Variable | 16  |
+ *   +------+------+----------+----------+----------+-----+
+ */
+size_t const UDP_HEADER_ROOM = 0x20 + MAX_ADDRESS_SIZE;
+size_t const UDP_TRAILER_ROOM = 0x10;
+// The largest datagram received, including its header, which bounds the memory of each batch
+size_t const MAX_DATAGRAM_SIZE = 0x1000;
+
+struct Datagram {
+  boost::asio::ip::udp::endpoint peer_ = {};
+  size_t offset_ = 0;
+  size_t size_ = 0;
+  std::array<uint8_t, UDP_HEADER_ROOM + MAX_DATAGRAM_SIZE + UDP_TRAILER_ROOM> buf_ = {};
+
+  MutableBuffer<uint8_t> data() { return {buf_.data() + offset_, size_}; }
+};
+
+/*
+ * Datagrams received or sent by one system call, recvmmsg/sendmmsg, if available. Otherwise,
+ *   receiving returns one datagram each time, and sending does one call for each datagram. The
+ *   datagrams received are forwarded in place, by moving the offset over the header or before
+ *   the prepended one and replacing the peer. The buffers are only swapped among the batches,
+ *   so that each batch keeps its capacity.
+ */
+class DatagramBatch {
+public:
+  using Yield = boost::asio::yield_context;
+  using Socket = boost::asio::ip::udp::socket;
+
+  static size_t const CAPACITY = 16;
+
+  explicit DatagramBatch(size_t capacity = CAPACITY);
+
+  Datagram& operator[](size_t i) { return *datagrams_[i]; }
+  size_t size() const { return size_; }
+
+  // Removing the i-th datagram, the order of the others is kept
+  void drop(size_t i);
+  // Appending the i-th datagram to another batch, which returns one of its free buffers
+  void moveTo(size_t i, DatagramBatch&);
+
+  /*
+   * Receiving at least one datagram at the offset of each buffer, the truncated ones, larger than
+   *   MAX_DATAGRAM_SIZE, are dropped and returned as the number of them
+   */
+  size_t receive(Socket&, size_t offset, Yield);
+  // Sending each datagram to its peer, the failed ones are dropped as UDP does
+  void send(Socket&, Yield);
+
+private:
+  std::vector<std::unique_ptr<Datagram>> datagrams_;
+  size_t size_ = 0;
+};
+
+// Parsing the address leading the datagram, returning the endpoint and the address length
+extern std::pair<Endpoint, size_t> parseUdpAddress(ConstBuffer<uint8_t>);
+// Prepending the address to the datagram
+extern void prependUdpAddress(Endpoint const&, Datagram&);
+// Parsing the SOCKS5 UDP request header, returning the destination and the header length
+extern std::pair<Endpoint, size_t> parseUdpHeader(ConstBuffer<uint8_t>);
+// Prepending the SOCKS5 UDP request header to the datagram
+extern void prependUdpHeader(Endpoint const&, Datagram&);
+
+} // namespace pichi::net
+
+#endif // PICHI_NET_UDP_HPP
@@ -0,0 +1,47 @@
+#ifndef PICHI_SLAB_HPP
+#define PICHI_SLAB_HPP
+
+#include <memory>
+#include <stddef.h>
+#include <utility>
+
+namespace pichi::slab {
+
+/*
+ * Per-thread free lists of blocks in classes of GRANULARITY bytes, which the objects made for
+ *   each connection are recycled through, so that the churn of connections costs no malloc once
+ *   the lists are warmed up. Blocks are pushed back to the list of the thread releasing them,
+ *   each list keeps up to MAX_FREE blocks, and the sizes beyond MAX_SIZE go to the heap as usual.
+ */
+inline size_t const GRANULARITY = 64;
+inline size_t const MAX_SIZE = 4096;
+inline size_t const MAX_FREE = 1024;
+
+extern void* allocate(size_t);
+extern void deallocate(void*, size_t) noexcept;
+
+// Blocks held by the free lists of the calling thread
+extern size_t cached();
+
+template <typename T> struct Allocator {
+  using value_type = T;
+
+  Allocator() = default;
+  template <typename U> Allocator(Allocator<U> const&) {}
+
+  T* allocate(size_t n) { return static_cast<T*>(slab::allocate(n * sizeof(T))); }
+  void deallocate(T* p, size_t n) noexcept { slab::deallocate(p, n * sizeof(T)); }
+
+  template <typename U> bool operator==(Allocator<U> const&) const { return true; }
+  template <typename U> bool operator!=(Allocator<U> const&) const { return false; }
+};
+
+// The object shared is allocated with its control block in one block of the slab
+template <typename T, typename... Args> std::shared_ptr<T> makeShared(Args&&... args)
+{
+  return std::allocate_shared<T>(Allocator<T>{}, std::forward<Args>(args)...);
+}
+
+} // namespace pichi::slab
+
+#endif // PICHI_SLAB_HPP
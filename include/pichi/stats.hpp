@@ -0,0 +1,116 @@
+#ifndef PICHI_STATS_HPP
+#define PICHI_STATS_HPP
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace pichi::stats {
+
+enum class Counter {
+  BYTES_IN,
+  BYTES_OUT,
+  OPENED_SESSIONS,
+  CLOSED_SESSIONS,
+  HANDSHAKE_FAILURES,
+  DUPLICATED_IVS,
+  REJECT_HITS,
+  SHED_CONNECTIONS,
+  TRUNCATED_DATAGRAMS,
+  COUNT
+};
+
+using Values = std::array<uint64_t, static_cast<size_t>(Counter::COUNT)>;
+
+class Counters {
+public:
+  void add(Counter c, uint64_t n = 1)
+  {
+    values_[static_cast<size_t>(c)].fetch_add(n, std::memory_order_relaxed);
+  }
+
+  Values load() const;
+
+private:
+  std::array<std::atomic<uint64_t>, static_cast<size_t>(Counter::COUNT)> values_ = {};
+};
+
+/*
+ * Counters are sharded by the calling thread and keyed by (ingress, egress, rule), whose
+ *   reference stays valid for the whole process, so that it should be looked up once and cached
+ *   by the session. Egress and rule are empty if the session fails before being routed, and the
+ *   rule is empty if it's routed by default.
+ */
+extern Counters& counters(std::string_view ingress, std::string_view egress = {},
+                          std::string_view rule = {});
+
+struct Sample {
+  std::string ingress_;
+  std::string egress_;
+  std::string rule_;
+  Values values_;
+};
+
+// Aggregating all shards on demand, samples are sorted by (ingress, egress, rule)
+extern std::vector<Sample> collect();
+
+using Clock = std::chrono::steady_clock;
+
+// Stages of the connection setup, connecting is recorded separately by each egress
+enum class Stage { READ_IV, READ_REMOTE, RESOLVE, ROUTE, CONFIRM, FIRST_BYTE, COUNT };
+
+// Durations in microseconds
+struct Summary {
+  uint64_t count_;
+  uint64_t mean_;
+  uint64_t max_;
+  uint64_t p50_;
+  uint64_t p90_;
+  uint64_t p99_;
+  uint64_t p999_;
+};
+
+/*
+ * Log-linear histogram in the HDR style with fixed memory. Each power of 2 is split into 16
+ *   linear sub-buckets, so that recorded values are kept within 1/16 relative error. Recording
+ *   is lock-free and resetting is not synchronized with recording.
+ */
+class Histogram {
+public:
+  static constexpr size_t SUB_BITS = 4;
+  static constexpr size_t SUB_SIZE = 1 << SUB_BITS;
+  // Durations beyond 2^36us (about 19 hours) are recorded as the maximum
+  static constexpr size_t MAX_BITS = 36;
+  static constexpr size_t SIZE = (MAX_BITS - SUB_BITS + 1) * SUB_SIZE;
+
+  static size_t index(uint64_t);
+  static uint64_t upper(size_t);
+
+  void record(Clock::duration);
+  Summary summary() const;
+  void reset();
+
+private:
+  std::array<std::atomic<uint64_t>, SIZE> buckets_ = {};
+  std::atomic<uint64_t> sum_ = 0;
+  std::atomic<uint64_t> max_ = 0;
+};
+
+extern Histogram& histogram(Stage);
+
+// The reference stays valid for the whole process, so that it should be cached by the session
+extern Histogram& connecting(std::string_view egress);
+
+// Summaries of connecting histograms sorted by egress name
+extern std::vector<std::pair<std::string, Summary>> connectings();
+
+extern void resetHistograms();
+
+} // namespace pichi::stats
+
+#endif // PICHI_STATS_HPP
@@ -26,7 +26,7 @@ namespace sys = boost::system;
 static auto const PID_FILE = (fs::path{PICHI_PREFIX} / "var" / "run" / "pichi.pid");
 static auto const LOG_FILE = (fs::path{PICHI_PREFIX} / "var" / "log" / "pichi.log");
 
-extern void run(string const&, uint16_t, string const&, string const&);
+extern void run(string const&, uint16_t, string const&, string const&, string const&, uint16_t);
 
 #ifdef HAS_UNISTD_H
 
@@ -62,6 +62,8 @@ int main(int argc, char const* argv[])
   auto geo = string{};
   auto user = string{};
   auto group = string{};
+  auto handoff = string{};
+  auto drain = uint16_t{};
   auto desc = po::options_description{"Allow options"};
   desc.add_options()("help,h", "produce help message")(
       "listen,l", po::value<string>(&listen)->default_value("::1"),
@@ -77,6 +79,12 @@ int main(int argc, char const* argv[])
 #if defined(HAS_SETGID) && defined(HAS_GETGRNAM)
               ("group", po::value<string>(&group), "run as group")
 #endif // HAS_SETGID && HAS_GETGRNAM
+#ifdef HAS_SCM_RIGHTS
+                  ("handoff", po::value<string>(&handoff),
+                   "UNIX socket handing the listening sockets over when upgrading")(
+                      "drain", po::value<uint16_t>(&drain)->default_value(60),
+                      "Deadline of draining after handing over(seconds)")
+#endif // HAS_SCM_RIGHTS
       ;
   auto vm = po::variables_map{};
 
@@ -133,7 +141,7 @@ int main(int argc, char const* argv[])
     }
 #endif // HAS_SETUID && HAS_GETPWNAM
 
-    run(listen, port, json, geo);
+    run(listen, port, json, geo, handoff, drain);
     return 0;
   }
   catch (exception const& e) {
@@ -0,0 +1,61 @@
+#include <boost/program_options.hpp>
+#include <fstream>
+#include <iostream>
+#include <pichi/api/rule_set.hpp>
+#include <string>
+#include <vector>
+
+using namespace std;
+namespace po = boost::program_options;
+
+/*
+ * Compiling text rule lists into the rule set file referenced by "file" field of rules. Each line
+ *   of the inputs is a domain name, an IP address or an IP range in CIDR notation. Empty lines and
+ *   the ones starting with '#' are ignored.
+ */
+int main(int argc, char const* argv[])
+{
+  auto output = string{};
+  auto inputs = vector<string>{};
+  auto desc = po::options_description{"Allow options"};
+  desc.add_options()("help,h", "produce help message")(
+      "output,o", po::value<string>(&output), "rule set file")(
+      "input,i", po::value<vector<string>>(&inputs), "text rule list, one entry per line");
+  auto positional = po::positional_options_description{};
+  positional.add("input", -1);
+  auto vm = po::variables_map{};
+
+  try {
+    po::store(po::command_line_parser(argc, argv).options(desc).positional(positional).run(), vm);
+    po::notify(vm);
+
+    if (vm.count("help") || !vm.count("output") || inputs.empty()) {
+      cout << "Usage: pichi-rules -o OUTPUT INPUT..." << endl << desc << endl;
+      return 1;
+    }
+
+    auto builder = pichi::api::RuleSetBuilder{};
+    auto count = size_t{0};
+    for (auto&& input : inputs) {
+      auto ifs = ifstream{input};
+      if (!ifs) {
+        cout << "ERROR: failed to open " << input << endl;
+        return 1;
+      }
+      for (auto line = string{}; getline(ifs, line);) {
+        line.erase(line.find_last_not_of(" \t\r") + 1);
+        line.erase(0, line.find_first_not_of(" \t"));
+        if (line.empty() || line[0] == '#') continue;
+        builder.add(line);
+        ++count;
+      }
+    }
+    builder.write(output.c_str());
+    cout << count << " entries compiled into " << output << endl;
+    return 0;
+  }
+  catch (exception const& e) {
+    cout << "ERROR: " << e.what() << endl;
+    return 1;
+  }
+}
@@ -26,6 +26,14 @@
 #include <signal.h>
 #endif // HAS_SIGNAL_H
 
+#ifdef HAS_SCM_RIGHTS
+#include <boost/asio/local/stream_protocol.hpp>
+#include <boost/asio/read.hpp>
+#include <boost/asio/write.hpp>
+#include <boost/filesystem/operations.hpp>
+#include <pichi/net/handoff.hpp>
+#endif // HAS_SCM_RIGHTS
+
 using namespace std;
 using namespace pichi;
 namespace asio = boost::asio;
@@ -34,6 +42,7 @@ namespace fs = boost::filesystem;
 namespace http = boost::beast::http;
 namespace ip = asio::ip;
 namespace json = rapidjson;
+namespace sys = boost::system;
 
 using ip::tcp;
 
@@ -41,7 +50,10 @@ static decltype(auto) INGRESSES = "ingresses";
 static decltype(auto) EGRESSES = "egresses";
 static decltype(auto) RULES = "rules";
 static decltype(auto) ROUTE = "route";
+static decltype(auto) ADMISSION = "admission";
 static decltype(auto) INDENT = "  ";
+// Told by the upgrading process once its configuration is loaded
+static auto const READY = '!';
 
 static asio::io_context io{1};
 static auto alloc = json::Document::AllocatorType{};
@@ -60,7 +72,8 @@ public:
 
   vector<string> get(string const& target);
   void put(string const& target, string const& body);
-  void del(string const& target);
+  // Whether it's deleted, which fails only if it's still used by others
+  bool del(string const& target);
 
 private:
   net::Endpoint endpoint_;
@@ -114,7 +127,7 @@ void HttpHelper::put(string const& target, string const& body)
   if (resp.result() != http::status::no_content) cout << INDENT << target << " NOT loaded" << endl;
 }
 
-void HttpHelper::del(string const& target)
+bool HttpHelper::del(string const& target)
 {
   auto s = tcp::socket{io};
   net::connect(endpoint_, s, yield_);
@@ -128,7 +141,8 @@ void HttpHelper::del(string const& target)
   auto buf = beast::flat_static_buffer<1024>{};
   auto resp = http::response<http::string_body>{};
   http::async_read(s, buf, resp, yield_);
-  assertTrue(resp.result() == http::status::no_content);
+  assertTrue(resp.result() == http::status::no_content || resp.result() == http::status::forbidden);
+  return resp.result() == http::status::no_content;
 }
 
 static auto genDirect() { return "{\"type\":\"direct\"}"; }
@@ -182,6 +196,8 @@ static void load(HttpHelper& helper, string const& fn)
     helper.put("/"s + ROUTE, toString(json[ROUTE]));
   else
     cout << INDENT << ROUTE << " NOT loaded" << endl;
+  // The global limits are optional, which are unlimited if absent
+  if (json.HasMember(ADMISSION)) helper.put("/"s + ADMISSION, toString(json[ADMISSION]));
   cout << "Configuration " << fn << " loaded" << endl;
 }
 
@@ -189,27 +205,119 @@ static void flush(HttpHelper& helper)
 {
   helper.put("/"s + EGRESSES + "/direct", genDirect());
   helper.put("/"s + ROUTE, genRoute());
+  helper.put("/"s + ADMISSION, "{}");
 
   for (auto&& rule : helper.get("/"s + RULES)) helper.del("/"s + RULES + "/" + rule);
-  for (auto&& egress : helper.get("/"s + EGRESSES))
-    if (egress != "direct") helper.del("/"s + EGRESSES + "/" + egress);
+  // The members and fallbacks can't be deleted until the groups and egresses using them are
+  auto egresses = helper.get("/"s + EGRESSES);
+  egresses.erase(remove(begin(egresses), end(egresses), "direct"), end(egresses));
+  while (!egresses.empty()) {
+    auto used = vector<string>{};
+    for (auto&& egress : egresses)
+      if (!helper.del("/"s + EGRESSES + "/" + egress)) used.push_back(egress);
+    assertTrue(used.size() < egresses.size());
+    egresses = move(used);
+  }
   for (auto&& ingress : helper.get("/"s + INGRESSES)) helper.del("/"s + INGRESSES + "/" + ingress);
 
   cout << "Configuration reset" << endl;
 }
 
-void run(string const& bind, uint16_t port, string const& fn, string const& mmdb)
+#ifdef HAS_SCM_RIGHTS
+
+using Local = asio::local::stream_protocol;
+
+// Connected to the old process until this one is ready
+static auto upgrading = Local::socket{io};
+
+// Inheriting the listeners of the old process serving the handoff path, if any
+static void inherit(string const& path)
+{
+  auto ec = sys::error_code{};
+  upgrading.connect(Local::endpoint{path}, ec);
+  if (ec) {
+    upgrading.close(ec);
+    return;
+  }
+  net::inherit(net::recvListeners(upgrading.native_handle()));
+  cout << "Listeners inherited from " << path << endl;
+}
+
+// The listeners not configured any more are closed, and the old process starts draining
+static void ready()
 {
+  net::releaseInherited();
+  if (!upgrading.is_open()) return;
+  auto ec = sys::error_code{};
+  asio::write(upgrading, asio::buffer(&READY, 1), ec);
+  upgrading.close(ec);
+}
+
+/*
+ * Handing the listeners over to each upgrading process connected, which serves API from then on.
+ *   This process drains and stops once the new one is ready, or listens to API again if the new
+ *   one fails before that.
+ */
+static void handoff(api::Server& server, string const& bind, uint16_t port, string const& path,
+                    chrono::seconds deadline)
+{
+  auto ec = sys::error_code{};
+  fs::remove(path, ec);
+  net::spawn(io, [&server, bind, port, deadline,
+                  acceptor = Local::acceptor{io, Local::endpoint{path}}](auto yield) mutable {
+    while (acceptor.is_open()) {
+      auto peer = acceptor.async_accept(yield);
+      auto reply = char{};
+      auto handed = false;
+      auto ec = sys::error_code{};
+      try {
+        // Blocking for a moment, since the listeners are only a few
+        peer.non_blocking(false);
+        net::sendListeners(peer.native_handle(), server.listeners());
+        server.unlisten();
+        handed = true;
+        asio::async_read(peer, asio::buffer(&reply, 1), yield[ec]);
+      }
+      catch (sys::system_error const& e) {
+        ec = e.code();
+      }
+      if (!ec && reply == READY) {
+        cout << "Draining for the upgraded process" << endl;
+        acceptor.close();
+        server.drain(deadline, []() { io.stop(); });
+        return;
+      }
+      cout << "Upgrade failed, still serving" << endl;
+      if (handed) server.listen(bind, port);
+    }
+  });
+}
+
+#endif // HAS_SCM_RIGHTS
+
+void run(string const& bind, uint16_t port, string const& fn, string const& mmdb,
+         string const& path, uint16_t deadline)
+{
+#ifdef HAS_SCM_RIGHTS
+  if (!path.empty()) inherit(path);
+#endif // HAS_SCM_RIGHTS
   auto server = api::Server{io, mmdb.c_str()};
   server.listen(bind, port);
 
   // FIXME load & flush aren't designed to be the atomic operations.
   net::spawn(
       io,
-      [=](auto yield) {
+      [=, &server](auto yield) {
         auto helper = HttpHelper{bind, port, yield};
         load(helper, fn);
 
+#ifdef HAS_SCM_RIGHTS
+        if (!path.empty()) {
+          ready();
+          handoff(server, bind, port, path, chrono::seconds{deadline});
+        }
+#endif // HAS_SCM_RIGHTS
+
 #if defined(HAS_SIGNAL_H) && defined(SIGHUP)
         auto ss = asio::signal_set{io};
         while (true) {
@@ -0,0 +1,191 @@
+#include <algorithm>
+#include <pichi/api/admission.hpp>
+#include <pichi/asserts.hpp>
+#include <pichi/net/adapter.hpp>
+#include <utility>
+#include <vector>
+
+using namespace std;
+namespace asio = boost::asio;
+
+namespace pichi::api {
+
+class AdmittedIngress final : public net::Ingress {
+public:
+  AdmittedIngress(unique_ptr<net::Ingress> ingress, Admission::Ticket ticket)
+    : ingress_{move(ingress)}, ticket_{move(ticket)}
+  {
+    ticket_.hold(ingress_.get());
+  }
+
+  size_t recv(MutableBuffer<uint8_t> buf, Yield yield) override
+  {
+    return ingress_->recv(buf, yield);
+  }
+
+  void send(ConstBuffer<uint8_t> buf, Yield yield) override { ingress_->send(buf, yield); }
+  void close() override { ingress_->close(); }
+  bool readable() const override { return ingress_->readable(); }
+  bool writable() const override { return ingress_->writable(); }
+
+  size_t readIV(MutableBuffer<uint8_t> iv, Yield yield) override
+  {
+    return ingress_->readIV(iv, yield);
+  }
+
+  net::Endpoint readRemote(Yield yield) override { return ingress_->readRemote(yield); }
+
+  void confirm(Yield yield) override
+  {
+    ingress_->confirm(yield);
+    ticket_.handshaken();
+  }
+
+  void disconnect(Yield yield) override { ingress_->disconnect(yield); }
+  bool associating() const override { return ingress_->associating(); }
+  string localAddress() const override { return ingress_->localAddress(); }
+
+  void associate(net::Endpoint const& relay, Yield yield) override
+  {
+    ingress_->associate(relay, yield);
+    ticket_.handshaken();
+  }
+
+  bool persistent() const override { return ingress_->persistent(); }
+
+  net::Exchanged exchange(net::Egress& egress, Yield yield) override
+  {
+    ticket_.handshaken();
+    return ingress_->exchange(egress, yield);
+  }
+
+  net::Ingress& underlying() override { return ingress_->underlying(); }
+
+private:
+  unique_ptr<net::Ingress> ingress_;
+  Admission::Ticket ticket_;
+};
+
+Admission::Ticket::Ticket(shared_ptr<Admission> ingress, shared_ptr<Admission> global)
+  : admissions_{move(ingress), move(global)}
+{
+  for (auto&& admission : admissions_) {
+    ++admission->sessions_;
+    ++admission->handshakes_;
+  }
+}
+
+Admission::Ticket::Ticket(Ticket&& ticket) noexcept
+  : admissions_{move(ticket.admissions_)}, handshaking_{ticket.handshaking_},
+    adapter_{exchange(ticket.adapter_, nullptr)}
+{
+}
+
+Admission::Ticket& Admission::Ticket::operator=(Ticket&& ticket) noexcept
+{
+  if (this != &ticket) {
+    release();
+    admissions_ = move(ticket.admissions_);
+    handshaking_ = ticket.handshaking_;
+    adapter_ = exchange(ticket.adapter_, nullptr);
+  }
+  return *this;
+}
+
+Admission::Ticket::~Ticket() { release(); }
+
+void Admission::Ticket::handshaken()
+{
+  if (!handshaking_) return;
+  handshaking_ = false;
+  for (auto&& admission : admissions_)
+    if (admission != nullptr) --admission->handshakes_;
+}
+
+void Admission::Ticket::hold(net::Adapter* adapter)
+{
+  assertTrue(adapter_ == nullptr && adapter != nullptr, PichiError::MISC);
+  adapter_ = adapter;
+  for (auto&& admission : admissions_)
+    if (admission != nullptr) admission->adapters_.insert(adapter_);
+}
+
+void Admission::Ticket::release()
+{
+  handshaken();
+  for (auto&& admission : admissions_) {
+    if (admission == nullptr) continue;
+    if (adapter_ != nullptr) admission->adapters_.erase(adapter_);
+    if (--admission->sessions_ == 0 && admission->drain_ != nullptr) admission->drain_->cancel();
+    admission.reset();
+  }
+  adapter_ = nullptr;
+}
+
+optional<Admission::Ticket> Admission::admit(shared_ptr<Admission> const& ingress,
+                                             shared_ptr<Admission> const& global,
+                                             Clock::time_point now)
+{
+  assertFalse(ingress == nullptr || global == nullptr, PichiError::MISC);
+  // Checking both before taking any token, so that a shed connection costs no token
+  if (ingress->full(now) || global->full(now)) return {};
+  if (ingress->limits_.rate_.has_value()) ingress->tokens_ -= 1.0;
+  if (global->limits_.rate_.has_value()) global->tokens_ -= 1.0;
+  return make_optional<Ticket>(ingress, global);
+}
+
+Admission::Admission(AdmissionVO limits) { configure(move(limits)); }
+
+void Admission::configure(AdmissionVO limits)
+{
+  limits_ = move(limits);
+  tokens_ = limits_.rate_.value_or(0);
+  refilled_ = Clock::now();
+}
+
+bool Admission::full(Clock::time_point now)
+{
+  if (limits_.rate_.has_value()) {
+    auto rate = static_cast<double>(*limits_.rate_);
+    auto elapsed = chrono::duration<double>{now - refilled_}.count();
+    tokens_ = min(rate, tokens_ + max(elapsed, 0.0) * rate);
+    refilled_ = max(now, refilled_);
+  }
+  return (limits_.sessions_.has_value() && sessions_ >= *limits_.sessions_) ||
+         (limits_.handshakes_.has_value() && handshakes_ >= *limits_.handshakes_) ||
+         (limits_.rate_.has_value() && tokens_ < 1.0);
+}
+
+AdmissionVO const& Admission::limits() const { return limits_; }
+
+size_t Admission::sessions() const { return sessions_; }
+
+size_t Admission::handshakes() const { return handshakes_; }
+
+void Admission::drain(asio::io_context& io, chrono::seconds deadline, function<void()> done)
+{
+  if (drain_ != nullptr) return;
+  drain_ = make_shared<asio::steady_timer>(io, deadline);
+  // Either expired or cancelled by the last session ended
+  drain_->async_wait([self = shared_from_this(), done = move(done)](auto) {
+    self->close();
+    done();
+  });
+  if (sessions_ == 0) drain_->cancel();
+}
+
+bool Admission::draining() const { return drain_ != nullptr; }
+
+void Admission::close()
+{
+  // Copied, since the adapters might leave once closed
+  auto adapters = vector<net::Adapter*>{cbegin(adapters_), cend(adapters_)};
+  for (auto adapter : adapters) adapter->close();
+}
+
+unique_ptr<net::Ingress> admit(unique_ptr<net::Ingress> ingress, Admission::Ticket ticket)
+{
+  return make_unique<AdmittedIngress>(move(ingress), move(ticket));
+}
+
+} // namespace pichi::api
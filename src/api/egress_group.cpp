@@ -0,0 +1,122 @@
+#include <algorithm>
+#include <functional>
+#include <pichi/api/egress_group.hpp>
+#include <pichi/asserts.hpp>
+#include <pichi/net/adapter.hpp>
+#include <utility>
+
+using namespace std;
+using Clock = chrono::steady_clock;
+
+namespace pichi::api {
+
+class TrackedEgress final : public net::Egress {
+public:
+  TrackedEgress(unique_ptr<net::Egress> egress, shared_ptr<EgressLoad> load)
+    : egress_{move(egress)}, load_{move(load)}
+  {
+    ++load_->sessions_;
+  }
+
+  ~TrackedEgress() override { --load_->sessions_; }
+
+  size_t recv(MutableBuffer<uint8_t> buf, Yield yield) override
+  {
+    return egress_->recv(buf, yield);
+  }
+
+  void send(ConstBuffer<uint8_t> buf, Yield yield) override { egress_->send(buf, yield); }
+  void close() override { egress_->close(); }
+  bool readable() const override { return egress_->readable(); }
+  bool writable() const override { return egress_->writable(); }
+
+  void connect(net::Endpoint const& remote, net::Endpoint const& server, Yield yield) override
+  {
+    auto start = Clock::now();
+    try {
+      egress_->connect(remote, server, yield);
+    }
+    catch (...) {
+      load_->record(Clock::now() - start, true);
+      throw;
+    }
+    load_->record(Clock::now() - start);
+  }
+
+  bool alive() override { return egress_->alive(); }
+  net::Egress& underlying() override { return egress_->underlying(); }
+
+private:
+  unique_ptr<net::Egress> egress_;
+  shared_ptr<EgressLoad> load_;
+};
+
+// The finalizer of SplitMix64, spreading the combined hashes evenly
+static uint64_t mix(uint64_t x)
+{
+  x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ull;
+  x = (x ^ (x >> 27)) * 0x94d049bb133111ebull;
+  return x ^ (x >> 31);
+}
+
+void EgressLoad::record(chrono::nanoseconds elapsed, bool failed)
+{
+  if (failed) elapsed = max<chrono::nanoseconds>(elapsed, FAILURE_PENALTY);
+  auto sample = chrono::duration<double, micro>{elapsed}.count();
+  // Smoothed with the same gain as the RTT of TCP
+  latency_ = latency_ == 0.0 ? sample : latency_ + (sample - latency_) / 8;
+}
+
+unique_ptr<net::Egress> track(unique_ptr<net::Egress> egress, shared_ptr<EgressLoad> load)
+{
+  return make_unique<TrackedEgress>(move(egress), move(load));
+}
+
+EgressGroup::EgressGroup(vector<Member> members, Balance balance)
+  : members_{move(members)}, balance_{balance}
+{
+  assertFalse(members_.empty(), PichiError::MISC);
+  transform(cbegin(members_), cend(members_), back_inserter(hashes_),
+            [](auto&& member) { return hash<string>{}(member.name_); });
+}
+
+double EgressGroup::cost(size_t i) const
+{
+  auto&& load = *members_[i].load_;
+  auto sessions = static_cast<double>(load.sessions_ + 1);
+  return balance_ == Balance::LATENCY ? (load.latency_ + 1.0) * sessions : sessions;
+}
+
+bool EgressGroup::prefer(size_t i, size_t j, size_t key) const
+{
+  switch (balance_) {
+  case Balance::ROUND_ROBIN:
+    return false;
+  case Balance::LEAST_SESSIONS:
+  case Balance::LATENCY:
+    return cost(i) < cost(j);
+  case Balance::HASH:
+    return mix(key ^ hashes_[i]) > mix(key ^ hashes_[j]);
+  default:
+    fail(PichiError::MISC);
+  }
+}
+
+string_view EgressGroup::pick(net::Endpoint const& remote, Available const& available)
+{
+  auto n = members_.size();
+  auto first = next_++ % n;
+  // Availability is ignored if all members are down, since there's nowhere else to go
+  auto filtered = available && any_of(cbegin(members_), cend(members_),
+                                      [&](auto&& member) { return available(member.name_); });
+  auto key = balance_ == Balance::HASH ? hash<string_view>{}(remote.domain()) : size_t{0};
+  auto best = n;
+  for (auto k = size_t{0}; k < n && (best == n || balance_ != Balance::ROUND_ROBIN); ++k) {
+    auto i = (first + k) % n;
+    if (filtered && !available(members_[i].name_)) continue;
+    if (best == n || prefer(i, best, key)) best = i;
+  }
+  return members_[best].name_;
+}
+
+} // namespace pichi::api
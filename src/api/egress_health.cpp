@@ -0,0 +1,93 @@
+#include <boost/asio/bind_executor.hpp>
+#include <boost/asio/io_context.hpp>
+#include <chrono>
+#include <exception>
+#include <pichi/api/egress_health.hpp>
+#include <pichi/asserts.hpp>
+#include <pichi/log.hpp>
+#include <pichi/net/adapter.hpp>
+#include <pichi/net/asio.hpp>
+#include <pichi/net/helpers.hpp>
+#include <pichi/net/spawn.hpp>
+
+using namespace std;
+namespace asio = boost::asio;
+namespace sys = boost::system;
+using Clock = chrono::steady_clock;
+
+namespace pichi::api {
+
+EgressHealth::EgressHealth(asio::io_context& io, string name, EgressVO const& vo)
+  : strand_{io}, name_{move(name)}, vo_{vo}, next_{net::makeEndpoint(*vo.host_, *vo.port_)},
+    timer_{io}
+{
+  assertTrue(vo_.health_.has_value(), PichiError::MISC);
+}
+
+/*
+ * The deadline closes the probing egress, which aborts the pending preconnecting. The deadline
+ *   handler holds the egress, so that it's still valid even after the coroutine moves on.
+ */
+template <typename Yield> void EgressHealth::probe(Yield yield)
+{
+  auto interval = chrono::seconds{vo_.health_->interval_};
+  auto timeout = chrono::seconds{vo_.health_->timeout_};
+  while (!stopped_) {
+    auto egress = shared_ptr<net::Egress>{net::makeEgress(vo_, strand_.context())};
+    auto deadline = make_shared<asio::steady_timer>(strand_.context(), timeout);
+    deadline->async_wait(asio::bind_executor(strand_, [egress](auto ec) {
+      if (!ec) egress->close();
+    }));
+    auto start = Clock::now();
+    try {
+      egress->preconnect(next_, yield);
+      deadline->cancel();
+      status_.latency_ = chrono::duration_cast<chrono::microseconds>(Clock::now() - start).count();
+      report(true);
+    }
+    catch (exception const& e) {
+      deadline->cancel();
+      if (stopped_) break;
+      // A down egress fails every probe, so only the transitions reported are warned
+      log::debug("Egress ", name_, " probe failed: ", e.what());
+      report(false);
+    }
+    egress->close();
+
+    // Exceptions prohibited
+    auto ec = sys::error_code{};
+    timer_.expires_after(interval);
+    timer_.async_wait(yield[ec]);
+  }
+}
+
+void EgressHealth::report(bool succeeded)
+{
+  ++status_.probes_;
+  if (!succeeded) ++status_.failures_;
+
+  // streak_ counts the consecutive results against the current state
+  streak_ = succeeded != status_.up_ ? streak_ + 1 : 0;
+  auto threshold = status_.up_ ? vo_.health_->fall_ : vo_.health_->rise_;
+  if (streak_ < threshold) return;
+  status_.up_ = !status_.up_;
+  streak_ = 0;
+  log::warn("Egress ", name_, status_.up_ ? " is up" : " is down");
+}
+
+void EgressHealth::start()
+{
+  net::spawn(strand_, [self = shared_from_this()](auto yield) { self->probe(yield); });
+}
+
+void EgressHealth::stop()
+{
+  stopped_ = true;
+  timer_.cancel();
+}
+
+bool EgressHealth::up() const { return status_.up_; }
+
+HealthVO const& EgressHealth::status() const { return status_; }
+
+} // namespace pichi::api
@@ -1,22 +1,165 @@
 #include "config.h"
+#include <algorithm>
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/ip/tcp.hpp>
+#include <pichi/api/egress_health.hpp>
 #include <pichi/api/egress_manager.hpp>
+#include <pichi/api/egress_pool.hpp>
+#include <pichi/asserts.hpp>
+#include <pichi/net/adapter.hpp>
+#include <pichi/net/asio.hpp>
+#include <pichi/net/common.hpp>
+#include <pichi/net/mux.hpp>
 
 using namespace std;
+namespace asio = boost::asio;
+using asio::ip::tcp;
 
 namespace pichi::api {
 
+static auto const IMMEDIATE_EJECTOR =
+    EgressVO{AdapterType::REJECT, {}, {}, {}, {}, DelayMode::FIXED, 0};
+
+EgressManager::EgressManager(asio::io_context& io) : io_{io} {}
+
+EgressManager::~EgressManager()
+{
+  for (auto&& [name, pool] : pools_) pool->stop();
+  for (auto&& [name, mux] : muxes_) mux->close();
+  for (auto&& [name, health] : healths_) health->stop();
+}
+
 void EgressManager::update(string const& name, EgressVO vo)
 {
+  if (vo.type_ == AdapterType::GROUP) {
+    // Groups are never nested, nor contain themselves
+    assertFalse(isMember(name), PichiError::SEMANTIC_ERROR, "Nested egress group");
+    for (auto&& member : vo.members_) {
+      auto it = find(member);
+      assertFalse(it == end(), PichiError::SEMANTIC_ERROR, "Unknown egress");
+      assertFalse(member == name || it->second.type_ == AdapterType::GROUP,
+                  PichiError::SEMANTIC_ERROR, "Nested egress group");
+    }
+  }
+  if (vo.health_.has_value() && vo.health_->fallback_.has_value()) {
+    auto&& fallback = *vo.health_->fallback_;
+    assertFalse(fallback == name || find(fallback) == end(), PichiError::SEMANTIC_ERROR,
+                "Unknown egress");
+  }
 #ifndef ENABLE_TLS
   assertFalse(vo.tls_.has_value() && *vo.tls_, PichiError::SEMANTIC_ERROR, "TLS not supported");
 #endif // ENABLE_TLS
+  if (vo.socket_.has_value()) {
+    // A profile unsupported by the OS is rejected here rather than failing every connection
+    auto io = asio::io_context{};
+    auto socket = tcp::socket{io, tcp::v4()};
+    net::setOptions(socket, *vo.socket_);
+  }
+
+  // The connections made with the previous configuration are dropped
+  auto it = pools_.find(name);
+  if (it != std::end(pools_)) {
+    it->second->stop();
+    pools_.erase(it);
+  }
+  auto mux = muxes_.find(name);
+  if (mux != std::end(muxes_)) {
+    mux->second->close();
+    muxes_.erase(mux);
+  }
+  auto health = healths_.find(name);
+  if (health != std::end(healths_)) {
+    health->second->stop();
+    healths_.erase(health);
+  }
+  if (vo.pool_.has_value()) {
+    auto pool = make_shared<EgressPool>(io_, vo);
+    pool->start();
+    pools_.emplace(name, move(pool));
+  }
+  if (vo.type_ == AdapterType::MUX) muxes_.emplace(name, net::makeMuxClient(vo, io_));
+  if (vo.health_.has_value()) {
+    auto checker = make_shared<EgressHealth>(io_, name, vo);
+    checker->start();
+    healths_.emplace(name, move(checker));
+  }
+  groups_.erase(name);
+  if (vo.type_ == AdapterType::GROUP) {
+    // The load of a member is shared by all groups containing it
+    auto members = vector<EgressGroup::Member>{};
+    for (auto&& member : vo.members_) {
+      auto& load = loads_[member];
+      if (load == nullptr) load = make_shared<EgressLoad>();
+      members.push_back({member, load});
+    }
+    groups_.emplace(name, EgressGroup{move(members), *vo.balance_});
+  }
   c_[name] = move(vo);
+  prune();
 }
 
 void EgressManager::erase(string_view name)
 {
+  assertFalse(isUsed(name), PichiError::RES_IN_USE);
+  auto pool = pools_.find(name);
+  if (pool != std::end(pools_)) {
+    pool->second->stop();
+    pools_.erase(pool);
+  }
+  auto mux = muxes_.find(name);
+  if (mux != std::end(muxes_)) {
+    mux->second->close();
+    muxes_.erase(mux);
+  }
+  auto health = healths_.find(name);
+  if (health != std::end(healths_)) {
+    health->second->stop();
+    healths_.erase(health);
+  }
+  auto group = groups_.find(name);
+  if (group != std::end(groups_)) groups_.erase(group);
   auto it = find(name);
   if (it != end()) c_.erase(it);
+  prune();
+}
+
+void EgressManager::prune()
+{
+  // The egresses no longer grouped aren't tracked, while the sessions still keep their loads
+  for (auto it = std::begin(loads_); it != std::end(loads_);)
+    it = isMember(it->first) ? next(it) : loads_.erase(it);
+}
+
+unique_ptr<net::Egress> EgressManager::make(string_view name)
+{
+  auto it = find(name);
+  assertFalse(it == end(), PichiError::MISC);
+  if (!isUp(name)) return net::makeEgress(IMMEDIATE_EJECTOR, io_);
+
+  auto egress = unique_ptr<net::Egress>{};
+  auto pool = pools_.find(name);
+  if (pool != std::end(pools_)) egress = pool->second->take();
+  auto mux = muxes_.find(name);
+  if (egress == nullptr && mux != std::end(muxes_))
+    egress = make_unique<net::MuxEgress>(mux->second);
+  if (egress == nullptr) egress = net::makeEgress(it->second, io_);
+
+  auto load = loads_.find(name);
+  return load == std::end(loads_) ? move(egress) : track(move(egress), load->second);
+}
+
+string_view EgressManager::pick(string_view name, net::Endpoint const& remote)
+{
+  auto available = [this](auto member) { return isUp(member); };
+  auto group = groups_.find(name);
+  if (group != std::end(groups_)) name = group->second.pick(remote, available);
+  if (isUp(name)) return name;
+
+  // Only one hop of fallback, which is never checked for its own fallback
+  auto&& fallback = find(name)->second.health_->fallback_;
+  if (!fallback.has_value()) return name;
+  group = groups_.find(*fallback);
+  return group == std::end(groups_) ? *fallback : group->second.pick(remote, available);
 }
 
 EgressManager::ConstIterator EgressManager::begin() const noexcept { return cbegin(c_); }
@@ -25,4 +168,33 @@ EgressManager::ConstIterator EgressManager::end() const noexcept { return cend(c
 
 EgressManager::ConstIterator EgressManager::find(string_view name) const { return c_.find(name); }
 
+bool EgressManager::isMember(string_view name) const
+{
+  return any_of(cbegin(c_), cend(c_), [name](auto&& item) {
+    auto&& members = item.second.members_;
+    return std::find(cbegin(members), cend(members), name) != cend(members);
+  });
+}
+
+bool EgressManager::isUsed(string_view name) const
+{
+  return isMember(name) || any_of(cbegin(c_), cend(c_), [name](auto&& item) {
+           auto&& health = item.second.health_;
+           return health.has_value() && health->fallback_ == name;
+         });
+}
+
+bool EgressManager::isUp(string_view name) const
+{
+  auto it = healths_.find(name);
+  return it == std::end(healths_) || it->second->up();
+}
+
+map<string, HealthVO> EgressManager::health() const
+{
+  auto ret = map<string, HealthVO>{};
+  for (auto&& [name, checker] : healths_) ret.emplace(name, checker->status());
+  return ret;
+}
+
 } // namespace pichi::api
\ No newline at end of file
@@ -0,0 +1,112 @@
+#include <boost/asio/io_context.hpp>
+#include <exception>
+#include <pichi/api/egress_pool.hpp>
+#include <pichi/asserts.hpp>
+#include <pichi/net/adapter.hpp>
+#include <pichi/net/asio.hpp>
+#include <pichi/net/helpers.hpp>
+#include <pichi/net/spawn.hpp>
+
+using namespace std;
+namespace asio = boost::asio;
+namespace sys = boost::system;
+
+namespace pichi::api {
+
+static auto const RETRY_INTERVAL = 5s;
+static auto const CHECK_INTERVAL = 10s;
+
+EgressPool::EgressPool(asio::io_context& io, EgressVO const& vo)
+  : strand_{io}, vo_{vo}, next_{net::makeEndpoint(*vo.host_, *vo.port_)},
+    signal_{io, asio::steady_timer::time_point::max()}
+{
+  assertTrue(vo_.pool_.has_value(), PichiError::MISC);
+}
+
+EgressPool::~EgressPool() { clear(); }
+
+template <typename Yield> void EgressPool::wait(Clock::time_point deadline, Yield yield)
+{
+  // Exceptions prohibited
+  auto ec = sys::error_code{};
+  signal_.expires_at(deadline);
+  signal_.async_wait(yield[ec]);
+}
+
+/*
+ * Failing to connect the next hop is retried after a while rather than immediately, so that an
+ *   unreachable server doesn't keep the pool spinning.
+ */
+template <typename Yield> void EgressPool::refill(Yield yield)
+{
+  auto idle = chrono::seconds{vo_.pool_->idle_};
+  while (!stopped_) {
+    purge();
+    if (warm_.size() < vo_.pool_->size_) {
+      auto egress = net::makeEgress(vo_, strand_.context());
+      try {
+        egress->preconnect(next_, yield);
+        warm_.push_back({move(egress), Clock::now() + idle});
+      }
+      catch (...) {
+        net::logException(current_exception());
+        if (!stopped_) wait(Clock::now() + RETRY_INTERVAL, yield);
+      }
+    }
+    else {
+      wait(min(warm_.front().expiry_, Clock::now() + CHECK_INTERVAL), yield);
+    }
+  }
+  clear();
+}
+
+void EgressPool::purge()
+{
+  auto now = Clock::now();
+  for (auto it = begin(warm_); it != end(warm_);) {
+    if (it->expiry_ > now && it->egress_->alive()) {
+      ++it;
+    }
+    else {
+      it->egress_->close();
+      it = warm_.erase(it);
+    }
+  }
+}
+
+void EgressPool::clear()
+{
+  for (auto&& warm : warm_) warm.egress_->close();
+  warm_.clear();
+}
+
+void EgressPool::start()
+{
+  net::spawn(strand_, [self = shared_from_this()](auto yield) { self->refill(yield); });
+}
+
+void EgressPool::stop()
+{
+  stopped_ = true;
+  signal_.cancel();
+  clear();
+}
+
+EgressPool::EgressPtr EgressPool::take()
+{
+  auto now = Clock::now();
+  auto ret = EgressPtr{};
+  while (!warm_.empty() && ret == nullptr) {
+    auto warm = move(warm_.back());
+    warm_.pop_back();
+    if (warm.expiry_ > now && warm.egress_->alive())
+      ret = move(warm.egress_);
+    else
+      warm.egress_->close();
+  }
+  // Waking up the refilling coroutine to replace the taken one
+  signal_.cancel();
+  return ret;
+}
+
+} // namespace pichi::api
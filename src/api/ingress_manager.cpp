@@ -1,15 +1,60 @@
 #include "config.h"
+#include <boost/asio/post.hpp>
 #include <pichi/api/ingress_manager.hpp>
 #include <pichi/asserts.hpp>
+#include <pichi/net/asio.hpp>
+#include <pichi/net/common.hpp>
+#include <pichi/net/handoff.hpp>
 
 using namespace std;
 namespace asio = boost::asio;
 namespace ip = asio::ip;
 namespace sys = boost::system;
 using ip::tcp;
+using ip::udp;
 
 namespace pichi::api {
 
+/*
+ * The socket options are applied before listening, so that the buffer sizes are settled for the
+ *   handshakes of the accepted sockets, and that a profile unsupported by the OS is rejected here.
+ *   The one inherited from the process upgraded is already listening, which is adopted as it is.
+ */
+static tcp::acceptor createAcceptor(asio::io_context& io, IngressVO const& vo)
+{
+  auto endpoint = tcp::endpoint{ip::make_address(vo.bind_), vo.port_};
+  if (auto fd = net::adopt(net::listenerKey(endpoint)); fd.has_value()) {
+    auto acceptor = tcp::acceptor{io, endpoint.protocol(), *fd};
+    if (vo.socket_.has_value()) net::setOptions(acceptor, *vo.socket_);
+    return acceptor;
+  }
+  auto acceptor = tcp::acceptor{io, endpoint.protocol()};
+  acceptor.set_option(tcp::acceptor::reuse_address(true));
+  if (vo.socket_.has_value()) net::setOptions(acceptor, *vo.socket_);
+  acceptor.bind(endpoint);
+  acceptor.listen();
+  return acceptor;
+}
+
+/*
+ * The UDP socket is shared with the sessions relaying its datagrams, which stop once it's closed
+ *   along with the ingress.
+ */
+static shared_ptr<udp::socket> createUdpSocket(asio::io_context& io, IngressVO const& vo)
+{
+  if (vo.type_ != AdapterType::SS || !vo.udp_.value_or(false)) return nullptr;
+  auto endpoint = udp::endpoint{ip::make_address(vo.bind_), vo.port_};
+  if (auto fd = net::adopt(net::listenerKey(endpoint)); fd.has_value())
+    return make_shared<udp::socket>(io, endpoint.protocol(), *fd);
+  return make_shared<udp::socket>(io, endpoint);
+}
+
+static void closeUdpSocket(shared_ptr<udp::socket> const& socket)
+{
+  auto ec = sys::error_code{};
+  if (socket != nullptr) socket->close(ec);
+}
+
 IngressManager::IngressManager(boost::asio::io_context& io, Handler onChange)
   : io_{io}, onChange_{onChange}, c_{}
 {
@@ -17,7 +62,7 @@ IngressManager::IngressManager(boost::asio::io_context& io, Handler onChange)
 
 IngressManager::ValueType IngressManager::generatePair(DelegateIterator it)
 {
-  return make_pair(cref(it->first), cref(it->second.first));
+  return make_pair(cref(it->first), cref(get<0>(it->second)));
 }
 
 IngressManager::ConstIterator IngressManager::begin() const noexcept
@@ -38,25 +83,70 @@ void IngressManager::update(string const& name, IngressVO ivo)
   assertFalse(ivo.tls_.has_value() && *ivo.tls_, PichiError::SEMANTIC_ERROR, "TLS not supported");
 #endif // ENABLE_TLS
 
+  auto limits = ivo.admission_.value_or(AdmissionVO{});
   auto it = c_.find(name);
   if (it == std::end(c_)) {
-    auto p = c_.try_emplace(
-        name, make_pair(move(ivo), Acceptor{io_, {ip::make_address(ivo.bind_), ivo.port_}}));
+    auto acceptor = createAcceptor(io_, ivo);
+    auto socket = createUdpSocket(io_, ivo);
+    auto admission = make_shared<Admission>(move(limits));
+    auto p = c_.try_emplace(name,
+                            make_tuple(move(ivo), move(acceptor), move(socket), move(admission)));
     assertTrue(p.second, PichiError::MISC);
     it = p.first;
   }
   else {
-    it->second = make_pair(move(ivo), Acceptor{io_, {ip::make_address(ivo.bind_), ivo.port_}});
+    auto acceptor = createAcceptor(io_, ivo);
+    auto socket = createUdpSocket(io_, ivo);
+    closeUdpSocket(get<2>(it->second));
+    // The draining one is left to the sessions accepted before
+    auto admission = get<3>(it->second);
+    if (admission->draining())
+      admission = make_shared<Admission>(move(limits));
+    else
+      admission->configure(move(limits));
+    it->second = make_tuple(move(ivo), move(acceptor), move(socket), move(admission));
   }
   auto&& [iname, v] = *it;
-  auto&& [vo, acceptor] = v;
-  invoke(onChange_, acceptor, iname, vo);
+  auto&& [vo, acceptor, socket, admission] = v;
+  invoke(onChange_, acceptor, socket, admission, iname, vo);
 }
 
 void IngressManager::erase(string_view name)
 {
   auto it = c_.find(name);
-  if (it != std::end(c_)) c_.erase(it);
+  if (it == std::end(c_)) return;
+  closeUdpSocket(get<2>(it->second));
+  c_.erase(it);
+}
+
+void IngressManager::drain(string_view name, chrono::seconds deadline)
+{
+  auto it = c_.find(name);
+  if (it == std::end(c_)) return;
+  auto&& [vo, acceptor, socket, admission] = it->second;
+  auto ec = sys::error_code{};
+  acceptor.close(ec);
+  closeUdpSocket(socket);
+  admission->drain(io_, deadline, [this, name = string{name}, weak = weak_ptr{admission}]() {
+    // Posted, so that the sessions closed at the deadline are unwound before erasing
+    asio::post(io_, [this, name, weak]() {
+      auto it = c_.find(name);
+      if (it != std::end(c_) && get<3>(it->second) == weak.lock()) erase(name);
+    });
+  });
+}
+
+vector<net::Listener> IngressManager::listeners()
+{
+  auto ret = vector<net::Listener>{};
+  for (auto&& [name, v] : c_) {
+    auto&& [vo, acceptor, socket, admission] = v;
+    if (acceptor.is_open())
+      ret.push_back({net::listenerKey(acceptor.local_endpoint()), acceptor.native_handle()});
+    if (socket != nullptr && socket->is_open())
+      ret.push_back({net::listenerKey(socket->local_endpoint()), socket->native_handle()});
+  }
+  return ret;
 }
 
 } // namespace pichi::api
@@ -1,7 +1,10 @@
+#include <pichi/api/admission.hpp>
 #include <pichi/api/egress_manager.hpp>
 #include <pichi/api/ingress_manager.hpp>
 #include <pichi/api/rest.hpp>
 #include <pichi/api/router.hpp>
+#include <pichi/log.hpp>
+#include <pichi/stats.hpp>
 #include <rapidjson/stringbuffer.h>
 #include <rapidjson/writer.h>
 #include <sstream>
@@ -16,11 +19,36 @@ namespace pichi::api {
 
 static auto const INGRESS_REGEX = regex{"^/ingresses/?([?#].*)?$"};
 static auto const INGRESS_NAME_REGEX = regex{"^/ingresses/([^?#/]+)/?([?#].*)?$"};
+static auto const INGRESS_DRAIN_REGEX = regex{"^/ingresses/([^?#/]+)/drain/?([?#].*)?$"};
 static auto const EGRESS_REGEX = regex{"^/egresses/?([?#].*)?$"};
 static auto const EGRESS_NAME_REGEX = regex{"^/egresses/([^?#]+)/?([?#].*)?$"};
 static auto const RULE_REGEX = regex{"^/rules/?([?#].*)?$"};
 static auto const RULE_NAME_REGEX = regex{"^/rules/([^?#]+)/?([?#].*)?$"};
 static auto const ROUTE_REGEX = regex{"^/route/?([?#].*)?$"};
+static auto const LOG_REGEX = regex{"^/log/?([?#].*)?$"};
+static auto const STATS_REGEX = regex{"^/stats/?([?#].*)?$"};
+static auto const METRICS_REGEX = regex{"^/metrics/?([?#].*)?$"};
+static auto const LATENCY_REGEX = regex{"^/latency/?([?#].*)?$"};
+static auto const ADMISSION_REGEX = regex{"^/admission/?([?#].*)?$"};
+
+// Active sessions are exported separately, which are derived from opened and closed ones
+static auto const METRICS = array<tuple<stats::Counter, string_view, string_view>, 8>{
+    make_tuple(stats::Counter::BYTES_IN, "pichi_bytes_in_total"sv,
+               "Bytes received from ingresses"sv),
+    make_tuple(stats::Counter::BYTES_OUT, "pichi_bytes_out_total"sv,
+               "Bytes received from egresses"sv),
+    make_tuple(stats::Counter::OPENED_SESSIONS, "pichi_sessions_total"sv,
+               "Sessions ever created"sv),
+    make_tuple(stats::Counter::HANDSHAKE_FAILURES, "pichi_handshake_failures_total"sv,
+               "Connections failed before relaying"sv),
+    make_tuple(stats::Counter::DUPLICATED_IVS, "pichi_duplicated_ivs_total"sv,
+               "Connections with duplicated IVs"sv),
+    make_tuple(stats::Counter::REJECT_HITS, "pichi_reject_hits_total"sv,
+               "Sessions routed to reject egresses"sv),
+    make_tuple(stats::Counter::SHED_CONNECTIONS, "pichi_shed_connections_total"sv,
+               "Connections closed on accepting for the admission limits"sv),
+    make_tuple(stats::Counter::TRUNCATED_DATAGRAMS, "pichi_truncated_datagrams_total"sv,
+               "Datagrams dropped for exceeding the datagram buffer"sv)};
 
 static auto doc = json::Document{};
 static auto& alloc = doc.GetAllocator();
@@ -75,6 +103,139 @@ static auto options(initializer_list<http::verb>&& verbs)
   return resp;
 }
 
+static auto getLog()
+{
+  auto settings = log::settings();
+  return genResp(http::status::ok, LogVO{settings.level_, settings.format_, settings.limit_});
+}
+
+static auto putLog(Rest::Request const& req)
+{
+  auto vo = parse<LogVO>(req.body());
+  auto settings = log::settings();
+  if (vo.level_.has_value()) settings.level_ = *vo.level_;
+  if (vo.format_.has_value()) settings.format_ = *vo.format_;
+  if (vo.limit_.has_value()) settings.limit_ = *vo.limit_;
+  log::configure(settings);
+  return genResp(http::status::no_content);
+}
+
+static void accumulate(CountersVO& cvo, stats::Values const& values)
+{
+  auto at = [&values](auto c) { return values[static_cast<size_t>(c)]; };
+  cvo.bytesIn_ += at(stats::Counter::BYTES_IN);
+  cvo.bytesOut_ += at(stats::Counter::BYTES_OUT);
+  cvo.activeSessions_ += at(stats::Counter::OPENED_SESSIONS) - at(stats::Counter::CLOSED_SESSIONS);
+  cvo.totalSessions_ += at(stats::Counter::OPENED_SESSIONS);
+  cvo.handshakeFailures_ += at(stats::Counter::HANDSHAKE_FAILURES);
+  cvo.duplicatedIvs_ += at(stats::Counter::DUPLICATED_IVS);
+  cvo.rejectHits_ += at(stats::Counter::REJECT_HITS);
+  cvo.shedConnections_ += at(stats::Counter::SHED_CONNECTIONS);
+  cvo.truncatedDatagrams_ += at(stats::Counter::TRUNCATED_DATAGRAMS);
+}
+
+static auto getStats(EgressManager const& egresses)
+{
+  auto vo = StatsVO{};
+  vo.health_ = egresses.health();
+  for (auto&& sample : stats::collect()) {
+    accumulate(vo.total_, sample.values_);
+    accumulate(vo.ingresses_[sample.ingress_], sample.values_);
+    // Sessions failed before routing are only counted by ingress
+    if (!sample.egress_.empty()) accumulate(vo.egresses_[sample.egress_], sample.values_);
+    if (!sample.rule_.empty()) accumulate(vo.rules_[sample.rule_], sample.values_);
+  }
+  return genResp(http::status::ok, vo);
+}
+
+static void appendLabel(string& buf, string_view key, string_view value)
+{
+  buf.append(key).append("=\"");
+  for (auto c : value) {
+    switch (c) {
+    case '\\':
+      buf.append("\\\\");
+      break;
+    case '"':
+      buf.append("\\\"");
+      break;
+    case '\n':
+      buf.append("\\n");
+      break;
+    default:
+      buf.push_back(c);
+    }
+  }
+  buf.append("\"");
+}
+
+static void appendSample(string& buf, string_view name, stats::Sample const& sample,
+                         uint64_t value)
+{
+  buf.append(name).append("{");
+  appendLabel(buf, "ingress"sv, sample.ingress_);
+  buf.append(",");
+  appendLabel(buf, "egress"sv, sample.egress_);
+  buf.append(",");
+  appendLabel(buf, "rule"sv, sample.rule_);
+  buf.append("} ").append(to_string(value)).append("\n");
+}
+
+static auto getMetrics(EgressManager const& egresses)
+{
+  auto samples = stats::collect();
+  auto at = [](auto&& sample, auto c) { return sample.values_[static_cast<size_t>(c)]; };
+  auto buf = string{};
+  auto header = [&buf](auto name, auto help, auto type) {
+    buf.append("# HELP ").append(name).append(" ").append(help).append("\n");
+    buf.append("# TYPE ").append(name).append(" ").append(type).append("\n");
+  };
+
+  for (auto [counter, name, help] : METRICS) {
+    header(name, help, "counter"sv);
+    for (auto&& sample : samples) appendSample(buf, name, sample, at(sample, counter));
+  }
+
+  header("pichi_active_sessions"sv, "Sessions being relayed or handshaking"sv, "gauge"sv);
+  for (auto&& sample : samples)
+    appendSample(buf, "pichi_active_sessions"sv, sample,
+                 at(sample, stats::Counter::OPENED_SESSIONS) -
+                     at(sample, stats::Counter::CLOSED_SESSIONS));
+
+  header("pichi_egress_up"sv, "Whether the health checked egress is up"sv, "gauge"sv);
+  for (auto&& [name, health] : egresses.health()) {
+    buf.append("pichi_egress_up{");
+    appendLabel(buf, "egress"sv, name);
+    buf.append("} ").append(health.up_ ? "1" : "0").append("\n");
+  }
+
+  auto ret = genResp(http::status::ok);
+  ret.set(http::field::content_type, "text/plain; version=0.0.4");
+  ret.body() = move(buf);
+  return ret;
+}
+
+static HistogramVO toVO(stats::Summary const& s)
+{
+  return {s.count_, s.mean_, s.max_, s.p50_, s.p90_, s.p99_, s.p999_};
+}
+
+static auto getLatency()
+{
+  auto summary = [](auto stage) { return toVO(stats::histogram(stage).summary()); };
+  auto vo = LatencyVO{};
+  vo.readIV_ = summary(stats::Stage::READ_IV);
+  vo.readRemote_ = summary(stats::Stage::READ_REMOTE);
+  vo.resolve_ = summary(stats::Stage::RESOLVE);
+  vo.route_ = summary(stats::Stage::ROUTE);
+  // Sessions ejected for duplicated IVs are connected to no named egress
+  for (auto&& [egress, s] : stats::connectings())
+    if (!egress.empty()) vo.connect_.emplace(egress, toVO(s));
+  vo.confirm_ = summary(stats::Stage::CONFIRM);
+  vo.firstByte_ = summary(stats::Stage::FIRST_BYTE);
+  return genResp(http::status::ok, vo);
+}
+
 static http::status e2c(PichiError e)
 {
   switch (e) {
@@ -95,7 +256,8 @@ static http::status e2c(sys::error_code e)
                                             http::status::internal_server_error;
 }
 
-Rest::Rest(IngressManager& ingresses, EgressManager& egresses, Router& router)
+Rest::Rest(IngressManager& ingresses, EgressManager& egresses, Router& router,
+           Admission& admission)
   : apis_{
         make_tuple(http::verb::get, INGRESS_REGEX,
                    [&](auto&&, auto&&) { return getVO(ingresses); }),
@@ -111,6 +273,16 @@ Rest::Rest(IngressManager& ingresses, EgressManager& egresses, Router& router)
                    [](auto&&, auto&&) {
                      return options({http::verb::put, http::verb::delete_, http::verb::options});
                    }),
+        make_tuple(http::verb::put, INGRESS_DRAIN_REGEX,
+                   [&](auto&& r, auto&& mr) {
+                     auto vo = parse<DrainVO>(r.body());
+                     ingresses.drain(mr[1].str(), chrono::seconds{vo.deadline_});
+                     return genResp(http::status::accepted);
+                   }),
+        make_tuple(http::verb::options, INGRESS_DRAIN_REGEX,
+                   [](auto&&, auto&&) {
+                     return options({http::verb::put, http::verb::options});
+                   }),
         make_tuple(http::verb::get, EGRESS_REGEX, [&](auto&&, auto&&) { return getVO(egresses); }),
         make_tuple(http::verb::options, EGRESS_REGEX,
                    [](auto&&, auto&&) {
@@ -134,11 +306,17 @@ Rest::Rest(IngressManager& ingresses, EgressManager& egresses, Router& router)
                    }),
         make_tuple(http::verb::put, RULE_NAME_REGEX,
                    [&](auto&& r, auto&& mr) { return putVO(r, mr, router); }),
+        make_tuple(http::verb::patch, RULE_NAME_REGEX,
+                   [&](auto&& r, auto&& mr) {
+                     router.patch(mr[1].str(), parse<RulePatchVO>(r.body()));
+                     return genResp(http::status::no_content);
+                   }),
         make_tuple(http::verb::delete_, RULE_NAME_REGEX,
                    [&](auto&&, auto&& mr) { return delVO(mr, router); }),
         make_tuple(http::verb::options, RULE_NAME_REGEX,
                    [](auto&&, auto&&) {
-                     return options({http::verb::put, http::verb::delete_, http::verb::options});
+                     return options({http::verb::put, http::verb::patch, http::verb::delete_,
+                                     http::verb::options});
                    }),
         make_tuple(http::verb::get, ROUTE_REGEX,
                    [&](auto&&, auto&&) { return genResp(http::status::ok, router.getRoute()); }),
@@ -156,7 +334,47 @@ Rest::Rest(IngressManager& ingresses, EgressManager& egresses, Router& router)
                      router.setRoute(move(vo));
                      return genResp(http::status::no_content);
                    }),
-        make_tuple(http::verb::options, ROUTE_REGEX, [](auto&&, auto&&) {
+        make_tuple(http::verb::options, ROUTE_REGEX,
+                   [](auto&&, auto&&) {
+                     return options({http::verb::get, http::verb::put, http::verb::options});
+                   }),
+        make_tuple(http::verb::get, LOG_REGEX, [](auto&&, auto&&) { return getLog(); }),
+        make_tuple(http::verb::put, LOG_REGEX, [](auto&& r, auto&&) { return putLog(r); }),
+        make_tuple(http::verb::options, LOG_REGEX,
+                   [](auto&&, auto&&) {
+                     return options({http::verb::get, http::verb::put, http::verb::options});
+                   }),
+        make_tuple(http::verb::get, STATS_REGEX,
+                   [&](auto&&, auto&&) { return getStats(egresses); }),
+        make_tuple(http::verb::options, STATS_REGEX,
+                   [](auto&&, auto&&) {
+                     return options({http::verb::get, http::verb::options});
+                   }),
+        make_tuple(http::verb::get, METRICS_REGEX,
+                   [&](auto&&, auto&&) { return getMetrics(egresses); }),
+        make_tuple(http::verb::options, METRICS_REGEX,
+                   [](auto&&, auto&&) {
+                     return options({http::verb::get, http::verb::options});
+                   }),
+        make_tuple(http::verb::get, LATENCY_REGEX, [](auto&&, auto&&) { return getLatency(); }),
+        make_tuple(http::verb::delete_, LATENCY_REGEX,
+                   [](auto&&, auto&&) {
+                     stats::resetHistograms();
+                     return genResp(http::status::no_content);
+                   }),
+        make_tuple(http::verb::options, LATENCY_REGEX,
+                   [](auto&&, auto&&) {
+                     return options({http::verb::get, http::verb::delete_, http::verb::options});
+                   }),
+        make_tuple(http::verb::get, ADMISSION_REGEX,
+                   [&](auto&&, auto&&) { return genResp(http::status::ok, admission.limits()); }),
+        make_tuple(http::verb::put, ADMISSION_REGEX,
+                   [&](auto&& r, auto&&) {
+                     // Replacing all limits, so that an absent one is lifted
+                     admission.configure(parse<AdmissionVO>(r.body()));
+                     return genResp(http::status::no_content);
+                   }),
+        make_tuple(http::verb::options, ADMISSION_REGEX, [](auto&&, auto&&) {
           return options({http::verb::get, http::verb::put, http::verb::options});
         })}
 {
@@ -1,13 +1,17 @@
 #include <boost/asio/ip/network_v4.hpp>
 #include <boost/asio/ip/network_v6.hpp>
 #include <boost/asio/ip/tcp.hpp>
-#include <iostream>
+#include <boost/dynamic_bitset.hpp>
 #include <maxminddb.h>
-#include <numeric>
 #include <pichi/api/router.hpp>
+#include <pichi/api/rule_set.hpp>
 #include <pichi/asserts.hpp>
+#include <pichi/log.hpp>
+#include <pichi/net/helpers.hpp>
 #include <pichi/scope_guard.hpp>
 #include <regex>
+#include <set>
+#include <unordered_map>
 
 using namespace std;
 namespace ip = boost::asio::ip;
@@ -21,6 +25,8 @@ namespace msg {
 static auto const DM_INVALID = "Invalid domain string"sv;
 static auto const RG_INVALID = "Invalid IP range string"sv;
 static auto const AT_INVALID = "Invalid adapter type string"sv;
+static auto const PT_INVALID = "Invalid pattern string"sv;
+static auto const RL_UNKNOWN = "Unknown rules"sv;
 
 } // namespace msg
 
@@ -69,85 +75,390 @@ bool Geo::match(tcp::endpoint const& endpoint, string_view country) const
   return string_view{entry.utf8_string, entry.data_size} == country;
 }
 
-Router::ValueType Router::generatePair(DelegateIterator it)
+// IP ranges parsed ahead of applying them, so that patching never fails halfway
+struct Networks {
+  vector<ip::network_v4> v4_ = {};
+  vector<ip::network_v6> v6_ = {};
+};
+
+static Networks parseRanges(set<string> const& ranges)
 {
-  return make_pair(ref(it->first), ref(it->second.first));
+  auto ret = Networks{};
+  for (auto&& range : ranges) {
+    auto ec = sys::error_code{};
+    auto n4 = ip::make_network_v4(range, ec);
+    if (!ec) {
+      ret.v4_.push_back(n4.canonical());
+      continue;
+    }
+    auto n6 = ip::make_network_v6(range, ec);
+    assertFalse(static_cast<bool>(ec), PichiError::SEMANTIC_ERROR, msg::RG_INVALID);
+    ret.v6_.push_back(n6.canonical());
+  }
+  return ret;
 }
 
-Router::Router(char const* fn) : geo_{fn} {}
-
-string_view Router::route(net::Endpoint const& e, string_view ingress, AdapterType type,
-                          ResolvedResult const& r) const
+// Ranges are kept in the canonical form, so that every spelling of a network refers to one entry
+static set<string> canonicalize(Networks const& networks)
 {
-  auto it = find_if(cbegin(route_.rules_), cend(route_.rules_), [&, this](auto&& pair) {
-    auto it = rules_.find(pair.first);
-    assertFalse(it == cend(rules_), PichiError::MISC);
-    auto& rule = as_const(it->second.first);
-    auto& matchers = as_const(it->second.second);
-    return any_of(cbegin(matchers), cend(matchers),
-                  [&](auto&& matcher) { return matcher(e, r, ingress, type); });
-  });
-  auto rule = it != cend(route_.rules_) ? string_view{it->first} : "DEFAUTL rule"sv;
-  auto egress = string_view{it != cend(route_.rules_) ? it->second : *route_.default_};
-  cout << e.host_ << ":" << e.port_ << " -> " << egress << " (" << rule << ")" << endl;
-  return egress;
+  auto ret = set<string>{};
+  for (auto&& n : networks.v4_) ret.insert(n.to_string());
+  for (auto&& n : networks.v6_) ret.insert(n.to_string());
+  return ret;
 }
 
-void Router::update(string const& name, RuleVO rvo)
+class Router::Program {
+private:
+  using Bits = boost::dynamic_bitset<>;
+  using Index = map<string, Bits, less<>>;
+  using Patterns = vector<tuple<string, regex, Bits>>;
+  template <typename Network> using Ranges = vector<pair<Network, Bits>>;
+
+  // The tables are shared by the versions of the program, and copied only before being patched
+  template <typename Table> static Table& copy(shared_ptr<Table>& table)
+  {
+    table = make_shared<Table>(*table);
+    return *table;
+  }
+
+  Bits& at(Index& index, string_view key)
+  {
+    auto it = index.find(key);
+    if (it == std::end(index)) it = index.emplace(key, Bits{items_.size()}).first;
+    return it->second;
+  }
+
+  void reset(Index& index, string_view key, size_t i)
+  {
+    auto it = index.find(key);
+    if (it == std::end(index)) return;
+    it->second.reset(i);
+    if (it->second.none()) index.erase(it);
+  }
+
+  template <typename Network>
+  void patchRange(Ranges<Network>& ranges, Network network, size_t i, bool set)
+  {
+    auto it = find_if(std::begin(ranges), std::end(ranges),
+                      [&network](auto&& item) { return item.first == network; });
+    if (it == std::end(ranges)) {
+      if (!set) return;
+      it = ranges.emplace(std::end(ranges), network, Bits{items_.size()});
+    }
+    it->second[i] = set;
+    if (it->second.none()) ranges.erase(it);
+  }
+
+  void patchPattern(Patterns& patterns, string const& pattern, size_t i, bool set)
+  {
+    auto it = find_if(std::begin(patterns), std::end(patterns),
+                      [&pattern](auto&& item) { return get<0>(item) == pattern; });
+    if (it == std::end(patterns)) {
+      if (!set) return;
+      it = patterns.emplace(std::end(patterns), pattern, regex{pattern}, Bits{items_.size()});
+    }
+    get<2>(*it)[i] = set;
+    if (get<2>(*it).none()) patterns.erase(it);
+  }
+
+  static void sortPatterns(Patterns& patterns)
+  {
+    stable_sort(std::begin(patterns), std::end(patterns), [](auto&& lhs, auto&& rhs) {
+      return get<2>(lhs).find_first() < get<2>(rhs).find_first();
+    });
+  }
+
+  Bits byName(net::Endpoint const& e, string_view ingress, AdapterType type, size_t bound) const
+  {
+    auto ret = Bits{items_.size()};
+
+    auto it = ingresses_->find(ingress);
+    if (it != cend(*ingresses_)) ret |= it->second;
+
+    auto t = types_->find(type);
+    if (t != cend(*types_)) ret |= t->second;
+
+    auto domain = e.type_ == net::Endpoint::Type::DOMAIN_NAME ? e.domain() : string_view{};
+    if (!domain.empty() && domain[0] != '.') {
+      // Every suffix starting after a dot is a candidate domain
+      for (auto host = domain; !host.empty();) {
+        auto it = domains_->find(host);
+        if (it != cend(*domains_)) ret |= it->second;
+        auto dot = host.find('.');
+        if (dot == string_view::npos) break;
+        host.remove_prefix(dot + 1);
+      }
+    }
+
+    // Rule sets and patterns are sorted by their first rule, so the ones behind the chosen rule
+    //   are skipped
+    bound = min(bound, ret.find_first());
+    if (e.type_ == net::Endpoint::Type::DOMAIN_NAME) {
+      for (auto&& [set, i] : *sets_) {
+        if (i >= bound) break;
+        if (set->matchDomain(domain)) {
+          ret.set(i);
+          bound = i;
+        }
+      }
+    }
+    // The address is formatted only if any pattern is tried against it
+    auto formatted = string{};
+    for (auto&& [pattern, re, bits] : *patterns_) {
+      if (bits.find_first() >= bound) break;
+      if (e.type_ != net::Endpoint::Type::DOMAIN_NAME && formatted.empty()) {
+        formatted = net::formatHost(e);
+        domain = formatted;
+      }
+      if (regex_search(cbegin(domain), cend(domain), re)) {
+        ret |= bits;
+        bound = ret.find_first();
+      }
+    }
+    return ret;
+  }
+
+  Bits byAddress(ResolvedResult const& r, Geo const& geo) const
+  {
+    auto ret = Bits{items_.size()};
+    for (auto&& entry : r) {
+      auto address = entry.endpoint().address();
+      for (auto&& [set, i] : *sets_)
+        if (set->hasRanges() && set->matchAddress(address)) ret.set(i);
+      if (address.is_v4()) {
+        auto v4 = address.to_v4();
+        for (auto&& [network, bits] : *v4_)
+          if (ip::make_network_v4(v4, network.prefix_length()).network() == network.network())
+            ret |= bits;
+      }
+      else {
+        auto v6 = address.to_v6();
+        for (auto&& [network, bits] : *v6_)
+          if (ip::make_network_v6(v6, network.prefix_length()).network() == network.network())
+            ret |= bits;
+      }
+    }
+    for (auto&& [country, bits] : *countries_)
+      if (any_of(cbegin(r), cend(r), [&geo, &c = country](auto&& entry) {
+            return geo.match(entry.endpoint(), c);
+          }))
+        ret |= bits;
+    return ret;
+  }
+
+  Routing choose(net::Endpoint const& e, string_view ingress, size_t i) const
+  {
+    if (i < items_.size()) {
+      log::access(e, ingress, items_[i].second, items_[i].first);
+      return {items_[i].first, items_[i].second};
+    }
+    log::access(e, ingress, default_, "DEFAUTL rule"sv);
+    return {{}, default_};
+  }
+
+public:
+  Program(Container const& rules, RuleSets const& sets, RouteVO const& route)
+    : items_{route.rules_}, default_{*route.default_}, addresses_{items_.size()}
+  {
+    auto patterns = Index{};
+    // network_v4/network_v6 are not ordered, so they are keyed by (network address, prefix)
+    auto v4 = map<pair<ip::address_v4, unsigned short>, Bits>{};
+    auto v6 = map<pair<ip::address_v6, unsigned short>, Bits>{};
+    for (auto i = size_t{0}; i < items_.size(); ++i) {
+      auto it = rules.find(items_[i].first);
+      assertFalse(it == cend(rules), PichiError::MISC);
+      auto& vo = it->second;
+
+      for (auto&& range : vo.range_) {
+        auto ec = sys::error_code{};
+        auto n4 = ip::make_network_v4(range, ec);
+        if (!ec) {
+          v4.try_emplace(make_pair(n4.network(), n4.prefix_length()), items_.size())
+              .first->second.set(i);
+        }
+        else {
+          auto n6 = ip::make_network_v6(range, ec);
+          assertFalse(static_cast<bool>(ec), PichiError::MISC);
+          v6.try_emplace(make_pair(n6.network(), n6.prefix_length()), items_.size())
+              .first->second.set(i);
+        }
+      }
+      for (auto&& ingress : vo.ingress_) at(*ingresses_, ingress).set(i);
+      for (auto type : vo.type_) types_->try_emplace(type, items_.size()).first->second.set(i);
+      for (auto&& pattern : vo.pattern_) at(patterns, pattern).set(i);
+      for (auto&& domain : vo.domain_)
+        if (!domain.empty()) at(*domains_, domain).set(i);
+      for (auto&& country : vo.country_) at(*countries_, country).set(i);
+
+      auto set = sets.find(items_[i].first);
+      if (set != cend(sets)) sets_->emplace_back(set->second, i);
+
+      if (!vo.range_.empty() || !vo.country_.empty() ||
+          (set != cend(sets) && set->second->hasRanges()))
+        addresses_.set(i);
+    }
+
+    transform(cbegin(patterns), cend(patterns), back_inserter(*patterns_), [](auto&& item) {
+      return make_tuple(item.first, regex{item.first}, item.second);
+    });
+    sortPatterns(*patterns_);
+    transform(cbegin(v4), cend(v4), back_inserter(*v4_), [](auto&& item) {
+      return make_pair(ip::make_network_v4(item.first.first, item.first.second), item.second);
+    });
+    transform(cbegin(v6), cend(v6), back_inserter(*v6_), [](auto&& item) {
+      return make_pair(ip::make_network_v6(item.first.first, item.first.second), item.second);
+    });
+  }
+
+  optional<Routing> route(net::Endpoint const& e, string_view ingress, AdapterType type) const
+  {
+    auto first = addresses_.find_first();
+    auto i = byName(e, ingress, type, first).find_first();
+    // Resolving is required if any rule containing address conditions precedes the matched one
+    if (first < i) return {};
+    return choose(e, ingress, i);
+  }
+
+  Routing route(net::Endpoint const& e, string_view ingress, AdapterType type,
+                ResolvedResult const& r, Geo const& geo) const
+  {
+    auto matched = byAddress(r, geo);
+    matched |= byName(e, ingress, type, matched.find_first());
+    return choose(e, ingress, matched.find_first());
+  }
+
+  bool needResolving() const { return addresses_.any(); }
+
+  /*
+   * Patching conditions of all items referring to the rule, whose entries must have been
+   *   validated and the ranges canonicalized. Only the tables of the conditions patched are
+   *   copied. Removing goes first, so the entries both removed and added are kept.
+   */
+  void patch(string_view name, RulePatchVO const& vo, Networks const& removed,
+             Networks const& added, bool addressing)
+  {
+    auto items = vector<size_t>{};
+    for (auto i = size_t{0}; i < items_.size(); ++i)
+      if (items_[i].first == name) items.push_back(i);
+
+    if (!removed.v4_.empty() || !added.v4_.empty()) {
+      auto& v4 = copy(v4_);
+      for (auto i : items) {
+        for (auto&& n : removed.v4_) patchRange(v4, n, i, false);
+        for (auto&& n : added.v4_) patchRange(v4, n, i, true);
+      }
+    }
+    if (!removed.v6_.empty() || !added.v6_.empty()) {
+      auto& v6 = copy(v6_);
+      for (auto i : items) {
+        for (auto&& n : removed.v6_) patchRange(v6, n, i, false);
+        for (auto&& n : added.v6_) patchRange(v6, n, i, true);
+      }
+    }
+    if (!vo.remove_.domain_.empty() || !vo.add_.domain_.empty()) {
+      auto& domains = copy(domains_);
+      for (auto i : items) {
+        for (auto&& domain : vo.remove_.domain_) reset(domains, domain, i);
+        for (auto&& domain : vo.add_.domain_)
+          if (!domain.empty()) at(domains, domain).set(i);
+      }
+    }
+    if (!vo.remove_.pattern_.empty() || !vo.add_.pattern_.empty()) {
+      auto& patterns = copy(patterns_);
+      for (auto i : items) {
+        for (auto&& pattern : vo.remove_.pattern_) patchPattern(patterns, pattern, i, false);
+        for (auto&& pattern : vo.add_.pattern_) patchPattern(patterns, pattern, i, true);
+      }
+      sortPatterns(patterns);
+    }
+    for (auto i : items) addresses_[i] = addressing;
+  }
+
+private:
+  vector<pair<string, string>> items_;
+  string default_;
+  shared_ptr<Index> ingresses_ = make_shared<Index>();
+  shared_ptr<unordered_map<AdapterType, Bits>> types_ =
+      make_shared<unordered_map<AdapterType, Bits>>();
+  shared_ptr<Index> domains_ = make_shared<Index>();
+  shared_ptr<Patterns> patterns_ = make_shared<Patterns>();
+  shared_ptr<vector<pair<shared_ptr<RuleSet const>, size_t>>> sets_ =
+      make_shared<vector<pair<shared_ptr<RuleSet const>, size_t>>>();
+  shared_ptr<Ranges<ip::network_v4>> v4_ = make_shared<Ranges<ip::network_v4>>();
+  shared_ptr<Ranges<ip::network_v6>> v6_ = make_shared<Ranges<ip::network_v6>>();
+  shared_ptr<Index> countries_ = make_shared<Index>();
+  Bits addresses_;
+};
+
+// Validating the rule, returning its ranges parsed
+static Networks validate(RuleVO const& rvo)
 {
-  rules_[name] = make_pair(move(rvo), vector<Matcher>{});
-  auto it = rules_.find(name);
-  auto guard = makeScopeGuard([it, this]() { rules_.erase(it); });
-  auto& vo = as_const(it->second.first);
-  auto& matchers = it->second.second;
-
-  transform(cbegin(vo.range_), cend(vo.range_), back_inserter(matchers),
-            [](auto&& range) -> Matcher {
-              auto ec = sys::error_code{};
-              auto n4 = ip::make_network_v4(range, ec);
-              if (ec) {
-                auto n6 = ip::make_network_v6(range, ec);
-                assertFalse(static_cast<bool>(ec), PichiError::SEMANTIC_ERROR, msg::RG_INVALID);
-                return [n6](auto&&, auto&& r, auto, auto) {
-                  return any_of(cbegin(r), cend(r), [n6](auto&& entry) {
-                    auto address = entry.endpoint().address();
-                    return address.is_v6() && n6.hosts().find(address.to_v6()) != cend(n6.hosts());
-                  });
-                };
-              }
-              else
-                return [n4](auto&&, auto&& r, auto, auto) {
-                  return any_of(cbegin(r), cend(r), [n4](auto&& entry) {
-                    auto address = entry.endpoint().address();
-                    return address.is_v4() && n4.hosts().find(address.to_v4()) != cend(n4.hosts());
-                  });
-                };
-            });
-  transform(cbegin(vo.ingress_), cend(vo.ingress_), back_inserter(matchers), [](auto&& i) {
-    return [&i](auto&&, auto&&, auto ingress, auto) { return i == ingress; };
-  });
-  transform(cbegin(vo.type_), cend(vo.type_), back_inserter(matchers), [](auto t) {
+  auto ret = parseRanges(rvo.range_);
+  for_each(cbegin(rvo.type_), cend(rvo.type_), [](auto t) {
     // ingress type shouldn't be DIRECT or REJECT
     assertFalse(t == AdapterType::DIRECT, PichiError::SEMANTIC_ERROR, msg::AT_INVALID);
     assertFalse(t == AdapterType::REJECT, PichiError::SEMANTIC_ERROR, msg::AT_INVALID);
-    return [t](auto&&, auto&&, auto, auto type) { return t == type; };
   });
-  transform(cbegin(vo.pattern_), cend(vo.pattern_), back_inserter(matchers), [](auto&& pattern) {
-    return [&pattern](auto&& e, auto&&, auto, auto) { return matchPattern(e.host_, pattern); };
+  for_each(cbegin(rvo.pattern_), cend(rvo.pattern_), [](auto&& pattern) {
+    try {
+      regex{pattern};
+    }
+    catch (regex_error const&) {
+      fail(PichiError::SEMANTIC_ERROR, msg::PT_INVALID);
+    }
   });
-  transform(cbegin(vo.domain_), cend(vo.domain_), back_inserter(matchers), [](auto&& domain) {
-    return [&domain](auto&& e, auto&&, auto, auto) {
-      return e.type_ == net::Endpoint::Type::DOMAIN_NAME && matchDomain(e.host_, domain);
-    };
+  for_each(cbegin(rvo.domain_), cend(rvo.domain_), [](auto&& domain) {
+    assertFalse(!domain.empty() && domain[0] == '.', PichiError::SEMANTIC_ERROR, msg::DM_INVALID);
   });
-  transform(cbegin(vo.country_), cend(vo.country_), back_inserter(matchers),
-            [& geo = as_const(geo_)](auto&& country) {
-              return [&country, &geo](auto&&, auto&& r, auto, auto) {
-                return any_of(cbegin(r), cend(r), [&geo, &country](auto&& entry) {
-                  return geo.match(entry.endpoint(), country);
-                });
-              };
-            });
+  return ret;
+}
+
+Router::ValueType Router::generatePair(DelegateIterator it)
+{
+  return make_pair(ref(it->first), ref(it->second));
+}
+
+Router::Router(char const* fn) : geo_{fn}, program_{make_shared<Program>(rules_, sets_, route_)}
+{
+}
+
+optional<Router::Routing> Router::route(net::Endpoint const& e, string_view ingress,
+                                        AdapterType type) const
+{
+  return program_->route(e, ingress, type);
+}
+
+Router::Routing Router::route(net::Endpoint const& e, string_view ingress, AdapterType type,
+                              ResolvedResult const& r) const
+{
+  return program_->route(e, ingress, type, r, geo_);
+}
+
+void Router::update(string const& name, RuleVO rvo)
+{
+  rvo.range_ = canonicalize(validate(rvo));
+
+  auto set = rvo.file_.has_value() ? make_shared<RuleSet const>(rvo.file_->c_str()) :
+                                    shared_ptr<RuleSet const>{};
+
+  auto [it, inserted] = rules_.try_emplace(name);
+  auto oldRule = exchange(it->second, move(rvo));
+  auto oldSet = shared_ptr<RuleSet const>{};
+  if (auto s = sets_.find(name); s != std::end(sets_)) {
+    oldSet = move(s->second);
+    sets_.erase(s);
+  }
+  if (set) sets_.emplace(name, move(set));
+
+  auto guard = makeScopeGuard([&, it = it, inserted = inserted, this]() {
+    if (inserted)
+      rules_.erase(it);
+    else
+      it->second = move(oldRule);
+    sets_.erase(name);
+    if (oldSet) sets_.emplace(name, move(oldSet));
+  });
+  program_ = make_shared<Program>(rules_, sets_, route_);
   guard.disable();
 }
 
@@ -159,6 +470,8 @@ void Router::erase(string_view name)
               PichiError::RES_IN_USE);
   auto it = rules_.find(name);
   if (it != std::end(rules_)) rules_.erase(it);
+  auto set = sets_.find(name);
+  if (set != std::end(sets_)) sets_.erase(set);
 }
 
 Router::ConstIterator Router::begin() const noexcept
@@ -174,24 +487,53 @@ Router::ConstIterator Router::end() const noexcept
 bool Router::isUsed(string_view egress) const
 {
   return route_.default_ == egress || any_of(cbegin(route_.rules_), cend(route_.rules_),
-                                             [=](auto&& item) { return item.first == egress; });
+                                             [=](auto&& item) { return item.second == egress; });
+}
+
+void Router::patch(string_view name, RulePatchVO vo)
+{
+  auto it = rules_.find(name);
+  assertFalse(it == std::end(rules_), PichiError::SEMANTIC_ERROR, msg::RL_UNKNOWN);
+  auto removed = validate(vo.remove_);
+  auto added = validate(vo.add_);
+  vo.remove_.range_ = canonicalize(removed);
+  vo.add_.range_ = canonicalize(added);
+
+  // Patching the rule can't fail once validated, so its entries are patched in place
+  auto apply = [](auto& entries, auto const& removed, auto const& added) {
+    for (auto&& entry : removed) entries.erase(entry);
+    entries.insert(cbegin(added), cend(added));
+  };
+  auto& rule = it->second;
+  apply(rule.range_, vo.remove_.range_, vo.add_.range_);
+  apply(rule.domain_, vo.remove_.domain_, vo.add_.domain_);
+  apply(rule.pattern_, vo.remove_.pattern_, vo.add_.pattern_);
+
+  if (none_of(cbegin(route_.rules_), cend(route_.rules_),
+              [name](auto&& item) { return item.first == name; }))
+    return;
+  // The program is patched on a copy, so that the routing never sees a half-applied change
+  auto set = sets_.find(name);
+  auto addressing = !rule.range_.empty() || !rule.country_.empty() ||
+                    (set != cend(sets_) && set->second->hasRanges());
+  auto program = make_shared<Program>(*program_);
+  program->patch(name, vo, removed, added, addressing);
+  program_ = move(program);
 }
 
-bool Router::needResloving() const { return needResolving_; }
+bool Router::needResloving() const { return program_->needResolving(); }
 
 RouteVO Router::getRoute() const { return route_; }
 
 void Router::setRoute(RouteVO rvo)
 {
-  needResolving_ = accumulate(
-      cbegin(rvo.rules_), cend(rvo.rules_), false, [this](auto needResolving, auto&& pair) {
-        auto it = rules_.find(pair.first);
-        assertFalse(it == cend(rules_), PichiError::SEMANTIC_ERROR, "Unknown rules"sv);
-        auto& rule = it->second.first;
-        return needResolving || !(rule.range_.empty() && rule.country_.empty());
-      });
-  route_.rules_ = move(rvo.rules_);
-  if (rvo.default_.has_value()) route_.default_ = rvo.default_;
+  assertTrue(all_of(cbegin(rvo.rules_), cend(rvo.rules_),
+                    [this](auto&& pair) { return rules_.find(pair.first) != cend(rules_); }),
+             PichiError::SEMANTIC_ERROR, msg::RL_UNKNOWN);
+  auto route = RouteVO{rvo.default_.has_value() ? move(rvo.default_) : route_.default_,
+                       move(rvo.rules_)};
+  program_ = make_shared<Program>(rules_, sets_, route);
+  route_ = move(route);
 }
 
 } // namespace pichi::api
@@ -0,0 +1,257 @@
+#include <algorithm>
+#include <boost/asio/ip/address.hpp>
+#include <boost/asio/ip/network_v4.hpp>
+#include <boost/asio/ip/network_v6.hpp>
+#include <boost/endian/buffers.hpp>
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+#include <cstring>
+#include <fstream>
+#include <pichi/api/rule_set.hpp>
+#include <pichi/asserts.hpp>
+
+using namespace std;
+namespace endian = boost::endian;
+namespace ip = boost::asio::ip;
+namespace ipc = boost::interprocess;
+namespace sys = boost::system;
+
+namespace pichi::api {
+
+namespace msg {
+
+static auto const RS_INVALID = "Invalid rule set file"sv;
+static auto const RS_ENTRY_INVALID = "Invalid rule set entry"sv;
+static auto const RS_WRITE_ERROR = "Failed to write rule set file"sv;
+
+} // namespace msg
+
+static auto const MAGIC = array<char, 4>{'P', 'R', 'S', '\0'};
+static auto const VERSION = uint32_t{1};
+
+using U32 = endian::little_uint32_buf_t;
+using V6 = array<uint8_t, 16>;
+
+struct Header {
+  array<char, 4> magic_;
+  U32 version_;
+  U32 domains_;
+  U32 v4_;
+  U32 v6_;
+  U32 pool_;
+};
+
+struct DomainEntry {
+  U32 offset_;
+  U32 size_;
+};
+
+struct V4Entry {
+  U32 first_;
+  U32 last_;
+};
+
+struct V6Entry {
+  V6 first_;
+  V6 last_;
+};
+
+static_assert(sizeof(Header) == 24 && alignof(Header) == 1);
+static_assert(sizeof(DomainEntry) == 8 && alignof(DomainEntry) == 1);
+static_assert(sizeof(V4Entry) == 8 && alignof(V4Entry) == 1);
+static_assert(sizeof(V6Entry) == 32 && alignof(V6Entry) == 1);
+
+class RuleSet::Mapping {
+public:
+  explicit Mapping(char const* fn)
+  {
+    try {
+      region_ = ipc::mapped_region{ipc::file_mapping{fn, ipc::read_only}, ipc::read_only};
+    }
+    catch (ipc::interprocess_exception const&) {
+      fail(PichiError::SEMANTIC_ERROR, msg::RS_INVALID);
+    }
+
+    auto base = static_cast<char const*>(region_.get_address());
+    auto size = region_.get_size();
+    assertFalse(size < sizeof(Header), PichiError::SEMANTIC_ERROR, msg::RS_INVALID);
+    auto header = reinterpret_cast<Header const*>(base);
+    assertTrue(header->magic_ == MAGIC, PichiError::SEMANTIC_ERROR, msg::RS_INVALID);
+    assertTrue(header->version_.value() == VERSION, PichiError::SEMANTIC_ERROR, msg::RS_INVALID);
+
+    auto expected = sizeof(Header) + uint64_t{header->domains_.value()} * sizeof(DomainEntry) +
+                    uint64_t{header->v4_.value()} * sizeof(V4Entry) +
+                    uint64_t{header->v6_.value()} * sizeof(V6Entry) + header->pool_.value();
+    assertTrue(expected == size, PichiError::SEMANTIC_ERROR, msg::RS_INVALID);
+
+    domains_ = {reinterpret_cast<DomainEntry const*>(base + sizeof(Header)),
+                header->domains_.value()};
+    v4_ = {reinterpret_cast<V4Entry const*>(domains_.first + domains_.second), header->v4_.value()};
+    v6_ = {reinterpret_cast<V6Entry const*>(v4_.first + v4_.second), header->v6_.value()};
+    pool_ = {reinterpret_cast<char const*>(v6_.first + v6_.second), header->pool_.value()};
+    assertTrue(all_of(domains_.first, domains_.first + domains_.second,
+                      [this](auto&& e) {
+                        return uint64_t{e.offset_.value()} + e.size_.value() <= pool_.size();
+                      }),
+               PichiError::SEMANTIC_ERROR, msg::RS_INVALID);
+  }
+
+  string_view domain(DomainEntry const& e) const
+  {
+    return pool_.substr(e.offset_.value(), e.size_.value());
+  }
+
+  bool contains(string_view domain) const
+  {
+    auto first = domains_.first;
+    auto last = domains_.first + domains_.second;
+    auto it = lower_bound(first, last, domain,
+                          [this](auto&& e, auto&& value) { return this->domain(e) < value; });
+    return it != last && this->domain(*it) == domain;
+  }
+
+  bool contains(uint32_t v4) const
+  {
+    auto first = v4_.first;
+    auto last = v4_.first + v4_.second;
+    auto it = upper_bound(first, last, v4,
+                          [](auto&& value, auto&& e) { return value < e.first_.value(); });
+    return it != first && v4 <= prev(it)->last_.value();
+  }
+
+  bool contains(V6 const& v6) const
+  {
+    auto first = v6_.first;
+    auto last = v6_.first + v6_.second;
+    auto it = upper_bound(first, last, v6, [](auto&& value, auto&& e) { return value < e.first_; });
+    return it != first && !(prev(it)->last_ < v6);
+  }
+
+  bool hasDomains() const { return domains_.second > 0; }
+  bool hasRanges() const { return v4_.second > 0 || v6_.second > 0; }
+
+private:
+  ipc::mapped_region region_;
+  pair<DomainEntry const*, size_t> domains_;
+  pair<V4Entry const*, size_t> v4_;
+  pair<V6Entry const*, size_t> v6_;
+  string_view pool_;
+};
+
+RuleSet::RuleSet(char const* fn) : mapping_{make_unique<Mapping>(fn)} {}
+
+RuleSet::~RuleSet() = default;
+
+bool RuleSet::matchDomain(string_view host) const
+{
+  if (host.empty() || host[0] == '.' || !mapping_->hasDomains()) return false;
+  while (!host.empty()) {
+    if (mapping_->contains(host)) return true;
+    auto dot = host.find('.');
+    if (dot == string_view::npos) break;
+    host.remove_prefix(dot + 1);
+  }
+  return false;
+}
+
+bool RuleSet::matchAddress(ip::address const& address) const
+{
+  return address.is_v4() ? mapping_->contains(address.to_v4().to_uint()) :
+                           mapping_->contains(address.to_v6().to_bytes());
+}
+
+bool RuleSet::hasDomains() const { return mapping_->hasDomains(); }
+
+bool RuleSet::hasRanges() const { return mapping_->hasRanges(); }
+
+template <typename Interval> static void merge(vector<Interval>& intervals)
+{
+  sort(begin(intervals), end(intervals));
+  auto out = begin(intervals);
+  for (auto it = begin(intervals); it != end(intervals); ++it) {
+    if (out != begin(intervals) && !(prev(out)->second < it->first)) {
+      prev(out)->second = max(prev(out)->second, it->second);
+    }
+    else
+      *out++ = *it;
+  }
+  intervals.erase(out, end(intervals));
+}
+
+void RuleSetBuilder::add(string_view entry)
+{
+  assertFalse(entry.empty(), PichiError::SEMANTIC_ERROR, msg::RS_ENTRY_INVALID);
+
+  auto ec = sys::error_code{};
+  auto str = string{entry};
+  auto slash = str.find('/') != string::npos;
+
+  auto n4 = slash ? ip::make_network_v4(str, ec) : ip::network_v4{ip::make_address_v4(str, ec), 32};
+  if (!ec) {
+    v4_.emplace_back(n4.network().to_uint(), n4.broadcast().to_uint());
+    return;
+  }
+
+  ec.clear();
+  auto n6 =
+      slash ? ip::make_network_v6(str, ec) : ip::network_v6{ip::make_address_v6(str, ec), 128};
+  if (!ec) {
+    auto first = n6.network().to_bytes();
+    auto last = first;
+    for (auto i = n6.prefix_length(); i < 128; ++i)
+      last[i / 8] |= static_cast<uint8_t>(0x80 >> (i % 8));
+    v6_.emplace_back(first, last);
+    return;
+  }
+
+  // Otherwise, it's a domain name
+  assertFalse(slash, PichiError::SEMANTIC_ERROR, msg::RS_ENTRY_INVALID);
+  assertFalse(entry[0] == '.', PichiError::SEMANTIC_ERROR, msg::RS_ENTRY_INVALID);
+  domains_.push_back(move(str));
+}
+
+void RuleSetBuilder::write(char const* fn)
+{
+  sort(begin(domains_), end(domains_));
+  domains_.erase(unique(begin(domains_), end(domains_)), end(domains_));
+  merge(v4_);
+  merge(v6_);
+
+  auto header = Header{MAGIC};
+  header.version_ = VERSION;
+  header.domains_ = static_cast<uint32_t>(domains_.size());
+  header.v4_ = static_cast<uint32_t>(v4_.size());
+  header.v6_ = static_cast<uint32_t>(v6_.size());
+
+  auto table = vector<DomainEntry>{};
+  auto pool = string{};
+  for (auto&& domain : domains_) {
+    auto e = DomainEntry{};
+    e.offset_ = static_cast<uint32_t>(pool.size());
+    e.size_ = static_cast<uint32_t>(domain.size());
+    table.push_back(e);
+    pool.append(domain);
+  }
+  header.pool_ = static_cast<uint32_t>(pool.size());
+
+  auto v4 = vector<V4Entry>{};
+  transform(cbegin(v4_), cend(v4_), back_inserter(v4), [](auto&& interval) {
+    auto e = V4Entry{};
+    e.first_ = interval.first;
+    e.last_ = interval.second;
+    return e;
+  });
+  auto v6 = vector<V6Entry>{};
+  transform(cbegin(v6_), cend(v6_), back_inserter(v6),
+            [](auto&& interval) { return V6Entry{interval.first, interval.second}; });
+
+  auto ofs = ofstream{fn, ios::binary | ios::trunc};
+  ofs.write(reinterpret_cast<char const*>(&header), sizeof(Header));
+  ofs.write(reinterpret_cast<char const*>(table.data()), table.size() * sizeof(DomainEntry));
+  ofs.write(reinterpret_cast<char const*>(v4.data()), v4.size() * sizeof(V4Entry));
+  ofs.write(reinterpret_cast<char const*>(v6.data()), v6.size() * sizeof(V6Entry));
+  ofs.write(pool.data(), pool.size());
+  assertTrue(static_cast<bool>(ofs), PichiError::MISC, msg::RS_WRITE_ERROR);
+}
+
+} // namespace pichi::api
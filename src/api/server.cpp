@@ -1,18 +1,29 @@
+#include <boost/asio/bind_executor.hpp>
 #include <boost/asio/ip/tcp.hpp>
+#include <boost/asio/steady_timer.hpp>
 #include <boost/asio/system_timer.hpp>
 #include <boost/beast/core/flat_buffer.hpp>
 #include <boost/beast/http/read.hpp>
 #include <boost/beast/http/write.hpp>
 #include <chrono>
-#include <iostream>
 #include <memory>
+#include <optional>
 #include <pichi/api/server.hpp>
 #include <pichi/api/session.hpp>
+#include <pichi/api/ss_udp_ingress.hpp>
+#include <pichi/api/udp_association.hpp>
 #include <pichi/api/vos.hpp>
 #include <pichi/asserts.hpp>
+#include <pichi/log.hpp>
 #include <pichi/net/asio.hpp>
 #include <pichi/net/helpers.hpp>
+#include <pichi/net/mux.hpp>
 #include <pichi/net/spawn.hpp>
+#include <pichi/net/ssudp.hpp>
+#include <pichi/scope_guard.hpp>
+#include <pichi/slab.hpp>
+#include <pichi/stats.hpp>
+#include <unordered_map>
 
 using namespace std;
 namespace asio = boost::asio;
@@ -21,34 +32,88 @@ namespace http = beast::http;
 namespace ip = asio::ip;
 namespace sys = boost::system;
 using tcp = ip::tcp;
+using udp = ip::udp;
 
 namespace pichi::api {
 
 static auto const RANDOM_EJECTOR = EgressVO{AdapterType::REJECT, {}, {}, {}, {}, DelayMode::RANDOM};
 static auto const IV_EXPIRE_TIME = 1h;
+// Egresses kept idle by each persistent connection, until no request comes in time
+static size_t const MAX_KEPT_EGRESSES = 8;
+static auto const KEEP_ALIVE_TIMEOUT = 60s;
 
-static auto resolve(net::Endpoint const& remote, asio::io_context& io, asio::yield_context yield)
+/*
+ * Resolving is started speculatively before routing, and waited only if the router reaches
+ *   the first rule requiring the resolved addresses.
+ */
+struct Resolution {
+  tcp::resolver resolver_;
+  asio::system_timer done_;
+  optional<tcp::resolver::results_type> result_ = {};
+};
+
+template <typename Strand>
+static auto resolve(net::Endpoint const& remote, Strand& strand)
+{
+  auto& io = strand.context();
+  auto r = make_shared<Resolution>(Resolution{
+      tcp::resolver{io}, asio::system_timer{io, asio::system_timer::time_point::max()}});
+  // The address is the result itself, which doesn't bother the resolver thread
+  if (remote.type_ != net::Endpoint::Type::DOMAIN_NAME) {
+    r->result_ = tcp::resolver::results_type::create(
+        tcp::endpoint{net::toAddress(remote), remote.port_}, {}, {});
+    return r;
+  }
+  r->resolver_.async_resolve(
+      remote.domain(), to_string(remote.port_),
+      asio::bind_executor(strand, [r, start = stats::Clock::now()](auto ec, auto result) {
+        stats::histogram(stats::Stage::RESOLVE).record(stats::Clock::now() - start);
+        r->result_ = ec ? tcp::resolver::results_type{} : move(result);
+        r->done_.cancel();
+      }));
+  return r;
+}
+
+template <typename Yield>
+static tcp::resolver::results_type const& waitFor(Resolution& r, Yield yield)
+{
+  if (!r.result_.has_value()) {
+    // Exceptions prohibited
+    auto ec = sys::error_code{};
+    r.done_.async_wait(yield[ec]);
+  }
+  return *r.result_;
+}
+
+// Closed with RST, which neither waits for the peer nor leaves TIME_WAIT behind
+static void shed(tcp::socket& s)
 {
   auto ec = sys::error_code{};
-  auto r = tcp::resolver{io}.async_resolve(remote.host_, remote.port_, yield[ec]);
-  return ec ? tcp::resolver::results_type{} : r;
+  s.set_option(tcp::socket::linger{true, 0}, ec);
+  s.close(ec);
 }
 
 Server::Server(asio::io_context& io, char const* fn)
-  : strand_{io}, router_{fn}, egresses_{}, ingresses_{io,
-                                                      [this](auto&& a, auto in, auto& vo) {
-                                                        startIngress(a, in, vo);
-                                                      }},
-    rest_{ingresses_, egresses_, router_}
+  : strand_{io}, api_{io}, admission_{make_shared<Admission>()}, router_{fn}, egresses_{io},
+    ingresses_{io,
+               [this](auto&& a, auto&& u, auto&& ad, auto in, auto& vo) {
+                 startIngress(a, u, ad, in, vo);
+               }},
+    rest_{ingresses_, egresses_, router_, *admission_}
 {
 }
 
 void Server::listen(string_view address, uint16_t port)
 {
-  net::spawn(strand_, [a = tcp::acceptor{strand_.context(), {ip::make_address(address), port}},
-                       this](auto yield) mutable {
-    while (a.is_open()) {
-      auto s = make_shared<tcp::socket>(a.async_accept(yield));
+  auto endpoint = tcp::endpoint{ip::make_address(address), port};
+  // Inherited from the process upgraded, which is already bound and listening
+  if (auto fd = net::adopt(net::listenerKey(endpoint)); fd.has_value())
+    api_.assign(endpoint.protocol(), *fd);
+  else
+    api_ = tcp::acceptor{strand_.context(), endpoint};
+  net::spawn(strand_, [this](auto yield) {
+    while (api_.is_open()) {
+      auto s = make_shared<tcp::socket>(api_.async_accept(yield));
       net::spawn(
           strand_,
           [this, s](auto yield) mutable {
@@ -63,34 +128,225 @@ void Server::listen(string_view address, uint16_t port)
             auto ec = sys::error_code{};
             auto resp = Rest::errorResponse(eptr);
             http::async_write(*s, resp, yield[ec]);
-            if (ec) cout << "Ignoring HTTP error: " << ec.message() << endl;
+            if (ec) log::warn("Ignoring HTTP error: ", ec.message());
           });
     }
   });
 }
 
+void Server::unlisten()
+{
+  auto ec = sys::error_code{};
+  api_.close(ec);
+}
+
 template <typename Yield>
-void Server::listen(Acceptor& acceptor, string_view iname, IngressVO const& vo, Yield yield)
+void Server::serve(unique_ptr<net::Ingress> ingress, string_view iname, AdapterType type,
+                   TimePoint accepted, Yield yield)
 {
-  while (acceptor.is_open()) {
-    net::spawn(strand_, [s = acceptor.async_accept(yield), &vo, iname, this](auto yield) mutable {
-      auto& io = strand_.context();
-      auto ingress = net::makeIngress(vo, move(s));
-      auto iv = array<uint8_t, 32>{};
-      if (isDuplicated({iv, ingress->readIV(iv, yield)}, yield)) {
-        make_shared<Session>(io, move(ingress), net::makeEgress(RANDOM_EJECTOR, io))->start();
-      }
-      else {
-        auto remote = ingress->readRemote(yield);
-        auto&& evo = route(remote, iname, vo.type_,
-                           router_.needResloving() ? resolve(remote, io, yield) : ResolveResult{});
-        auto session = make_shared<Session>(io, move(ingress), net::makeEgress(evo, io));
-        if (evo.type_ == AdapterType::DIRECT || evo.type_ == AdapterType::REJECT)
-          session->start(remote);
+  auto& io = strand_.context();
+  auto iv = array<uint8_t, 32>{};
+  auto ivSize = ingress->readIV(iv, yield);
+  if (ivSize > 0) stats::histogram(stats::Stage::READ_IV).record(stats::Clock::now() - accepted);
+  if (isDuplicated({iv, ivSize}, yield)) {
+    auto& counters = stats::counters(iname);
+    counters.add(stats::Counter::DUPLICATED_IVS);
+    slab::makeShared<Session>(io, move(ingress), net::makeEgress(RANDOM_EJECTOR, io), counters,
+                              stats::connecting({}), accepted)
+        ->start();
+  }
+  else {
+    auto start = stats::Clock::now();
+    auto remote = ingress->readRemote(yield);
+    stats::histogram(stats::Stage::READ_REMOTE).record(stats::Clock::now() - start);
+    if (ingress->associating()) {
+      make_shared<UdpAssociation>(io, move(ingress), remote, routeUdp(iname, type),
+                                  stats::counters(iname))
+          ->start();
+      return;
+    }
+    if (ingress->persistent())
+      persist(move(ingress), remote, iname, type, yield);
+    else
+      relay(move(ingress), remote, iname, type, accepted, yield);
+  }
+}
+
+template <typename Yield>
+void Server::relay(unique_ptr<net::Ingress> ingress, net::Endpoint const& remote,
+                   string_view iname, AdapterType type, TimePoint accepted, Yield yield)
+{
+  auto [rule, routed] = route(remote, iname, type, yield);
+  // A group is replaced by the member picked, which the session is accounted to
+  auto egress = egresses_.pick(routed, remote);
+  auto it = egresses_.find(egress);
+  assertFalse(it == cend(egresses_));
+  auto&& evo = it->second;
+  auto& counters = stats::counters(iname, egress, rule);
+  auto session =
+      slab::makeShared<Session>(strand_.context(), move(ingress), egresses_.make(egress), counters,
+                                stats::connecting(egress), accepted);
+  // A down egress without fallback is made rejecting at once
+  auto rejected = evo.type_ == AdapterType::REJECT || !egresses_.isUp(egress);
+  if (rejected) counters.add(stats::Counter::REJECT_HITS);
+  if (evo.type_ == AdapterType::DIRECT || rejected)
+    session->start(remote);
+  else
+    session->start(remote, net::makeEndpoint(*evo.host_, *evo.port_));
+}
+
+/*
+ * Each request of the persistent connection is routed and exchanged on its own, which is counted
+ *   as a session, over the egress kept for its origin if that one is still alive. The request
+ *   which isn't persistent any more, such as HTTP CONNECT, is relayed by a session at last. The
+ *   connection idle for KEEP_ALIVE_TIMEOUT between requests is closed with the egresses kept.
+ */
+template <typename Yield>
+void Server::persist(unique_ptr<net::Ingress> ingress, net::Endpoint remote, string_view iname,
+                     AdapterType type, Yield yield)
+{
+  // Keyed by the egress name and the origin
+  auto kept = unordered_map<string, unique_ptr<net::Egress>>{};
+  while (ingress->persistent()) {
+    auto [rule, routed] = route(remote, iname, type, yield);
+    // Owned, since the router and the egresses might be updated while connecting
+    auto name = string{egresses_.pick(routed, remote)};
+    auto it = egresses_.find(name);
+    assertFalse(it == cend(egresses_));
+    auto&& evo = it->second;
+    auto& counters = stats::counters(iname, name, rule);
+
+    auto key = name + " " + net::formatHost(remote) + " " + to_string(remote.port_);
+    auto egress = unique_ptr<net::Egress>{};
+    if (auto k = kept.find(key); k != end(kept)) {
+      egress = move(k->second);
+      kept.erase(k);
+    }
+    if (egress == nullptr || !egress->alive()) {
+      auto rejected = evo.type_ == AdapterType::REJECT || !egresses_.isUp(name);
+      if (rejected) counters.add(stats::Counter::REJECT_HITS);
+      egress = egresses_.make(name);
+      try {
+        auto start = stats::Clock::now();
+        if (evo.type_ == AdapterType::DIRECT || rejected)
+          egress->connect(remote, remote, yield);
         else
-          session->start(remote, net::makeEndpoint(*evo.host_, *evo.port_));
+          egress->connect(remote, net::makeEndpoint(*evo.host_, *evo.port_), yield);
+        stats::connecting(name).record(stats::Clock::now() - start);
+      }
+      catch (exception const&) {
+        counters.add(stats::Counter::HANDSHAKE_FAILURES);
+        ingress->disconnect(yield);
+        return;
       }
+    }
+
+    counters.add(stats::Counter::OPENED_SESSIONS);
+    auto exchanged = net::Exchanged{};
+    try {
+      exchanged = ingress->exchange(*egress, yield);
+    }
+    catch (exception const&) {
+      counters.add(stats::Counter::CLOSED_SESSIONS);
+      net::logException(current_exception());
+      return;
+    }
+    counters.add(stats::Counter::BYTES_IN, exchanged.in_);
+    counters.add(stats::Counter::BYTES_OUT, exchanged.out_);
+    counters.add(stats::Counter::CLOSED_SESSIONS);
+    if (exchanged.reusable_) {
+      if (kept.size() == MAX_KEPT_EGRESSES) kept.erase(begin(kept));
+      kept.emplace(move(key), move(egress));
+    }
+    if (!ingress->persistent()) return;
+
+    // The handler refers to the ingress only while waiting for the next request
+    auto reading = make_shared<net::Ingress*>(ingress.get());
+    auto timer = asio::steady_timer{strand_.context(), KEEP_ALIVE_TIMEOUT};
+    timer.async_wait(asio::bind_executor(strand_, [reading](auto ec) {
+      if (!ec && *reading != nullptr) exchange(*reading, nullptr)->close();
+    }));
+    auto guard = makeScopeGuard([&reading, &timer]() {
+      *reading = nullptr;
+      timer.cancel();
     });
+    try {
+      remote = ingress->readRemote(yield);
+    }
+    catch (sys::system_error const& e) {
+      // Closed by the client between requests as expected, or by the timer
+      if (e.code() == asio::error::eof || *reading == nullptr) return;
+      throw;
+    }
+  }
+  relay(move(ingress), remote, iname, type, stats::Clock::now(), yield);
+}
+
+/*
+ * Each stream opened by the mux client is served like an accepted connection, which is admitted
+ *   on its own and closed at once if there's no room. The streams keep their own copy of the
+ *   ingress name, because the mux connection might outlive the ingress.
+ */
+template <typename Yield>
+void Server::demux(shared_ptr<net::Mux> mux, shared_ptr<Admission> admission, string_view iname,
+                   Yield yield)
+{
+  mux->start();
+  while (auto stream = mux->accept(yield)) {
+    auto ticket = Admission::admit(admission, admission_);
+    if (!ticket.has_value()) {
+      mux->close(*stream);
+      stats::counters(iname).add(stats::Counter::SHED_CONNECTIONS);
+      continue;
+    }
+    net::spawn(
+        strand_,
+        [ingress = admit(make_unique<net::MuxIngress>(mux, move(stream)), move(*ticket)),
+         iname = string{iname}, this](auto yield) mutable {
+          serve(move(ingress), iname, AdapterType::MUX, stats::Clock::now(), yield);
+        },
+        [iname = string{iname}](auto, auto) noexcept {
+          stats::counters(iname).add(stats::Counter::HANDSHAKE_FAILURES);
+        });
+  }
+}
+
+template <typename Yield>
+void Server::listen(Acceptor& acceptor, shared_ptr<Admission> admission, string_view iname,
+                    IngressVO const& vo, Yield yield)
+{
+  // Not every OS makes the accepted socket inherit the options of the acceptor, while TCP Fast
+  //   Open only makes sense for listening or connecting.
+  auto options = vo.socket_;
+  if (options.has_value()) options->fastOpen_.reset();
+  while (acceptor.is_open()) {
+    auto s = acceptor.async_accept(yield);
+    auto ticket = Admission::admit(admission, admission_);
+    if (!ticket.has_value()) {
+      shed(s);
+      stats::counters(iname).add(stats::Counter::SHED_CONNECTIONS);
+      continue;
+    }
+    net::spawn(
+        strand_,
+        [s = move(s), ticket = move(*ticket), admission, &vo, iname, options,
+         this](auto yield) mutable {
+          auto accepted = stats::Clock::now();
+          if (options.has_value()) net::setOptions(s, *options);
+          if (vo.type_ == AdapterType::MUX) {
+            // The mux connection is a session as long as it's open, which handshakes no more,
+            //   while its streams are admitted as sessions too
+            ticket.handshaken();
+            demux(net::makeMux(vo, move(s)), admission, iname, yield);
+          }
+          else {
+            auto ingress = admit(net::makeIngress(vo, move(s)), move(ticket));
+            serve(move(ingress), iname, vo.type_, accepted, yield);
+          }
+        },
+        [iname](auto, auto) noexcept {
+          stats::counters(iname).add(stats::Counter::HANDSHAKE_FAILURES);
+        });
   }
 }
 
@@ -112,7 +368,7 @@ template <typename Yield> bool Server::isDuplicated(ConstBuffer<uint8_t> raw, Yi
 
   auto [it, inserted] = ivs_.insert({raw.cbegin(), raw.cend()});
   if (!inserted) {
-    cout << "Pichi Error: Duplicated IV" << endl;
+    log::error("Pichi Error: Duplicated IV");
     return true;
   }
   net::spawn(strand_, [it = it, this](auto yield) {
@@ -124,23 +380,84 @@ template <typename Yield> bool Server::isDuplicated(ConstBuffer<uint8_t> raw, Yi
   return false;
 }
 
-EgressVO const& Server::route(net::Endpoint const& remote, string_view iname, AdapterType type,
-                              ResolveResult const& r)
+template <typename Yield>
+Router::Routing Server::route(net::Endpoint const& remote, string_view iname, AdapterType type,
+                              Yield yield)
 {
-  auto it = egresses_.find(router_.route(remote, iname, type, r));
-  assertFalse(it == cend(egresses_));
-  return it->second;
+  auto& histogram = stats::histogram(stats::Stage::ROUTE);
+  auto resolution = router_.needResloving() ? resolve(remote, strand_) : shared_ptr<Resolution>{};
+  auto start = stats::Clock::now();
+  auto routing = router_.route(remote, iname, type);
+  auto elapsed = stats::Clock::now() - start;
+  if (routing.has_value()) {
+    histogram.record(elapsed);
+    return *routing;
+  }
+
+  assertFalse(resolution == nullptr, PichiError::MISC);
+  auto&& r = waitFor(*resolution, yield);
+  // Route might be changed during resolving
+  start = stats::Clock::now();
+  auto ret = router_.route(remote, iname, type, r);
+  // Waiting for resolving is excluded, which is recorded by the RESOLVE stage
+  histogram.record(elapsed + stats::Clock::now() - start);
+  return ret;
 }
 
-void Server::startIngress(Acceptor& acceptor, string_view iname, IngressVO const& vo)
+// Each destination of the datagrams is routed like the remote of a TCP session
+UdpRelay::Route Server::routeUdp(string_view iname, AdapterType type)
 {
+  return [this, iname = string{iname}, type](auto&& destination, auto yield) {
+    auto [rule, name] = route(destination, iname, type, yield);
+    auto egress = egresses_.pick(name, destination);
+    auto routed = UdpRelay::Routed{AdapterType::REJECT, &stats::counters(iname, egress, rule)};
+    auto it = egresses_.find(egress);
+    if (it == cend(egresses_) || !egresses_.isUp(egress)) return routed;
+    auto&& evo = it->second;
+    routed.type_ = evo.type_;
+    if (evo.type_ == AdapterType::SS && evo.udp_.value_or(false)) {
+      routed.server_ = net::makeEndpoint(*evo.host_, *evo.port_);
+      routed.codec_ = net::makeSSUdpCodec(*evo.method_, *evo.password_);
+    }
+    return routed;
+  };
+}
+
+void Server::startIngress(Acceptor& acceptor, shared_ptr<udp::socket> const& socket,
+                          shared_ptr<Admission> const& admission, string_view iname,
+                          IngressVO const& vo)
+{
+  if (socket != nullptr)
+    make_shared<SSUdpIngress>(strand_.context(), socket,
+                              net::makeSSUdpCodec(*vo.method_, *vo.password_),
+                              routeUdp(iname, vo.type_), stats::counters(iname))
+        ->start();
+
   /*
    * IngressVO named `iname` has already been inserted into `ingresses_`.
    * It should be removed if exception occurs.
    */
   net::spawn(
-      strand_, [this, &acceptor, iname, &vo](auto yield) { listen(acceptor, iname, vo, yield); },
+      strand_,
+      [this, &acceptor, admission, iname, &vo](auto yield) {
+        listen(acceptor, admission, iname, vo, yield);
+      },
       [ this, iname ](auto eptr, auto) noexcept { removeIngress(eptr, iname); });
 }
 
+vector<net::Listener> Server::listeners()
+{
+  auto ret = ingresses_.listeners();
+  if (api_.is_open())
+    ret.push_back({net::listenerKey(api_.local_endpoint()), api_.native_handle()});
+  return ret;
+}
+
+void Server::drain(chrono::seconds deadline, function<void()> done)
+{
+  unlisten();
+  for (auto&& [iname, vo] : ingresses_) ingresses_.drain(iname, deadline);
+  admission_->drain(strand_.context(), deadline, move(done));
+}
+
 } // namespace pichi::api
@@ -1,28 +1,202 @@
 #include <array>
+#include <boost/asio/ip/tcp.hpp>
+#include <boost/asio/steady_timer.hpp>
 #include <iostream>
+#include <memory>
 #include <pichi/api/session.hpp>
+#include <pichi/crypto/method.hpp>
 #include <pichi/exception.hpp>
 #include <pichi/net/adapter.hpp>
 #include <pichi/net/common.hpp>
+#include <pichi/net/direct.hpp>
+#include <pichi/net/helpers.hpp>
+#include <pichi/net/http.hpp>
+#include <pichi/net/mux.hpp>
+#include <pichi/net/socks5.hpp>
 #include <pichi/net/spawn.hpp>
+#include <pichi/net/ssaead.hpp>
+#include <pichi/slab.hpp>
+#include <typeinfo>
+#include <vector>
 
 using namespace std;
 namespace asio = boost::asio;
 namespace sys = boost::system;
+using TcpSocket = asio::ip::tcp::socket;
+using pichi::crypto::CryptoMethod;
 
 namespace pichi::api {
 
-static void bridge(net::Adapter& from, net::Adapter& to, asio::yield_context yield)
+/*
+ * Pipe relays one direction through a ring of buffers, so that the next recv overlaps the
+ *   previous send while the in-flight bytes are bounded by the ring. The reader and the writer
+ *   run on the same strand, and wake each other up by cancelling the timer. Only one of them
+ *   could be waiting at any time because the ring can't be both full and empty.
+ *
+ * Chunks are allocated on their first use and resized as ChunkSizer suggests, so that an
+ *   interactive session holds a few small chunks while a bulk one reads in large ones. The ring
+ *   gets shallower as the chunks grow, which bounds the memory held by each direction to
+ *   MAX_RELAY_SIZE. The depth is only changed while the ring is drained, since the chunks in
+ *   flight are indexed by it.
+ */
+class Pipe {
+private:
+  struct Chunk {
+    vector<uint8_t> buf_;
+    size_t size_;
+  };
+
+  static void resize(vector<uint8_t>& buf, size_t size)
+  {
+    if (buf.size() == size) return;
+    buf.resize(size);
+    buf.shrink_to_fit();
+  }
+
+  void reshape(size_t depth, size_t size)
+  {
+    depth_ = depth;
+    for (auto i = size_t{0}; i < chunks_.size(); ++i)
+      if (i >= depth_ || chunks_[i].buf_.size() > size) resize(chunks_[i].buf_, 0);
+  }
+
+  template <typename Yield> void wait(Yield yield)
+  {
+    // Exceptions prohibited
+    auto ec = sys::error_code{};
+    signal_.async_wait(yield[ec]);
+  }
+
+public:
+  explicit Pipe(asio::io_context& io) : signal_{io, asio::steady_timer::time_point::max()} {}
+
+  template <typename From, typename Yield>
+  void read(From& from, net::Adapter const& to, Yield yield)
+  {
+    while (!closed_ && from.readable() && to.writable()) {
+      auto depth = sizer_.depth();
+      if (tail_ - head_ == depth_ || (depth != depth_ && head_ != tail_)) {
+        wait(yield);
+        continue;
+      }
+      if (depth != depth_) reshape(depth, sizer_.size());
+      auto& chunk = chunks_[tail_ % depth_];
+      resize(chunk.buf_, sizer_.size());
+      chunk.size_ = from.recv(chunk.buf_, yield);
+      sizer_.update(chunk.size_);
+      ++tail_;
+      signal_.cancel();
+    }
+    close();
+  }
+
+  template <typename To, typename Relayed, typename Yield>
+  void write(To& to, Relayed&& relayed, Yield yield)
+  {
+    while (!closed_ || head_ != tail_) {
+      if (head_ == tail_) {
+        wait(yield);
+        continue;
+      }
+      auto& chunk = chunks_[head_ % depth_];
+      to.send({chunk.buf_, chunk.size_}, yield);
+      relayed(chunk.size_);
+      ++head_;
+      signal_.cancel();
+    }
+  }
+
+  void close()
+  {
+    closed_ = true;
+    signal_.cancel();
+  }
+
+  void fail()
+  {
+    failed_ = true;
+    close();
+  }
+
+  bool failed() const { return failed_; }
+
+private:
+  asio::steady_timer signal_;
+  array<Chunk, net::MAX_RELAY_DEPTH> chunks_;
+  net::ChunkSizer sizer_;
+  size_t depth_ = sizer_.depth();
+  size_t head_ = 0;
+  size_t tail_ = 0;
+  bool closed_ = false;
+  bool failed_ = false;
+};
+
+/*
+ * The adapters relayed most are resolved to their concrete types once for each session, so that
+ *   the loops generated for them call recv, send and readable directly instead of through the
+ *   vtable, skipping the forwarding wrappers as well. The others are relayed as their bases.
+ *   Each side is resolved on its own, so that the loops are generated for each type rather than
+ *   for each pair of them.
+ */
+template <typename... Adapters> struct Resolving {
+  template <typename Base, typename Function> static void visit(Base& base, Function&& f)
+  {
+    auto& type = typeid(base);
+    if (!((type == typeid(Adapters) && (f(static_cast<Adapters&>(base)), true)) || ...)) f(base);
+  }
+};
+
+using Ingresses = Resolving<net::HttpIngress<TcpSocket>, net::Socks5Adapter<TcpSocket>,
+                            net::SSAeadAdapter<CryptoMethod::AES_128_GCM, TcpSocket>,
+                            net::SSAeadAdapter<CryptoMethod::AES_256_GCM, TcpSocket>,
+                            net::SSAeadAdapter<CryptoMethod::CHACHA20_IETF_POLY1305, TcpSocket>,
+                            net::MuxIngress>;
+
+using Egresses = Resolving<net::DirectAdapter, net::HttpEgress<TcpSocket>,
+                           net::Socks5Adapter<TcpSocket>,
+                           net::SSAeadAdapter<CryptoMethod::AES_128_GCM, TcpSocket>,
+                           net::SSAeadAdapter<CryptoMethod::AES_256_GCM, TcpSocket>,
+                           net::SSAeadAdapter<CryptoMethod::CHACHA20_IETF_POLY1305, TcpSocket>,
+                           net::MuxEgress>;
+
+template <typename From>
+void Session::read(shared_ptr<Pipe> const& pipe, From& from, net::Adapter const& to)
 {
-  auto buf = array<uint8_t, net::MAX_FRAME_SIZE>{};
-  while (from.readable() && to.writable()) to.send({buf, from.recv(buf, yield)}, yield);
+  net::spawn(
+      strand_,
+      [self = shared_from_this(), pipe, &from, &to](auto yield) { pipe->read(from, to, yield); },
+      [pipe](auto, auto) noexcept { pipe->fail(); });
+}
+
+/*
+ * The session is closed as soon as the writer fails, or after the chunks already read are
+ *   flushed if the reader fails.
+ */
+template <typename To, typename Relayed>
+void Session::write(shared_ptr<Pipe> const& pipe, To& to, Relayed&& relayed)
+{
+  net::spawn(
+      strand_,
+      [self = shared_from_this(), pipe, &to, relayed = forward<Relayed>(relayed),
+       this](auto yield) mutable {
+        pipe->write(to, relayed, yield);
+        if (pipe->failed()) close();
+      },
+      [pipe, this](auto, auto) noexcept {
+        pipe->fail();
+        close();
+      });
 }
 
-Session::~Session() = default;
+Session::~Session() { counters_.add(stats::Counter::CLOSED_SESSIONS); }
 
-Session::Session(asio::io_context& io, Session::IngressPtr&& ingress, Session::EgressPtr&& egress)
-  : strand_{io}, ingress_{move(ingress)}, egress_{move(egress)}
+Session::Session(asio::io_context& io, Session::IngressPtr&& ingress, Session::EgressPtr&& egress,
+                 stats::Counters& counters, stats::Histogram& connecting,
+                 stats::Clock::time_point accepted)
+  : strand_{io}, ingress_{move(ingress)}, egress_{move(egress)}, counters_{counters},
+    connecting_{connecting}, accepted_{accepted}
 {
+  counters_.add(stats::Counter::OPENED_SESSIONS);
 }
 
 void Session::start(net::Endpoint const& remote, net::Endpoint const& next)
@@ -32,16 +206,35 @@ void Session::start(net::Endpoint const& remote, net::Endpoint const& next)
   net::spawn(
       strand_,
       [=, self = shared_from_this()](auto yield) {
+        auto start = stats::Clock::now();
         egress_->connect(remote, next, yield);
+        auto connected = stats::Clock::now();
+        connecting_.record(connected - start);
         ingress_->confirm(yield);
-        net::spawn(
-            strand_, [self, this](auto yield) { bridge(*ingress_, *egress_, yield); },
-            [this](auto, auto) noexcept { close(); });
-        net::spawn(
-            strand_, [self, this](auto yield) { bridge(*egress_, *ingress_, yield); },
-            [this](auto, auto) noexcept { close(); });
+        stats::histogram(stats::Stage::CONFIRM).record(stats::Clock::now() - connected);
+        auto inbound = slab::makeShared<Pipe>(strand_.context());
+        auto outbound = slab::makeShared<Pipe>(strand_.context());
+        auto& ingress = ingress_->underlying();
+        auto& egress = egress_->underlying();
+        Ingresses::visit(ingress, [&](auto& concrete) {
+          read(inbound, concrete, egress);
+          write(outbound, concrete, [this, first = true](auto n) mutable {
+            if (first) {
+              stats::histogram(stats::Stage::FIRST_BYTE).record(stats::Clock::now() - accepted_);
+              first = false;
+            }
+            counters_.add(stats::Counter::BYTES_OUT, n);
+          });
+        });
+        Egresses::visit(egress, [&](auto& concrete) {
+          read(outbound, concrete, ingress);
+          write(inbound, concrete, [this](auto n) { counters_.add(stats::Counter::BYTES_IN, n); });
+        });
       },
-      [this](auto, auto yield) noexcept { ingress_->disconnect(yield); });
+      [this](auto, auto yield) noexcept {
+        counters_.add(stats::Counter::HANDSHAKE_FAILURES);
+        ingress_->disconnect(yield);
+      });
 }
 
 void Session::start(net::Endpoint const& remote) { start(remote, remote); }
@@ -0,0 +1,127 @@
+#include <pichi/api/ss_udp_ingress.hpp>
+#include <pichi/asserts.hpp>
+#include <pichi/log.hpp>
+#include <pichi/net/spawn.hpp>
+#include <pichi/net/ssudp.hpp>
+#include <utility>
+
+using namespace std;
+namespace asio = boost::asio;
+namespace sys = boost::system;
+
+namespace pichi::api {
+
+static auto const SWEEP_INTERVAL = 10s;
+static auto const MAX_SESSIONS = size_t{1024};
+// Most clients exchange few datagrams at once, and the replies are batched less
+static auto const SESSION_BATCH = size_t{4};
+
+SSUdpIngress::SSUdpIngress(asio::io_context& io, shared_ptr<Socket> socket,
+                           shared_ptr<net::SSUdpCodec> codec, UdpRelay::Route route,
+                           stats::Counters& counters)
+  : strand_{io}, socket_{move(socket)}, codec_{move(codec)}, route_{move(route)},
+    counters_{counters}, timer_{io}
+{
+}
+
+SSUdpIngress::~SSUdpIngress() = default;
+
+void SSUdpIngress::start()
+{
+  auto self = shared_from_this();
+  auto eh = [self](auto, auto) noexcept { self->close(); };
+  net::spawn(strand_, [self](auto yield) { self->upstream(yield); }, eh);
+  net::spawn(strand_, [self](auto yield) { self->sweep(yield); }, eh);
+}
+
+void SSUdpIngress::close()
+{
+  if (closed_) return;
+  closed_ = true;
+  auto ec = sys::error_code{};
+  socket_->close(ec);
+  timer_.cancel();
+  for (auto&& [client, relay] : sessions_) relay->close();
+  sessions_.clear();
+}
+
+shared_ptr<UdpRelay> SSUdpIngress::session(UdpEndpoint const& client)
+{
+  auto it = sessions_.find(client);
+  if (it != std::end(sessions_)) return it->second;
+  if (sessions_.size() >= MAX_SESSIONS) {
+    log::warn("Too many Shadowsocks UDP sessions, dropping the datagram");
+    return nullptr;
+  }
+
+  auto relay = make_shared<UdpRelay>(
+      strand_, socket_, route_,
+      [codec = codec_, client](auto&& source, auto& d) {
+        net::prependUdpAddress(source, d);
+        codec->seal(d);
+        d.peer_ = client;
+        return true;
+      },
+      counters_, SESSION_BATCH);
+  relay->start();
+  sessions_.emplace(client, relay);
+  return relay;
+}
+
+void SSUdpIngress::upstream(Yield yield)
+{
+  while (!closed_) {
+    if (auto truncated = up_.receive(*socket_, net::UDP_HEADER_ROOM, yield); truncated > 0)
+      counters_.add(stats::Counter::TRUNCATED_DATAGRAMS, truncated);
+
+    // The consecutive datagrams of the same session are sent by one call
+    auto relay = shared_ptr<UdpRelay>{};
+    while (up_.size() > 0) {
+      auto& d = up_[0];
+      auto next = shared_ptr<UdpRelay>{};
+      try {
+        codec_->open(d);
+        auto [destination, len] = net::parseUdpAddress(d.data());
+        d.offset_ += len;
+        d.size_ -= len;
+        next = session(d.peer_);
+        if (next != nullptr && !next->forward(destination, d, yield)) next.reset();
+      }
+      catch (Exception const&) {
+        // Datagrams failing the authentication, or malformed ones, are dropped silently
+      }
+      catch (sys::system_error const& e) {
+        log::warn("Shadowsocks UDP session failed: ", e.what());
+      }
+      if (next == nullptr) {
+        up_.drop(0);
+        continue;
+      }
+      if (relay != nullptr && relay != next) relay->send(out_, yield);
+      relay = next;
+      up_.moveTo(0, out_);
+    }
+    if (relay != nullptr) relay->send(out_, yield);
+  }
+}
+
+void SSUdpIngress::sweep(Yield yield)
+{
+  while (!closed_) {
+    auto ec = sys::error_code{};
+    timer_.expires_after(SWEEP_INTERVAL);
+    timer_.async_wait(yield[ec]);
+
+    auto now = UdpRelay::Clock::now();
+    for (auto it = begin(sessions_); it != end(sessions_);) {
+      if (it->second->expiry() > now) {
+        ++it;
+        continue;
+      }
+      it->second->close();
+      it = sessions_.erase(it);
+    }
+  }
+}
+
+} // namespace pichi::api
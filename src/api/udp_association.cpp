@@ -0,0 +1,119 @@
+#include <array>
+#include <boost/asio/io_context.hpp>
+#include <pichi/api/udp_association.hpp>
+#include <pichi/asserts.hpp>
+#include <pichi/net/adapter.hpp>
+#include <pichi/net/helpers.hpp>
+#include <pichi/net/spawn.hpp>
+#include <utility>
+
+using namespace std;
+namespace asio = boost::asio;
+namespace ip = asio::ip;
+namespace sys = boost::system;
+using udp = ip::udp;
+
+namespace pichi::api {
+
+UdpAssociation::UdpAssociation(asio::io_context& io, IngressPtr&& ingress,
+                               net::Endpoint const& client, UdpRelay::Route route,
+                               stats::Counters& counters)
+  : strand_{io}, ingress_{move(ingress)}, expected_{client}, route_{move(route)},
+    counters_{counters}, inbound_{make_shared<Socket>(io)}
+{
+}
+
+UdpAssociation::~UdpAssociation() = default;
+
+void UdpAssociation::start()
+{
+  net::spawn(
+      strand_, [self = shared_from_this()](auto yield) { self->run(yield); },
+      [self = shared_from_this()](auto, auto) noexcept { self->close(); });
+}
+
+void UdpAssociation::close()
+{
+  if (closed_) return;
+  closed_ = true;
+  auto ec = sys::error_code{};
+  inbound_->close(ec);
+  if (relay_ != nullptr) relay_->close();
+  ingress_->close();
+}
+
+void UdpAssociation::run(Yield yield)
+{
+  auto address = ip::make_address(ingress_->localAddress());
+  inbound_->open(address.is_v4() ? udp::v4() : udp::v6());
+  inbound_->bind({address, 0});
+
+  // The relay is closed along with the association, before replying to the client
+  relay_ = make_shared<UdpRelay>(
+      strand_, inbound_, route_,
+      [this](auto&& source, auto& d) {
+        if (!client_.has_value()) return false;
+        net::prependUdpHeader(source, d);
+        d.peer_ = *client_;
+        return true;
+      },
+      counters_);
+
+  auto local = inbound_->local_endpoint();
+  ingress_->associate(net::makeEndpoint(local.address(), local.port()), yield);
+
+  relay_->start();
+  auto self = shared_from_this();
+  net::spawn(
+      strand_, [self](auto yield) { self->upstream(yield); },
+      [self](auto, auto) noexcept { self->close(); });
+
+  // The association ends once the client closes the ingress
+  auto buf = array<uint8_t, 512>{};
+  while (!closed_) ingress_->recv(buf, yield);
+}
+
+bool UdpAssociation::accept(UdpEndpoint const& client)
+{
+  if (client_.has_value()) return *client_ == client;
+
+  // The client might not know its address and port when associating, which are zeros then
+  if (expected_.type_ != net::Endpoint::Type::DOMAIN_NAME) {
+    auto address = net::toAddress(expected_);
+    if (!address.is_unspecified() && address != client.address()) return false;
+  }
+  if (expected_.port_ != 0 && expected_.port_ != client.port()) return false;
+  client_ = client;
+  return true;
+}
+
+void UdpAssociation::upstream(Yield yield)
+{
+  while (!closed_) {
+    // The room is left for the salt, if sealed for a Shadowsocks egress
+    if (auto truncated = up_.receive(*inbound_, net::UDP_HEADER_ROOM, yield); truncated > 0)
+      counters_.add(stats::Counter::TRUNCATED_DATAGRAMS, truncated);
+    for (auto i = 0u; i < up_.size();) {
+      auto& d = up_[i];
+      auto forwarded = false;
+      try {
+        if (accept(d.peer_)) {
+          auto [destination, len] = net::parseUdpHeader(d.data());
+          d.offset_ += len;
+          d.size_ -= len;
+          forwarded = relay_->forward(destination, d, yield);
+        }
+      }
+      catch (Exception const&) {
+        // Malformed or fragmented datagrams are dropped
+      }
+      if (forwarded)
+        ++i;
+      else
+        up_.drop(i);
+    }
+    relay_->send(up_, yield);
+  }
+}
+
+} // namespace pichi::api
@@ -0,0 +1,228 @@
+#include <boost/asio/ip/v6_only.hpp>
+#include <pichi/api/udp_relay.hpp>
+#include <pichi/asserts.hpp>
+#include <pichi/log.hpp>
+#include <pichi/net/helpers.hpp>
+#include <pichi/net/spawn.hpp>
+#include <pichi/net/ssudp.hpp>
+#include <utility>
+
+using namespace std;
+namespace asio = boost::asio;
+namespace ip = asio::ip;
+namespace sys = boost::system;
+using udp = ip::udp;
+using pichi::net::AdapterType;
+
+namespace pichi::api {
+
+static auto const SWEEP_INTERVAL = 10s;
+static auto const MAX_MAPPINGS = size_t{4096};
+
+static string toKey(net::Endpoint const& endpoint)
+{
+  return net::formatHost(endpoint) + " " + to_string(endpoint.port_);
+}
+
+// The replies to IPv4 destinations are received by the dual-stack socket as IPv4-mapped ones
+static udp::endpoint unmap(udp::endpoint const& endpoint)
+{
+  auto address = endpoint.address();
+  if (address.is_v6() && address.to_v6().is_v4_mapped())
+    return {ip::make_address_v4(ip::v4_mapped, address.to_v6()), endpoint.port()};
+  return endpoint;
+}
+
+UdpRelay::UdpRelay(Strand strand, shared_ptr<Socket> inbound, Route route, Reply reply,
+                   stats::Counters& counters, size_t capacity)
+  : strand_{move(strand)}, inbound_{move(inbound)}, route_{move(route)}, reply_{move(reply)},
+    counters_{counters}, outbound_{strand_.context()}, down_{capacity}, timer_{strand_.context()},
+    expiry_{Clock::now() + MAPPING_IDLE}
+{
+  // Dual-stack if available, or IPv6 destinations are unreachable
+  auto ec = sys::error_code{};
+  outbound_.open(udp::v6(), ec);
+  if (!ec) outbound_.set_option(ip::v6_only{false}, ec);
+  if (ec) {
+    outbound_.close(ec);
+    outbound_.open(udp::v4());
+  }
+}
+
+UdpRelay::~UdpRelay() = default;
+
+void UdpRelay::start()
+{
+  auto self = shared_from_this();
+  auto eh = [self](auto, auto) noexcept { self->close(); };
+  net::spawn(strand_, [self](auto yield) { self->downstream(yield); }, eh);
+  net::spawn(strand_, [self](auto yield) { self->sweep(yield); }, eh);
+}
+
+void UdpRelay::close()
+{
+  if (closed_) return;
+  closed_ = true;
+  auto ec = sys::error_code{};
+  outbound_.close(ec);
+  timer_.cancel();
+}
+
+UdpRelay::Clock::time_point UdpRelay::expiry() const { return expiry_; }
+
+UdpRelay::Mapping* UdpRelay::map(net::Endpoint const& destination, Yield yield)
+{
+  auto key = toKey(destination);
+  auto it = nat_.find(key);
+  if (it == std::end(nat_)) {
+    if (nat_.size() >= MAX_MAPPINGS) return nullptr;
+
+    auto routed = route_(destination, yield);
+    auto mapping = Mapping{destination, {}, routed.codec_, routed.counters_, {}};
+    if (routed.type_ == AdapterType::REJECT) routed.counters_->add(stats::Counter::REJECT_HITS);
+    if (routed.type_ == AdapterType::DIRECT || routed.codec_ != nullptr) {
+      auto&& next = routed.codec_ != nullptr ? *routed.server_ : destination;
+      auto ec = sys::error_code{};
+      auto v6 = outbound_.local_endpoint(ec).protocol() == udp::v6();
+      auto resolver = udp::resolver{strand_.context()};
+      auto results =
+          next.type_ == net::Endpoint::Type::DOMAIN_NAME
+              ? resolver.async_resolve(next.domain(), to_string(next.port_), yield[ec])
+              : udp::resolver::results_type::create(
+                    udp::endpoint{net::toAddress(next), next.port_}, {}, {});
+      for (auto&& entry : results) {
+        auto address = entry.endpoint().address();
+        if (address.is_v4() && v6)
+          mapping.target_ = udp::endpoint{ip::make_address_v6(ip::v4_mapped, address.to_v4()),
+                                          entry.endpoint().port()};
+        else if (address.is_v4() || v6)
+          mapping.target_ = entry.endpoint();
+        if (mapping.target_.has_value()) break;
+      }
+    }
+    else if (routed.type_ != AdapterType::REJECT) {
+      log::warn("UDP to ", net::formatHost(destination), ":", to_string(destination.port_),
+                " dropped by egress type");
+    }
+    // Closed while routing or resolving
+    if (closed_) return nullptr;
+    it = nat_.emplace(move(key), move(mapping)).first;
+    index(it->second);
+  }
+  it->second.expiry_ = Clock::now() + MAPPING_IDLE;
+  expiry_ = it->second.expiry_;
+  return &it->second;
+}
+
+void UdpRelay::index(Mapping& mapping)
+{
+  if (mapping.target_.has_value()) peers_[unmap(*mapping.target_)].push_back(&mapping);
+}
+
+/*
+ * Several mappings might share a peer, such as the same Shadowsocks server, so the reply is
+ *   credited to the one of its source. The domain names are resolved by the direct egress or the
+ *   Shadowsocks server, hence the reply from the address of a domain is matched by the port only.
+ */
+UdpRelay::Mapping* UdpRelay::match(vector<Mapping*> const& mappings, net::Endpoint const& source)
+{
+  auto ret = static_cast<Mapping*>(nullptr);
+  for (auto mapping : mappings) {
+    auto&& destination = mapping->destination_;
+    if (destination == source) return mapping;
+    if (ret == nullptr && destination.type_ == net::Endpoint::Type::DOMAIN_NAME &&
+        destination.port_ == source.port_)
+      ret = mapping;
+  }
+  return ret;
+}
+
+bool UdpRelay::forward(net::Endpoint const& destination, net::Datagram& d, Yield yield)
+{
+  if (closed_) return false;
+  auto mapping = map(destination, yield);
+  if (mapping == nullptr || !mapping->target_.has_value()) return false;
+  mapping->counters_->add(stats::Counter::BYTES_IN, d.size_);
+  if (mapping->codec_ != nullptr) {
+    net::prependUdpAddress(destination, d);
+    mapping->codec_->seal(d);
+  }
+  d.peer_ = *mapping->target_;
+  return true;
+}
+
+void UdpRelay::send(net::DatagramBatch& batch, Yield yield)
+{
+  if (closed_)
+    while (batch.size() > 0) batch.drop(0);
+  else
+    batch.send(outbound_, yield);
+}
+
+void UdpRelay::downstream(Yield yield)
+{
+  while (!closed_) {
+    if (auto truncated = down_.receive(outbound_, net::UDP_HEADER_ROOM, yield); truncated > 0)
+      counters_.add(stats::Counter::TRUNCATED_DATAGRAMS, truncated);
+    // The owner of the reply might be gone once the relay is closed
+    if (closed_) break;
+    for (auto i = 0u; i < down_.size();) {
+      auto& d = down_[i];
+      auto peer = peers_.find(unmap(d.peer_));
+      if (peer == std::end(peers_)) {
+        down_.drop(i);
+        continue;
+      }
+      auto&& mappings = peer->second;
+      auto source = net::makeEndpoint(peer->first.address(), peer->first.port());
+      try {
+        // The Shadowsocks server tells the source, which is resolved, in the datagram. The
+        //   mappings sharing the server share its key as well.
+        if (auto&& codec = mappings.front()->codec_; codec != nullptr) {
+          codec->open(d);
+          auto [endpoint, len] = net::parseUdpAddress(d.data());
+          d.offset_ += len;
+          d.size_ -= len;
+          source = move(endpoint);
+        }
+      }
+      catch (Exception const&) {
+        down_.drop(i);
+        continue;
+      }
+      auto found = match(mappings, source);
+      if (found == nullptr) {
+        down_.drop(i);
+        continue;
+      }
+      auto& mapping = *found;
+      mapping.expiry_ = Clock::now() + MAPPING_IDLE;
+      expiry_ = mapping.expiry_;
+      mapping.counters_->add(stats::Counter::BYTES_OUT, d.size_);
+      if (!reply_(source, d)) {
+        down_.drop(i);
+        continue;
+      }
+      ++i;
+    }
+    down_.send(*inbound_, yield);
+  }
+}
+
+void UdpRelay::sweep(Yield yield)
+{
+  while (!closed_) {
+    auto ec = sys::error_code{};
+    timer_.expires_after(SWEEP_INTERVAL);
+    timer_.async_wait(yield[ec]);
+
+    auto now = Clock::now();
+    for (auto it = begin(nat_); it != end(nat_);)
+      it = it->second.expiry_ > now ? next(it) : nat_.erase(it);
+
+    peers_.clear();
+    for (auto&& [key, mapping] : nat_) index(mapping);
+  }
+}
+
+} // namespace pichi::api
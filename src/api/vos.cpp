@@ -12,6 +12,8 @@ static decltype(auto) REJECT_TYPE = "reject";
 static decltype(auto) SOCKS5_TYPE = "socks5";
 static decltype(auto) HTTP_TYPE = "http";
 static decltype(auto) SS_TYPE = "ss";
+static decltype(auto) MUX_TYPE = "mux";
+static decltype(auto) GROUP_TYPE = "group";
 
 static decltype(auto) RC4_MD5_METHOD = "rc4-md5";
 static decltype(auto) BF_CFB_METHOD = "bf-cfb";
@@ -33,9 +35,76 @@ static decltype(auto) AES_256_GCM_METHOD = "aes-256-gcm";
 static decltype(auto) CHACHA20_IETF_POLY1305_METHOD = "chacha20-ietf-poly1305";
 static decltype(auto) XCHACHA20_IETF_POLY1305_METHOD = "xchacha20-ietf-poly1305";
 
+static decltype(auto) DEBUG_LEVEL = "debug";
+static decltype(auto) INFO_LEVEL = "info";
+static decltype(auto) WARN_LEVEL = "warn";
+static decltype(auto) ERROR_LEVEL = "error";
+
+static decltype(auto) TEXT_FORMAT = "text";
+static decltype(auto) JSON_FORMAT = "json";
+
 static decltype(auto) RANDOM_DELAY_MODE = "random";
 static decltype(auto) FIXED_DELAY_MODE = "fixed";
 
+static decltype(auto) ROUND_ROBIN_BALANCE = "round_robin";
+static decltype(auto) LEAST_SESSIONS_BALANCE = "least_sessions";
+static decltype(auto) LATENCY_BALANCE = "latency";
+static decltype(auto) HASH_BALANCE = "hash";
+
+static auto const MAX_POOL_SIZE = uint16_t{64};
+static auto const MAX_POOL_IDLE = uint16_t{3600};
+static auto const DEFAULT_POOL_IDLE = uint16_t{60};
+static auto const MAX_MUX_CONNECTIONS = uint16_t{16};
+static auto const DEFAULT_MUX_CONNECTIONS = uint16_t{1};
+static auto const MAX_GROUP_MEMBERS = size_t{64};
+static auto const MAX_HEALTH_INTERVAL = uint16_t{3600};
+static auto const DEFAULT_HEALTH_INTERVAL = uint16_t{10};
+static auto const MAX_HEALTH_TIMEOUT = uint16_t{60};
+static auto const DEFAULT_HEALTH_TIMEOUT = uint16_t{5};
+static auto const MAX_HEALTH_THRESHOLD = uint8_t{10};
+static auto const DEFAULT_HEALTH_RISE = uint8_t{2};
+static auto const DEFAULT_HEALTH_FALL = uint8_t{3};
+static auto const MAX_DRAIN_DEADLINE = uint16_t{3600};
+static auto const DEFAULT_DRAIN_DEADLINE = uint16_t{60};
+
+namespace SocketOptionsKey {
+
+static decltype(auto) noDelay_ = "nodelay";
+static decltype(auto) recvBuffer_ = "recv_buffer";
+static decltype(auto) sendBuffer_ = "send_buffer";
+static decltype(auto) keepAlive_ = "keepalive";
+static decltype(auto) congestion_ = "congestion";
+static decltype(auto) notSentLowat_ = "notsent_lowat";
+static decltype(auto) tos_ = "tos";
+static decltype(auto) fastOpen_ = "fastopen";
+
+} // namespace SocketOptionsKey
+
+namespace PoolVOKey {
+
+static decltype(auto) size_ = "size";
+static decltype(auto) idle_ = "idle";
+
+} // namespace PoolVOKey
+
+namespace HealthCheckVOKey {
+
+static decltype(auto) interval_ = "interval";
+static decltype(auto) timeout_ = "timeout";
+static decltype(auto) rise_ = "rise";
+static decltype(auto) fall_ = "fall";
+static decltype(auto) fallback_ = "fallback";
+
+} // namespace HealthCheckVOKey
+
+namespace AdmissionVOKey {
+
+static decltype(auto) sessions_ = "sessions";
+static decltype(auto) handshakes_ = "handshakes";
+static decltype(auto) rate_ = "rate";
+
+} // namespace AdmissionVOKey
+
 namespace IngressVOKey {
 
 static decltype(auto) type_ = "type";
@@ -46,6 +115,9 @@ static decltype(auto) password_ = "password";
 static decltype(auto) tls_ = "tls";
 static decltype(auto) certFile_ = "cert_file";
 static decltype(auto) keyFile_ = "key_file";
+static decltype(auto) socket_ = "socket";
+static decltype(auto) udp_ = "udp";
+static decltype(auto) admission_ = "admission";
 
 } // namespace IngressVOKey
 
@@ -61,6 +133,13 @@ static decltype(auto) delay_ = "delay";
 static decltype(auto) tls_ = "tls";
 static decltype(auto) insecure_ = "insecure";
 static decltype(auto) caFile_ = "ca_file";
+static decltype(auto) socket_ = "socket";
+static decltype(auto) pool_ = "pool";
+static decltype(auto) connections_ = "connections";
+static decltype(auto) udp_ = "udp";
+static decltype(auto) members_ = "members";
+static decltype(auto) balance_ = "balance";
+static decltype(auto) health_ = "health";
 
 } // namespace EgressVOKey
 
@@ -72,9 +151,17 @@ static decltype(auto) type_ = "ingress_type";
 static decltype(auto) pattern_ = "pattern";
 static decltype(auto) domain_ = "domain";
 static decltype(auto) country_ = "country";
+static decltype(auto) file_ = "file";
 
 } // namespace RuleVOKey
 
+namespace RulePatchVOKey {
+
+static decltype(auto) add_ = "add";
+static decltype(auto) remove_ = "remove";
+
+} // namespace RulePatchVOKey
+
 namespace RouteVOKey {
 
 static decltype(auto) default_ = "default";
@@ -82,6 +169,77 @@ static decltype(auto) rules_ = "rules";
 
 } // namespace RouteVOKey
 
+namespace LogVOKey {
+
+static decltype(auto) level_ = "level";
+static decltype(auto) format_ = "format";
+static decltype(auto) limit_ = "limit";
+
+} // namespace LogVOKey
+
+namespace DrainVOKey {
+
+static decltype(auto) deadline_ = "deadline";
+
+} // namespace DrainVOKey
+
+namespace CountersVOKey {
+
+static decltype(auto) bytesIn_ = "bytes_in";
+static decltype(auto) bytesOut_ = "bytes_out";
+static decltype(auto) activeSessions_ = "active_sessions";
+static decltype(auto) totalSessions_ = "total_sessions";
+static decltype(auto) handshakeFailures_ = "handshake_failures";
+static decltype(auto) duplicatedIvs_ = "duplicated_ivs";
+static decltype(auto) rejectHits_ = "reject_hits";
+static decltype(auto) shedConnections_ = "shed_connections";
+static decltype(auto) truncatedDatagrams_ = "truncated_datagrams";
+
+} // namespace CountersVOKey
+
+namespace HealthVOKey {
+
+static decltype(auto) up_ = "up";
+static decltype(auto) probes_ = "probes";
+static decltype(auto) failures_ = "failures";
+static decltype(auto) latency_ = "latency";
+
+} // namespace HealthVOKey
+
+namespace StatsVOKey {
+
+static decltype(auto) total_ = "total";
+static decltype(auto) ingresses_ = "ingresses";
+static decltype(auto) egresses_ = "egresses";
+static decltype(auto) rules_ = "rules";
+static decltype(auto) health_ = "health";
+
+} // namespace StatsVOKey
+
+namespace HistogramVOKey {
+
+static decltype(auto) count_ = "count";
+static decltype(auto) mean_ = "mean";
+static decltype(auto) max_ = "max";
+static decltype(auto) p50_ = "p50";
+static decltype(auto) p90_ = "p90";
+static decltype(auto) p99_ = "p99";
+static decltype(auto) p999_ = "p999";
+
+} // namespace HistogramVOKey
+
+namespace LatencyVOKey {
+
+static decltype(auto) readIV_ = "read_iv";
+static decltype(auto) readRemote_ = "read_remote";
+static decltype(auto) resolve_ = "resolve";
+static decltype(auto) route_ = "route";
+static decltype(auto) connect_ = "connect";
+static decltype(auto) confirm_ = "confirm";
+static decltype(auto) firstByte_ = "first_byte";
+
+} // namespace LatencyVOKey
+
 namespace ErrorVOKey {
 
 static decltype(auto) message_ = "message";
@@ -101,6 +259,25 @@ static auto const CM_INVALID = "Invalid crypto method string"sv;
 static auto const PT_INVALID = "Port number must be in range (0, 65536)"sv;
 static auto const DM_INVALID = "Invalid delay mode type string"sv;
 static auto const DL_INVALID = "Delay time must be in range [0, 300]"sv;
+static auto const LV_INVALID = "Invalid log level string"sv;
+static auto const FMT_INVALID = "Invalid log format string"sv;
+static auto const LMT_INVALID = "Limit must be a non-negative integer"sv;
+static auto const BUF_INVALID = "Buffer size must be in range (0, 2147483648)"sv;
+static auto const KA_INVALID = "Keepalive must be in range [0, 65535]"sv;
+static auto const LOWAT_INVALID = "notsent_lowat must be in range [0, 2147483648)"sv;
+static auto const TOS_INVALID = "TOS must be in range [0, 255]"sv;
+static auto const POOL_SIZE_INVALID = "Pool size must be in range [1, 64]"sv;
+static auto const POOL_IDLE_INVALID = "Pool idle time must be in range [1, 3600]"sv;
+static auto const CONN_INVALID = "Connections must be in range [1, 16]"sv;
+static auto const UDP_INVALID = "UDP requires an AEAD method"sv;
+static auto const BAL_INVALID = "Invalid balance string"sv;
+static auto const MEMBERS_INVALID = "Members must be 1 to 64 egress names"sv;
+static auto const ADMISSION_INVALID = "Admission limits must be positive integers"sv;
+static auto const INTERVAL_INVALID = "Health check interval must be in range [1, 3600]"sv;
+static auto const TIMEOUT_INVALID = "Health check timeout must be in range [1, 60]"sv;
+static auto const THRESHOLD_INVALID = "Health check thresholds must be in range [1, 10]"sv;
+static auto const DEADLINE_INVALID = "Drain deadline must be in range [0, 3600]"sv;
+static auto const PATCH_INVALID = "Only range, domain and pattern can be patched"sv;
 static auto const STR_EMPTY = "Empty string"sv;
 static auto const MISSING_TYPE_FIELD = "Missing type field"sv;
 static auto const MISSING_HOST_FIELD = "Missing host field"sv;
@@ -111,6 +288,8 @@ static auto const MISSING_PW_FIELD = "Missing password field"sv;
 static auto const MISSING_EG_FIELD = "Missing egress field"sv;
 static auto const MISSING_MODE_FIELD = "Missing mode field"sv;
 static auto const MISSING_DELAY_FIELD = "Missing delay field"sv;
+static auto const MISSING_MEMBERS_FIELD = "Missing members field"sv;
+static auto const MISSING_SIZE_FIELD = "Missing size field"sv;
 static auto const MISSING_CERT_FILE_FIELD = "Missing cert_file field"sv;
 static auto const MISSING_KEY_FILE_FIELD = "Missing key_file field"sv;
 
@@ -125,6 +304,37 @@ static DelayMode parseDelayMode(json::Value const& v)
   fail(PichiError::BAD_JSON, msg::DM_INVALID);
 }
 
+static Balance parseBalance(json::Value const& v)
+{
+  assertTrue(v.IsString(), PichiError::BAD_JSON, msg::STR_TYPE_ERROR);
+  auto str = string_view{v.GetString()};
+  if (str == ROUND_ROBIN_BALANCE) return Balance::ROUND_ROBIN;
+  if (str == LEAST_SESSIONS_BALANCE) return Balance::LEAST_SESSIONS;
+  if (str == LATENCY_BALANCE) return Balance::LATENCY;
+  if (str == HASH_BALANCE) return Balance::HASH;
+  fail(PichiError::BAD_JSON, msg::BAL_INVALID);
+}
+
+static log::Level parseLevel(json::Value const& v)
+{
+  assertTrue(v.IsString(), PichiError::BAD_JSON, msg::STR_TYPE_ERROR);
+  auto str = string_view{v.GetString()};
+  if (str == DEBUG_LEVEL) return log::Level::DEBUG;
+  if (str == INFO_LEVEL) return log::Level::INFO;
+  if (str == WARN_LEVEL) return log::Level::WARN;
+  if (str == ERROR_LEVEL) return log::Level::ERR;
+  fail(PichiError::BAD_JSON, msg::LV_INVALID);
+}
+
+static log::Format parseFormat(json::Value const& v)
+{
+  assertTrue(v.IsString(), PichiError::BAD_JSON, msg::STR_TYPE_ERROR);
+  auto str = string_view{v.GetString()};
+  if (str == TEXT_FORMAT) return log::Format::TEXT;
+  if (str == JSON_FORMAT) return log::Format::JSON;
+  fail(PichiError::BAD_JSON, msg::FMT_INVALID);
+}
+
 static AdapterType parseAdapterType(json::Value const& v)
 {
   assertTrue(v.IsString(), PichiError::BAD_JSON, msg::STR_TYPE_ERROR);
@@ -134,6 +344,8 @@ static AdapterType parseAdapterType(json::Value const& v)
   if (str == SOCKS5_TYPE) return AdapterType::SOCKS5;
   if (str == HTTP_TYPE) return AdapterType::HTTP;
   if (str == SS_TYPE) return AdapterType::SS;
+  if (str == MUX_TYPE) return AdapterType::MUX;
+  if (str == GROUP_TYPE) return AdapterType::GROUP;
   fail(PichiError::BAD_JSON, msg::AT_INVALID);
 }
 
@@ -163,6 +375,20 @@ static CryptoMethod parseCryptoMethod(json::Value const& v)
   fail(PichiError::BAD_JSON, msg::CM_INVALID);
 }
 
+static bool isAead(CryptoMethod method)
+{
+  switch (method) {
+  case CryptoMethod::AES_128_GCM:
+  case CryptoMethod::AES_192_GCM:
+  case CryptoMethod::AES_256_GCM:
+  case CryptoMethod::CHACHA20_IETF_POLY1305:
+  case CryptoMethod::XCHACHA20_IETF_POLY1305:
+    return true;
+  default:
+    return false;
+  }
+}
+
 static uint16_t parsePort(json::Value const& v)
 {
   assertTrue(v.IsInt(), PichiError::BAD_JSON, msg::INT_TYPE_ERROR);
@@ -194,6 +420,97 @@ static pair<string, string> parseRule(json::Value const& v)
   return make_pair(parseString(array[0]), parseString(array[1]));
 }
 
+template <typename Integer>
+static Integer parseInteger(json::Value const& v, Integer min, Integer max, string_view error)
+{
+  assertTrue(v.IsUint(), PichiError::BAD_JSON, error);
+  auto value = v.GetUint();
+  assertTrue(value >= min && value <= max, PichiError::BAD_JSON, error);
+  return static_cast<Integer>(value);
+}
+
+static SocketOptions parseSocketOptions(json::Value const& v)
+{
+  assertTrue(v.IsObject(), PichiError::BAD_JSON, msg::OBJ_TYPE_ERROR);
+
+  auto maxInt = static_cast<uint32_t>(numeric_limits<int>::max());
+  auto ret = SocketOptions{};
+  if (v.HasMember(SocketOptionsKey::noDelay_))
+    ret.noDelay_ = parseBoolean(v[SocketOptionsKey::noDelay_]);
+  if (v.HasMember(SocketOptionsKey::recvBuffer_))
+    ret.recvBuffer_ = parseInteger(v[SocketOptionsKey::recvBuffer_], 1u, maxInt, msg::BUF_INVALID);
+  if (v.HasMember(SocketOptionsKey::sendBuffer_))
+    ret.sendBuffer_ = parseInteger(v[SocketOptionsKey::sendBuffer_], 1u, maxInt, msg::BUF_INVALID);
+  if (v.HasMember(SocketOptionsKey::keepAlive_))
+    ret.keepAlive_ = parseInteger<uint16_t>(v[SocketOptionsKey::keepAlive_], 0,
+                                            numeric_limits<uint16_t>::max(), msg::KA_INVALID);
+  if (v.HasMember(SocketOptionsKey::congestion_))
+    ret.congestion_ = parseString(v[SocketOptionsKey::congestion_]);
+  if (v.HasMember(SocketOptionsKey::notSentLowat_))
+    ret.notSentLowat_ =
+        parseInteger(v[SocketOptionsKey::notSentLowat_], 0u, maxInt, msg::LOWAT_INVALID);
+  if (v.HasMember(SocketOptionsKey::tos_))
+    ret.tos_ = parseInteger<uint8_t>(v[SocketOptionsKey::tos_], 0,
+                                     numeric_limits<uint8_t>::max(), msg::TOS_INVALID);
+  if (v.HasMember(SocketOptionsKey::fastOpen_))
+    ret.fastOpen_ = parseBoolean(v[SocketOptionsKey::fastOpen_]);
+  return ret;
+}
+
+static PoolVO parsePool(json::Value const& v)
+{
+  assertTrue(v.IsObject(), PichiError::BAD_JSON, msg::OBJ_TYPE_ERROR);
+  assertTrue(v.HasMember(PoolVOKey::size_), PichiError::BAD_JSON, msg::MISSING_SIZE_FIELD);
+
+  auto ret = PoolVO{};
+  ret.size_ = parseInteger<uint16_t>(v[PoolVOKey::size_], 1, MAX_POOL_SIZE, msg::POOL_SIZE_INVALID);
+  ret.idle_ = DEFAULT_POOL_IDLE;
+  if (v.HasMember(PoolVOKey::idle_))
+    ret.idle_ =
+        parseInteger<uint16_t>(v[PoolVOKey::idle_], 1, MAX_POOL_IDLE, msg::POOL_IDLE_INVALID);
+  return ret;
+}
+
+static AdmissionVO parseAdmission(json::Value const& v)
+{
+  assertTrue(v.IsObject(), PichiError::BAD_JSON, msg::OBJ_TYPE_ERROR);
+
+  auto maxInt = numeric_limits<uint32_t>::max();
+  auto ret = AdmissionVO{};
+  if (v.HasMember(AdmissionVOKey::sessions_))
+    ret.sessions_ =
+        parseInteger(v[AdmissionVOKey::sessions_], 1u, maxInt, msg::ADMISSION_INVALID);
+  if (v.HasMember(AdmissionVOKey::handshakes_))
+    ret.handshakes_ =
+        parseInteger(v[AdmissionVOKey::handshakes_], 1u, maxInt, msg::ADMISSION_INVALID);
+  if (v.HasMember(AdmissionVOKey::rate_))
+    ret.rate_ = parseInteger(v[AdmissionVOKey::rate_], 1u, maxInt, msg::ADMISSION_INVALID);
+  return ret;
+}
+
+static HealthCheckVO parseHealthCheck(json::Value const& v)
+{
+  assertTrue(v.IsObject(), PichiError::BAD_JSON, msg::OBJ_TYPE_ERROR);
+
+  auto ret = HealthCheckVO{DEFAULT_HEALTH_INTERVAL, DEFAULT_HEALTH_TIMEOUT, DEFAULT_HEALTH_RISE,
+                           DEFAULT_HEALTH_FALL};
+  if (v.HasMember(HealthCheckVOKey::interval_))
+    ret.interval_ = parseInteger<uint16_t>(v[HealthCheckVOKey::interval_], 1, MAX_HEALTH_INTERVAL,
+                                           msg::INTERVAL_INVALID);
+  if (v.HasMember(HealthCheckVOKey::timeout_))
+    ret.timeout_ = parseInteger<uint16_t>(v[HealthCheckVOKey::timeout_], 1, MAX_HEALTH_TIMEOUT,
+                                          msg::TIMEOUT_INVALID);
+  if (v.HasMember(HealthCheckVOKey::rise_))
+    ret.rise_ = parseInteger<uint8_t>(v[HealthCheckVOKey::rise_], 1, MAX_HEALTH_THRESHOLD,
+                                      msg::THRESHOLD_INVALID);
+  if (v.HasMember(HealthCheckVOKey::fall_))
+    ret.fall_ = parseInteger<uint8_t>(v[HealthCheckVOKey::fall_], 1, MAX_HEALTH_THRESHOLD,
+                                      msg::THRESHOLD_INVALID);
+  if (v.HasMember(HealthCheckVOKey::fallback_))
+    ret.fallback_ = parseString(v[HealthCheckVOKey::fallback_]);
+  return ret;
+}
+
 template <typename OutputIt, typename T, typename Convert>
 void parseArray(json::Value const& root, T const& key, OutputIt out, Convert&& convert)
 {
@@ -222,6 +539,22 @@ json::Value toJson(DelayMode mode, Allocator& alloc)
   }
 }
 
+json::Value toJson(Balance balance, Allocator& alloc)
+{
+  switch (balance) {
+  case Balance::ROUND_ROBIN:
+    return toJson(ROUND_ROBIN_BALANCE, alloc);
+  case Balance::LEAST_SESSIONS:
+    return toJson(LEAST_SESSIONS_BALANCE, alloc);
+  case Balance::LATENCY:
+    return toJson(LATENCY_BALANCE, alloc);
+  case Balance::HASH:
+    return toJson(HASH_BALANCE, alloc);
+  default:
+    fail();
+  }
+}
+
 json::Value toJson(AdapterType type, Allocator& alloc)
 {
   switch (type) {
@@ -235,6 +568,10 @@ json::Value toJson(AdapterType type, Allocator& alloc)
     return toJson(HTTP_TYPE, alloc);
   case AdapterType::SS:
     return toJson(SS_TYPE, alloc);
+  case AdapterType::MUX:
+    return toJson(MUX_TYPE, alloc);
+  case AdapterType::GROUP:
+    return toJson(GROUP_TYPE, alloc);
   default:
     fail(PichiError::MISC);
   }
@@ -286,12 +623,72 @@ json::Value toJson(CryptoMethod method, Allocator& alloc)
   }
 }
 
+json::Value toJson(SocketOptions const& options, Allocator& alloc)
+{
+  auto ret = json::Value{};
+  ret.SetObject();
+  if (options.noDelay_.has_value())
+    ret.AddMember(SocketOptionsKey::noDelay_, *options.noDelay_, alloc);
+  if (options.recvBuffer_.has_value())
+    ret.AddMember(SocketOptionsKey::recvBuffer_, *options.recvBuffer_, alloc);
+  if (options.sendBuffer_.has_value())
+    ret.AddMember(SocketOptionsKey::sendBuffer_, *options.sendBuffer_, alloc);
+  if (options.keepAlive_.has_value())
+    ret.AddMember(SocketOptionsKey::keepAlive_, json::Value{*options.keepAlive_}, alloc);
+  if (options.congestion_.has_value())
+    ret.AddMember(SocketOptionsKey::congestion_, toJson(*options.congestion_, alloc), alloc);
+  if (options.notSentLowat_.has_value())
+    ret.AddMember(SocketOptionsKey::notSentLowat_, *options.notSentLowat_, alloc);
+  if (options.tos_.has_value())
+    ret.AddMember(SocketOptionsKey::tos_, json::Value{*options.tos_}, alloc);
+  if (options.fastOpen_.has_value())
+    ret.AddMember(SocketOptionsKey::fastOpen_, *options.fastOpen_, alloc);
+  return ret;
+}
+
+json::Value toJson(PoolVO const& pool, Allocator& alloc)
+{
+  auto ret = json::Value{};
+  ret.SetObject();
+  ret.AddMember(PoolVOKey::size_, json::Value{pool.size_}, alloc);
+  ret.AddMember(PoolVOKey::idle_, json::Value{pool.idle_}, alloc);
+  return ret;
+}
+
+json::Value toJson(AdmissionVO const& admission, Allocator& alloc)
+{
+  auto ret = json::Value{};
+  ret.SetObject();
+  if (admission.sessions_.has_value())
+    ret.AddMember(AdmissionVOKey::sessions_, json::Value{*admission.sessions_}, alloc);
+  if (admission.handshakes_.has_value())
+    ret.AddMember(AdmissionVOKey::handshakes_, json::Value{*admission.handshakes_}, alloc);
+  if (admission.rate_.has_value())
+    ret.AddMember(AdmissionVOKey::rate_, json::Value{*admission.rate_}, alloc);
+  return ret;
+}
+
+json::Value toJson(HealthCheckVO const& health, Allocator& alloc)
+{
+  auto ret = json::Value{};
+  ret.SetObject();
+  ret.AddMember(HealthCheckVOKey::interval_, json::Value{health.interval_}, alloc);
+  ret.AddMember(HealthCheckVOKey::timeout_, json::Value{health.timeout_}, alloc);
+  ret.AddMember(HealthCheckVOKey::rise_, json::Value{health.rise_}, alloc);
+  ret.AddMember(HealthCheckVOKey::fall_, json::Value{health.fall_}, alloc);
+  if (health.fallback_.has_value()) {
+    assertFalse(health.fallback_->empty(), PichiError::MISC);
+    ret.AddMember(HealthCheckVOKey::fallback_, toJson(*health.fallback_, alloc), alloc);
+  }
+  return ret;
+}
+
 json::Value toJson(IngressVO const& ingress, Allocator& alloc)
 {
   auto ret = json::Value{};
   ret.SetObject();
   if (ingress.type_ == AdapterType::HTTP || ingress.type_ == AdapterType::SOCKS5 ||
-      ingress.type_ == AdapterType::SS) {
+      ingress.type_ == AdapterType::SS || ingress.type_ == AdapterType::MUX) {
     assertFalse(ingress.bind_.empty(), PichiError::MISC);
     assertFalse(ingress.port_ == 0, PichiError::MISC);
     ret.AddMember(IngressVOKey::bind_, toJson(ingress.bind_, alloc), alloc);
@@ -305,9 +702,12 @@ json::Value toJson(IngressVO const& ingress, Allocator& alloc)
     assertFalse(ingress.password_->empty(), PichiError::MISC);
     ret.AddMember(IngressVOKey::method_, toJson(*ingress.method_, alloc), alloc);
     ret.AddMember(IngressVOKey::password_, toJson(*ingress.password_, alloc), alloc);
+    assertTrue(ingress.udp_.has_value(), PichiError::MISC);
+    ret.AddMember(IngressVOKey::udp_, *ingress.udp_, alloc);
     break;
   case AdapterType::HTTP:
   case AdapterType::SOCKS5:
+  case AdapterType::MUX:
     assertTrue(ingress.tls_.has_value(), PichiError::MISC);
     ret.AddMember(IngressVOKey::tls_, *ingress.tls_, alloc);
     if (*ingress.tls_) {
@@ -322,6 +722,10 @@ json::Value toJson(IngressVO const& ingress, Allocator& alloc)
   default:
     fail(PichiError::MISC);
   }
+  if (ingress.socket_.has_value())
+    ret.AddMember(IngressVOKey::socket_, toJson(*ingress.socket_, alloc), alloc);
+  if (ingress.admission_.has_value())
+    ret.AddMember(IngressVOKey::admission_, toJson(*ingress.admission_, alloc), alloc);
   return ret;
 }
 
@@ -330,13 +734,18 @@ json::Value toJson(EgressVO const& evo, Allocator& alloc)
   auto egress_ = json::Value{};
   egress_.SetObject();
   egress_.AddMember(EgressVOKey::type_, toJson(evo.type_, alloc), alloc);
-  if (evo.type_ != AdapterType::DIRECT && evo.type_ != AdapterType::REJECT) {
+  if (evo.type_ != AdapterType::DIRECT && evo.type_ != AdapterType::REJECT &&
+      evo.type_ != AdapterType::GROUP) {
     assertTrue(evo.host_.has_value(), PichiError::MISC);
     assertFalse(evo.host_->empty(), PichiError::MISC);
     assertTrue(evo.port_.has_value(), PichiError::MISC);
     assertFalse(*evo.port_ == 0, PichiError::MISC);
     egress_.AddMember(EgressVOKey::host_, toJson(*evo.host_, alloc), alloc);
     egress_.AddMember(EgressVOKey::port_, json::Value{*evo.port_}, alloc);
+    if (evo.pool_.has_value())
+      egress_.AddMember(EgressVOKey::pool_, toJson(*evo.pool_, alloc), alloc);
+    if (evo.health_.has_value())
+      egress_.AddMember(EgressVOKey::health_, toJson(*evo.health_, alloc), alloc);
   }
   switch (evo.type_) {
   case AdapterType::SS:
@@ -345,7 +754,13 @@ json::Value toJson(EgressVO const& evo, Allocator& alloc)
     assertFalse(evo.password_->empty(), PichiError::MISC);
     egress_.AddMember(EgressVOKey::method_, toJson(*evo.method_, alloc), alloc);
     egress_.AddMember(EgressVOKey::password_, toJson(*evo.password_, alloc), alloc);
+    assertTrue(evo.udp_.has_value(), PichiError::MISC);
+    egress_.AddMember(EgressVOKey::udp_, *evo.udp_, alloc);
     break;
+  case AdapterType::MUX:
+    assertTrue(evo.connections_.has_value(), PichiError::MISC);
+    egress_.AddMember(EgressVOKey::connections_, json::Value{*evo.connections_}, alloc);
+    [[fallthrough]];
   case AdapterType::SOCKS5:
   case AdapterType::HTTP:
     assertTrue(evo.tls_.has_value(), PichiError::MISC);
@@ -368,11 +783,20 @@ json::Value toJson(EgressVO const& evo, Allocator& alloc)
       egress_.AddMember(EgressVOKey::delay_, json::Value{*evo.delay_}, alloc);
     }
     break;
+  case AdapterType::GROUP:
+    assertFalse(evo.members_.empty(), PichiError::MISC);
+    assertTrue(evo.balance_.has_value(), PichiError::MISC);
+    egress_.AddMember(EgressVOKey::members_,
+                      toJson(cbegin(evo.members_), cend(evo.members_), alloc), alloc);
+    egress_.AddMember(EgressVOKey::balance_, toJson(*evo.balance_, alloc), alloc);
+    break;
   case AdapterType::DIRECT:
     break;
   default:
     fail(PichiError::MISC);
   }
+  if (evo.type_ != AdapterType::REJECT && evo.socket_.has_value())
+    egress_.AddMember(EgressVOKey::socket_, toJson(*evo.socket_, alloc), alloc);
 
   return egress_;
 }
@@ -396,6 +820,7 @@ json::Value toJson(RuleVO const& rvo, Allocator& alloc)
   if (!rvo.country_.empty())
     rule.AddMember(RuleVOKey::country_, toJson(begin(rvo.country_), end(rvo.country_), alloc),
                    alloc);
+  if (rvo.file_.has_value()) rule.AddMember(RuleVOKey::file_, toJson(*rvo.file_, alloc), alloc);
   return rule;
 }
 
@@ -422,6 +847,107 @@ json::Value toJson(RouteVO const& rvo, Allocator& alloc)
   return route;
 }
 
+json::Value toJson(LogVO const& lvo, Allocator& alloc)
+{
+  assertTrue(lvo.level_.has_value(), PichiError::MISC);
+  assertTrue(lvo.format_.has_value(), PichiError::MISC);
+  assertTrue(lvo.limit_.has_value(), PichiError::MISC);
+
+  auto ret = json::Value{};
+  ret.SetObject();
+  switch (*lvo.level_) {
+  case log::Level::DEBUG:
+    ret.AddMember(LogVOKey::level_, toJson(DEBUG_LEVEL, alloc), alloc);
+    break;
+  case log::Level::INFO:
+    ret.AddMember(LogVOKey::level_, toJson(INFO_LEVEL, alloc), alloc);
+    break;
+  case log::Level::WARN:
+    ret.AddMember(LogVOKey::level_, toJson(WARN_LEVEL, alloc), alloc);
+    break;
+  case log::Level::ERR:
+    ret.AddMember(LogVOKey::level_, toJson(ERROR_LEVEL, alloc), alloc);
+    break;
+  default:
+    fail(PichiError::MISC);
+  }
+  ret.AddMember(LogVOKey::format_,
+                toJson(*lvo.format_ == log::Format::JSON ? JSON_FORMAT : TEXT_FORMAT, alloc),
+                alloc);
+  ret.AddMember(LogVOKey::limit_, json::Value{*lvo.limit_}, alloc);
+  return ret;
+}
+
+json::Value toJson(CountersVO const& cvo, Allocator& alloc)
+{
+  auto ret = json::Value{};
+  ret.SetObject();
+  ret.AddMember(CountersVOKey::bytesIn_, cvo.bytesIn_, alloc);
+  ret.AddMember(CountersVOKey::bytesOut_, cvo.bytesOut_, alloc);
+  ret.AddMember(CountersVOKey::activeSessions_, cvo.activeSessions_, alloc);
+  ret.AddMember(CountersVOKey::totalSessions_, cvo.totalSessions_, alloc);
+  ret.AddMember(CountersVOKey::handshakeFailures_, cvo.handshakeFailures_, alloc);
+  ret.AddMember(CountersVOKey::duplicatedIvs_, cvo.duplicatedIvs_, alloc);
+  ret.AddMember(CountersVOKey::rejectHits_, cvo.rejectHits_, alloc);
+  ret.AddMember(CountersVOKey::shedConnections_, cvo.shedConnections_, alloc);
+  ret.AddMember(CountersVOKey::truncatedDatagrams_, cvo.truncatedDatagrams_, alloc);
+  return ret;
+}
+
+json::Value toJson(HealthVO const& hvo, Allocator& alloc)
+{
+  auto ret = json::Value{};
+  ret.SetObject();
+  ret.AddMember(HealthVOKey::up_, hvo.up_, alloc);
+  ret.AddMember(HealthVOKey::probes_, hvo.probes_, alloc);
+  ret.AddMember(HealthVOKey::failures_, hvo.failures_, alloc);
+  ret.AddMember(HealthVOKey::latency_, hvo.latency_, alloc);
+  return ret;
+}
+
+json::Value toJson(StatsVO const& svo, Allocator& alloc)
+{
+  auto ret = json::Value{};
+  ret.SetObject();
+  ret.AddMember(StatsVOKey::total_, toJson(svo.total_, alloc), alloc);
+  ret.AddMember(StatsVOKey::ingresses_,
+                toJson(cbegin(svo.ingresses_), cend(svo.ingresses_), alloc), alloc);
+  ret.AddMember(StatsVOKey::egresses_, toJson(cbegin(svo.egresses_), cend(svo.egresses_), alloc),
+                alloc);
+  ret.AddMember(StatsVOKey::rules_, toJson(cbegin(svo.rules_), cend(svo.rules_), alloc), alloc);
+  ret.AddMember(StatsVOKey::health_, toJson(cbegin(svo.health_), cend(svo.health_), alloc), alloc);
+  return ret;
+}
+
+json::Value toJson(HistogramVO const& hvo, Allocator& alloc)
+{
+  auto ret = json::Value{};
+  ret.SetObject();
+  ret.AddMember(HistogramVOKey::count_, hvo.count_, alloc);
+  ret.AddMember(HistogramVOKey::mean_, hvo.mean_, alloc);
+  ret.AddMember(HistogramVOKey::max_, hvo.max_, alloc);
+  ret.AddMember(HistogramVOKey::p50_, hvo.p50_, alloc);
+  ret.AddMember(HistogramVOKey::p90_, hvo.p90_, alloc);
+  ret.AddMember(HistogramVOKey::p99_, hvo.p99_, alloc);
+  ret.AddMember(HistogramVOKey::p999_, hvo.p999_, alloc);
+  return ret;
+}
+
+json::Value toJson(LatencyVO const& lvo, Allocator& alloc)
+{
+  auto ret = json::Value{};
+  ret.SetObject();
+  ret.AddMember(LatencyVOKey::readIV_, toJson(lvo.readIV_, alloc), alloc);
+  ret.AddMember(LatencyVOKey::readRemote_, toJson(lvo.readRemote_, alloc), alloc);
+  ret.AddMember(LatencyVOKey::resolve_, toJson(lvo.resolve_, alloc), alloc);
+  ret.AddMember(LatencyVOKey::route_, toJson(lvo.route_, alloc), alloc);
+  ret.AddMember(LatencyVOKey::connect_, toJson(cbegin(lvo.connect_), cend(lvo.connect_), alloc),
+                alloc);
+  ret.AddMember(LatencyVOKey::confirm_, toJson(lvo.confirm_, alloc), alloc);
+  ret.AddMember(LatencyVOKey::firstByte_, toJson(lvo.firstByte_, alloc), alloc);
+  return ret;
+}
+
 json::Value toJson(ErrorVO const& evo, Allocator& alloc)
 {
   using StringRef = json::Value::StringRefType;
@@ -444,7 +970,7 @@ template <> IngressVO parse(json::Value const& v)
 
   ivo.type_ = parseAdapterType(v[IngressVOKey::type_]);
   if (ivo.type_ == AdapterType::HTTP || ivo.type_ == AdapterType::SOCKS5 ||
-      ivo.type_ == AdapterType::SS) {
+      ivo.type_ == AdapterType::SS || ivo.type_ == AdapterType::MUX) {
     assertTrue(v.HasMember(IngressVOKey::bind_), PichiError::BAD_JSON, msg::MISSING_BIND_FIELD);
     assertTrue(v.HasMember(IngressVOKey::port_), PichiError::BAD_JSON, msg::MISSING_PORT_FIELD);
     ivo.bind_ = parseString(v[IngressVOKey::bind_]);
@@ -457,9 +983,12 @@ template <> IngressVO parse(json::Value const& v)
     assertTrue(v.HasMember(IngressVOKey::password_), PichiError::BAD_JSON, msg::MISSING_PW_FIELD);
     ivo.method_ = parseCryptoMethod(v[IngressVOKey::method_]);
     ivo.password_ = parseString(v[IngressVOKey::password_]);
+    ivo.udp_ = v.HasMember(IngressVOKey::udp_) && parseBoolean(v[IngressVOKey::udp_]);
+    assertFalse(*ivo.udp_ && !isAead(*ivo.method_), PichiError::BAD_JSON, msg::UDP_INVALID);
     break;
   case AdapterType::SOCKS5:
   case AdapterType::HTTP:
+  case AdapterType::MUX:
     ivo.tls_ = v.HasMember(IngressVOKey::tls_) && parseBoolean(v[IngressVOKey::tls_]);
     if (*ivo.tls_) {
       assertTrue(v.HasMember(IngressVOKey::certFile_), PichiError::BAD_JSON,
@@ -473,6 +1002,10 @@ template <> IngressVO parse(json::Value const& v)
   default:
     fail(PichiError::BAD_JSON, msg::AT_INVALID);
   }
+  if (v.HasMember(IngressVOKey::socket_))
+    ivo.socket_ = parseSocketOptions(v[IngressVOKey::socket_]);
+  if (v.HasMember(IngressVOKey::admission_))
+    ivo.admission_ = parseAdmission(v[IngressVOKey::admission_]);
 
   return ivo;
 }
@@ -486,11 +1019,17 @@ template <> EgressVO parse(json::Value const& v)
   evo.type_ = parseAdapterType(v[EgressVOKey::type_]);
 
   if (evo.type_ == AdapterType::HTTP || evo.type_ == AdapterType::SOCKS5 ||
-      evo.type_ == AdapterType::SS) {
+      evo.type_ == AdapterType::SS || evo.type_ == AdapterType::MUX) {
     assertTrue(v.HasMember(EgressVOKey::host_), PichiError::BAD_JSON, msg::MISSING_HOST_FIELD);
     assertTrue(v.HasMember(EgressVOKey::port_), PichiError::BAD_JSON, msg::MISSING_PORT_FIELD);
     evo.host_ = parseString(v[EgressVOKey::host_]);
     evo.port_ = parsePort(v[EgressVOKey::port_]);
+    // Streams over a mux share its connections, which are long-lived already
+    if (evo.type_ != AdapterType::MUX && v.HasMember(EgressVOKey::pool_))
+      evo.pool_ = parsePool(v[EgressVOKey::pool_]);
+    // Probing is preconnecting, which isn't done by a mux either
+    if (evo.type_ != AdapterType::MUX && v.HasMember(EgressVOKey::health_))
+      evo.health_ = parseHealthCheck(v[EgressVOKey::health_]);
   }
 
   switch (evo.type_) {
@@ -499,7 +1038,15 @@ template <> EgressVO parse(json::Value const& v)
     assertTrue(v.HasMember(EgressVOKey::password_), PichiError::BAD_JSON, msg::MISSING_PW_FIELD);
     evo.method_ = parseCryptoMethod(v[EgressVOKey::method_]);
     evo.password_ = parseString(v[EgressVOKey::password_]);
+    evo.udp_ = v.HasMember(EgressVOKey::udp_) && parseBoolean(v[EgressVOKey::udp_]);
+    assertFalse(*evo.udp_ && !isAead(*evo.method_), PichiError::BAD_JSON, msg::UDP_INVALID);
     break;
+  case AdapterType::MUX:
+    evo.connections_ = DEFAULT_MUX_CONNECTIONS;
+    if (v.HasMember(EgressVOKey::connections_))
+      evo.connections_ = parseInteger<uint16_t>(v[EgressVOKey::connections_], 1,
+                                                MAX_MUX_CONNECTIONS, msg::CONN_INVALID);
+    [[fallthrough]];
   case AdapterType::SOCKS5:
   case AdapterType::HTTP:
     evo.tls_ = v.HasMember(EgressVOKey::tls_) && parseBoolean(v[EgressVOKey::tls_]);
@@ -527,11 +1074,24 @@ template <> EgressVO parse(json::Value const& v)
       evo.delay_ = 0;
     }
     break;
+  case AdapterType::GROUP:
+    assertTrue(v.HasMember(EgressVOKey::members_), PichiError::BAD_JSON,
+               msg::MISSING_MEMBERS_FIELD);
+    parseArray(v, EgressVOKey::members_, back_inserter(evo.members_), &parseString);
+    assertFalse(evo.members_.empty() || evo.members_.size() > MAX_GROUP_MEMBERS,
+                PichiError::BAD_JSON, msg::MEMBERS_INVALID);
+    evo.balance_ = v.HasMember(EgressVOKey::balance_) ? parseBalance(v[EgressVOKey::balance_]) :
+                                                        Balance::ROUND_ROBIN;
+    break;
   case AdapterType::DIRECT:
     break;
   default:
     fail(PichiError::BAD_JSON, msg::AT_INVALID);
   }
+  // The options are applied to the connections of the members instead
+  if (evo.type_ != AdapterType::REJECT && evo.type_ != AdapterType::GROUP &&
+      v.HasMember(EgressVOKey::socket_))
+    evo.socket_ = parseSocketOptions(v[EgressVOKey::socket_]);
 
   return evo;
 }
@@ -542,16 +1102,33 @@ template <> RuleVO parse(json::Value const& v)
 
   auto rvo = RuleVO{};
 
-  parseArray(v, RuleVOKey::range_, back_inserter(rvo.range_), &parseString);
+  parseArray(v, RuleVOKey::range_, inserter(rvo.range_, end(rvo.range_)), &parseString);
   parseArray(v, RuleVOKey::ingress_, back_inserter(rvo.ingress_), &parseString);
   parseArray(v, RuleVOKey::type_, back_inserter(rvo.type_), &parseAdapterType);
-  parseArray(v, RuleVOKey::pattern_, back_inserter(rvo.pattern_), &parseString);
-  parseArray(v, RuleVOKey::domain_, back_inserter(rvo.domain_), &parseString);
+  parseArray(v, RuleVOKey::pattern_, inserter(rvo.pattern_, end(rvo.pattern_)), &parseString);
+  parseArray(v, RuleVOKey::domain_, inserter(rvo.domain_, end(rvo.domain_)), &parseString);
   parseArray(v, RuleVOKey::country_, back_inserter(rvo.country_), &parseString);
+  if (v.HasMember(RuleVOKey::file_)) rvo.file_ = parseString(v[RuleVOKey::file_]);
 
   return rvo;
 }
 
+template <> RulePatchVO parse(json::Value const& v)
+{
+  assertTrue(v.IsObject(), PichiError::BAD_JSON, msg::OBJ_TYPE_ERROR);
+
+  auto parsePart = [&v](auto&& key) {
+    if (!v.HasMember(key)) return RuleVO{};
+    auto rvo = parse<RuleVO>(v[key]);
+    assertTrue(rvo.ingress_.empty() && rvo.type_.empty() && rvo.country_.empty() &&
+                   !rvo.file_.has_value(),
+               PichiError::BAD_JSON, msg::PATCH_INVALID);
+    return rvo;
+  };
+
+  return {parsePart(RulePatchVOKey::add_), parsePart(RulePatchVOKey::remove_)};
+}
+
 template <> RouteVO parse(json::Value const& v)
 {
   assertTrue(v.IsObject(), PichiError::BAD_JSON, msg::OBJ_TYPE_ERROR);
@@ -565,4 +1142,32 @@ template <> RouteVO parse(json::Value const& v)
   return rvo;
 }
 
+template <> AdmissionVO parse(json::Value const& v) { return parseAdmission(v); }
+
+template <> LogVO parse(json::Value const& v)
+{
+  assertTrue(v.IsObject(), PichiError::BAD_JSON, msg::OBJ_TYPE_ERROR);
+
+  auto lvo = LogVO{};
+  if (v.HasMember(LogVOKey::level_)) lvo.level_ = parseLevel(v[LogVOKey::level_]);
+  if (v.HasMember(LogVOKey::format_)) lvo.format_ = parseFormat(v[LogVOKey::format_]);
+  if (v.HasMember(LogVOKey::limit_)) {
+    assertTrue(v[LogVOKey::limit_].IsUint(), PichiError::BAD_JSON, msg::LMT_INVALID);
+    lvo.limit_ = v[LogVOKey::limit_].GetUint();
+  }
+
+  return lvo;
+}
+
+template <> DrainVO parse(json::Value const& v)
+{
+  assertTrue(v.IsObject(), PichiError::BAD_JSON, msg::OBJ_TYPE_ERROR);
+
+  auto dvo = DrainVO{DEFAULT_DRAIN_DEADLINE};
+  if (v.HasMember(DrainVOKey::deadline_))
+    dvo.deadline_ = parseInteger<uint16_t>(v[DrainVOKey::deadline_], 0, MAX_DRAIN_DEADLINE,
+                                           msg::DEADLINE_INVALID);
+  return dvo;
+}
+
 } // namespace pichi::api
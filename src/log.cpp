@@ -0,0 +1,373 @@
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <charconv>
+#include <chrono>
+#include <cstdio>
+#include <ctime>
+#include <memory>
+#include <mutex>
+#include <pichi/log.hpp>
+#include <pichi/net/helpers.hpp>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+using namespace std;
+using Clock = chrono::system_clock;
+
+namespace pichi::log {
+
+static size_t const RING_SIZE = 1024;
+static size_t const TEXT_SIZE = 256 - sizeof(Clock::time_point) - 8;
+// Type, host size and port of the remote endpoint leading an ACCESS record
+static size_t const REMOTE_HEADER_SIZE = 4;
+static size_t const MAX_WINDOWS = 1024;
+static auto const IDLE_INTERVAL = 20ms;
+static auto const LIMIT_WINDOW = 1s;
+
+enum class Kind : uint8_t { MESSAGE, ACCESS };
+
+struct Record {
+  Clock::time_point time_;
+  Level level_;
+  Kind kind_;
+  uint16_t size_;
+  array<char, TEXT_SIZE> text_;
+
+  void append(string_view s)
+  {
+    auto n = min(s.size(), TEXT_SIZE - size_);
+    copy_n(cbegin(s), n, begin(text_) + size_);
+    size_ += static_cast<uint16_t>(n);
+  }
+
+  string_view text() const { return {text_.data(), size_}; }
+};
+
+/*
+ * Single-producer single-consumer ring, the producer is the owning thread and the consumer is
+ *   the writer thread.
+ */
+class Ring {
+public:
+  Record* reserve()
+  {
+    auto tail = tail_.load(memory_order_relaxed);
+    if (tail - head_.load(memory_order_acquire) == RING_SIZE) {
+      dropped_.fetch_add(1, memory_order_relaxed);
+      return nullptr;
+    }
+    return &records_[tail % RING_SIZE];
+  }
+
+  void commit() { tail_.store(tail_.load(memory_order_relaxed) + 1, memory_order_release); }
+
+  template <typename Consume> bool consume(Consume&& f)
+  {
+    auto head = head_.load(memory_order_relaxed);
+    auto tail = tail_.load(memory_order_acquire);
+    for (auto i = head; i != tail; ++i) f(records_[i % RING_SIZE]);
+    head_.store(tail, memory_order_release);
+    return head != tail;
+  }
+
+  bool empty() const
+  {
+    return head_.load(memory_order_acquire) == tail_.load(memory_order_acquire);
+  }
+
+  size_t dropped() { return dropped_.exchange(0, memory_order_relaxed); }
+
+private:
+  array<Record, RING_SIZE> records_;
+  alignas(64) atomic<size_t> head_ = 0;
+  alignas(64) atomic<size_t> tail_ = 0;
+  atomic<size_t> dropped_ = 0;
+};
+
+static atomic<Level> level_ = Level::INFO;
+static atomic<Format> format_ = Format::TEXT;
+static atomic<uint32_t> limit_ = 10;
+
+static string_view toString(Level level)
+{
+  switch (level) {
+  case Level::DEBUG:
+    return "DEBUG"sv;
+  case Level::INFO:
+    return "INFO"sv;
+  case Level::WARN:
+    return "WARN"sv;
+  default:
+    return "ERROR"sv;
+  }
+}
+
+static void appendTime(string& buf, Clock::time_point time)
+{
+  auto t = Clock::to_time_t(time);
+  auto ms = chrono::duration_cast<chrono::milliseconds>(time.time_since_epoch()).count() % 1000;
+  auto date = array<char, 32>{};
+  // Only invoked by the writer thread
+  auto n = strftime(date.data(), date.size(), "%Y-%m-%dT%H:%M:%S", gmtime(&t));
+  auto millis = array<char, 8>{};
+  snprintf(millis.data(), millis.size(), ".%03dZ", static_cast<int>(ms));
+  buf.append(date.data(), n).append(millis.data());
+}
+
+static void appendEscaped(string& buf, string_view s)
+{
+  for (auto c : s) {
+    switch (c) {
+    case '"':
+      buf.append("\\\"");
+      break;
+    case '\\':
+      buf.append("\\\\");
+      break;
+    default:
+      if (static_cast<unsigned char>(c) < 0x20) {
+        auto hex = array<char, 8>{};
+        snprintf(hex.data(), hex.size(), "\\u%04x", c);
+        buf.append(hex.data());
+      }
+      else
+        buf.push_back(c);
+    }
+  }
+}
+
+/*
+ * The remote endpoint of an ACCESS record is stored in binary, and only formatted here by the
+ *   writer thread.
+ */
+static string_view parseRemote(string_view text, string& remote)
+{
+  if (text.size() < REMOTE_HEADER_SIZE) return {};
+  auto e = net::Endpoint{};
+  e.type_ = static_cast<net::Endpoint::Type>(text[0]);
+  e.size_ = static_cast<uint8_t>(min<size_t>(static_cast<uint8_t>(text[1]),
+                                             text.size() - REMOTE_HEADER_SIZE));
+  e.port_ = net::ntoh<uint16_t>({reinterpret_cast<uint8_t const*>(text.data()) + 2, 2});
+  copy_n(cbegin(text) + REMOTE_HEADER_SIZE, e.size_, begin(e.host_));
+  remote = net::formatHost(e);
+  remote.append(":").append(to_string(e.port_));
+  return text.substr(REMOTE_HEADER_SIZE + e.size_);
+}
+
+static void format(string& buf, Record const& r, Format fmt)
+{
+  auto remote = string{};
+  auto fields = array<string_view, 3>{};
+  if (r.kind_ == Kind::ACCESS) {
+    auto text = parseRemote(r.text(), remote);
+    for (auto& field : fields) {
+      auto pos = min(text.find('\0'), text.size());
+      field = text.substr(0, pos);
+      text.remove_prefix(min(pos + 1, text.size()));
+    }
+  }
+  auto& [ingress, egress, rule] = fields;
+
+  if (fmt == Format::JSON) {
+    buf.append("{\"time\":\"");
+    appendTime(buf, r.time_);
+    buf.append("\",\"level\":\"").append(toString(r.level_)).append("\",");
+    if (r.kind_ == Kind::ACCESS) {
+      buf.append("\"remote\":\"");
+      appendEscaped(buf, remote);
+      buf.append("\",\"ingress\":\"");
+      appendEscaped(buf, ingress);
+      buf.append("\",\"egress\":\"");
+      appendEscaped(buf, egress);
+      buf.append("\",\"rule\":\"");
+      appendEscaped(buf, rule);
+      buf.append("\"}\n");
+    }
+    else {
+      buf.append("\"message\":\"");
+      appendEscaped(buf, r.text());
+      buf.append("\"}\n");
+    }
+  }
+  else {
+    appendTime(buf, r.time_);
+    buf.append(" ").append(toString(r.level_)).append(" ");
+    if (r.kind_ == Kind::ACCESS)
+      buf.append(remote).append(" -> ").append(egress).append(" (");
+    buf.append(r.kind_ == Kind::ACCESS ? rule : r.text());
+    if (r.kind_ == Kind::ACCESS) buf.append(", ").append(ingress).append(")");
+    buf.append("\n");
+  }
+}
+
+class Writer {
+public:
+  Writer() = default;
+  ~Writer()
+  {
+    stopping_.store(true, memory_order_release);
+    thread_.join();
+  }
+
+  Writer(Writer const&) = delete;
+  Writer& operator=(Writer const&) = delete;
+
+  shared_ptr<Ring> attach()
+  {
+    auto lock = unique_lock<mutex>{mutex_};
+    return rings_.emplace_back(make_shared<Ring>());
+  }
+
+private:
+  void run()
+  {
+    while (!stopping_.load(memory_order_acquire))
+      if (!drain()) this_thread::sleep_for(IDLE_INTERVAL);
+    drain();
+  }
+
+  bool drain()
+  {
+    auto rings = vector<shared_ptr<Ring>>{};
+    {
+      auto lock = unique_lock<mutex>{mutex_};
+      // Rings whose owning threads have exited are released once drained
+      rings_.erase(remove_if(begin(rings_), end(rings_),
+                             [](auto&& ring) { return ring.use_count() == 1 && ring->empty(); }),
+                   end(rings_));
+      rings = rings_;
+    }
+
+    auto fmt = format_.load(memory_order_relaxed);
+    auto busy = false;
+    buf_.clear();
+    for (auto&& ring : rings) {
+      busy = ring->consume([this, fmt](auto&& r) { format(buf_, r, fmt); }) || busy;
+      auto dropped = ring->dropped();
+      if (dropped > 0) {
+        auto notice = Record{Clock::now(), Level::WARN, Kind::MESSAGE, 0, {}};
+        auto n = to_string(dropped);
+        notice.append(n);
+        notice.append(" log records dropped");
+        format(buf_, notice, fmt);
+      }
+    }
+    if (!buf_.empty()) {
+      fwrite(buf_.data(), 1, buf_.size(), stdout);
+      fflush(stdout);
+    }
+    return busy;
+  }
+
+  mutex mutex_;
+  vector<shared_ptr<Ring>> rings_;
+  string buf_;
+  atomic<bool> stopping_ = false;
+  thread thread_{[this]() { run(); }};
+};
+
+struct Window {
+  Clock::time_point start_;
+  uint32_t count_;
+  uint32_t suppressed_;
+};
+
+struct Local {
+  shared_ptr<Ring> ring_;
+  unordered_map<size_t, Window> windows_ = {};
+};
+
+static Local& local()
+{
+  static auto writer = Writer{};
+  thread_local auto local = Local{writer.attach()};
+  return local;
+}
+
+static Record* reserve(Level level, Kind kind)
+{
+  auto r = local().ring_->reserve();
+  if (r != nullptr) {
+    r->time_ = Clock::now();
+    r->level_ = level;
+    r->kind_ = kind;
+    r->size_ = 0;
+  }
+  return r;
+}
+
+/*
+ * Identical WARN/ERR records beyond the limit are suppressed within a window, and the number of
+ *   suppressed ones is attached to the first record of the next window.
+ */
+static bool throttle(Record& r)
+{
+  auto limit = limit_.load(memory_order_relaxed);
+  if (r.level_ < Level::WARN || limit == 0) return false;
+
+  auto& windows = local().windows_;
+  if (windows.size() >= MAX_WINDOWS) windows.clear();
+  auto& w = windows.try_emplace(hash<string_view>{}(r.text()), Window{r.time_, 0, 0}).first->second;
+  if (r.time_ - w.start_ >= LIMIT_WINDOW) {
+    if (w.suppressed_ > 0) {
+      r.append(" (");
+      r.append(to_string(w.suppressed_));
+      r.append(" identical records suppressed)");
+    }
+    w = Window{r.time_, 0, 0};
+  }
+  if (w.count_ < limit) {
+    ++w.count_;
+    return false;
+  }
+  ++w.suppressed_;
+  return true;
+}
+
+Settings settings()
+{
+  return {level_.load(memory_order_relaxed), format_.load(memory_order_relaxed),
+          limit_.load(memory_order_relaxed)};
+}
+
+void configure(Settings const& s)
+{
+  level_.store(s.level_, memory_order_relaxed);
+  format_.store(s.format_, memory_order_relaxed);
+  limit_.store(s.limit_, memory_order_relaxed);
+}
+
+bool enabled(Level level) { return level >= level_.load(memory_order_relaxed); }
+
+void write(Level level, initializer_list<string_view> pieces)
+{
+  auto r = reserve(level, Kind::MESSAGE);
+  if (r == nullptr) return;
+  for (auto piece : pieces) r->append(piece);
+  if (!throttle(*r)) local().ring_->commit();
+}
+
+void access(net::Endpoint const& remote, string_view ingress, string_view egress,
+            string_view rule)
+{
+  if (!enabled(Level::INFO)) return;
+  auto r = reserve(Level::INFO, Kind::ACCESS);
+  if (r == nullptr) return;
+  auto header = array<uint8_t, REMOTE_HEADER_SIZE>{};
+  header[0] = static_cast<uint8_t>(remote.type_);
+  header[1] = static_cast<uint8_t>(min<size_t>(remote.size_, TEXT_SIZE - REMOTE_HEADER_SIZE));
+  net::hton(remote.port_, {header.data() + 2, 2});
+  r->append({reinterpret_cast<char const*>(header.data()), header.size()});
+  r->append(remote.domain().substr(0, header[1]));
+  for (auto field : {ingress, egress}) {
+    r->append(field);
+    r->append("\0"sv);
+  }
+  r->append(rule);
+  local().ring_->commit();
+}
+
+} // namespace pichi::log
@@ -15,6 +15,7 @@
 #include <pichi/net/direct.hpp>
 #include <pichi/net/helpers.hpp>
 #include <pichi/net/http.hpp>
+#include <pichi/net/mux.hpp>
 #include <pichi/net/reject.hpp>
 #include <pichi/net/socks5.hpp>
 #include <pichi/net/ssaead.hpp>
@@ -62,12 +63,112 @@ static auto createTlsContext(api::EgressVO const& vo)
 }
 #endif // ENABLE_TLS
 
+// Socket option of a string value, such as TCP_CONGESTION
+template <int optionLevel, int optionName> class StringOption {
+public:
+  explicit StringOption(string_view value) : value_{value} {}
+
+  template <typename Protocol> int level(Protocol const&) const { return optionLevel; }
+  template <typename Protocol> int name(Protocol const&) const { return optionName; }
+  template <typename Protocol> void const* data(Protocol const&) const { return value_.data(); }
+  template <typename Protocol> size_t size(Protocol const&) const { return value_.size(); }
+
+private:
+  string_view value_;
+};
+
+// IP_TOS for IPv4, or IPV6_TCLASS for IPv6
+class TosOption {
+public:
+  explicit TosOption(uint8_t value) : value_{value} {}
+
+  template <typename Protocol> int level(Protocol const& p) const
+  {
+    return p.family() == AF_INET6 ? IPPROTO_IPV6 : IPPROTO_IP;
+  }
+
+  template <typename Protocol> int name(Protocol const& p) const
+  {
+    return p.family() == AF_INET6 ? IPV6_TCLASS : IP_TOS;
+  }
+
+  template <typename Protocol> void const* data(Protocol const&) const { return &value_; }
+  template <typename Protocol> size_t size(Protocol const&) const { return sizeof(value_); }
+
+private:
+  int value_;
+};
+
+template <int optionLevel, int optionName>
+using IntOption = asio::detail::socket_option::integer<optionLevel, optionName>;
+
+// Pending TFO requests allowed for a listener before falling back to the normal handshake
+static auto const FAST_OPEN_QUEUE = 256;
+
+template <typename Socket> void setOptions(Socket& s, SocketOptions const& options)
+{
+  if constexpr (IsSslStreamV<Socket>) {
+    setOptions(s.next_layer(), options);
+  }
+  else {
+    if (options.noDelay_.has_value()) s.set_option(tcp::no_delay{*options.noDelay_});
+    if (options.recvBuffer_.has_value())
+      s.set_option(asio::socket_base::receive_buffer_size{static_cast<int>(*options.recvBuffer_)});
+    if (options.sendBuffer_.has_value())
+      s.set_option(asio::socket_base::send_buffer_size{static_cast<int>(*options.sendBuffer_)});
+    if (options.keepAlive_.has_value()) {
+      s.set_option(asio::socket_base::keep_alive{*options.keepAlive_ > 0});
+      if (*options.keepAlive_ > 0) {
+#if defined(TCP_KEEPIDLE)
+        s.set_option(IntOption<IPPROTO_TCP, TCP_KEEPIDLE>{*options.keepAlive_});
+#elif defined(TCP_KEEPALIVE)
+        s.set_option(IntOption<IPPROTO_TCP, TCP_KEEPALIVE>{*options.keepAlive_});
+#endif // TCP_KEEPIDLE
+      }
+    }
+    if (options.congestion_.has_value()) {
+#ifdef TCP_CONGESTION
+      s.set_option(StringOption<IPPROTO_TCP, TCP_CONGESTION>{*options.congestion_});
+#else  // TCP_CONGESTION
+      fail(PichiError::SEMANTIC_ERROR, "Congestion control not supported");
+#endif // TCP_CONGESTION
+    }
+    if (options.notSentLowat_.has_value()) {
+#ifdef TCP_NOTSENT_LOWAT
+      s.set_option(IntOption<IPPROTO_TCP, TCP_NOTSENT_LOWAT>{
+          static_cast<int>(*options.notSentLowat_)});
+#else  // TCP_NOTSENT_LOWAT
+      fail(PichiError::SEMANTIC_ERROR, "TCP_NOTSENT_LOWAT not supported");
+#endif // TCP_NOTSENT_LOWAT
+    }
+    if (options.tos_.has_value()) s.set_option(TosOption{*options.tos_});
+    if (options.fastOpen_.has_value()) {
+      if constexpr (is_same_v<Socket, tcp::acceptor>) {
+#ifdef TCP_FASTOPEN
+        auto queue = *options.fastOpen_ ? FAST_OPEN_QUEUE : 0;
+        s.set_option(IntOption<IPPROTO_TCP, TCP_FASTOPEN>{queue});
+#else  // TCP_FASTOPEN
+        fail(PichiError::SEMANTIC_ERROR, "TCP Fast Open not supported");
+#endif // TCP_FASTOPEN
+      }
+      else {
+        // The SYN is deferred until the first write, which carries the cookie or asks for one.
+#ifdef TCP_FASTOPEN_CONNECT
+        s.set_option(IntOption<IPPROTO_TCP, TCP_FASTOPEN_CONNECT>{*options.fastOpen_});
+#else  // TCP_FASTOPEN_CONNECT
+        fail(PichiError::SEMANTIC_ERROR, "TCP Fast Open not supported");
+#endif // TCP_FASTOPEN_CONNECT
+      }
+    }
+  }
+}
+
 template <typename Socket, typename Yield>
-void connect(Endpoint const& endpoint, Socket& s, Yield yield)
+void connect(Endpoint const& endpoint, Socket& s, SocketOptions const& options, Yield yield)
 {
 #ifdef ENABLE_TLS
   if constexpr (IsSslStreamV<Socket>) {
-    connect(endpoint, s.next_layer(), yield);
+    connect(endpoint, s.next_layer(), options, yield);
     s.async_handshake(ssl::stream_base::handshake_type::client, yield);
   }
   else
@@ -78,10 +179,32 @@ void connect(Endpoint const& endpoint, Socket& s, Yield yield)
   }
   else
 #endif // BUILD_TEST
-    asio::async_connect(s,
-                        tcp::resolver{s.get_executor().context()}.async_resolve(
-                            endpoint.host_, endpoint.port_, yield),
-                        yield);
+  {
+    // Trying each resolved endpoint like asio::async_connect, but with the options applied before
+    //   connecting, because the buffer sizes have to be settled before the handshake. With TCP
+    //   Fast Open, async_connect completes at once, and an unreachable endpoint fails the first
+    //   write instead of falling back to the next one.
+    auto attempt = [&s, &options, &yield](tcp::endpoint const& next, sys::error_code& ec) {
+      close(s);
+      s.open(next.protocol());
+      setOptions(s, options);
+      s.async_connect(next, yield[ec]);
+    };
+    auto ec = sys::error_code{asio::error::host_not_found};
+    // The address is connected as it is, without going through the resolver
+    if (endpoint.type_ != Endpoint::Type::DOMAIN_NAME) {
+      attempt({toAddress(endpoint), endpoint.port_}, ec);
+      if (!ec) return;
+      throw sys::system_error{ec};
+    }
+    auto resolver = tcp::resolver{s.get_executor().context()};
+    auto port = to_string(endpoint.port_);
+    for (auto&& entry : resolver.async_resolve(endpoint.domain(), port, yield)) {
+      attempt(entry.endpoint(), ec);
+      if (!ec) return;
+    }
+    throw sys::system_error{ec};
+  }
 }
 
 template <typename Socket, typename Yield>
@@ -140,6 +263,36 @@ template <typename Socket> bool isOpen(Socket const& s)
   }
 }
 
+/*
+ * An idle connection is alive if it has neither been closed nor reset by the peer, which is
+ *   told by peeking without blocking. The data already arrived, such as TLS session tickets,
+ *   doesn't matter.
+ */
+template <typename Socket> bool isAlive(Socket& s)
+{
+  if constexpr (IsSslStreamV<Socket>) {
+    return isAlive(s.next_layer());
+  }
+  else
+#ifdef BUILD_TEST
+      if constexpr (is_same_v<Socket, pichi::test::Stream>) {
+    return s.is_open();
+  }
+  else
+#endif // BUILD_TEST
+  {
+    if (!s.is_open()) return false;
+    auto ec = sys::error_code{};
+    auto byte = uint8_t{0};
+    s.non_blocking(true, ec);
+    if (ec) return false;
+    auto peeked = s.receive(asio::buffer(&byte, 1), asio::socket_base::message_peek, ec);
+    auto alive = peeked > 0 || ec == asio::error::would_block;
+    s.non_blocking(false, ec);
+    return alive;
+  }
+}
+
 template <typename Socket> unique_ptr<Ingress> makeIngress(api::IngressVO const& vo, Socket&& s)
 {
   auto container = array<uint8_t, 1024>{0};
@@ -224,7 +377,7 @@ template <typename Socket> unique_ptr<Ingress> makeIngress(api::IngressVO const&
   }
 }
 
-unique_ptr<Egress> makeEgress(api::EgressVO const& vo, asio::io_context& io)
+static unique_ptr<Egress> createEgress(api::EgressVO const& vo, asio::io_context& io)
 {
   auto container = array<uint8_t, 1024>{0};
   auto psk = MutableBuffer<uint8_t>{container};
@@ -307,33 +460,81 @@ unique_ptr<Egress> makeEgress(api::EgressVO const& vo, asio::io_context& io)
   }
 }
 
+unique_ptr<Egress> makeEgress(api::EgressVO const& vo, asio::io_context& io)
+{
+  auto egress = createEgress(vo, io);
+  if (vo.socket_.has_value()) egress->setOptions(*vo.socket_);
+  return egress;
+}
+
+template <typename Socket> shared_ptr<Mux> makeMux(api::IngressVO const& vo, Socket&& s)
+{
+  assertTrue(vo.type_ == AdapterType::MUX, PichiError::MISC);
+  auto& io = s.get_executor().context();
+#ifdef ENABLE_TLS
+  if (*vo.tls_) {
+    auto ctx = createTlsContext(vo);
+    return make_shared<MuxOver<TlsSocket>>(io, false, forward<Socket>(s), ctx);
+  }
+  else
+#endif // ENABLE_TLS
+    return make_shared<MuxOver<TcpSocket>>(io, false, forward<Socket>(s));
+}
+
+shared_ptr<MuxClient> makeMuxClient(api::EgressVO const& vo, asio::io_context& io)
+{
+  assertTrue(vo.type_ == AdapterType::MUX, PichiError::MISC);
+  auto next = makeEndpoint(*vo.host_, *vo.port_);
+  auto options = vo.socket_.value_or(SocketOptions{});
+  return make_shared<MuxClient>(
+      io, *vo.connections_, [&io, vo, next, options](auto yield) -> shared_ptr<Mux> {
+#ifdef ENABLE_TLS
+        if (*vo.tls_) {
+          auto ctx = createTlsContext(vo);
+          auto mux = make_shared<MuxOver<TlsSocket>>(io, true, io, ctx);
+          mux->connect(next, options, yield);
+          return mux;
+        }
+#endif // ENABLE_TLS
+        auto mux = make_shared<MuxOver<TcpSocket>>(io, true, io);
+        mux->connect(next, options, yield);
+        return mux;
+      });
+}
+
 using Yield = asio::yield_context;
 
-template void connect<>(Endpoint const&, TcpSocket&, Yield);
+template void connect<>(Endpoint const&, TcpSocket&, SocketOptions const&, Yield);
 template void read<>(TcpSocket&, MutableBuffer<uint8_t>, Yield);
 template size_t readSome<>(TcpSocket&, MutableBuffer<uint8_t>, Yield);
 template void write<>(TcpSocket&, ConstBuffer<uint8_t>, Yield);
 template void close<>(TcpSocket&);
 template bool isOpen<>(TcpSocket const&);
+template bool isAlive<>(TcpSocket&);
+template void setOptions<>(TcpSocket&, SocketOptions const&);
+template void setOptions<>(tcp::acceptor&, SocketOptions const&);
 
 #ifdef ENABLE_TLS
-template void connect<>(Endpoint const&, TlsSocket&, Yield);
+template void connect<>(Endpoint const&, TlsSocket&, SocketOptions const&, Yield);
 template void read<>(TlsSocket&, MutableBuffer<uint8_t>, Yield);
 template size_t readSome<>(TlsSocket&, MutableBuffer<uint8_t>, Yield);
 template void write<>(TlsSocket&, ConstBuffer<uint8_t>, Yield);
 template void close<>(TlsSocket&);
 template bool isOpen<>(TlsSocket const&);
+template bool isAlive<>(TlsSocket&);
 #endif // ENABLE_TLS
 
 #ifdef BUILD_TEST
-template void connect<>(Endpoint const&, pichi::test::Stream&, Yield);
+template void connect<>(Endpoint const&, pichi::test::Stream&, SocketOptions const&, Yield);
 template void read<>(pichi::test::Stream&, MutableBuffer<uint8_t>, Yield);
 template size_t readSome<>(pichi::test::Stream&, MutableBuffer<uint8_t>, Yield);
 template void write<>(pichi::test::Stream&, ConstBuffer<uint8_t>, Yield);
 template void close<>(pichi::test::Stream&);
 template bool isOpen<>(pichi::test::Stream const&);
+template bool isAlive<>(pichi::test::Stream&);
 #endif // BUILD_TEST
 
 template unique_ptr<Ingress> makeIngress<>(api::IngressVO const&, TcpSocket&&);
+template shared_ptr<Mux> makeMux<>(api::IngressVO const&, TcpSocket&&);
 
 } // namespace pichi::net
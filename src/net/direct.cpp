@@ -25,7 +25,10 @@ bool DirectAdapter::writable() const { return isOpen(socket_); }
 
 void DirectAdapter::connect(Endpoint const&, Endpoint const& server, Yield yield)
 {
-  pichi::net::connect(server, socket_, yield);
+  pichi::net::connect(server, socket_, options_, yield);
 }
 
+// The connection to the origin is reused by the persistent HTTP ingress if it's still alive
+bool DirectAdapter::alive() { return isAlive(socket_); }
+
 } // namespace pichi::net
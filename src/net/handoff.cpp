@@ -0,0 +1,190 @@
+#include "config.h"
+#include <algorithm>
+#include <array>
+#include <pichi/asserts.hpp>
+#include <pichi/net/handoff.hpp>
+#include <pichi/scope_guard.hpp>
+#include <unordered_map>
+#include <utility>
+
+#ifdef HAS_SCM_RIGHTS
+#include <cerrno>
+#include <cstring>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif // HAS_SCM_RIGHTS
+
+using namespace std;
+namespace ip = boost::asio::ip;
+namespace sys = boost::system;
+
+namespace pichi::net {
+
+// Indexed by the keys, which are unique among the listeners
+static auto inherited = unordered_map<string, int>{};
+
+template <typename Endpoint> static string makeKey(string_view protocol, Endpoint const& endpoint)
+{
+  return string{protocol} + " " + endpoint.address().to_string() + " " +
+         to_string(endpoint.port());
+}
+
+string listenerKey(ip::tcp::endpoint const& endpoint) { return makeKey("tcp", endpoint); }
+
+string listenerKey(ip::udp::endpoint const& endpoint) { return makeKey("udp", endpoint); }
+
+#ifdef HAS_SCM_RIGHTS
+
+/*
+ * Each listener is sent as a record of fixed size, with its descriptor attached to the first
+ *   byte, so that the records are delimited on the stream socket:
+ *
+ *   +------+----------+---------+
+ *   | KLEN |   KEY    | PADDING |
+ *   +------+----------+---------+
+ *   |  1   | Variable |   ...   |
+ *   +------+----------+---------+
+ *
+ *   The last record has an empty key and no descriptor.
+ */
+static size_t const RECORD_SIZE = 0x100;
+
+using Record = array<char, RECORD_SIZE>;
+
+struct Control {
+  alignas(cmsghdr) array<char, CMSG_SPACE(sizeof(int))> buf_;
+};
+
+static void check(bool failed)
+{
+  if (failed) throw sys::system_error{errno, sys::system_category()};
+}
+
+static void sendRecord(int socket, string_view key, int fd)
+{
+  assertTrue(key.size() < RECORD_SIZE, PichiError::MISC);
+  auto record = Record{};
+  record[0] = static_cast<char>(key.size());
+  copy(cbegin(key), cend(key), begin(record) + 1);
+
+  auto control = Control{};
+  auto iov = iovec{record.data(), record.size()};
+  auto msg = msghdr{};
+  msg.msg_iov = &iov;
+  msg.msg_iovlen = 1;
+  if (fd >= 0) {
+    msg.msg_control = control.buf_.data();
+    msg.msg_controllen = control.buf_.size();
+    auto cmsg = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+    memcpy(CMSG_DATA(cmsg), &fd, sizeof(int));
+  }
+
+  for (auto sent = size_t{0}; sent < record.size();) {
+    // The descriptor goes along with the first byte, the rest are sent plainly
+    auto n = sent == 0 ? sendmsg(socket, &msg, 0) :
+                         send(socket, record.data() + sent, record.size() - sent, 0);
+    if (n < 0 && errno == EINTR) continue;
+    check(n < 0);
+    sent += static_cast<size_t>(n);
+  }
+}
+
+static Listener recvRecord(int socket)
+{
+  auto record = Record{};
+  auto fd = -1;
+  // The descriptor received is closed unless it's returned
+  auto guard = makeScopeGuard([&fd]() {
+    if (fd >= 0) ::close(fd);
+  });
+  for (auto received = size_t{0}; received < record.size();) {
+    auto control = Control{};
+    auto iov = iovec{record.data() + received, record.size() - received};
+    auto msg = msghdr{};
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control.buf_.data();
+    msg.msg_controllen = control.buf_.size();
+    auto n = recvmsg(socket, &msg, 0);
+    if (n < 0 && errno == EINTR) continue;
+    check(n < 0);
+    // Only the last descriptor is kept if the peer attaches more
+    for (auto cmsg = CMSG_FIRSTHDR(&msg); cmsg != nullptr; cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+      if (cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_type != SCM_RIGHTS) continue;
+      auto count = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+      for (auto i = size_t{0}; i < count; ++i) {
+        if (fd >= 0) ::close(fd);
+        memcpy(&fd, CMSG_DATA(cmsg) + i * sizeof(int), sizeof(int));
+      }
+    }
+    assertFalse((msg.msg_flags & MSG_CTRUNC) != 0, PichiError::BAD_PROTO,
+                "Handoff descriptors truncated");
+    assertFalse(n == 0, PichiError::CONN_FAILURE, "Handoff interrupted");
+    received += static_cast<size_t>(n);
+  }
+  auto size = static_cast<uint8_t>(record[0]);
+  if (size == 0) return {{}, -1};
+  guard.disable();
+  return {{record.data() + 1, size}, fd};
+}
+
+void sendListeners(int socket, vector<Listener> const& listeners)
+{
+  for (auto&& listener : listeners) {
+    assertFalse(listener.key_.empty() || listener.fd_ < 0, PichiError::MISC);
+    sendRecord(socket, listener.key_, listener.fd_);
+  }
+  sendRecord(socket, {}, -1);
+}
+
+vector<Listener> recvListeners(int socket)
+{
+  auto ret = vector<Listener>{};
+  try {
+    for (auto listener = recvRecord(socket); !listener.key_.empty();
+         listener = recvRecord(socket)) {
+      assertFalse(listener.fd_ < 0, PichiError::BAD_PROTO, "Listener without descriptor");
+      ret.push_back(move(listener));
+    }
+  }
+  catch (...) {
+    for (auto&& listener : ret) ::close(listener.fd_);
+    throw;
+  }
+  return ret;
+}
+
+void releaseInherited()
+{
+  for (auto&& [key, fd] : inherited) ::close(fd);
+  inherited.clear();
+}
+
+#else // HAS_SCM_RIGHTS
+
+void sendListeners(int, vector<Listener> const&) { fail(PichiError::MISC); }
+
+vector<Listener> recvListeners(int) { fail(PichiError::MISC); }
+
+void releaseInherited() { inherited.clear(); }
+
+#endif // HAS_SCM_RIGHTS
+
+void inherit(vector<Listener> listeners)
+{
+  for (auto&& listener : listeners) inherited.insert_or_assign(move(listener.key_), listener.fd_);
+}
+
+optional<int> adopt(string const& key)
+{
+  auto it = inherited.find(key);
+  if (it == end(inherited)) return {};
+  auto fd = it->second;
+  inherited.erase(it);
+  return fd;
+}
+
+} // namespace pichi::net
@@ -1,6 +1,6 @@
 #include <array>
 #include <boost/asio/ip/address.hpp>
-#include <limits>
+#include <charconv>
 #include <pichi/asserts.hpp>
 #include <pichi/net/helpers.hpp>
 
@@ -11,52 +11,34 @@ namespace sys = boost::system;
 
 namespace pichi::net {
 
-template <typename AddressType> struct AddressHelper {
-  static_assert(is_same_v<AddressType, ip::address_v4> || is_same_v<AddressType, ip::address_v6>);
-  using BytesType = typename AddressType::bytes_type;
-  static auto const BYTES_SIZE = sizeof(BytesType);
-
-  static string bytes2Ip(ConstBuffer<uint8_t> bytes)
-  {
-    auto tmp = BytesType{};
-    copy_n(cbegin(bytes), BYTES_SIZE, begin(tmp));
-    if constexpr (is_same_v<AddressType, ip::address_v4>)
-      return ip::make_address_v4(tmp).to_string();
-    else
-      return ip::make_address_v6(tmp).to_string();
-  }
-
-  static size_t ip2Bytes(string_view ip, MutableBuffer<uint8_t> dst)
-  {
-    if constexpr (is_same_v<AddressType, ip::address_v4>)
-      copy_n(cbegin(ip::make_address_v4(ip).to_bytes()), BYTES_SIZE, begin(dst));
-    else
-      copy_n(cbegin(ip::make_address_v6(ip).to_bytes()), BYTES_SIZE, begin(dst));
-    return BYTES_SIZE;
-  }
-};
+static size_t const IPV4_SIZE = sizeof(ip::address_v4::bytes_type);
+static size_t const IPV6_SIZE = sizeof(ip::address_v6::bytes_type);
 
-using IPv4 = AddressHelper<ip::address_v4>;
-using IPv6 = AddressHelper<ip::address_v6>;
-
-static string bytes2Port(ConstBuffer<uint8_t> bytes)
+// The text is copied to the stack, since make_address accepts only strings terminated by zero
+static ip::address parseAddress(string_view host, sys::error_code& ec)
 {
-  return to_string(ntoh<uint16_t>({bytes, sizeof(uint16_t)}));
+  auto text = array<char, 64>{};
+  if (host.size() >= text.size()) {
+    ec = asio::error::invalid_argument;
+    return {};
+  }
+  copy_n(cbegin(host), host.size(), begin(text));
+  return ip::make_address(text.data(), ec);
 }
 
-static size_t port2Bytes(string const& port, MutableBuffer<uint8_t> dst)
+static Endpoint makeEndpoint(Endpoint::Type type, ConstBuffer<uint8_t> host, uint16_t port)
 {
-  auto i = stoi(port);
-  assertTrue(i > 0, PichiError::MISC);
-  assertTrue(i <= numeric_limits<uint16_t>::max(), PichiError::MISC);
-  hton(static_cast<uint16_t>(i), dst);
-  return sizeof(uint16_t);
+  assertFalse(host.size() == 0, PichiError::MISC);
+  assertTrue(host.size() <= Endpoint::MAX_HOST_SIZE, PichiError::MISC);
+  auto endpoint = Endpoint{type, static_cast<uint8_t>(host.size()), port};
+  copy_n(cbegin(host), host.size(), begin(endpoint.host_));
+  return endpoint;
 }
 
 size_t serializeEndpoint(Endpoint const& endpoint, MutableBuffer<uint8_t> target)
 {
-  assertFalse(endpoint.host_.empty(), PichiError::MISC);
-  assertFalse(endpoint.port_.empty(), PichiError::MISC);
+  assertFalse(endpoint.size_ == 0, PichiError::MISC);
+  assertFalse(endpoint.port_ == 0, PichiError::MISC);
   auto pos = target.begin();
   switch (endpoint.type_) {
   case Endpoint::Type::DOMAIN_NAME:
@@ -67,11 +49,9 @@ size_t serializeEndpoint(Endpoint const& endpoint, MutableBuffer<uint8_t> target
       |  1   |     1    | Variable |  2   |
       +------+----------+----------+------+
      */
-    assertTrue(endpoint.host_.size() <= 0xff, PichiError::MISC);
-    assertTrue(target.size() >= 4 + endpoint.host_.size(), PichiError::MISC);
+    assertTrue(target.size() >= 4 + endpoint.size_, PichiError::MISC);
     *pos++ = 0x03;
-    *pos++ = endpoint.host_.size();
-    pos = copy_n(cbegin(endpoint.host_), endpoint.host_.size(), pos);
+    *pos++ = endpoint.size_;
     break;
   case Endpoint::Type::IPV4:
     /* Format
@@ -81,9 +61,9 @@ size_t serializeEndpoint(Endpoint const& endpoint, MutableBuffer<uint8_t> target
       |  1   |     4     |  2   |
       +------+-----------+------+
      */
+    assertTrue(endpoint.size_ == IPV4_SIZE, PichiError::MISC);
     assertTrue(target.size() >= 7, PichiError::MISC);
     *pos++ = 0x01;
-    pos += IPv4::ip2Bytes(endpoint.host_, {pos, IPv4::BYTES_SIZE});
     break;
   case Endpoint::Type::IPV6:
     /* Format
@@ -93,64 +73,136 @@ size_t serializeEndpoint(Endpoint const& endpoint, MutableBuffer<uint8_t> target
       |  1   |    16     |  2   |
       +------+-----------+------+
      */
+    assertTrue(endpoint.size_ == IPV6_SIZE, PichiError::MISC);
     assertTrue(target.size() >= 19, PichiError::MISC);
     *pos++ = 0x04;
-    pos += IPv6::ip2Bytes(endpoint.host_, {pos, IPv6::BYTES_SIZE});
     break;
   default:
     fail(PichiError::BAD_PROTO);
   }
-  pos += port2Bytes(endpoint.port_, {pos, sizeof(uint16_t)});
+  pos = copy_n(cbegin(endpoint.host_), endpoint.size_, pos);
+  hton(endpoint.port_, {pos, sizeof(uint16_t)});
+  pos += sizeof(uint16_t);
 
   return pos - target.begin();
 }
 
-Endpoint parseEndpoint(function<void(MutableBuffer<uint8_t>)> read)
+size_t endpointSize(ConstBuffer<uint8_t> head)
 {
-  auto buf = std::array<uint8_t, 512>{};
-  auto len = uint8_t{0};
-
-  read({buf, 1});
-  switch (buf[0]) {
+  assertTrue(head.size() >= ENDPOINT_HEAD_SIZE, PichiError::BAD_PROTO);
+  auto p = head.data();
+  switch (p[0]) {
   case 0x01:
-    read({buf, IPv4::BYTES_SIZE + sizeof(uint16_t)});
-    return Endpoint{Endpoint::Type::IPV4, IPv4::bytes2Ip(buf),
-                    bytes2Port({buf.data() + IPv4::BYTES_SIZE, sizeof(uint16_t)})};
+    return 1 + IPV4_SIZE + sizeof(uint16_t);
   case 0x03:
-    read({buf, 1});
-    len = buf.front();
-    assertTrue(len > 0, PichiError::BAD_PROTO);
-
-    read({buf, static_cast<size_t>(len + 2)});
-    return Endpoint{Endpoint::Type::DOMAIN_NAME,
-                    {cbegin(buf), cbegin(buf) + len},
-                    bytes2Port({buf.data() + len, sizeof(uint16_t)})};
+    assertTrue(p[1] > 0, PichiError::BAD_PROTO);
+    return 2 + p[1] + sizeof(uint16_t);
   case 0x04:
-    read({buf, IPv6::BYTES_SIZE + sizeof(uint16_t)});
-    return Endpoint{Endpoint::Type::IPV6, IPv6::bytes2Ip(buf),
-                    bytes2Port({buf.data() + IPv6::BYTES_SIZE, sizeof(uint16_t)})};
+    return 1 + IPV6_SIZE + sizeof(uint16_t);
   default:
     fail(PichiError::BAD_PROTO);
   }
 }
 
+pair<Endpoint, size_t> parseEndpoint(ConstBuffer<uint8_t> src)
+{
+  auto size = endpointSize(src);
+  assertTrue(src.size() >= size, PichiError::BAD_PROTO);
+
+  auto p = src.data();
+  auto port = ntoh<uint16_t>({p + size - sizeof(uint16_t), sizeof(uint16_t)});
+  switch (p[0]) {
+  case 0x01:
+    return {makeEndpoint(Endpoint::Type::IPV4, {p + 1, IPV4_SIZE}, port), size};
+  case 0x04:
+    return {makeEndpoint(Endpoint::Type::IPV6, {p + 1, IPV6_SIZE}, port), size};
+  default:
+    return {makeEndpoint(Endpoint::Type::DOMAIN_NAME, {p + 2, p[1]}, port), size};
+  }
+}
+
 Endpoint::Type detectHostType(string_view host)
 {
   assertFalse(host.empty(), PichiError::MISC);
   auto ec = sys::error_code{};
-  auto address = ip::make_address(host, ec);
+  auto address = parseAddress(host, ec);
   if (ec) return Endpoint::Type::DOMAIN_NAME;
   return address.is_v4() ? Endpoint::Type::IPV4 : Endpoint::Type::IPV6;
 }
 
 Endpoint makeEndpoint(string_view host, uint16_t port)
 {
-  return {detectHostType(host), to_string(host), to_string(port)};
+  assertFalse(host.empty(), PichiError::MISC);
+  auto ec = sys::error_code{};
+  auto address = parseAddress(host, ec);
+  if (!ec) return makeEndpoint(address, port);
+  return makeEndpoint(Endpoint::Type::DOMAIN_NAME,
+                      {reinterpret_cast<uint8_t const*>(host.data()), host.size()}, port);
 }
 
 Endpoint makeEndpoint(string_view host, string_view port)
 {
-  return {detectHostType(host), to_string(host), to_string(port)};
+  auto value = uint16_t{0};
+  auto [end, ec] = from_chars(port.data(), port.data() + port.size(), value);
+  assertTrue(ec == errc{} && end == port.data() + port.size(), PichiError::MISC);
+  return makeEndpoint(host, value);
+}
+
+Endpoint makeEndpoint(ip::address const& address, uint16_t port)
+{
+  if (address.is_v4())
+    return makeEndpoint(Endpoint::Type::IPV4, address.to_v4().to_bytes(), port);
+  else
+    return makeEndpoint(Endpoint::Type::IPV6, address.to_v6().to_bytes(), port);
+}
+
+ip::address toAddress(Endpoint const& endpoint)
+{
+  switch (endpoint.type_) {
+  case Endpoint::Type::IPV4: {
+    auto bytes = ip::address_v4::bytes_type{};
+    copy_n(cbegin(endpoint.host_), bytes.size(), begin(bytes));
+    return ip::make_address_v4(bytes);
+  }
+  case Endpoint::Type::IPV6: {
+    auto bytes = ip::address_v6::bytes_type{};
+    copy_n(cbegin(endpoint.host_), bytes.size(), begin(bytes));
+    return ip::make_address_v6(bytes);
+  }
+  default:
+    fail(PichiError::MISC);
+  }
+}
+
+string formatHost(Endpoint const& endpoint)
+{
+  if (endpoint.type_ == Endpoint::Type::DOMAIN_NAME) return to_string(endpoint.domain());
+  return toAddress(endpoint).to_string();
+}
+
+size_t ChunkSizer::depth() const
+{
+  return clamp(MAX_RELAY_SIZE / size_, size_t{2}, MAX_RELAY_DEPTH);
+}
+
+void ChunkSizer::update(size_t received)
+{
+  if (received >= size_) {
+    sparse_ = 0;
+    if (++filled_ < GROW_AFTER || size_ >= MAX_CHUNK_SIZE) return;
+    size_ *= 2;
+    filled_ = 0;
+  }
+  else if (received < size_ / 4) {
+    filled_ = 0;
+    if (++sparse_ < SHRINK_AFTER || size_ <= MIN_CHUNK_SIZE) return;
+    size_ /= 2;
+    sparse_ = 0;
+  }
+  else {
+    filled_ = 0;
+    sparse_ = 0;
+  }
 }
 
 } // namespace pichi::net
@@ -1,15 +1,20 @@
 #include "config.h"
+#include <array>
 #include <boost/asio/buffers_iterator.hpp>
 #include <boost/asio/write.hpp>
+#include <boost/beast/http/buffer_body.hpp>
 #include <boost/beast/http/read.hpp>
 #include <boost/beast/http/serializer.hpp>
 #include <boost/beast/http/write.hpp>
+#include <chrono>
+#include <deque>
 #include <pichi/asserts.hpp>
 #include <pichi/net/asio.hpp>
 #include <pichi/net/helpers.hpp>
 #include <pichi/net/http.hpp>
 #include <pichi/test/socket.hpp>
 #include <pichi/uri.hpp>
+#include <unordered_map>
 
 #ifdef ENABLE_TLS
 #include <boost/asio/ssl/stream.hpp>
@@ -32,6 +37,17 @@ template <bool isRequest> using Message = boost::beast::http::message<isRequest,
 using Request = Message<true>;
 using Response = Message<false>;
 template <bool isRequest> using Serializer = boost::beast::http::serializer<isRequest, Body>;
+using Clock = chrono::steady_clock;
+
+// Bytes read for each parsing while relaying, and the ones parsed as the body are dropped
+static size_t const RELAY_CHUNK = 0x4000;
+static size_t const DROPPED_SIZE = 0x400;
+
+// Upstream proxies rejecting CONNECT are remembered for a while, in case they're reconfigured
+static auto const REJECTING_EXPIRY = 10min;
+// Relaying connections parked for each upstream proxy, and how long they rest before dropped
+static size_t const MAX_PARKED = 16;
+static auto const PARKED_IDLE = 30s;
 
 template <typename Stream, bool isRequest>
 static auto writeHttp(Stream& s, Message<isRequest>& m, asio::yield_context yield)
@@ -172,26 +188,6 @@ template <typename Stream> static void tunnelConfirm(Stream& s, Yield yield)
   writeHttp(s, rep, yield);
 }
 
-template <typename Stream> static bool tunnelConnect(Endpoint const& remote, Stream& s, Yield yield)
-{
-  auto host = remote.host_ + ":" + remote.port_;
-  auto req = Request{};
-  req.method(http::verb::connect);
-  req.target(host);
-  req.set(http::field::host, host);
-  addCloseHeader(req);
-  req.prepare_payload();
-
-  writeHttp(s, req, yield);
-
-  auto parser = ResponseParser{};
-  auto cache = Cache{};
-  readHttpHeader(s, cache, parser, yield);
-  auto code = parser.release().result_int();
-
-  return code >= 200 && code < 300;
-}
-
 template <typename DynamicBuffer>
 static auto copyToCache(ConstBuffer<uint8_t> buf, DynamicBuffer& cache)
 {
@@ -243,18 +239,218 @@ static bool tryToSendHeader(Parser<isRequest>& parser, DynamicBuffer& cache,
   return true;
 }
 
+template <typename Parser> static void unlimit(Parser& parser)
+{
+  parser.header_limit(numeric_limits<uint32_t>::max());
+  parser.body_limit(numeric_limits<uint64_t>::max());
+}
+
+template <bool isRequest> static Cache serializeHeader(Header<isRequest> const& header)
+{
+  auto m = Message<isRequest>{header};
+  auto sr = Serializer<isRequest>{m};
+  auto cache = Cache{};
+  do {
+    auto ec = sys::error_code{};
+    sr.next(ec, [&](auto&&, auto&& serialized) {
+      auto n = asio::buffer_size(serialized);
+      cache.commit(asio::buffer_copy(cache.prepare(n), serialized));
+      sr.consume(n);
+    });
+    assertNoError(ec);
+  } while (!sr.is_header_done());
+  return cache;
+}
+
+/*
+ * The message is sent as it is received, while the parser only finds where it ends, chunked or
+ *   not, so that no more than one message is relayed. The one delimited by EOF ends when recv
+ *   reaches EOF, and the bytes received after the message are left in the cache.
+ */
+template <bool isRequest, typename Recv, typename Send>
+static size_t relayMessage(RelayParser<isRequest>& parser, Cache& cache, Recv&& recv, Send&& send)
+{
+  auto dropped = array<char, DROPPED_SIZE>{};
+  auto relayed = size_t{0};
+  auto more = cache.size() == 0;
+  while (!parser.is_done()) {
+    if (more) {
+      auto buf = cache.prepare(RELAY_CHUNK);
+      try {
+        cache.commit(recv(MutableBuffer<uint8_t>{static_cast<uint8_t*>(buf.data()), buf.size()}));
+      }
+      catch (sys::system_error const& e) {
+        // Nothing received at all isn't a message delimited by EOF
+        if (e.code() != asio::error::eof || !parser.got_some()) throw;
+        auto ec = sys::error_code{};
+        parser.put_eof(ec);
+        assertNoError(ec);
+        break;
+      }
+    }
+
+    parser.get().body().data = dropped.data();
+    parser.get().body().size = dropped.size();
+    auto ec = sys::error_code{};
+    auto parsed = parser.put(cache.data(), ec);
+    more = ec == http::error::need_more || parsed == cache.size();
+    if (ec == http::error::need_more || ec == http::error::need_buffer) ec = {};
+    assertNoError(ec);
+
+    if (parsed == 0) continue;
+    send(ConstBuffer<uint8_t>{static_cast<uint8_t const*>(cache.data().data()), parsed});
+    cache.consume(parsed);
+    relayed += parsed;
+  }
+  return relayed;
+}
+
+/*
+ * The bytes passing by are only looked at, so that the parser finds where the message ends,
+ *   and the number of them parsed is returned. A partial header isn't parsed at all.
+ */
+template <bool isRequest>
+static size_t follow(RelayParser<isRequest>& parser, ConstBuffer<uint8_t> buf)
+{
+  auto dropped = array<char, DROPPED_SIZE>{};
+  auto left = buf;
+  while (!parser.is_done() && left.size() > 0) {
+    parser.get().body().data = dropped.data();
+    parser.get().body().size = dropped.size();
+    auto ec = sys::error_code{};
+    auto parsed = parser.put(asio::buffer(left), ec);
+    left += parsed;
+    if (ec == http::error::need_more) break;
+    if (ec == http::error::need_buffer) ec = {};
+    assertNoError(ec);
+    if (parsed == 0) break;
+  }
+  return buf.size() - left.size();
+}
+
+/*
+ * The response rejecting CONNECT is read as a whole if it keeps the connection alive, so that
+ *   the connection could relay HTTP requests afterwards. The status and whether the connection
+ *   is still usable are returned.
+ */
+template <typename Stream>
+static pair<unsigned, bool> tunnelConnect(Endpoint const& remote, Stream& s, Yield yield)
+{
+  auto host = formatHost(remote) + ":" + to_string(remote.port_);
+  auto req = Request{};
+  req.method(http::verb::connect);
+  req.target(host);
+  req.set(http::field::host, host);
+  req.prepare_payload();
+
+  writeHttp(s, req, yield);
+
+  auto parser = ResponseParser{};
+  auto cache = Cache{};
+  readHttpHeader(s, cache, parser, yield);
+  auto code = parser.get().result_int();
+  if ((code >= 200 && code < 300) || !parser.keep_alive()) return {code, code < 300};
+
+  auto rejection = RelayParser<false>{move(parser)};
+  relayMessage(
+      rejection, cache, [&](auto buf) { return readSome(s, buf, yield); }, [](auto&&) {});
+  return {code, cache.size() == 0};
+}
+
+/*
+ * Upstream is told apart by the endpoint of the proxy and the stream type. It remembers whether
+ *   the proxy rejects CONNECT, and parks the relaying connections resting between messages for
+ *   the following sessions. Like the other caches, it's only accessed by the thread running
+ *   io_context.
+ */
+template <typename Stream> class Upstream {
+private:
+  struct Parked {
+    Stream stream_;
+    Clock::time_point expiry_;
+  };
+
+  void purge()
+  {
+    auto now = Clock::now();
+    while (!parked_.empty() && parked_.front().expiry_ <= now) {
+      pichi::net::close(parked_.front().stream_);
+      parked_.pop_front();
+    }
+  }
+
+public:
+  // Never destroyed, since the parked streams mustn't outlive io_context on exiting
+  static Upstream& get(Endpoint const& next)
+  {
+    static auto& upstreams = *new unordered_map<string, Upstream>{};
+    return upstreams[formatHost(next) + ":" + to_string(next.port_)];
+  }
+
+  bool relaying() const { return Clock::now() < relaying_; }
+
+  void reject() { relaying_ = Clock::now() + REJECTING_EXPIRY; }
+
+  void park(Stream&& stream)
+  {
+    purge();
+    if (parked_.size() == MAX_PARKED) {
+      pichi::net::close(parked_.front().stream_);
+      parked_.pop_front();
+    }
+    parked_.push_back({move(stream), Clock::now() + PARKED_IDLE});
+  }
+
+  // The most recently parked one still alive
+  optional<Stream> take()
+  {
+    purge();
+    while (!parked_.empty()) {
+      auto parked = move(parked_.back());
+      parked_.pop_back();
+      if (isAlive(parked.stream_)) return move(parked.stream_);
+      pichi::net::close(parked.stream_);
+    }
+    return {};
+  }
+
+private:
+  Clock::time_point relaying_ = {};
+  deque<Parked> parked_;
+};
+
 } // namespace detail
 
 using namespace detail;
 
 template <typename Stream> size_t HttpIngress<Stream>::recv(MutableBuffer<uint8_t> buf, Yield yield)
 {
-  return recv_(buf, yield);
+  switch (receiving_) {
+  case Relaying::HEADER: {
+    receiving_ = Relaying::RAW;
+    auto req = reqParser_->release();
+    if (!reqParser_->upgrade()) addCloseHeader(req);
+    return recvHeader(req, reqCache_, buf);
+  }
+  case Relaying::RAW:
+    return recvRaw(stream_, reqCache_, buf, yield);
+  default:
+    fail("Bad invocation"sv);
+  }
 }
 
 template <typename Stream> void HttpIngress<Stream>::send(ConstBuffer<uint8_t> buf, Yield yield)
 {
-  send_(buf, yield);
+  switch (sending_) {
+  case Relaying::HEADER:
+    if (tryToSendHeader(respParser_, respCache_, buf, stream_, yield)) sending_ = Relaying::RAW;
+    break;
+  case Relaying::RAW:
+    write(stream_, buf, yield);
+    break;
+  default:
+    fail("Bad invocation"sv);
+  }
 }
 
 template <typename Stream> bool HttpIngress<Stream>::readable() const
@@ -264,7 +460,13 @@ template <typename Stream> bool HttpIngress<Stream>::readable() const
 
 template <typename Stream> bool HttpIngress<Stream>::writable() const { return isOpen(stream_); }
 
-template <typename Stream> void HttpIngress<Stream>::confirm(Yield yield) { confirm_(yield); }
+template <typename Stream> void HttpIngress<Stream>::confirm(Yield yield)
+{
+  assertFalse(sending_ == Relaying::NONE, "Bad invocation"sv);
+  if (!tunnel_) return;
+  tunnelConfirm(stream_, yield);
+  reqParser_->release();
+}
 
 template <typename Stream> void HttpIngress<Stream>::close() { pichi::net::close(stream_); }
 
@@ -282,27 +484,21 @@ template <typename Stream> Endpoint HttpIngress<Stream>::readRemote(Yield yield)
 {
 #ifdef ENABLE_TLS
   if constexpr (IsSslStreamV<Stream>) {
-    stream_.async_handshake(ssl::stream_base::handshake_type::server, yield);
+    // The persistent connection has been handshaken for the first request
+    if (!persistent_) stream_.async_handshake(ssl::stream_base::handshake_type::server, yield);
   }
 #endif // ENABLE_TLS
 
-  readHttpHeader(stream_, reqCache_, reqParser_, yield);
+  reqParser_.emplace();
+  unlimit(*reqParser_);
+  readHttpHeader(stream_, reqCache_, *reqParser_, yield);
 
-  auto& req = reqParser_.get();
+  auto& req = reqParser_->get();
   if (req.method() == http::verb::connect) {
-    send_ = [this](auto buf, auto yield) { write(stream_, buf, yield); };
-    recv_ = [this](auto buf, auto yield) {
-      if (reqCache_.size() == 0) return readSome(stream_, buf, yield);
-
-      auto copied = min(buf.size(), reqCache_.size());
-      copy_n(asio::buffers_begin(reqCache_.data()), copied, begin(buf));
-      reqCache_.consume(copied);
-      return copied;
-    };
-    confirm_ = [this](auto yield) {
-      tunnelConfirm(stream_, yield);
-      reqParser_.release();
-    };
+    persistent_ = false;
+    tunnel_ = true;
+    sending_ = Relaying::RAW;
+    receiving_ = Relaying::RAW;
 
     /*
      * HTTP CONNECT @RFC2616
@@ -313,17 +509,11 @@ template <typename Stream> Endpoint HttpIngress<Stream>::readRemote(Yield yield)
     return net::makeEndpoint(hp.host_, hp.port_);
   }
   else {
-    send_ = [this](auto buf, auto yield) {
-      if (tryToSendHeader(respParser_, respCache_, buf, stream_, yield))
-        send_ = [this](auto buf, auto yield) { write(stream_, buf, yield); };
-    };
-    recv_ = [this](auto buf, auto yield) {
-      recv_ = [this](auto buf, auto yield) { return recvRaw(stream_, reqCache_, buf, yield); };
-      auto req = reqParser_.release();
-      if (!reqParser_.upgrade()) addCloseHeader(req);
-      return recvHeader(req, reqCache_, buf);
-    };
-    confirm_ = [](auto) {};
+    persistent_ = req.version() == 11 && reqParser_->keep_alive() && !reqParser_->upgrade() &&
+                  !beast::iequals(req[http::field::proxy_connection], "close");
+    tunnel_ = false;
+    sending_ = Relaying::HEADER;
+    receiving_ = Relaying::HEADER;
 
     removeHostFromTarget(req);
     auto it = req.find(http::field::host);
@@ -333,44 +523,247 @@ template <typename Stream> Endpoint HttpIngress<Stream>::readRemote(Yield yield)
   }
 }
 
+template <typename Stream> bool HttpIngress<Stream>::persistent() const { return persistent_; }
+
+template <typename Stream> Exchanged HttpIngress<Stream>::exchange(Egress& egress, Yield yield)
+{
+  assertTrue(persistent_, PichiError::MISC);
+  auto ret = Exchanged{};
+  auto& req = reqParser_->get();
+  auto head = req.method() == http::verb::head;
+
+  // The client waits for continuing before sending the body, which is relayed after the header
+  if (beast::iequals(req[http::field::expect], "100-continue")) {
+    auto rep = Response{};
+    rep.version(11);
+    rep.result(http::status::continue_);
+    writeHttp(stream_, rep, yield);
+    req.erase(http::field::expect);
+  }
+  req.erase(http::field::proxy_connection);
+  auto header = serializeHeader(req);
+  egress.send({static_cast<uint8_t const*>(header.data().data()), header.size()}, yield);
+  ret.in_ += header.size();
+
+  auto request = RelayParser<true>{move(*reqParser_)};
+  reqParser_.reset();
+  request.eager(true);
+  ret.in_ += relayMessage(
+      request, reqCache_, [&](auto buf) { return readSome(stream_, buf, yield); },
+      [&](auto buf) { egress.send(buf, yield); });
+
+  // Informational responses are relayed ahead of the final one
+  auto response = optional<RelayParser<false>>{};
+  do {
+    response.emplace();
+    unlimit(*response);
+    response->eager(true);
+    response->skip(head);
+    ret.out_ += relayMessage(
+        *response, respCache_, [&](auto buf) { return egress.recv(buf, yield); },
+        [&](auto buf) { write(stream_, buf, yield); });
+  } while (response->get().result_int() / 100 == 1 &&
+           response->get().result() != http::status::switching_protocols);
+
+  // The bytes following the response aren't expected, and neither is the egress reused then
+  persistent_ = request.keep_alive() && response->keep_alive() &&
+                response->get().result() != http::status::switching_protocols;
+  ret.reusable_ = persistent_ && respCache_.size() == 0;
+  respCache_.consume(respCache_.size());
+  return ret;
+}
+
+template <typename Stream> HttpEgress<Stream>::~HttpEgress()
+{
+  // The stream has to be movable to be parked
+  if constexpr (is_move_constructible_v<Stream>) {
+    if (!upstream_.has_value() || !idle()) return;
+    // Only the upstream rejecting CONNECT takes the parked connections
+    auto& upstream = Upstream<Stream>::get(*upstream_);
+    if (upstream.relaying()) upstream.park(move(*stream_));
+  }
+}
+
+/*
+ * CONNECT is skipped for the upstream known to reject it, and the connection parked for it is
+ *   preferred to a new one. Otherwise, the connection which CONNECT is rejected on relays
+ *   instead if it's still usable.
+ */
 template <typename Stream>
 void HttpEgress<Stream>::connect(Endpoint const& remote, Endpoint const& next, Yield yield)
 {
-  pichi::net::connect(next, *stream_, yield);
-  if (tunnelConnect(remote, *stream_, yield)) {
-    send_ = [this](auto buf, auto yield) { write(*stream_, buf, yield); };
-    recv_ = [this](auto buf, auto yield) { return readSome(*stream_, buf, yield); };
+  auto& upstream = Upstream<Stream>::get(next);
+  if (!upstream.relaying()) {
+    if (!isOpen(*stream_)) preconnect(next, yield);
+    auto [code, usable] = tunnelConnect(remote, *stream_, yield);
+    if (code >= 200 && code < 300) {
+      relaying_ = Relaying::RAW;
+      return;
+    }
+
+    // Only rejecting the method itself is remembered, since the others might depend on remote
+    if (code == 405 || code == 501) upstream.reject();
+    if (!usable) {
+      pichi::net::close(origin_);
+      stream_ = addressof(backup_);
+      pichi::net::connect(next, *stream_, options_, yield);
+    }
+  }
+  else if (!isOpen(*stream_)) {
+    if constexpr (is_move_constructible_v<Stream>) {
+      auto parked = upstream.take();
+      if (parked.has_value()) stream_ = addressof(parked_.emplace(move(*parked)));
+    }
+    if (!isOpen(*stream_)) preconnect(next, yield);
+  }
+
+  upstream_ = next;
+  reqParser_.emplace();
+  unlimit(*reqParser_);
+  relaying_ = Relaying::FOLLOWING;
+}
+
+/*
+ * The header of each request is sent with its target in absolute form, while the body is sent
+ *   as it is. The bytes of a partial header are cached until the rest arrives. Everything after
+ *   the upgrading or closing request is sent without following.
+ */
+template <typename Stream> void HttpEgress<Stream>::relay(ConstBuffer<uint8_t> buf, Yield yield)
+{
+  if (raw_) {
+    write(*stream_, buf, yield);
     return;
   }
 
-  // Failed to make connection via HTTP CONNECT, so try HTTP relay again.
-  send_ = [this](auto buf, auto yield) {
-    if (tryToSendHeader(reqParser_, reqCache_, buf, *stream_, yield))
-      send_ = [this](auto buf, auto yield) { write(*stream_, buf, yield); };
-  };
-  recv_ = [this](auto buf, auto yield) { return recvRaw(*stream_, respCache_, buf, yield); };
+  copyToCache(buf, reqCache_);
+  while (reqCache_.size() > 0 && !raw_) {
+    if (!request_.has_value()) {
+      auto ec = sys::error_code{};
+      reqCache_.consume(reqParser_->put(reqCache_.data(), ec));
+      if (ec == http::error::need_more) return;
+      assertNoError(ec);
+
+      request_.emplace(move(*reqParser_));
+      reqParser_.emplace();
+      unlimit(*reqParser_);
+      auto req = Request{request_->get().base()};
+      addHostToTarget(req);
+      writeHttpHeader(*stream_, req, yield);
+      pending_.push_back(req.method());
+      // Nothing but the raw bytes is expected after the last request
+      persistent_ = persistent_ && request_->keep_alive();
+      raw_ = request_->upgrade() || !persistent_;
+    }
+    else {
+      auto parsed = follow(*request_, {static_cast<uint8_t const*>(reqCache_.data().data()),
+                                       reqCache_.size()});
+      if (parsed == 0) return;
+      write(*stream_, {static_cast<uint8_t const*>(reqCache_.data().data()), parsed}, yield);
+      reqCache_.consume(parsed);
+    }
+    if (request_->is_done()) request_.reset();
+  }
 
-  pichi::net::close(origin_);
-  stream_ = addressof(backup_);
-  pichi::net::connect(next, *stream_, yield);
+  if (reqCache_.size() == 0) return;
+  write(*stream_, {static_cast<uint8_t const*>(reqCache_.data().data()), reqCache_.size()}, yield);
+  reqCache_.consume(reqCache_.size());
 }
 
+/*
+ * The responses are followed as they're received, while the bytes of a partial header are
+ *   parsed again with the rest from the cache. The bytes without any request pending, or after
+ *   switching protocols, aren't followed any more.
+ */
+template <typename Stream>
+size_t HttpEgress<Stream>::receive(MutableBuffer<uint8_t> buf, Yield yield)
+{
+  auto received = readSome(*stream_, buf, yield);
+  if (raw_) return received;
+
+  auto fromCache = respCache_.size() > 0;
+  if (fromCache) copyToCache({buf.data(), received}, respCache_);
+  auto left = fromCache ? ConstBuffer<uint8_t>{static_cast<uint8_t const*>(respCache_.data().data()),
+                                               respCache_.size()}
+                        : ConstBuffer<uint8_t>{buf.data(), received};
+  while (left.size() > 0 && !raw_) {
+    if (!response_.has_value()) {
+      if (pending_.empty()) {
+        raw_ = true;
+        break;
+      }
+      response_.emplace();
+      unlimit(*response_);
+      response_->eager(true);
+      response_->skip(pending_.front() == http::verb::head);
+    }
+
+    auto parsed = follow(*response_, left);
+    if (parsed == 0) break;
+    left += parsed;
+    if (!response_->is_done()) continue;
+
+    if (response_->get().result() == http::status::switching_protocols) {
+      raw_ = true;
+    }
+    else if (response_->get().result_int() / 100 != 1) {
+      // Informational responses precede the final one
+      pending_.pop_front();
+      persistent_ = persistent_ && response_->keep_alive();
+    }
+    response_.reset();
+  }
+
+  if (fromCache) respCache_.consume(raw_ ? respCache_.size() : respCache_.size() - left.size());
+  else if (!raw_) copyToCache(left, respCache_);
+  return received;
+}
+
+// Resting between messages, which are all kept alive
+template <typename Stream> bool HttpEgress<Stream>::idle()
+{
+  return persistent_ && !raw_ && pending_.empty() && !request_.has_value() &&
+         !response_.has_value() && !reqParser_->got_some() && reqCache_.size() == 0 &&
+         respCache_.size() == 0 && isAlive(*stream_);
+}
+
+// Only the stream for HTTP CONNECT is preconnected, and the backup one is connected on fallback
+template <typename Stream>
+void HttpEgress<Stream>::preconnect(Endpoint const& next, Yield yield)
+{
+  pichi::net::connect(next, origin_, options_, yield);
+}
+
+template <typename Stream> bool HttpEgress<Stream>::alive() { return isAlive(*stream_); }
+
 template <typename Stream> size_t HttpEgress<Stream>::recv(MutableBuffer<uint8_t> buf, Yield yield)
 {
-  return recv_(buf, yield);
+  switch (relaying_) {
+  case Relaying::RAW:
+    return readSome(*stream_, buf, yield);
+  case Relaying::FOLLOWING:
+    return receive(buf, yield);
+  default:
+    fail("Bad invocation"sv);
+  }
 }
 
 template <typename Stream> void HttpEgress<Stream>::send(ConstBuffer<uint8_t> buf, Yield yield)
 {
-  send_(buf, yield);
+  switch (relaying_) {
+  case Relaying::RAW:
+    write(*stream_, buf, yield);
+    break;
+  case Relaying::FOLLOWING:
+    relay(buf, yield);
+    break;
+  default:
+    fail("Bad invocation"sv);
+  }
 }
 
 template <typename Stream> void HttpEgress<Stream>::close() { pichi::net::close(*stream_); }
 
-template <typename Stream> bool HttpEgress<Stream>::readable() const
-{
-  return isOpen(*stream_) || respCache_.size() > 0;
-}
+template <typename Stream> bool HttpEgress<Stream>::readable() const { return isOpen(*stream_); }
 
 template <typename Stream> bool HttpEgress<Stream>::writable() const { return isOpen(*stream_); }
 
@@ -0,0 +1,400 @@
+#include "config.h"
+#include <algorithm>
+#include <array>
+#include <boost/asio/ip/tcp.hpp>
+#include <boost/beast/core/flat_buffer.hpp>
+#include <pichi/asserts.hpp>
+#include <pichi/net/asio.hpp>
+#include <pichi/net/helpers.hpp>
+#include <pichi/net/mux.hpp>
+#include <pichi/net/spawn.hpp>
+#include <utility>
+
+#ifdef ENABLE_TLS
+#include <boost/asio/ssl/stream.hpp>
+#endif // ENABLE_TLS
+
+using namespace std;
+namespace asio = boost::asio;
+namespace beast = boost::beast;
+namespace ssl = asio::ssl;
+namespace sys = boost::system;
+using tcp = asio::ip::tcp;
+
+namespace pichi::net {
+
+struct MuxStream {
+  MuxStream(asio::io_context& io, uint32_t id, Endpoint remote)
+    : id_{id}, remote_{move(remote)}, signal_{io, asio::steady_timer::time_point::max()}
+  {
+  }
+
+  uint32_t id_;
+  Endpoint remote_;
+  beast::flat_buffer inbox_ = {};
+  // Credits to send, and the bytes consumed but not granted back to the peer yet
+  size_t credit_ = MUX_WINDOW;
+  size_t consumed_ = 0;
+  bool finReceived_ = false;
+  bool closed_ = false;
+  asio::steady_timer signal_;
+};
+
+template <typename Yield> static void wait(asio::steady_timer& signal, Yield yield)
+{
+  // Exceptions prohibited
+  auto ec = sys::error_code{};
+  signal.async_wait(yield[ec]);
+}
+
+void serializeMuxHeader(MuxHeader const& header, MutableBuffer<uint8_t> dst)
+{
+  assertTrue(dst.size() >= MUX_HEADER_SIZE, PichiError::MISC);
+  dst.data()[0] = MUX_VERSION;
+  dst.data()[1] = static_cast<uint8_t>(header.cmd_);
+  hton(header.length_, dst + 2);
+  hton(header.id_, dst + 4);
+}
+
+MuxHeader parseMuxHeader(ConstBuffer<uint8_t> src)
+{
+  assertTrue(src.size() >= MUX_HEADER_SIZE, PichiError::MISC);
+  auto p = src.data();
+  assertTrue(p[0] == MUX_VERSION, PichiError::BAD_PROTO);
+  assertTrue(p[1] <= static_cast<uint8_t>(MuxCommand::FIN), PichiError::BAD_PROTO);
+  auto length = ntoh<uint16_t>({p + 2, 2});
+  assertTrue(length <= MAX_FRAME_SIZE, PichiError::BAD_PROTO);
+  return {static_cast<MuxCommand>(p[1]), length, ntoh<uint32_t>({p + 4, 4})};
+}
+
+Mux::Mux(asio::io_context& io, bool client)
+  : strand_{io}, client_{client}, writable_{io, asio::steady_timer::time_point::max()},
+    acceptable_{io, asio::steady_timer::time_point::max()}
+{
+}
+
+Mux::~Mux() = default;
+
+void Mux::enqueue(MuxHeader const& header, ConstBuffer<uint8_t> payload)
+{
+  assertTrue(header.length_ == payload.size(), PichiError::MISC);
+  auto offset = outbox_.size();
+  outbox_.resize(offset + MUX_HEADER_SIZE + payload.size());
+  serializeMuxHeader(header, {outbox_.data() + offset, MUX_HEADER_SIZE});
+  copy_n(cbegin(payload), payload.size(), begin(outbox_) + offset + MUX_HEADER_SIZE);
+  writable_.cancel();
+}
+
+void Mux::dispatch(MuxHeader const& header, ConstBuffer<uint8_t> payload)
+{
+  auto it = streams_.find(header.id_);
+  // Frames for the streams already closed locally are dropped
+  auto stream = it != std::end(streams_) ? it->second : StreamPtr{};
+  switch (header.cmd_) {
+  case MuxCommand::SYN: {
+    assertFalse(client_, PichiError::BAD_PROTO);
+    assertTrue(stream == nullptr, PichiError::BAD_PROTO);
+    if (streams_.size() >= MUX_MAX_STREAMS) {
+      // Refused without being accepted, and its later frames are dropped as an unknown stream
+      enqueue({MuxCommand::FIN, 0, header.id_});
+      break;
+    }
+    auto remote = parseEndpoint(payload).first;
+    stream = make_shared<MuxStream>(strand_.context(), header.id_, move(remote));
+    streams_.emplace(header.id_, stream);
+    accepted_.push_back(move(stream));
+    acceptable_.cancel();
+    break;
+  }
+  case MuxCommand::PSH:
+    if (stream == nullptr) break;
+    assertTrue(stream->inbox_.size() + stream->consumed_ + payload.size() <= MUX_WINDOW,
+               PichiError::BAD_PROTO);
+    stream->inbox_.commit(
+        asio::buffer_copy(stream->inbox_.prepare(payload.size()), asio::buffer(payload)));
+    stream->signal_.cancel();
+    break;
+  case MuxCommand::UPD:
+    assertTrue(payload.size() == sizeof(uint32_t), PichiError::BAD_PROTO);
+    if (stream == nullptr) break;
+    stream->credit_ += ntoh<uint32_t>(payload);
+    assertTrue(stream->credit_ <= MUX_WINDOW, PichiError::BAD_PROTO);
+    stream->signal_.cancel();
+    break;
+  case MuxCommand::FIN:
+    if (stream == nullptr) break;
+    stream->finReceived_ = true;
+    stream->signal_.cancel();
+    break;
+  default:
+    fail(PichiError::BAD_PROTO);
+  }
+}
+
+void Mux::readLoop(Yield yield)
+{
+  handshake(yield);
+  net::spawn(
+      strand_, [self = shared_from_this()](auto yield) { self->writeLoop(yield); },
+      [self = shared_from_this()](auto, auto) noexcept { self->close(); });
+
+  auto header = array<uint8_t, MUX_HEADER_SIZE>{};
+  auto payload = vector<uint8_t>(MAX_FRAME_SIZE);
+  while (!closed_) {
+    read(header, yield);
+    auto h = parseMuxHeader(header);
+    if (h.length_ > 0) read({payload, h.length_}, yield);
+    dispatch(h, {payload, h.length_});
+  }
+}
+
+void Mux::writeLoop(Yield yield)
+{
+  auto sending = vector<uint8_t>{};
+  while (!closed_) {
+    if (outbox_.empty()) {
+      wait(writable_, yield);
+      continue;
+    }
+    // Sending all frames queued so far by one write
+    swap(outbox_, sending);
+    write(sending, yield);
+    sending.clear();
+  }
+}
+
+void Mux::start()
+{
+  net::spawn(
+      strand_, [self = shared_from_this()](auto yield) { self->readLoop(yield); },
+      [self = shared_from_this()](auto, auto) noexcept { self->close(); });
+}
+
+void Mux::close()
+{
+  if (closed_) return;
+  closed_ = true;
+  shutdown();
+  for (auto&& [id, stream] : streams_) stream->signal_.cancel();
+  streams_.clear();
+  accepted_.clear();
+  writable_.cancel();
+  acceptable_.cancel();
+}
+
+bool Mux::closed() const { return closed_; }
+
+size_t Mux::streams() const { return streams_.size(); }
+
+Mux::StreamPtr Mux::open(Endpoint const& remote)
+{
+  assertTrue(client_, PichiError::MISC);
+  assertFalse(closed_, PichiError::CONN_FAILURE, "Mux connection closed");
+  assertTrue(streams_.size() < MUX_MAX_STREAMS, PichiError::CONN_FAILURE, "Mux connection full");
+
+  auto stream = make_shared<MuxStream>(strand_.context(), nextId_++, remote);
+  auto payload = array<uint8_t, 512>{};
+  auto len = serializeEndpoint(remote, payload);
+  enqueue({MuxCommand::SYN, static_cast<uint16_t>(len), stream->id_}, {payload, len});
+  streams_.emplace(stream->id_, stream);
+  return stream;
+}
+
+Mux::StreamPtr Mux::accept(Yield yield)
+{
+  while (accepted_.empty()) {
+    if (closed_) return nullptr;
+    wait(acceptable_, yield);
+  }
+  auto stream = move(accepted_.front());
+  accepted_.erase(begin(accepted_));
+  return stream;
+}
+
+size_t Mux::recv(MuxStream& stream, MutableBuffer<uint8_t> buf, Yield yield)
+{
+  while (stream.inbox_.size() == 0) {
+    if (stream.closed_) throw sys::system_error{asio::error::operation_aborted};
+    if (stream.finReceived_) throw sys::system_error{asio::error::eof};
+    if (closed_) throw sys::system_error{asio::error::connection_reset};
+    wait(stream.signal_, yield);
+  }
+
+  auto n = asio::buffer_copy(asio::buffer(buf), stream.inbox_.data());
+  stream.inbox_.consume(n);
+  stream.consumed_ += n;
+  if (stream.consumed_ >= MUX_WINDOW / 2 && !stream.closed_ && !closed_) {
+    auto increment = array<uint8_t, sizeof(uint32_t)>{};
+    hton(static_cast<uint32_t>(stream.consumed_), increment);
+    enqueue({MuxCommand::UPD, sizeof(uint32_t), stream.id_}, increment);
+    stream.consumed_ = 0;
+  }
+  return n;
+}
+
+void Mux::send(MuxStream& stream, ConstBuffer<uint8_t> buf, Yield yield)
+{
+  while (buf.size() > 0) {
+    if (stream.closed_) throw sys::system_error{asio::error::operation_aborted};
+    if (stream.finReceived_) throw sys::system_error{asio::error::broken_pipe};
+    if (closed_) throw sys::system_error{asio::error::connection_reset};
+    if (stream.credit_ == 0) {
+      wait(stream.signal_, yield);
+      continue;
+    }
+    auto n = min({buf.size(), stream.credit_, MAX_FRAME_SIZE});
+    enqueue({MuxCommand::PSH, static_cast<uint16_t>(n), stream.id_}, {buf, n});
+    stream.credit_ -= n;
+    buf = buf + n;
+  }
+}
+
+void Mux::close(MuxStream& stream)
+{
+  if (stream.closed_) return;
+  stream.closed_ = true;
+  stream.signal_.cancel();
+  if (closed_) return;
+  enqueue({MuxCommand::FIN, 0, stream.id_});
+  streams_.erase(stream.id_);
+}
+
+template <typename Socket> void MuxOver<Socket>::handshake(Yield yield)
+{
+#ifdef ENABLE_TLS
+  if constexpr (IsSslStreamV<Socket>) {
+    // The client side has finished its handshake while connecting
+    if (!client()) socket_.async_handshake(ssl::stream_base::handshake_type::server, yield);
+  }
+#endif // ENABLE_TLS
+}
+
+template <typename Socket> void MuxOver<Socket>::read(MutableBuffer<uint8_t> buf, Yield yield)
+{
+  pichi::net::read(socket_, buf, yield);
+}
+
+template <typename Socket> void MuxOver<Socket>::write(ConstBuffer<uint8_t> buf, Yield yield)
+{
+  pichi::net::write(socket_, buf, yield);
+}
+
+template <typename Socket> void MuxOver<Socket>::shutdown() { pichi::net::close(socket_); }
+
+template <typename Socket>
+void MuxOver<Socket>::connect(Endpoint const& server, SocketOptions const& options, Yield yield)
+{
+  pichi::net::connect(server, socket_, options, yield);
+}
+
+MuxClient::MuxClient(asio::io_context& io, size_t connections, Dial dial)
+  : connections_{connections}, dial_{move(dial)}, dialed_{io, asio::steady_timer::time_point::max()}
+{
+}
+
+shared_ptr<Mux> MuxClient::acquire(Yield yield)
+{
+  while (true) {
+    muxes_.erase(remove_if(begin(muxes_), end(muxes_), [](auto&& mux) { return mux->closed(); }),
+                 end(muxes_));
+    if (muxes_.size() + dialing_ < connections_) {
+      ++dialing_;
+      auto mux = shared_ptr<Mux>{};
+      try {
+        mux = dial_(yield);
+      }
+      catch (...) {
+        --dialing_;
+        dialed_.cancel();
+        throw;
+      }
+      --dialing_;
+      mux->start();
+      muxes_.push_back(mux);
+      dialed_.cancel();
+      return mux;
+    }
+    if (!muxes_.empty()) {
+      auto least = *min_element(begin(muxes_), end(muxes_), [](auto&& lhs, auto&& rhs) {
+        return lhs->streams() < rhs->streams();
+      });
+      if (least->streams() < MUX_MAX_STREAMS) return least;
+    }
+    // The other connections are being dialed, or all of them are full
+    assertTrue(dialing_ > 0, PichiError::CONN_FAILURE, "All mux connections are full");
+    wait(dialed_, yield);
+  }
+}
+
+void MuxClient::close()
+{
+  for (auto&& mux : muxes_) mux->close();
+  muxes_.clear();
+}
+
+MuxIngress::MuxIngress(shared_ptr<Mux> mux, Mux::StreamPtr stream)
+  : mux_{move(mux)}, stream_{move(stream)}
+{
+}
+
+MuxIngress::~MuxIngress() { close(); }
+
+size_t MuxIngress::recv(MutableBuffer<uint8_t> buf, Yield yield)
+{
+  return mux_->recv(*stream_, buf, yield);
+}
+
+void MuxIngress::send(ConstBuffer<uint8_t> buf, Yield yield) { mux_->send(*stream_, buf, yield); }
+
+void MuxIngress::close() { mux_->close(*stream_); }
+
+bool MuxIngress::readable() const { return !stream_->closed_ && !mux_->closed(); }
+
+bool MuxIngress::writable() const { return !stream_->closed_ && !mux_->closed(); }
+
+Endpoint MuxIngress::readRemote(Yield) { return stream_->remote_; }
+
+// The stream has been opened by the client without waiting for the confirmation
+void MuxIngress::confirm(Yield) {}
+
+void MuxIngress::disconnect(Yield) { close(); }
+
+MuxEgress::MuxEgress(shared_ptr<MuxClient> client) : client_{move(client)} {}
+
+MuxEgress::~MuxEgress() { close(); }
+
+size_t MuxEgress::recv(MutableBuffer<uint8_t> buf, Yield yield)
+{
+  return mux_->recv(*stream_, buf, yield);
+}
+
+void MuxEgress::send(ConstBuffer<uint8_t> buf, Yield yield) { mux_->send(*stream_, buf, yield); }
+
+void MuxEgress::close()
+{
+  if (stream_ != nullptr) mux_->close(*stream_);
+}
+
+bool MuxEgress::readable() const
+{
+  return stream_ != nullptr && !stream_->closed_ && !mux_->closed();
+}
+
+bool MuxEgress::writable() const
+{
+  return stream_ != nullptr && !stream_->closed_ && !mux_->closed();
+}
+
+void MuxEgress::connect(Endpoint const& remote, Endpoint const&, Yield yield)
+{
+  mux_ = client_->acquire(yield);
+  stream_ = mux_->open(remote);
+}
+
+template class MuxOver<tcp::socket>;
+
+#ifdef ENABLE_TLS
+template class MuxOver<ssl::stream<tcp::socket>>;
+#endif // ENABLE_TLS
+
+} // namespace pichi::net
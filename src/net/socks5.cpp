@@ -6,6 +6,8 @@
 #include <pichi/net/helpers.hpp>
 #include <pichi/net/socks5.hpp>
 #include <pichi/test/socket.hpp>
+#include <string>
+#include <type_traits>
 #include <utility>
 
 #ifdef ENABLE_TLS
@@ -61,18 +63,24 @@ template <typename Stream> Endpoint Socks5Adapter<Stream>::readRemote(Yield yiel
   buf[1] = m;
   write(stream_, {buf, 2}, yield);
 
-  read(stream_, {buf, 3}, yield);
+  // The request is read along with the head of the endpoint, whose rest is read at once then
+  read(stream_, {buf, 3 + ENDPOINT_HEAD_SIZE}, yield);
   assertTrue(buf[0] == 0x05, PichiError::BAD_PROTO);
-  assertTrue(buf[1] == 0x01, PichiError::BAD_PROTO);
+  // CMD = 0x01(CONNECT) or 0x03(UDP ASSOCIATE)
+  assertTrue(buf[1] == 0x01 || buf[1] == 0x03, PichiError::BAD_PROTO);
   assertTrue(buf[2] == 0x00, PichiError::BAD_PROTO);
+  associating_ = buf[1] == 0x03;
 
-  return parseEndpoint([this, yield](auto dst) { read(stream_, dst, yield); });
+  // The address and port the client expects to send datagrams from if associating
+  return readEndpoint({buf.data() + 3, buf.size() - 3}, ENDPOINT_HEAD_SIZE,
+                      [this, yield](auto dst) { read(stream_, dst, yield); })
+      .first;
 }
 
 template <typename Stream>
 void Socks5Adapter<Stream>::connect(Endpoint const& remote, Endpoint const& next, Yield yield)
 {
-  pichi::net::connect(next, stream_, yield);
+  if (!isOpen(stream_)) preconnect(next, yield);
 
   auto buf = HeaderBuffer<uint8_t>{0x05, 0x01, 0x00};
 
@@ -89,14 +97,24 @@ void Socks5Adapter<Stream>::connect(Endpoint const& remote, Endpoint const& next
   i += serializeEndpoint(remote, {buf.data() + i, buf.size() - i});
   write(stream_, {buf, i}, yield);
 
-  read(stream_, {buf, 3}, yield);
+  read(stream_, {buf, 3 + ENDPOINT_HEAD_SIZE}, yield);
   assertTrue(buf[0] == 0x05, PichiError::BAD_PROTO);
-  assertTrue(buf[1] == 0x00, PichiError::CONN_FAILURE,
-             "Failed to establish connection with " + remote.host_ + ":" + remote.port_);
+  if (buf[1] != 0x00)
+    fail(PichiError::CONN_FAILURE, "Failed to establish connection with " + formatHost(remote) +
+                                       ":" + to_string(remote.port_));
   assertTrue(buf[2] == 0x00, PichiError::BAD_PROTO);
-  parseEndpoint([this, yield](auto dst) { read(stream_, dst, yield); });
+  readEndpoint({buf.data() + 3, buf.size() - 3}, ENDPOINT_HEAD_SIZE,
+               [this, yield](auto dst) { read(stream_, dst, yield); });
 }
 
+template <typename Stream>
+void Socks5Adapter<Stream>::preconnect(Endpoint const& next, Yield yield)
+{
+  pichi::net::connect(next, stream_, options_, yield);
+}
+
+template <typename Stream> bool Socks5Adapter<Stream>::alive() { return isAlive(stream_); }
+
 template <typename Stream> void Socks5Adapter<Stream>::confirm(Yield yield)
 {
   static uint8_t const buf[] = {0x05, 0x00, 0x00, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00};
@@ -111,6 +129,39 @@ template <typename Stream> void Socks5Adapter<Stream>::disconnect(Yield yield)
   write(stream_, buf, yield[ec]);
 }
 
+template <typename Stream> bool Socks5Adapter<Stream>::associating() const
+{
+  return associating_;
+}
+
+template <typename Stream> string Socks5Adapter<Stream>::localAddress() const
+{
+#ifdef ENABLE_TLS
+  if constexpr (IsSslStreamV<Stream>) {
+    return stream_.next_layer().local_endpoint().address().to_string();
+  }
+  else
+#endif // ENABLE_TLS
+#ifdef BUILD_TEST
+      if constexpr (is_same_v<Stream, pichi::test::Stream>) {
+    return "127.0.0.1";
+  }
+  else
+#endif // BUILD_TEST
+  {
+    return stream_.local_endpoint().address().to_string();
+  }
+}
+
+template <typename Stream>
+void Socks5Adapter<Stream>::associate(Endpoint const& relay, Yield yield)
+{
+  assertTrue(associating_, PichiError::MISC);
+  auto buf = HeaderBuffer<uint8_t>{0x05, 0x00, 0x00};
+  auto len = 3 + serializeEndpoint(relay, {buf.data() + 3, buf.size() - 3});
+  write(stream_, {buf, len}, yield);
+}
+
 template class Socks5Adapter<tcp::socket>;
 
 #ifdef ENABLE_TLS
@@ -1,6 +1,6 @@
 #include <boost/beast/http/error.hpp>
-#include <iostream>
 #include <pichi/exception.hpp>
+#include <pichi/log.hpp>
 #include <pichi/net/spawn.hpp>
 
 using namespace std;
@@ -16,13 +16,13 @@ void logException(std::exception_ptr eptr) noexcept
     if (eptr) rethrow_exception(eptr);
   }
   catch (Exception& e) {
-    cout << "Pichi Error: " << e.what() << endl;
+    log::error("Pichi Error: ", e.what());
   }
   catch (sys::system_error& e) {
     if (e.code() == asio::error::eof || e.code() == asio::error::operation_aborted ||
         e.code() == http::error::end_of_stream)
       return;
-    cout << "Socket Error: " << e.what() << endl;
+    log::warn("Socket Error: ", e.what());
   }
 }
 
@@ -58,17 +58,20 @@ void SSAeadAdapter<method, Stream>::send(ConstBuffer<uint8_t> plain, Yield yield
 
   using CipherBuffer = array<uint8_t, 2 + MAX_FRAME_SIZE + 2 * TAG_SIZE<method>>;
 
+  // Plain larger than a frame is split, because the relay chunk could exceed the frame size
   auto cipher = CipherBuffer{};
-  auto len = encrypt(plain, cipher);
-
-  write(stream_, {cipher, len}, yield);
+  while (plain.size() > 0) {
+    auto consumed = min(plain.size(), MAX_FRAME_SIZE);
+    write(stream_, {cipher, encrypt({plain, consumed}, cipher)}, yield);
+    plain += consumed;
+  }
 }
 
 template <CryptoMethod method, typename Stream>
 void SSAeadAdapter<method, Stream>::connect(Endpoint const& remote, Endpoint const& server,
                                             Yield yield)
 {
-  pichi::net::connect(server, stream_, yield);
+  if (!isOpen(stream_)) preconnect(server, yield);
 
   auto plain = array<uint8_t, 512>{};
   auto plen = serializeEndpoint(remote, plain);
@@ -76,6 +79,17 @@ void SSAeadAdapter<method, Stream>::connect(Endpoint const& remote, Endpoint con
   send({plain, plen}, yield);
 }
 
+template <CryptoMethod method, typename Stream>
+void SSAeadAdapter<method, Stream>::preconnect(Endpoint const& server, Yield yield)
+{
+  pichi::net::connect(server, stream_, options_, yield);
+}
+
+template <CryptoMethod method, typename Stream> bool SSAeadAdapter<method, Stream>::alive()
+{
+  return isAlive(stream_);
+}
+
 template <CryptoMethod method, typename Stream>
 size_t SSAeadAdapter<method, Stream>::readIV(MutableBuffer<uint8_t> iv, Yield yield)
 {
@@ -90,10 +104,22 @@ size_t SSAeadAdapter<method, Stream>::readIV(MutableBuffer<uint8_t> iv, Yield yi
 template <CryptoMethod method, typename Stream>
 Endpoint SSAeadAdapter<method, Stream>::readRemote(Yield yield)
 {
-  return parseEndpoint([this, yield](auto dst) {
+  if (!ivReceived_) {
+    auto iv = array<uint8_t, IV_SIZE<method>>{};
+    readIV(iv, yield);
+  }
+
+  // The endpoint is parsed in place from the first frame, whose rest is cached for recv
+  auto frame = array<uint8_t, MAX_FRAME_SIZE>{};
+  auto len = recvFrame(frame, yield);
+  auto [endpoint, size] = readEndpoint(frame, len, [this, yield](auto dst) {
     for (size_t r = 0; r < dst.size(); r += recv(dst + r, yield))
       ;
   });
+  if (len > size)
+    cache_.commit(asio::buffer_copy(cache_.prepare(len - size),
+                                    asio::buffer(frame.data() + size, len - size)));
+  return endpoint;
 }
 
 template <CryptoMethod method, typename Stream> void SSAeadAdapter<method, Stream>::confirm(Yield)
@@ -27,7 +27,7 @@ size_t SSStreamAdapter<method, Stream>::recv(MutableBuffer<uint8_t> plain, Yield
   }
 
   auto cipher = FrameBuffer<uint8_t>{};
-  auto len = readSome(stream_, {cipher, plain.size()}, yield);
+  auto len = readSome(stream_, {cipher, min(plain.size(), cipher.size())}, yield);
   return decryptor_.decrypt({cipher, len}, plain);
 }
 
@@ -78,7 +78,20 @@ size_t SSStreamAdapter<method, Stream>::readIV(MutableBuffer<uint8_t> iv, Yield
 template <CryptoMethod method, typename Stream>
 Endpoint SSStreamAdapter<method, Stream>::readRemote(Yield yield)
 {
-  return parseEndpoint([this, yield](auto dst) { recv(dst, yield); });
+  if (!ivReceived_) {
+    auto iv = array<uint8_t, IV_SIZE<method>>{};
+    readIV(iv, yield);
+  }
+
+  // No more than the endpoint is read, since there's nowhere to keep the plain following it
+  auto plain = HeaderBuffer<uint8_t>{};
+  return readEndpoint(plain, 0,
+                      [this, yield](auto dst) {
+                        auto cipher = HeaderBuffer<uint8_t>{};
+                        read(stream_, {cipher, dst.size()}, yield);
+                        decryptor_.decrypt({cipher, dst.size()}, dst);
+                      })
+      .first;
 }
 
 template <CryptoMethod method, typename Stream> void SSStreamAdapter<method, Stream>::confirm(Yield)
@@ -94,7 +107,7 @@ template <CryptoMethod method, typename Stream>
 void SSStreamAdapter<method, Stream>::connect(Endpoint const& remote, Endpoint const& server,
                                               Yield yield)
 {
-  pichi::net::connect(server, stream_, yield);
+  if (!isOpen(stream_)) preconnect(server, yield);
 
   auto plain = HeaderBuffer<uint8_t>{};
   auto plen = serializeEndpoint(remote, plain);
@@ -102,6 +115,17 @@ void SSStreamAdapter<method, Stream>::connect(Endpoint const& remote, Endpoint c
   send({plain, plen}, yield);
 }
 
+template <CryptoMethod method, typename Stream>
+void SSStreamAdapter<method, Stream>::preconnect(Endpoint const& server, Yield yield)
+{
+  pichi::net::connect(server, stream_, options_, yield);
+}
+
+template <CryptoMethod method, typename Stream> bool SSStreamAdapter<method, Stream>::alive()
+{
+  return isAlive(stream_);
+}
+
 template class SSStreamAdapter<CryptoMethod::RC4_MD5, tcp::socket>;
 template class SSStreamAdapter<CryptoMethod::BF_CFB, tcp::socket>;
 template class SSStreamAdapter<CryptoMethod::AES_128_CTR, tcp::socket>;
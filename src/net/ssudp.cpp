@@ -0,0 +1,73 @@
+#include <algorithm>
+#include <pichi/asserts.hpp>
+#include <pichi/crypto/aead.hpp>
+#include <pichi/crypto/key.hpp>
+#include <pichi/net/ssudp.hpp>
+
+using namespace std;
+using namespace pichi::crypto;
+
+namespace pichi::net {
+
+template <CryptoMethod method> SSAeadUdpCodec<method>::SSAeadUdpCodec(ConstBuffer<uint8_t> psk)
+{
+  assertTrue(psk.size() == KEY_SIZE<method>, PichiError::CRYPTO_ERROR);
+  copy_n(cbegin(psk), KEY_SIZE<method>, begin(psk_));
+}
+
+template <CryptoMethod method> void SSAeadUdpCodec<method>::seal(Datagram& d)
+{
+  assertTrue(d.offset_ >= IV_SIZE<method>, PichiError::MISC);
+  assertTrue(d.offset_ + d.size_ + TAG_SIZE<method> <= d.buf_.size(), PichiError::MISC);
+
+  // The nonce starts from zero for each salt, which is never reused
+  auto encryptor = AeadEncryptor<method>{psk_};
+  auto plain = d.data();
+  d.size_ = encryptor.encrypt(plain, {plain.data(), plain.size() + TAG_SIZE<method>});
+
+  auto salt = encryptor.getIv();
+  d.offset_ -= salt.size();
+  d.size_ += salt.size();
+  copy_n(cbegin(salt), salt.size(), begin(d.buf_) + d.offset_);
+}
+
+template <CryptoMethod method> void SSAeadUdpCodec<method>::open(Datagram& d)
+{
+  assertTrue(d.size_ > IV_SIZE<method> + TAG_SIZE<method>, PichiError::BAD_PROTO);
+
+  auto decryptor = AeadDecryptor<method>{psk_};
+  decryptor.setIv({d.buf_.data() + d.offset_, IV_SIZE<method>});
+  d.offset_ += IV_SIZE<method>;
+  d.size_ -= IV_SIZE<method>;
+  auto cipher = d.data();
+  d.size_ = decryptor.decrypt(cipher, cipher);
+}
+
+template class SSAeadUdpCodec<CryptoMethod::AES_128_GCM>;
+template class SSAeadUdpCodec<CryptoMethod::AES_192_GCM>;
+template class SSAeadUdpCodec<CryptoMethod::AES_256_GCM>;
+template class SSAeadUdpCodec<CryptoMethod::CHACHA20_IETF_POLY1305>;
+template class SSAeadUdpCodec<CryptoMethod::XCHACHA20_IETF_POLY1305>;
+
+shared_ptr<SSUdpCodec> makeSSUdpCodec(CryptoMethod method, string_view password)
+{
+  auto container = array<uint8_t, 1024>{};
+  auto psk = MutableBuffer<uint8_t>{
+      container, generateKey(method, ConstBuffer<uint8_t>{password}, container)};
+  switch (method) {
+  case CryptoMethod::AES_128_GCM:
+    return make_shared<SSAeadUdpCodec<CryptoMethod::AES_128_GCM>>(psk);
+  case CryptoMethod::AES_192_GCM:
+    return make_shared<SSAeadUdpCodec<CryptoMethod::AES_192_GCM>>(psk);
+  case CryptoMethod::AES_256_GCM:
+    return make_shared<SSAeadUdpCodec<CryptoMethod::AES_256_GCM>>(psk);
+  case CryptoMethod::CHACHA20_IETF_POLY1305:
+    return make_shared<SSAeadUdpCodec<CryptoMethod::CHACHA20_IETF_POLY1305>>(psk);
+  case CryptoMethod::XCHACHA20_IETF_POLY1305:
+    return make_shared<SSAeadUdpCodec<CryptoMethod::XCHACHA20_IETF_POLY1305>>(psk);
+  default:
+    fail(PichiError::SEMANTIC_ERROR, "Shadowsocks UDP requires an AEAD method");
+  }
+}
+
+} // namespace pichi::net
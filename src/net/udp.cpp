@@ -0,0 +1,176 @@
+#include "config.h"
+#include <algorithm>
+#include <array>
+#include <pichi/asserts.hpp>
+#include <pichi/net/asio.hpp>
+#include <pichi/net/helpers.hpp>
+#include <pichi/net/udp.hpp>
+#include <utility>
+
+#if defined(HAS_RECVMMSG) || defined(HAS_SENDMMSG)
+#include <cerrno>
+#include <sys/socket.h>
+#endif // HAS_RECVMMSG || HAS_SENDMMSG
+
+using namespace std;
+namespace asio = boost::asio;
+namespace sys = boost::system;
+using udp = asio::ip::udp;
+
+namespace pichi::net {
+
+DatagramBatch::DatagramBatch(size_t capacity)
+{
+  assertTrue(capacity > 0 && capacity <= CAPACITY, PichiError::MISC);
+  datagrams_.reserve(capacity);
+  generate_n(back_inserter(datagrams_), capacity, []() { return make_unique<Datagram>(); });
+}
+
+void DatagramBatch::drop(size_t i)
+{
+  assertTrue(i < size_, PichiError::MISC);
+  rotate(begin(datagrams_) + i, begin(datagrams_) + i + 1, begin(datagrams_) + size_);
+  --size_;
+}
+
+void DatagramBatch::moveTo(size_t i, DatagramBatch& to)
+{
+  assertTrue(to.size_ < to.datagrams_.size(), PichiError::MISC);
+  assertTrue(i < size_, PichiError::MISC);
+  swap(datagrams_[i], to.datagrams_[to.size_++]);
+  drop(i);
+}
+
+size_t DatagramBatch::receive(Socket& s, size_t offset, Yield yield)
+{
+  assertTrue(offset <= UDP_HEADER_ROOM, PichiError::MISC);
+  // The trailer is left for the tag of the datagram sealed in place
+  auto capacity = Datagram{}.buf_.size() - offset - UDP_TRAILER_ROOM;
+  auto truncated = size_t{0};
+  size_ = 0;
+#ifdef HAS_RECVMMSG
+  auto headers = array<mmsghdr, CAPACITY>{};
+  auto iovecs = array<iovec, CAPACITY>{};
+  while (size_ == 0) {
+    s.async_wait(Socket::wait_read, yield);
+    for (auto i = 0u; i < datagrams_.size(); ++i) {
+      auto& d = *datagrams_[i];
+      iovecs[i] = {d.buf_.data() + offset, capacity};
+      headers[i] = {};
+      headers[i].msg_hdr.msg_name = d.peer_.data();
+      headers[i].msg_hdr.msg_namelen = static_cast<socklen_t>(d.peer_.capacity());
+      headers[i].msg_hdr.msg_iov = &iovecs[i];
+      headers[i].msg_hdr.msg_iovlen = 1;
+    }
+    auto n = ::recvmmsg(s.native_handle(), headers.data(), datagrams_.size(), MSG_DONTWAIT,
+                        nullptr);
+    if (n < 0) {
+      if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) continue;
+      throw sys::system_error{errno, sys::system_category()};
+    }
+    for (auto i = 0; i < n; ++i) {
+      if ((headers[i].msg_hdr.msg_flags & MSG_TRUNC) != 0) {
+        ++truncated;
+        continue;
+      }
+      auto& d = *datagrams_[i];
+      d.peer_.resize(headers[i].msg_hdr.msg_namelen);
+      d.offset_ = offset;
+      d.size_ = headers[i].msg_len;
+      swap(datagrams_[i], datagrams_[size_++]);
+    }
+  }
+#else  // HAS_RECVMMSG
+  // One more byte is received into the trailer, which tells the datagram is truncated
+  auto& d = *datagrams_.front();
+  while (size_ == 0) {
+    auto ec = sys::error_code{};
+    auto n = s.async_receive_from(asio::buffer(d.buf_.data() + offset, capacity + 1), d.peer_,
+                                  yield[ec]);
+    // Reported instead by some OSes, such as Windows
+    if (ec == asio::error::message_size || (!ec && n > capacity)) {
+      ++truncated;
+      continue;
+    }
+    if (ec) throw sys::system_error{ec};
+    d.offset_ = offset;
+    d.size_ = n;
+    size_ = 1;
+  }
+#endif // HAS_RECVMMSG
+  return truncated;
+}
+
+void DatagramBatch::send(Socket& s, Yield yield)
+{
+#ifdef HAS_SENDMMSG
+  auto headers = array<mmsghdr, CAPACITY>{};
+  auto iovecs = array<iovec, CAPACITY>{};
+  for (auto i = 0u; i < size_; ++i) {
+    auto& d = *datagrams_[i];
+    iovecs[i] = {d.buf_.data() + d.offset_, d.size_};
+    headers[i] = {};
+    headers[i].msg_hdr.msg_name = d.peer_.data();
+    headers[i].msg_hdr.msg_namelen = static_cast<socklen_t>(d.peer_.size());
+    headers[i].msg_hdr.msg_iov = &iovecs[i];
+    headers[i].msg_hdr.msg_iovlen = 1;
+  }
+  auto sent = 0u;
+  while (sent < size_) {
+    auto n = ::sendmmsg(s.native_handle(), headers.data() + sent, size_ - sent, MSG_DONTWAIT);
+    if (n >= 0) {
+      sent += n;
+    }
+    else if (errno == EAGAIN || errno == EWOULDBLOCK) {
+      s.async_wait(Socket::wait_write, yield);
+    }
+    else if (errno != EINTR) {
+      // Such as the unreachable destination, only the first datagram not sent is failed
+      ++sent;
+    }
+  }
+#else  // HAS_SENDMMSG
+  for (auto i = 0u; i < size_; ++i) {
+    auto& d = *datagrams_[i];
+    auto ec = sys::error_code{};
+    s.async_send_to(asio::buffer(d.buf_.data() + d.offset_, d.size_), d.peer_, yield[ec]);
+  }
+#endif // HAS_SENDMMSG
+  size_ = 0;
+}
+
+pair<Endpoint, size_t> parseUdpAddress(ConstBuffer<uint8_t> src) { return parseEndpoint(src); }
+
+void prependUdpAddress(Endpoint const& endpoint, Datagram& d)
+{
+  auto address = array<uint8_t, MAX_ADDRESS_SIZE>{};
+  auto len = serializeEndpoint(endpoint, address);
+  assertTrue(len <= d.offset_, PichiError::MISC);
+  d.offset_ -= len;
+  d.size_ += len;
+  copy_n(cbegin(address), len, begin(d.buf_) + d.offset_);
+}
+
+pair<Endpoint, size_t> parseUdpHeader(ConstBuffer<uint8_t> src)
+{
+  assertTrue(src.size() > 3, PichiError::BAD_PROTO);
+  auto p = src.data();
+  assertTrue(p[0] == 0x00, PichiError::BAD_PROTO);
+  assertTrue(p[1] == 0x00, PichiError::BAD_PROTO);
+  // Fragmentation is optional according to RFC 1928, and the fragments are dropped
+  assertTrue(p[2] == 0x00, PichiError::BAD_PROTO);
+
+  auto [endpoint, len] = parseUdpAddress(src + 3);
+  return {move(endpoint), 3 + len};
+}
+
+void prependUdpHeader(Endpoint const& source, Datagram& d)
+{
+  prependUdpAddress(source, d);
+  assertTrue(d.offset_ >= 3, PichiError::MISC);
+  d.offset_ -= 3;
+  d.size_ += 3;
+  fill_n(begin(d.buf_) + d.offset_, 3, 0x00);
+}
+
+} // namespace pichi::net
@@ -0,0 +1,86 @@
+#include <array>
+#include <new>
+#include <pichi/slab.hpp>
+#include <utility>
+
+using namespace std;
+
+namespace pichi::slab {
+
+static size_t const CLASSES = MAX_SIZE / GRANULARITY;
+
+// The block itself links to the next one while it's free
+struct Free {
+  Free* next_;
+};
+
+struct List {
+  Free* head_;
+  size_t size_;
+};
+
+/*
+ * The lists are trivially destructible, so they stay valid while the other thread-local objects
+ *   are destructed, and the flag tells that they have been reclaimed at the thread exit. The
+ *   blocks released after that go to the heap directly.
+ */
+static thread_local array<List, CLASSES> freeLists = {};
+static thread_local bool reclaimed = false;
+
+class Reclaimer {
+public:
+  ~Reclaimer()
+  {
+    reclaimed = true;
+    for (auto&& list : freeLists) {
+      while (list.head_ != nullptr) ::operator delete(exchange(list.head_, list.head_->next_));
+      list.size_ = 0;
+    }
+  }
+};
+
+static List* threadLists()
+{
+  if (reclaimed) return nullptr;
+  // Constructed at the first use by each thread, to reclaim the lists once the thread exits
+  static thread_local auto reclaimer = Reclaimer{};
+  static_cast<void>(reclaimer);
+  return freeLists.data();
+}
+
+static size_t classify(size_t size) { return (size + GRANULARITY - 1) / GRANULARITY - 1; }
+
+void* allocate(size_t size)
+{
+  if (size == 0 || size > MAX_SIZE) return ::operator new(size);
+  auto c = classify(size);
+  auto lists = threadLists();
+  // Blocks are always of the whole class, since they might be cached by any thread later
+  if (lists == nullptr || lists[c].head_ == nullptr) return ::operator new((c + 1) * GRANULARITY);
+  --lists[c].size_;
+  return exchange(lists[c].head_, lists[c].head_->next_);
+}
+
+void deallocate(void* p, size_t size) noexcept
+{
+  if (p == nullptr) return;
+  auto lists = size == 0 || size > MAX_SIZE ? nullptr : threadLists();
+  if (lists == nullptr || lists[classify(size)].size_ == MAX_FREE) {
+    ::operator delete(p);
+    return;
+  }
+  auto& list = lists[classify(size)];
+  ++list.size_;
+  list.head_ = new (p) Free{list.head_};
+}
+
+size_t cached()
+{
+  auto lists = threadLists();
+  if (lists == nullptr) return 0;
+  auto ret = size_t{0};
+  for (auto i = size_t{0}; i < CLASSES; ++i) ret += lists[i].size_;
+  return ret;
+}
+
+} // namespace pichi::slab
@@ -0,0 +1,180 @@
+#include <algorithm>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <numeric>
+#include <pichi/stats.hpp>
+#include <tuple>
+
+using namespace std;
+
+namespace pichi::stats {
+
+using Key = tuple<string, string, string>;
+using KeyView = tuple<string_view, string_view, string_view>;
+
+/*
+ * The mutex only guards the structure of the map, which is modified when a new key is met by
+ *   the owning thread, and iterated by the collecting thread.
+ */
+struct Shard {
+  mutex mutex_;
+  map<Key, Counters, less<>> counters_;
+};
+
+class Registry {
+public:
+  shared_ptr<Shard> attach()
+  {
+    auto lock = unique_lock<mutex>{mutex_};
+    // Shards are never released because the counters must survive their owning threads
+    return shards_.emplace_back(make_shared<Shard>());
+  }
+
+  vector<shared_ptr<Shard>> shards()
+  {
+    auto lock = unique_lock<mutex>{mutex_};
+    return shards_;
+  }
+
+private:
+  mutex mutex_;
+  vector<shared_ptr<Shard>> shards_;
+};
+
+static Registry& registry()
+{
+  static auto registry = Registry{};
+  return registry;
+}
+
+Values Counters::load() const
+{
+  auto ret = Values{};
+  transform(cbegin(values_), cend(values_), begin(ret),
+            [](auto&& value) { return value.load(memory_order_relaxed); });
+  return ret;
+}
+
+Counters& counters(string_view ingress, string_view egress, string_view rule)
+{
+  thread_local auto shard = registry().attach();
+  auto lock = unique_lock<mutex>{shard->mutex_};
+  auto it = shard->counters_.find(KeyView{ingress, egress, rule});
+  if (it == cend(shard->counters_))
+    it = shard->counters_.try_emplace(Key{ingress, egress, rule}).first;
+  return it->second;
+}
+
+vector<Sample> collect()
+{
+  auto merged = map<Key, Values>{};
+  for (auto&& shard : registry().shards()) {
+    auto lock = unique_lock<mutex>{shard->mutex_};
+    for (auto&& [key, counters] : shard->counters_) {
+      auto& values = merged[key];
+      auto delta = counters.load();
+      transform(cbegin(values), cend(values), cbegin(delta), begin(values), plus<uint64_t>{});
+    }
+  }
+
+  auto ret = vector<Sample>{};
+  ret.reserve(merged.size());
+  for (auto&& [key, values] : merged) {
+    auto& [ingress, egress, rule] = key;
+    ret.push_back({ingress, egress, rule, values});
+  }
+  return ret;
+}
+
+size_t Histogram::index(uint64_t value)
+{
+  value = min(value, (uint64_t{1} << MAX_BITS) - 1);
+  if (value < SUB_SIZE) return value;
+  auto exponent = size_t{0};
+  while ((value >> exponent) >= 2) ++exponent;
+  auto shift = exponent - SUB_BITS;
+  return (shift + 1) * SUB_SIZE + ((value >> shift) - SUB_SIZE);
+}
+
+uint64_t Histogram::upper(size_t i)
+{
+  auto group = i / SUB_SIZE;
+  auto sub = uint64_t{i % SUB_SIZE};
+  if (group == 0) return sub;
+  return ((SUB_SIZE + sub + 1) << (group - 1)) - 1;
+}
+
+void Histogram::record(Clock::duration d)
+{
+  auto us = chrono::duration_cast<chrono::microseconds>(d).count();
+  auto value = us < 0 ? uint64_t{0} : static_cast<uint64_t>(us);
+  buckets_[index(value)].fetch_add(1, memory_order_relaxed);
+  sum_.fetch_add(value, memory_order_relaxed);
+  auto top = max_.load(memory_order_relaxed);
+  while (top < value && !max_.compare_exchange_weak(top, value, memory_order_relaxed))
+    ;
+}
+
+Summary Histogram::summary() const
+{
+  auto counts = array<uint64_t, SIZE>{};
+  transform(cbegin(buckets_), cend(buckets_), begin(counts),
+            [](auto&& bucket) { return bucket.load(memory_order_relaxed); });
+  auto count = accumulate(cbegin(counts), cend(counts), uint64_t{0});
+  auto top = max_.load(memory_order_relaxed);
+  if (count == 0) return {};
+
+  // The upper bound of the bucket containing the percentile, which never exceeds the maximum
+  auto percentile = [&counts, count, top](uint64_t permille) {
+    auto rank = max<uint64_t>((count * permille + 999) / 1000, 1);
+    auto seen = uint64_t{0};
+    for (auto i = size_t{0}; i < SIZE; ++i) {
+      seen += counts[i];
+      if (seen >= rank) return min(upper(i), top);
+    }
+    return top;
+  };
+  auto mean = sum_.load(memory_order_relaxed) / count;
+  return {count, mean, top, percentile(500), percentile(900), percentile(990), percentile(999)};
+}
+
+void Histogram::reset()
+{
+  for (auto& bucket : buckets_) bucket.store(0, memory_order_relaxed);
+  sum_.store(0, memory_order_relaxed);
+  max_.store(0, memory_order_relaxed);
+}
+
+static array<Histogram, static_cast<size_t>(Stage::COUNT)> stages_;
+
+static mutex mutex_;
+static map<string, Histogram, less<>> connectings_;
+
+Histogram& histogram(Stage stage) { return stages_[static_cast<size_t>(stage)]; }
+
+Histogram& connecting(string_view egress)
+{
+  auto lock = unique_lock<mutex>{mutex_};
+  auto it = connectings_.find(egress);
+  if (it == cend(connectings_)) it = connectings_.try_emplace(string{egress}).first;
+  return it->second;
+}
+
+vector<pair<string, Summary>> connectings()
+{
+  auto lock = unique_lock<mutex>{mutex_};
+  auto ret = vector<pair<string, Summary>>{};
+  ret.reserve(connectings_.size());
+  for (auto&& [egress, histogram] : connectings_) ret.emplace_back(egress, histogram.summary());
+  return ret;
+}
+
+void resetHistograms()
+{
+  for (auto& histogram : stages_) histogram.reset();
+  auto lock = unique_lock<mutex>{mutex_};
+  for (auto&& item : connectings_) item.second.reset();
+}
+
+} // namespace pichi::stats
@@ -0,0 +1,177 @@
+#define BOOST_TEST_MODULE pichi admission test
+
+#include "utils.hpp"
+#include <boost/asio/io_context.hpp>
+#include <boost/test/unit_test.hpp>
+#include <pichi/api/admission.hpp>
+#include <pichi/net/adapter.hpp>
+
+using namespace std;
+using namespace pichi;
+using namespace pichi::api;
+using Clock = Admission::Clock;
+namespace asio = boost::asio;
+
+struct FakeAdapter : public net::Adapter {
+  size_t recv(MutableBuffer<uint8_t>, Yield) override { fail(); }
+  void send(ConstBuffer<uint8_t>, Yield) override { fail(); }
+  void close() override { closed_ = true; }
+  bool readable() const override { return !closed_; }
+  bool writable() const override { return !closed_; }
+
+  bool closed_ = false;
+};
+
+static auto makeAdmission(optional<uint32_t> sessions, optional<uint32_t> handshakes = {},
+                          optional<uint32_t> rate = {})
+{
+  return make_shared<Admission>(AdmissionVO{sessions, handshakes, rate});
+}
+
+BOOST_AUTO_TEST_SUITE(ADMISSION)
+
+BOOST_AUTO_TEST_CASE(admit_Unlimited)
+{
+  auto ingress = make_shared<Admission>();
+  auto global = make_shared<Admission>();
+  auto tickets = vector<Admission::Ticket>{};
+  for (auto i = 0; i < 1024; ++i) {
+    auto ticket = Admission::admit(ingress, global);
+    BOOST_REQUIRE(ticket.has_value());
+    tickets.push_back(move(*ticket));
+  }
+  BOOST_CHECK_EQUAL(ingress->sessions(), 1024);
+  BOOST_CHECK_EQUAL(global->handshakes(), 1024);
+
+  tickets.clear();
+  BOOST_CHECK_EQUAL(ingress->sessions(), 0);
+  BOOST_CHECK_EQUAL(global->sessions(), 0);
+  BOOST_CHECK_EQUAL(global->handshakes(), 0);
+}
+
+BOOST_AUTO_TEST_CASE(admit_Sessions)
+{
+  auto ingress = makeAdmission(2);
+  auto global = make_shared<Admission>();
+  auto first = Admission::admit(ingress, global);
+  auto second = Admission::admit(ingress, global);
+  BOOST_CHECK(first.has_value());
+  BOOST_CHECK(second.has_value());
+  BOOST_CHECK(!Admission::admit(ingress, global).has_value());
+
+  // Still a session after the handshake
+  second->handshaken();
+  BOOST_CHECK(!Admission::admit(ingress, global).has_value());
+  second.reset();
+  BOOST_CHECK(Admission::admit(ingress, global).has_value());
+}
+
+BOOST_AUTO_TEST_CASE(admit_Handshakes)
+{
+  auto ingress = make_shared<Admission>();
+  auto global = makeAdmission({}, 1);
+  auto ticket = Admission::admit(ingress, global);
+  BOOST_CHECK(ticket.has_value());
+  BOOST_CHECK(!Admission::admit(ingress, global).has_value());
+
+  ticket->handshaken();
+  ticket->handshaken();
+  BOOST_CHECK_EQUAL(global->handshakes(), 0);
+  BOOST_CHECK_EQUAL(global->sessions(), 1);
+  BOOST_CHECK(Admission::admit(ingress, global).has_value());
+}
+
+BOOST_AUTO_TEST_CASE(admit_Rate)
+{
+  auto ingress = makeAdmission({}, {}, 4);
+  auto global = makeAdmission({}, {}, 2);
+  auto now = Clock::now();
+
+  // Bursting up to the tokens of one second, the shed ones take no token
+  BOOST_CHECK(Admission::admit(ingress, global, now).has_value());
+  BOOST_CHECK(Admission::admit(ingress, global, now).has_value());
+  BOOST_CHECK(!Admission::admit(ingress, global, now).has_value());
+
+  global->configure({});
+  BOOST_CHECK(Admission::admit(ingress, global, now).has_value());
+  BOOST_CHECK(Admission::admit(ingress, global, now).has_value());
+  BOOST_CHECK(!Admission::admit(ingress, global, now).has_value());
+
+  // Refilled by the rate, 4 per second here
+  BOOST_CHECK(!Admission::admit(ingress, global, now + 200ms).has_value());
+  BOOST_CHECK(Admission::admit(ingress, global, now + 300ms).has_value());
+  BOOST_CHECK(!Admission::admit(ingress, global, now + 300ms).has_value());
+  for (auto i = 0; i < 4; ++i)
+    BOOST_CHECK(Admission::admit(ingress, global, now + 10s).has_value());
+  BOOST_CHECK(!Admission::admit(ingress, global, now + 10s).has_value());
+}
+
+BOOST_AUTO_TEST_CASE(Ticket_Move)
+{
+  auto ingress = makeAdmission(1);
+  auto global = make_shared<Admission>();
+  auto ticket = Admission::admit(ingress, global);
+  BOOST_REQUIRE(ticket.has_value());
+
+  auto moved = move(*ticket);
+  ticket.reset();
+  BOOST_CHECK_EQUAL(ingress->sessions(), 1);
+  BOOST_CHECK_EQUAL(global->handshakes(), 1);
+
+  moved = Admission::Ticket{make_shared<Admission>(), global};
+  BOOST_CHECK_EQUAL(ingress->sessions(), 0);
+  BOOST_CHECK_EQUAL(global->sessions(), 1);
+}
+
+BOOST_AUTO_TEST_CASE(configure_Limits)
+{
+  auto admission = make_shared<Admission>();
+  admission->configure(AdmissionVO{8, {}, 16});
+  BOOST_CHECK(admission->limits().sessions_ == 8u);
+  BOOST_CHECK(!admission->limits().handshakes_.has_value());
+  BOOST_CHECK(admission->limits().rate_ == 16u);
+}
+
+BOOST_AUTO_TEST_CASE(drain_Idle)
+{
+  auto io = asio::io_context{};
+  auto admission = make_shared<Admission>();
+  auto ticket = Admission::admit(admission, make_shared<Admission>());
+  BOOST_REQUIRE(ticket.has_value());
+
+  auto drained = false;
+  admission->drain(io, 1h, [&drained]() { drained = true; });
+  BOOST_CHECK(admission->draining());
+  io.poll();
+  BOOST_CHECK(!drained);
+
+  // Done once the last session ends, long before the deadline
+  ticket.reset();
+  io.run();
+  BOOST_CHECK(drained);
+}
+
+BOOST_AUTO_TEST_CASE(drain_Deadline)
+{
+  auto io = asio::io_context{};
+  auto admission = make_shared<Admission>();
+  auto held = FakeAdapter{};
+  auto released = FakeAdapter{};
+  auto first = Admission::admit(admission, make_shared<Admission>());
+  auto second = Admission::admit(admission, make_shared<Admission>());
+  BOOST_REQUIRE(first.has_value() && second.has_value());
+  first->hold(&held);
+  second->hold(&released);
+  second.reset();
+
+  auto drained = 0;
+  admission->drain(io, 0s, [&drained]() { ++drained; });
+  // Drained only once
+  admission->drain(io, 0s, [&drained]() { ++drained; });
+  io.run();
+  BOOST_CHECK_EQUAL(drained, 1);
+  BOOST_CHECK(held.closed_);
+  BOOST_CHECK(!released.closed_);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,179 @@
+#define BOOST_TEST_MODULE pichi egress_group test
+
+#include "utils.hpp"
+#include <boost/asio/io_context.hpp>
+#include <boost/test/unit_test.hpp>
+#include <map>
+#include <pichi/api/egress_group.hpp>
+#include <pichi/api/egress_manager.hpp>
+#include <pichi/net/adapter.hpp>
+#include <pichi/net/asio.hpp>
+#include <pichi/net/helpers.hpp>
+
+using namespace std;
+using namespace pichi;
+using namespace pichi::api;
+namespace asio = boost::asio;
+
+static auto makeMembers(size_t n)
+{
+  auto members = vector<EgressGroup::Member>{};
+  for (auto i = size_t{0}; i < n; ++i)
+    members.push_back({to_string(i), make_shared<EgressLoad>()});
+  return members;
+}
+
+static auto makeRemote(string const& host) { return net::makeEndpoint(host, 443); }
+
+static auto makeGroupVO(vector<string> members, Balance balance = Balance::ROUND_ROBIN)
+{
+  auto vo = EgressVO{AdapterType::GROUP};
+  vo.members_ = move(members);
+  vo.balance_ = balance;
+  return vo;
+}
+
+BOOST_AUTO_TEST_SUITE(EGRESS_GROUP)
+
+BOOST_AUTO_TEST_CASE(EgressLoad_record)
+{
+  auto load = EgressLoad{};
+  load.record(8ms);
+  BOOST_CHECK_EQUAL(load.latency_, 8000.0);
+  load.record(16ms);
+  BOOST_CHECK_EQUAL(load.latency_, 9000.0);
+
+  load = EgressLoad{};
+  load.record(1ms, true);
+  BOOST_CHECK_EQUAL(load.latency_, 1000000.0);
+}
+
+BOOST_AUTO_TEST_CASE(EgressGroup_Round_Robin)
+{
+  auto group = EgressGroup{makeMembers(3), Balance::ROUND_ROBIN};
+  for (auto i = 0; i < 6; ++i) BOOST_CHECK_EQUAL(group.pick(makeRemote(ph)), to_string(i % 3));
+}
+
+BOOST_AUTO_TEST_CASE(EgressGroup_Least_Sessions)
+{
+  auto members = makeMembers(3);
+  members[0].load_->sessions_ = 2;
+  members[1].load_->sessions_ = 1;
+  members[2].load_->sessions_ = 2;
+  auto group = EgressGroup{members, Balance::LEAST_SESSIONS};
+  BOOST_CHECK_EQUAL(group.pick(makeRemote(ph)), "1");
+
+  // Ties are broken in turn
+  members[1].load_->sessions_ = 2;
+  auto picked = map<string_view, size_t>{};
+  for (auto i = 0; i < 3; ++i) ++picked[group.pick(makeRemote(ph))];
+  BOOST_CHECK_EQUAL(picked.size(), 3);
+}
+
+BOOST_AUTO_TEST_CASE(EgressGroup_Latency)
+{
+  auto members = makeMembers(2);
+  members[0].load_->latency_ = 1000.0;
+  members[1].load_->latency_ = 3000.0;
+  auto group = EgressGroup{members, Balance::LATENCY};
+  BOOST_CHECK_EQUAL(group.pick(makeRemote(ph)), "0");
+  BOOST_CHECK_EQUAL(group.pick(makeRemote(ph)), "0");
+
+  // The faster one is avoided once it's loaded enough
+  members[0].load_->sessions_ = 3;
+  BOOST_CHECK_EQUAL(group.pick(makeRemote(ph)), "1");
+
+  // Not connected yet, then tried first
+  members.push_back({"2", make_shared<EgressLoad>()});
+  group = EgressGroup{members, Balance::LATENCY};
+  BOOST_CHECK_EQUAL(group.pick(makeRemote(ph)), "2");
+}
+
+BOOST_AUTO_TEST_CASE(EgressGroup_Hash)
+{
+  auto group = EgressGroup{makeMembers(4), Balance::HASH};
+  auto picked = map<string, string>{};
+  for (auto i = 0; i < 64; ++i) {
+    auto host = "host" + to_string(i);
+    picked[host] = string{group.pick(makeRemote(host))};
+    BOOST_CHECK_EQUAL(group.pick(makeRemote(host)), picked[host]);
+  }
+
+  // Only the hosts of the member removed are moved
+  auto members = makeMembers(4);
+  members.pop_back();
+  group = EgressGroup{members, Balance::HASH};
+  for (auto&& [host, name] : picked)
+    if (name != "3") BOOST_CHECK_EQUAL(group.pick(makeRemote(host)), name);
+}
+
+BOOST_AUTO_TEST_CASE(EgressGroup_Available)
+{
+  auto up = [](auto name) { return name != "1"; };
+  for (auto balance : {Balance::ROUND_ROBIN, Balance::LEAST_SESSIONS, Balance::HASH}) {
+    auto group = EgressGroup{makeMembers(3), balance};
+    for (auto i = 0; i < 32; ++i) BOOST_CHECK_NE(group.pick(makeRemote(to_string(i)), up), "1");
+  }
+
+  // Still picked in turn if all are down
+  auto group = EgressGroup{makeMembers(3), Balance::ROUND_ROBIN};
+  for (auto i = 0; i < 6; ++i)
+    BOOST_CHECK_EQUAL(group.pick(makeRemote(ph), [](auto) { return false; }), to_string(i % 3));
+}
+
+BOOST_AUTO_TEST_CASE(track_Sessions)
+{
+  auto io = asio::io_context{};
+  auto load = make_shared<EgressLoad>();
+  auto first = track(net::makeEgress(defaultEgressVO(AdapterType::DIRECT), io), load);
+  auto second = track(net::makeEgress(defaultEgressVO(AdapterType::DIRECT), io), load);
+  BOOST_CHECK_EQUAL(load->sessions_, 2);
+  first.reset();
+  BOOST_CHECK_EQUAL(load->sessions_, 1);
+  second.reset();
+  BOOST_CHECK_EQUAL(load->sessions_, 0);
+}
+
+BOOST_AUTO_TEST_CASE(EgressManager_Group)
+{
+  auto io = asio::io_context{};
+  auto manager = EgressManager{io};
+  manager.update("reject", defaultEgressVO(AdapterType::REJECT));
+  manager.update("group", makeGroupVO({"direct", "reject"}));
+
+  BOOST_CHECK(manager.isUsed("direct"));
+  BOOST_CHECK(manager.isUsed("reject"));
+  BOOST_CHECK(!manager.isUsed("group"));
+  BOOST_CHECK_EQUAL(manager.pick("group", makeRemote(ph)), "direct");
+  BOOST_CHECK_EQUAL(manager.pick("group", makeRemote(ph)), "reject");
+  BOOST_CHECK_EQUAL(manager.pick("direct", makeRemote(ph)), "direct");
+
+  BOOST_CHECK_EXCEPTION(manager.erase("reject"), Exception,
+                        verifyException<PichiError::RES_IN_USE>);
+  manager.erase("group");
+  BOOST_CHECK(!manager.isUsed("reject"));
+  manager.erase("reject");
+  BOOST_CHECK(manager.find("reject") == manager.end());
+}
+
+BOOST_AUTO_TEST_CASE(EgressManager_Group_Invalid)
+{
+  auto io = asio::io_context{};
+  auto manager = EgressManager{io};
+  BOOST_CHECK_EXCEPTION(manager.update("group", makeGroupVO({ph})), Exception,
+                        verifyException<PichiError::SEMANTIC_ERROR>);
+
+  manager.update("group", makeGroupVO({"direct"}));
+  BOOST_CHECK_EXCEPTION(manager.update("nested", makeGroupVO({"group"})), Exception,
+                        verifyException<PichiError::SEMANTIC_ERROR>);
+  BOOST_CHECK_EXCEPTION(manager.update("direct", makeGroupVO({"group"})), Exception,
+                        verifyException<PichiError::SEMANTIC_ERROR>);
+
+  manager.update(ph, defaultEgressVO(AdapterType::DIRECT));
+  BOOST_CHECK_EXCEPTION(manager.update(ph, makeGroupVO({ph})), Exception,
+                        verifyException<PichiError::SEMANTIC_ERROR>);
+  BOOST_CHECK(manager.find("nested") == manager.end());
+  BOOST_CHECK(manager.find(ph)->second.type_ == AdapterType::DIRECT);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,88 @@
+#define BOOST_TEST_MODULE pichi egress_health test
+
+#include "utils.hpp"
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/ip/tcp.hpp>
+#include <boost/test/unit_test.hpp>
+#include <pichi/api/egress_health.hpp>
+#include <pichi/api/egress_manager.hpp>
+#include <pichi/net/asio.hpp>
+
+using namespace std;
+using namespace pichi;
+using namespace pichi::api;
+namespace asio = boost::asio;
+using asio::ip::tcp;
+
+// A port of loopback refusing to connect, which fails the probes at once
+static uint16_t refusedPort(asio::io_context& io)
+{
+  auto acceptor = tcp::acceptor{io, {asio::ip::make_address("127.0.0.1"), 0}};
+  return acceptor.local_endpoint().port();
+}
+
+static auto makeCheckedVO(uint16_t port, optional<string> fallback = {})
+{
+  auto vo = defaultEgressVO(AdapterType::HTTP);
+  vo.host_ = "127.0.0.1";
+  vo.port_ = port;
+  vo.health_ = HealthCheckVO{1, 1, 1, 1, move(fallback)};
+  return vo;
+}
+
+template <typename Predicate> static bool runUntil(asio::io_context& io, Predicate&& done)
+{
+  for (auto i = 0; i < 100 && !done(); ++i) io.run_for(50ms);
+  return done();
+}
+
+BOOST_AUTO_TEST_SUITE(EGRESS_HEALTH)
+
+BOOST_AUTO_TEST_CASE(EgressHealth_Down)
+{
+  auto io = asio::io_context{};
+  auto checker = make_shared<EgressHealth>(io, ph, makeCheckedVO(refusedPort(io)));
+  BOOST_CHECK(checker->up());
+
+  checker->start();
+  BOOST_CHECK(runUntil(io, [&]() { return !checker->up(); }));
+  BOOST_CHECK_GE(checker->status().probes_, 1);
+  BOOST_CHECK_EQUAL(checker->status().probes_, checker->status().failures_);
+
+  checker->stop();
+  io.run_for(50ms);
+}
+
+BOOST_AUTO_TEST_CASE(EgressManager_Fallback)
+{
+  auto io = asio::io_context{};
+  auto manager = EgressManager{io};
+  manager.update("proxy", makeCheckedVO(refusedPort(io), "direct"));
+  BOOST_CHECK(manager.isUsed("direct"));
+  BOOST_CHECK(!manager.isUsed("proxy"));
+  BOOST_CHECK_EQUAL(manager.health().size(), 1);
+  BOOST_CHECK_EQUAL(manager.pick("proxy", {{}, ph, "443"}), "proxy");
+
+  BOOST_CHECK(runUntil(io, [&]() { return !manager.isUp("proxy"); }));
+  BOOST_CHECK(!manager.health()["proxy"].up_);
+  BOOST_CHECK_EQUAL(manager.pick("proxy", {{}, ph, "443"}), "direct");
+
+  BOOST_CHECK_EXCEPTION(manager.erase("direct"), Exception,
+                        verifyException<PichiError::RES_IN_USE>);
+  manager.erase("proxy");
+  BOOST_CHECK(!manager.isUsed("direct"));
+  BOOST_CHECK(manager.health().empty());
+}
+
+BOOST_AUTO_TEST_CASE(EgressManager_Fallback_Invalid)
+{
+  auto io = asio::io_context{};
+  auto manager = EgressManager{io};
+  BOOST_CHECK_EXCEPTION(manager.update("proxy", makeCheckedVO(1, ph)), Exception,
+                        verifyException<PichiError::SEMANTIC_ERROR>);
+  BOOST_CHECK_EXCEPTION(manager.update("proxy", makeCheckedVO(1, "proxy")), Exception,
+                        verifyException<PichiError::SEMANTIC_ERROR>);
+  BOOST_CHECK(manager.find("proxy") == manager.end());
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -18,6 +18,7 @@ namespace sys = boost::system;
 using EndpointType = net::Endpoint::Type;
 using net::makeEndpoint;
 using net::parseEndpoint;
+using net::readEndpoint;
 using net::serializeEndpoint;
 
 class StubSocket {
@@ -42,13 +43,16 @@ public:
     copy_n(asio::buffers_begin(buffer_.data()), buf.size(), begin(buf));
     buffer_.consume(buf.size());
     transfered_ += buf.size();
+    ++reads_;
   }
 
   size_t transfered() const { return transfered_; }
+  size_t reads() const { return reads_; }
 
 private:
   beast::flat_static_buffer<1024> buffer_;
   size_t transfered_ = 0;
+  size_t reads_ = 0;
 };
 
 BOOST_AUTO_TEST_SUITE(ENDPOINT)
@@ -56,29 +60,25 @@ BOOST_AUTO_TEST_SUITE(ENDPOINT)
 BOOST_AUTO_TEST_CASE(serialize_Empty_Host)
 {
   auto buf = array<uint8_t, 64>{};
-  BOOST_CHECK_EXCEPTION(serializeEndpoint({EndpointType::DOMAIN_NAME, ""s, "1"s}, buf), Exception,
-                        verifyException<PichiError::MISC>);
-  BOOST_CHECK_EXCEPTION(serializeEndpoint({EndpointType::IPV4, ""s, "1"s}, buf), Exception,
-                        verifyException<PichiError::MISC>);
-  BOOST_CHECK_EXCEPTION(serializeEndpoint({EndpointType::IPV6, ""s, "1"s}, buf), Exception,
-                        verifyException<PichiError::MISC>);
+  for (auto type : {EndpointType::DOMAIN_NAME, EndpointType::IPV4, EndpointType::IPV6}) {
+    auto endpoint = net::Endpoint{type, 0, 1};
+    BOOST_CHECK_EXCEPTION(serializeEndpoint(endpoint, buf), Exception,
+                          verifyException<PichiError::MISC>);
+  }
 }
 
-BOOST_AUTO_TEST_CASE(serialize_Empty_Port)
+BOOST_AUTO_TEST_CASE(makeEndpoint_Empty_Port)
 {
-  auto buf = array<uint8_t, 64>{};
   for (auto host : {"localhost"sv, "127.0.0.1"sv, "::1"sv}) {
-    BOOST_CHECK_EXCEPTION(serializeEndpoint(makeEndpoint(host, ""sv), buf), Exception,
-                          verifyException<PichiError::MISC>);
+    BOOST_CHECK_EXCEPTION(makeEndpoint(host, ""sv), Exception, verifyException<PichiError::MISC>);
   }
 }
 
-BOOST_AUTO_TEST_CASE(serialize_Alphabetic_Port)
+BOOST_AUTO_TEST_CASE(makeEndpoint_Alphabetic_Port)
 {
-  auto buf = array<uint8_t, 64>{};
   for (auto host : {"localhost"sv, "127.0.0.1"sv, "::1"sv}) {
-    BOOST_CHECK_EXCEPTION(serializeEndpoint(makeEndpoint(host, "http"sv), buf), invalid_argument,
-                          [](auto&&) { return true; });
+    BOOST_CHECK_EXCEPTION(makeEndpoint(host, "http"sv), Exception,
+                          verifyException<PichiError::MISC>);
   }
 }
 
@@ -88,7 +88,7 @@ BOOST_AUTO_TEST_CASE(serialize_Port_Out_Of_Range)
   for (auto host : {"localhost"sv, "127.0.0.1"sv, "::1"sv}) {
     BOOST_CHECK_EXCEPTION(serializeEndpoint(makeEndpoint(host, 0), buf), Exception,
                           verifyException<PichiError::MISC>);
-    BOOST_CHECK_EXCEPTION(serializeEndpoint(makeEndpoint(host, "65536"sv), buf), Exception,
+    BOOST_CHECK_EXCEPTION(makeEndpoint(host, "65536"sv), Exception,
                           verifyException<PichiError::MISC>);
   }
 }
@@ -98,17 +98,17 @@ BOOST_AUTO_TEST_CASE(serialize_Invalid_IP_Address)
   auto buf = array<uint8_t, 64>{};
 
   for (auto type : {EndpointType::IPV4, EndpointType::IPV6}) {
-    BOOST_CHECK_EXCEPTION(serializeEndpoint({type, "localhost"s, "1"s}, buf), sys::system_error,
-                          verifyException<asio::error::invalid_argument>);
+    auto endpoint = makeEndpoint("localhost"sv, 1);
+    endpoint.type_ = type;
+    BOOST_CHECK_EXCEPTION(serializeEndpoint(endpoint, buf), Exception,
+                          verifyException<PichiError::MISC>);
   }
 }
 
-BOOST_AUTO_TEST_CASE(serialize_Domain_Name_Too_Long)
+BOOST_AUTO_TEST_CASE(makeEndpoint_Domain_Name_Too_Long)
 {
-  auto buf = array<uint8_t, 1024>{};
-  BOOST_CHECK_EXCEPTION(
-      serializeEndpoint({EndpointType::DOMAIN_NAME, string(0x100, 'a'), "1"s}, buf), Exception,
-      verifyException<PichiError::MISC>);
+  BOOST_CHECK_EXCEPTION(makeEndpoint(string(0x100, 'a'), 1), Exception,
+                        verifyException<PichiError::MISC>);
 }
 
 BOOST_AUTO_TEST_CASE(serialize_Domain_Lack_Of_Buffer)
@@ -188,57 +188,100 @@ BOOST_AUTO_TEST_CASE(parse_Invalid_Type)
 {
   for (auto i = 0; i < 0x100; ++i) {
     if (i == 0x01 || i == 0x03 || i == 0x04) continue;
-    auto t = static_cast<uint8_t>(i);
-    auto stub = StubSocket{};
-    stub.write(t);
-    BOOST_CHECK_EXCEPTION(parseEndpoint([&stub](auto buf) { stub.read(buf); }), Exception,
-                          verifyException<PichiError::BAD_PROTO>);
+    auto buf = array<uint8_t, 2>{static_cast<uint8_t>(i), 0x01};
+    BOOST_CHECK_EXCEPTION(parseEndpoint(buf), Exception, verifyException<PichiError::BAD_PROTO>);
   }
 }
 
 BOOST_AUTO_TEST_CASE(parse_Empty_Domain)
 {
-  auto stub = StubSocket{};
-  stub.write({0x03, 0x00, 0x01, 0xbb});
-  BOOST_CHECK_EXCEPTION(parseEndpoint([&stub](auto buf) { stub.read(buf); }), Exception,
-                        verifyException<PichiError::BAD_PROTO>);
+  auto buf = array<uint8_t, 4>{0x03, 0x00, 0x01, 0xbb};
+  BOOST_CHECK_EXCEPTION(parseEndpoint(buf), Exception, verifyException<PichiError::BAD_PROTO>);
 }
 
-BOOST_AUTO_TEST_CASE(parse_Domain)
+BOOST_AUTO_TEST_CASE(parse_Truncated)
+{
+  auto domain = array<uint8_t, 12>{0x03, 0x09, 'l', 'o', 'c', 'a', 'l', 'h', 'o', 's', 't', 0x01};
+  BOOST_CHECK_EXCEPTION(parseEndpoint(domain), Exception, verifyException<PichiError::BAD_PROTO>);
+  auto ipv4 = array<uint8_t, 6>{0x01, 0x00, 0x00, 0x00, 0x00, 0x01};
+  BOOST_CHECK_EXCEPTION(parseEndpoint(ipv4), Exception, verifyException<PichiError::BAD_PROTO>);
+  auto head = array<uint8_t, 1>{0x04};
+  BOOST_CHECK_EXCEPTION(parseEndpoint(head), Exception, verifyException<PichiError::BAD_PROTO>);
+}
+
+BOOST_AUTO_TEST_CASE(parse_Following_Bytes_Left)
+{
+  auto buf = array<uint8_t, 9>{0x01, 0x7f, 0x00, 0x00, 0x01, 0x01, 0xbb, 0xde, 0xad};
+  auto [ep, len] = parseEndpoint(buf);
+  BOOST_CHECK(makeEndpoint("127.0.0.1"sv, 443) == ep);
+  BOOST_CHECK_EQUAL(7, len);
+}
+
+BOOST_AUTO_TEST_CASE(read_Domain)
 {
   auto stub = StubSocket{};
   stub.write({0x03, 0x09, 'l', 'o', 'c', 'a', 'l', 'h', 'o', 's', 't', 0x01, 0xbb});
 
-  auto ep = parseEndpoint([&stub](auto buf) { stub.read(buf); });
+  auto buf = array<uint8_t, net::MAX_ADDRESS_SIZE>{};
+  auto [ep, len] = readEndpoint(buf, 0, [&stub](auto dst) { stub.read(dst); });
   BOOST_CHECK(EndpointType::DOMAIN_NAME == ep.type_);
-  BOOST_CHECK_EQUAL("localhost"sv, ep.host_);
-  BOOST_CHECK_EQUAL("443"sv, ep.port_);
+  BOOST_CHECK_EQUAL("localhost"sv, ep.domain());
+  BOOST_CHECK_EQUAL(443, ep.port_);
+  BOOST_CHECK_EQUAL(13, len);
   BOOST_CHECK_EQUAL(13, stub.transfered());
+  BOOST_CHECK_EQUAL(2, stub.reads());
 }
 
-BOOST_AUTO_TEST_CASE(parse_IPv4)
+BOOST_AUTO_TEST_CASE(read_IPv4)
 {
   auto stub = StubSocket{};
   stub.write({0x01, 0x00, 0x00, 0x00, 0x00, 0x01, 0xbb});
 
-  auto ep = parseEndpoint([&stub](auto buf) { stub.read(buf); });
+  auto buf = array<uint8_t, net::MAX_ADDRESS_SIZE>{};
+  auto [ep, len] = readEndpoint(buf, 0, [&stub](auto dst) { stub.read(dst); });
   BOOST_CHECK(EndpointType::IPV4 == ep.type_);
-  BOOST_CHECK_EQUAL("0.0.0.0"sv, ep.host_);
-  BOOST_CHECK_EQUAL("443"sv, ep.port_);
+  BOOST_CHECK_EQUAL("0.0.0.0"sv, net::formatHost(ep));
+  BOOST_CHECK_EQUAL(443, ep.port_);
+  BOOST_CHECK_EQUAL(7, len);
   BOOST_CHECK_EQUAL(7, stub.transfered());
+  BOOST_CHECK_EQUAL(2, stub.reads());
 }
 
-BOOST_AUTO_TEST_CASE(parse_IPv6)
+BOOST_AUTO_TEST_CASE(read_IPv6)
 {
   auto stub = StubSocket{};
   stub.write({0x04, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
               0x00, 0x00, 0x00, 0x01, 0xbb});
 
-  auto ep = parseEndpoint([&stub](auto buf) { stub.read(buf); });
+  auto buf = array<uint8_t, net::MAX_ADDRESS_SIZE>{};
+  auto [ep, len] = readEndpoint(buf, 0, [&stub](auto dst) { stub.read(dst); });
   BOOST_CHECK(EndpointType::IPV6 == ep.type_);
-  BOOST_CHECK_EQUAL("::"sv, ep.host_);
-  BOOST_CHECK_EQUAL("443"sv, ep.port_);
+  BOOST_CHECK_EQUAL("::"sv, net::formatHost(ep));
+  BOOST_CHECK_EQUAL(443, ep.port_);
+  BOOST_CHECK_EQUAL(19, len);
   BOOST_CHECK_EQUAL(19, stub.transfered());
+  BOOST_CHECK_EQUAL(2, stub.reads());
+}
+
+BOOST_AUTO_TEST_CASE(read_Rest_Of_Received)
+{
+  auto stub = StubSocket{};
+  stub.write({0x00, 0x01, 0xbb});
+
+  auto buf = array<uint8_t, net::MAX_ADDRESS_SIZE>{0x01, 0x7f, 0x00, 0x00};
+  auto [ep, len] = readEndpoint(buf, 4, [&stub](auto dst) { stub.read(dst); });
+  BOOST_CHECK(makeEndpoint("127.0.0.0"sv, 443) == ep);
+  BOOST_CHECK_EQUAL(7, len);
+  BOOST_CHECK_EQUAL(3, stub.transfered());
+  BOOST_CHECK_EQUAL(1, stub.reads());
+}
+
+BOOST_AUTO_TEST_CASE(read_Nothing_If_Received)
+{
+  auto buf = array<uint8_t, net::MAX_ADDRESS_SIZE>{0x01, 0x7f, 0x00, 0x00, 0x01, 0x01, 0xbb, 0xff};
+  auto [ep, len] = readEndpoint(buf, 8, [](auto) { BOOST_ERROR("Unexpected reading"); });
+  BOOST_CHECK(makeEndpoint("127.0.0.1"sv, 443) == ep);
+  BOOST_CHECK_EQUAL(7, len);
 }
 
 BOOST_AUTO_TEST_SUITE_END()
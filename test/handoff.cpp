@@ -0,0 +1,207 @@
+#define BOOST_TEST_MODULE pichi handoff test
+
+#include "utils.hpp"
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/ip/tcp.hpp>
+#include <boost/test/unit_test.hpp>
+#include <cstring>
+#include <fcntl.h>
+#include <pichi/api/ingress_manager.hpp>
+#include <pichi/net/handoff.hpp>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <vector>
+
+using namespace std;
+using namespace pichi;
+using namespace pichi::api;
+namespace asio = boost::asio;
+namespace ip = asio::ip;
+using ip::tcp;
+
+static auto const LOOPBACK = tcp::endpoint{ip::make_address("127.0.0.1"), 0};
+
+struct SocketPair {
+  SocketPair() { BOOST_REQUIRE(socketpair(AF_UNIX, SOCK_STREAM, 0, fds_) == 0); }
+  ~SocketPair()
+  {
+    close(fds_[0]);
+    close(fds_[1]);
+  }
+
+  int fds_[2];
+};
+
+// Handing the listener over as the old process, which closes its own then
+static uint16_t handOver(asio::io_context& io)
+{
+  auto old = tcp::acceptor{io, LOOPBACK};
+  auto port = old.local_endpoint().port();
+  auto pair = SocketPair{};
+  net::sendListeners(pair.fds_[0], {{net::listenerKey(old.local_endpoint()), old.native_handle()}});
+  net::inherit(net::recvListeners(pair.fds_[1]));
+  return port;
+}
+
+// Sending a record of the key with all descriptors attached to its first byte
+static void sendRecord(int socket, string_view key, vector<int> const& fds)
+{
+  auto record = array<char, 0x100>{};
+  record[0] = static_cast<char>(key.size());
+  copy(cbegin(key), cend(key), begin(record) + 1);
+  auto control = vector<char>(CMSG_SPACE(sizeof(int) * fds.size()));
+  auto iov = iovec{record.data(), record.size()};
+  auto msg = msghdr{};
+  msg.msg_iov = &iov;
+  msg.msg_iovlen = 1;
+  msg.msg_control = control.data();
+  msg.msg_controllen = control.size();
+  auto cmsg = CMSG_FIRSTHDR(&msg);
+  cmsg->cmsg_level = SOL_SOCKET;
+  cmsg->cmsg_type = SCM_RIGHTS;
+  cmsg->cmsg_len = CMSG_LEN(sizeof(int) * fds.size());
+  memcpy(CMSG_DATA(cmsg), fds.data(), sizeof(int) * fds.size());
+  BOOST_REQUIRE(sendmsg(socket, &msg, 0) == static_cast<ssize_t>(record.size()));
+}
+
+static size_t countDescriptors()
+{
+  auto ret = size_t{0};
+  for (auto fd = 0; fd < 1024; ++fd)
+    if (fcntl(fd, F_GETFD) != -1) ++ret;
+  return ret;
+}
+
+static auto makeIngressVO(uint16_t port)
+{
+  auto vo = defaultIngressVO(AdapterType::SOCKS5);
+  vo.bind_ = "127.0.0.1";
+  vo.port_ = port;
+  return vo;
+}
+
+BOOST_AUTO_TEST_SUITE(HANDOFF)
+
+BOOST_AUTO_TEST_CASE(listenerKey_Endpoint)
+{
+  BOOST_CHECK_EQUAL(net::listenerKey(tcp::endpoint{ip::make_address("::1"), 8080}), "tcp ::1 8080");
+  BOOST_CHECK_EQUAL(net::listenerKey(ip::udp::endpoint{ip::make_address("0.0.0.0"), 53}),
+                    "udp 0.0.0.0 53");
+}
+
+BOOST_AUTO_TEST_CASE(recvListeners_Empty)
+{
+  auto pair = SocketPair{};
+  net::sendListeners(pair.fds_[0], {});
+  BOOST_CHECK(net::recvListeners(pair.fds_[1]).empty());
+}
+
+BOOST_AUTO_TEST_CASE(recvListeners_Interrupted)
+{
+  auto pair = SocketPair{};
+  shutdown(pair.fds_[0], SHUT_WR);
+  BOOST_CHECK_EXCEPTION(net::recvListeners(pair.fds_[1]), Exception,
+                        verifyException<PichiError::CONN_FAILURE>);
+}
+
+BOOST_AUTO_TEST_CASE(recvListeners_Several_Descriptors)
+{
+  auto pair = SocketPair{};
+  auto fds = vector<int>{dup(STDIN_FILENO), dup(STDIN_FILENO)};
+  auto descriptors = countDescriptors();
+  sendRecord(pair.fds_[0], ph, fds);
+  for (auto fd : fds) close(fd);
+  net::sendListeners(pair.fds_[0], {});
+
+  auto listeners = net::recvListeners(pair.fds_[1]);
+  BOOST_REQUIRE_EQUAL(listeners.size(), 1);
+  BOOST_CHECK_EQUAL(listeners.front().key_, ph);
+  close(listeners.front().fd_);
+  BOOST_CHECK_EQUAL(countDescriptors(), descriptors - fds.size());
+}
+
+BOOST_AUTO_TEST_CASE(recvListeners_Descriptors_Truncated)
+{
+  auto pair = SocketPair{};
+  auto fds = vector<int>(8, STDIN_FILENO);
+  auto descriptors = countDescriptors();
+  sendRecord(pair.fds_[0], ph, fds);
+  net::sendListeners(pair.fds_[0], {});
+
+  BOOST_CHECK_EXCEPTION(net::recvListeners(pair.fds_[1]), Exception,
+                        verifyException<PichiError::BAD_PROTO>);
+  BOOST_CHECK_EQUAL(countDescriptors(), descriptors);
+}
+
+BOOST_AUTO_TEST_CASE(adopt_Listener)
+{
+  auto io = asio::io_context{};
+  auto port = handOver(io);
+  auto key = net::listenerKey(tcp::endpoint{ip::make_address("127.0.0.1"), port});
+  auto fd = net::adopt(key);
+  BOOST_REQUIRE(fd.has_value());
+  BOOST_CHECK(!net::adopt(key).has_value());
+
+  // Still listening after the old one closed
+  auto acceptor = tcp::acceptor{io, tcp::v4(), *fd};
+  auto client = tcp::socket{io};
+  client.connect({ip::make_address("127.0.0.1"), port});
+  auto accepted = acceptor.accept();
+  BOOST_CHECK_EQUAL(accepted.remote_endpoint(), client.local_endpoint());
+}
+
+BOOST_AUTO_TEST_CASE(releaseInherited_Unadopted)
+{
+  auto io = asio::io_context{};
+  auto port = handOver(io);
+  net::releaseInherited();
+  BOOST_CHECK(!net::adopt(net::listenerKey(tcp::endpoint{ip::make_address("127.0.0.1"), port}))
+                   .has_value());
+
+  // The port is free again
+  auto acceptor = tcp::acceptor{io, tcp::endpoint{ip::make_address("127.0.0.1"), port}};
+  BOOST_CHECK(acceptor.is_open());
+}
+
+BOOST_AUTO_TEST_CASE(IngressManager_Adopt)
+{
+  auto io = asio::io_context{};
+  auto port = handOver(io);
+  auto manager = IngressManager{io, [](auto&&...) {}};
+
+  // Binding again would fail without adopting the one inherited
+  manager.update(ph, makeIngressVO(port));
+  auto listeners = manager.listeners();
+  BOOST_REQUIRE_EQUAL(listeners.size(), 1);
+  BOOST_CHECK_EQUAL(listeners.front().key_, "tcp 127.0.0.1 " + to_string(port));
+}
+
+BOOST_AUTO_TEST_CASE(IngressManager_Drain)
+{
+  auto io = asio::io_context{};
+  auto manager = IngressManager{io, [](auto&&...) {}};
+  manager.update(ph, makeIngressVO(0));
+  manager.drain(ph, 1h);
+  BOOST_CHECK(manager.listeners().empty());
+
+  // Erased at once without sessions
+  io.run();
+  BOOST_CHECK(manager.begin() == manager.end());
+
+  // Draining the absent is ignored
+  manager.drain(ph, 1h);
+}
+
+BOOST_AUTO_TEST_CASE(IngressManager_Drain_Updated)
+{
+  auto io = asio::io_context{};
+  auto manager = IngressManager{io, [](auto&&...) {}};
+  manager.update(ph, makeIngressVO(0));
+  manager.drain(ph, 1h);
+  manager.update(ph, makeIngressVO(0));
+  io.run();
+  BOOST_CHECK(manager.begin() != manager.end());
+  BOOST_CHECK_EQUAL(manager.listeners().size(), 1);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
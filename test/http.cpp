@@ -75,6 +75,40 @@ static auto genRefuseResponse()
   return resp;
 }
 
+static auto genResponseWithBody()
+{
+  auto resp = http::response<http::string_body>{};
+  resp.version(11);
+  resp.result(http::status::ok);
+  resp.body() = "http body";
+  resp.prepare_payload();
+  return resp;
+}
+
+// Egress relaying the request exchanged, whose response is received until EOF
+class FakeEgress : public net::Egress {
+public:
+  explicit FakeEgress(string response) : response_{move(response)} {}
+
+  size_t recv(MutableBuffer<uint8_t> buf, Yield) override
+  {
+    if (response_.empty()) throw sys::system_error{asio::error::eof};
+    auto n = min(buf.size(), response_.size());
+    copy_n(cbegin(response_), n, begin(buf));
+    response_.erase(0, n);
+    return n;
+  }
+
+  void send(ConstBuffer<uint8_t> buf, Yield) override { sent_.append(cbegin(buf), cend(buf)); }
+  void close() override {}
+  bool readable() const override { return true; }
+  bool writable() const override { return true; }
+  void connect(net::Endpoint const&, net::Endpoint const&, Yield) override {}
+
+  string response_;
+  string sent_;
+};
+
 template <bool isRequest, typename Body>
 static size_t serializeToBuffer(http::message<isRequest, Body>& m, MutableBuffer<uint8_t> buf)
 {
@@ -112,6 +146,13 @@ static http::message<isRequest, Body> parseFromBuffer(ConstBuffer<uint8_t> buf)
   return parser.release();
 }
 
+template <bool isRequest, typename Body>
+static string serializeToString(http::message<isRequest, Body> m)
+{
+  auto buf = array<uint8_t, 1024>{};
+  return {cbegin(buf), cbegin(buf) + serializeToBuffer(m, buf)};
+}
+
 template <bool isRequest>
 static void verifyField(http::header<isRequest> const& h, http::field field, string_view content)
 {
@@ -143,7 +184,7 @@ BOOST_AUTO_TEST_CASE(readRemote_Tunnel_Correct)
   auto remote = ingress.readRemote(yield);
 
   BOOST_CHECK(HTTPS_ENDPOINT.type_ == remote.type_);
-  BOOST_CHECK_EQUAL(HTTPS_ENDPOINT.host_, remote.host_);
+  BOOST_CHECK_EQUAL(HTTPS_ENDPOINT.domain(), remote.domain());
   BOOST_CHECK_EQUAL(HTTPS_ENDPOINT.port_, remote.port_);
   BOOST_CHECK_EXCEPTION(ingress.recv(buf, yield), Exception, verifyException<PichiError::MISC>);
 }
@@ -160,7 +201,7 @@ BOOST_AUTO_TEST_CASE(readRemote_Relay_With_Host_Field_Only)
   auto remote = ingress.readRemote(yield);
 
   BOOST_CHECK(HTTP_ENDPOINT.type_ == remote.type_);
-  BOOST_CHECK_EQUAL(HTTP_ENDPOINT.host_, remote.host_);
+  BOOST_CHECK_EQUAL(HTTP_ENDPOINT.domain(), remote.domain());
   BOOST_CHECK_EQUAL(HTTP_ENDPOINT.port_, remote.port_);
 }
 
@@ -176,7 +217,7 @@ BOOST_AUTO_TEST_CASE(readRemote_Relay_With_Both_Fields)
   auto remote = ingress.readRemote(yield);
 
   BOOST_CHECK(HTTP_ENDPOINT.type_ == remote.type_);
-  BOOST_CHECK_EQUAL(HTTP_ENDPOINT.host_, remote.host_);
+  BOOST_CHECK_EQUAL(HTTP_ENDPOINT.domain(), remote.domain());
   BOOST_CHECK_EQUAL(HTTP_ENDPOINT.port_, remote.port_);
 }
 
@@ -460,6 +501,213 @@ BOOST_AUTO_TEST_CASE(Ingress_send_Relay)
   verifyField(sent, http::field::proxy_connection, "close"sv);
 }
 
+BOOST_AUTO_TEST_CASE(readRemote_Persistent)
+{
+  auto keepAlive = genRelayReq("http://localhost/"s);
+  auto closing = genRelayReq("http://localhost/"s);
+  closing.set(http::field::connection, "close");
+  auto proxyClosing = genRelayReq("http://localhost/"s);
+  proxyClosing.set(http::field::proxy_connection, "close");
+  auto legacy = genRelayReq("http://localhost/"s);
+  legacy.version(10);
+  auto upgrading = genRelayReq("http://localhost/"s);
+  upgrading.set(http::field::connection, "upgrade");
+  upgrading.set(http::field::upgrade, "websocket");
+  auto tunnel = genTunnelReq();
+
+  auto socket = Socket{};
+  auto ingress = HttpIngress{socket, true};
+  auto verify = [&](auto& req, bool expected) {
+    auto raw = serializeToString(req);
+    socket.fill(ConstBuffer<uint8_t>{raw});
+    ingress.readRemote(yield);
+    BOOST_CHECK_EQUAL(expected, ingress.persistent());
+  };
+  verify(keepAlive, true);
+  verify(closing, false);
+  verify(proxyClosing, false);
+  verify(legacy, false);
+  verify(upgrading, false);
+  verify(tunnel, false);
+}
+
+BOOST_AUTO_TEST_CASE(Ingress_exchange_With_Body)
+{
+  auto origin = genRelayReqWithBody("http://localhost/"s);
+  origin.set(http::field::proxy_connection, "keep-alive");
+  auto raw = serializeToString(origin);
+  auto response = genResponseWithBody();
+  auto egress = FakeEgress{serializeToString(response)};
+
+  auto socket = Socket{};
+  auto ingress = HttpIngress{socket, true};
+  socket.fill(ConstBuffer<uint8_t>{raw});
+  ingress.readRemote(yield);
+  auto exchanged = ingress.exchange(egress, yield);
+
+  auto req = parseFromBuffer<true, http::string_body>(ConstBuffer<uint8_t>{egress.sent_});
+  BOOST_CHECK_EQUAL("/", req.target());
+  BOOST_CHECK_EQUAL("http body", req.body());
+  BOOST_CHECK(req.find(http::field::proxy_connection) == cend(req));
+  BOOST_CHECK_EQUAL(egress.sent_.size(), exchanged.in_);
+
+  auto buf = array<uint8_t, 1024>{};
+  auto size = socket.flush(buf);
+  auto resp = parseFromBuffer<false, http::string_body>({buf, size});
+  BOOST_CHECK_EQUAL(http::status::ok, resp.result());
+  BOOST_CHECK_EQUAL("http body", resp.body());
+  BOOST_CHECK(resp.find(http::field::connection) == cend(resp));
+  BOOST_CHECK_EQUAL(size, exchanged.out_);
+
+  BOOST_CHECK(exchanged.reusable_);
+  BOOST_CHECK(ingress.persistent());
+}
+
+BOOST_AUTO_TEST_CASE(Ingress_exchange_Pipelined)
+{
+  auto first = genRelayReqWithBody("http://localhost/first"s);
+  auto second = genRelayReq("http://localhost:8080/second"s);
+  second.set(http::field::host, "localhost:8080");
+  auto raw = serializeToString(first) + serializeToString(second);
+  auto response = serializeToString(genResponse());
+  auto egress = FakeEgress{response};
+
+  auto socket = Socket{};
+  auto ingress = HttpIngress{socket, true};
+  socket.fill(ConstBuffer<uint8_t>{raw});
+  ingress.readRemote(yield);
+  ingress.exchange(egress, yield);
+
+  // The second request is left for the next reading
+  auto req = parseFromBuffer<true, http::string_body>(ConstBuffer<uint8_t>{egress.sent_});
+  BOOST_CHECK_EQUAL("/first", req.target());
+
+  auto remote = ingress.readRemote(yield);
+  BOOST_CHECK_EQUAL(8080, remote.port_);
+  auto another = FakeEgress{response};
+  ingress.exchange(another, yield);
+  req = parseFromBuffer<true, http::string_body>(ConstBuffer<uint8_t>{another.sent_});
+  BOOST_CHECK_EQUAL("/second", req.target());
+  BOOST_CHECK(req.body().empty());
+}
+
+BOOST_AUTO_TEST_CASE(Ingress_exchange_Chunked_Response)
+{
+  auto raw = serializeToString(genRelayReq("http://localhost/"s));
+  auto chunked = "HTTP/1.1 200 OK\r\nTransfer-Encoding: chunked\r\n\r\n"
+                 "4\r\nhttp\r\n5\r\n body\r\n0\r\n\r\n"s;
+  auto egress = FakeEgress{chunked};
+
+  auto socket = Socket{};
+  auto ingress = HttpIngress{socket, true};
+  socket.fill(ConstBuffer<uint8_t>{raw});
+  ingress.readRemote(yield);
+  auto exchanged = ingress.exchange(egress, yield);
+
+  auto buf = array<uint8_t, 1024>{};
+  auto size = socket.flush(buf);
+  BOOST_CHECK_EQUAL(chunked, string(cbegin(buf), cbegin(buf) + size));
+  BOOST_CHECK_EQUAL(chunked.size(), exchanged.out_);
+  BOOST_CHECK(exchanged.reusable_);
+  BOOST_CHECK(ingress.persistent());
+}
+
+BOOST_AUTO_TEST_CASE(Ingress_exchange_Response_Until_EOF)
+{
+  auto raw = serializeToString(genRelayReq("http://localhost/"s));
+  auto delimited = "HTTP/1.1 200 OK\r\n\r\nhttp body"s;
+  auto egress = FakeEgress{delimited};
+
+  auto socket = Socket{};
+  auto ingress = HttpIngress{socket, true};
+  socket.fill(ConstBuffer<uint8_t>{raw});
+  ingress.readRemote(yield);
+  auto exchanged = ingress.exchange(egress, yield);
+
+  BOOST_CHECK_EQUAL(delimited.size(), exchanged.out_);
+  BOOST_CHECK(!exchanged.reusable_);
+  BOOST_CHECK(!ingress.persistent());
+}
+
+BOOST_AUTO_TEST_CASE(Ingress_exchange_Closed_Before_Response)
+{
+  auto raw = serializeToString(genRelayReq("http://localhost/"s));
+  auto egress = FakeEgress{""s};
+
+  auto socket = Socket{};
+  auto ingress = HttpIngress{socket, true};
+  socket.fill(ConstBuffer<uint8_t>{raw});
+  ingress.readRemote(yield);
+  BOOST_CHECK_EXCEPTION(ingress.exchange(egress, yield), sys::system_error,
+                        [](auto&& e) { return e.code() == asio::error::eof; });
+}
+
+BOOST_AUTO_TEST_CASE(Ingress_exchange_Closing_Response)
+{
+  auto raw = serializeToString(genRelayReq("http://localhost/"s));
+  auto response = genResponseWithBody();
+  response.set(http::field::connection, "close");
+  auto egress = FakeEgress{serializeToString(response)};
+
+  auto socket = Socket{};
+  auto ingress = HttpIngress{socket, true};
+  socket.fill(ConstBuffer<uint8_t>{raw});
+  ingress.readRemote(yield);
+  auto exchanged = ingress.exchange(egress, yield);
+
+  BOOST_CHECK(!exchanged.reusable_);
+  BOOST_CHECK(!ingress.persistent());
+}
+
+BOOST_AUTO_TEST_CASE(Ingress_exchange_Head)
+{
+  auto origin = genRelayReq("http://localhost/"s);
+  origin.method(http::verb::head);
+  auto raw = serializeToString(origin);
+  // Content-Length of HEAD response comes without the body
+  auto head = "HTTP/1.1 200 OK\r\nContent-Length: 9\r\n\r\n"s;
+  auto egress = FakeEgress{head};
+
+  auto socket = Socket{};
+  auto ingress = HttpIngress{socket, true};
+  socket.fill(ConstBuffer<uint8_t>{raw});
+  ingress.readRemote(yield);
+  auto exchanged = ingress.exchange(egress, yield);
+
+  BOOST_CHECK_EQUAL(head.size(), exchanged.out_);
+  BOOST_CHECK(exchanged.reusable_);
+}
+
+BOOST_AUTO_TEST_CASE(Ingress_exchange_Expect_Continue)
+{
+  auto origin = genRelayReqWithBody("http://localhost/"s);
+  origin.set(http::field::expect, "100-continue");
+  auto raw = serializeToString(origin);
+  auto response = genResponse();
+  auto egress = FakeEgress{serializeToString(response)};
+
+  auto socket = Socket{};
+  auto ingress = HttpIngress{socket, true};
+  socket.fill(ConstBuffer<uint8_t>{raw});
+  ingress.readRemote(yield);
+  ingress.exchange(egress, yield);
+
+  auto req = parseFromBuffer<true, http::string_body>(ConstBuffer<uint8_t>{egress.sent_});
+  BOOST_CHECK(req.find(http::field::expect) == cend(req));
+  BOOST_CHECK_EQUAL("http body", req.body());
+
+  // Continued by the ingress ahead of the response
+  auto buf = array<uint8_t, 1024>{};
+  auto size = socket.flush(buf);
+  auto continued = "HTTP/1.1 100 Continue\r\n\r\n"sv;
+  BOOST_REQUIRE_GE(size, continued.size());
+  BOOST_CHECK_EQUAL(continued, string_view(reinterpret_cast<char const*>(buf.data()),
+                                           continued.size()));
+  auto resp = parseFromBuffer<false, http::empty_body>(
+      {buf.data() + continued.size(), size - continued.size()});
+  BOOST_CHECK_EQUAL(http::status::no_content, resp.result());
+}
+
 BOOST_AUTO_TEST_CASE(Egress_connect_Tunnel)
 {
   auto buf = array<uint8_t, 1024>{};
@@ -551,8 +799,8 @@ BOOST_AUTO_TEST_CASE(Egress_send_Relay_HTTP_Request_Without_Upgrade)
   BOOST_CHECK_EQUAL("http://localhost/", sent.target());
   BOOST_CHECK_EQUAL(http::verb::get, sent.method());
   verifyField(sent, http::field::host, "localhost"sv);
-  verifyField(sent, http::field::connection, "close"sv);
-  verifyField(sent, http::field::proxy_connection, "close"sv);
+  BOOST_CHECK(sent.find(http::field::connection) == cend(sent));
+  BOOST_CHECK(sent.find(http::field::proxy_connection) == cend(sent));
 }
 
 BOOST_AUTO_TEST_CASE(Egress_send_Relay_HTTP_Request_With_Upgrade)
@@ -601,8 +849,8 @@ BOOST_AUTO_TEST_CASE(Egress_send_Relay_Multiple_Parts_Header)
   BOOST_CHECK_EQUAL("http://localhost/", sent.target());
   BOOST_CHECK_EQUAL(http::verb::get, sent.method());
   verifyField(sent, http::field::host, "localhost"sv);
-  verifyField(sent, http::field::connection, "close"sv);
-  verifyField(sent, http::field::proxy_connection, "close"sv);
+  BOOST_CHECK(sent.find(http::field::connection) == cend(sent));
+  BOOST_CHECK(sent.find(http::field::proxy_connection) == cend(sent));
 }
 
 BOOST_AUTO_TEST_CASE(Egress_send_Relay_Request_With_Body)
@@ -627,8 +875,8 @@ BOOST_AUTO_TEST_CASE(Egress_send_Relay_Request_With_Body)
   BOOST_CHECK_EQUAL("http://localhost/"s, sent.target());
   BOOST_CHECK_EQUAL(http::verb::post, sent.method());
   verifyField(sent, http::field::host, "localhost"sv);
-  verifyField(sent, http::field::connection, "close"sv);
-  verifyField(sent, http::field::proxy_connection, "close"sv);
+  BOOST_CHECK(sent.find(http::field::connection) == cend(sent));
+  BOOST_CHECK(sent.find(http::field::proxy_connection) == cend(sent));
   BOOST_CHECK_EQUAL("http body"s, sent.body());
 }
 
@@ -645,6 +893,7 @@ BOOST_AUTO_TEST_CASE(Egress_send_Relay_Request_With_Extra_Data)
   socket.flush(buf);
 
   auto origin = genRelayReq("/"s);
+  origin.set(http::field::connection, "close");
   egress.send({buf, serializeToBuffer(origin, buf)}, yield);
   parseFromBuffer<true, http::empty_body>({buf, socket.flush(buf)});
 
@@ -656,6 +905,97 @@ BOOST_AUTO_TEST_CASE(Egress_send_Relay_Request_With_Extra_Data)
                                 cbegin(buf) + extra.size());
 }
 
+BOOST_AUTO_TEST_CASE(Egress_send_Relay_Pipelined_Requests)
+{
+  auto buf = array<uint8_t, 1024>{};
+  auto socket = Socket{};
+  auto egress = HttpEgress{socket};
+
+  auto resp = genRefuseResponse();
+  socket.fill({buf, serializeToBuffer(resp, buf)});
+
+  egress.connect(net::makeEndpoint("localhost"sv, "80"sv), {}, yield);
+  socket.flush(buf);
+
+  auto raw = serializeToString(genRelayReqWithBody("/first"s)) +
+             serializeToString(genRelayReq("/second"s));
+  egress.send(ConstBuffer<uint8_t>{raw}, yield);
+
+  auto size = socket.flush(buf);
+  auto parser = http::request_parser<http::string_body>{};
+  parser.eager(true);
+  auto ec = sys::error_code{};
+  auto parsed = parser.put(asio::buffer(buf.data(), size), ec);
+  BOOST_REQUIRE(!ec);
+  BOOST_CHECK_EQUAL("http://localhost/first"s, parser.get().target());
+  BOOST_CHECK_EQUAL("http body"s, parser.get().body());
+
+  auto second = parseFromBuffer<true, http::empty_body>({buf.data() + parsed, size - parsed});
+  BOOST_CHECK_EQUAL("http://localhost/second"s, second.target());
+}
+
+BOOST_AUTO_TEST_CASE(Egress_connect_Skip_Rejecting_Upstream)
+{
+  auto next = net::makeEndpoint("rejecting"sv, "3128"sv);
+  auto buf = array<uint8_t, 1024>{};
+  auto socket = Socket{};
+  auto egress = HttpEgress{socket};
+
+  auto rejection = genResponseWithBody();
+  rejection.result(http::status::method_not_allowed);
+  auto raw = serializeToString(rejection);
+  socket.fill(ConstBuffer<uint8_t>{raw});
+
+  egress.connect(HTTP_ENDPOINT, next, yield);
+  auto req = parseFromBuffer<true, http::empty_body>({buf, socket.flush(buf)});
+  BOOST_CHECK_EQUAL(http::verb::connect, req.method());
+
+  // The rejection kept alive is read as a whole, and the connection relays afterwards
+  auto origin = genRelayReq("/"s);
+  egress.send({buf, serializeToBuffer(origin, buf)}, yield);
+  auto sent = parseFromBuffer<true, http::empty_body>({buf, socket.flush(buf)});
+  BOOST_CHECK_EQUAL("http://localhost/"s, sent.target());
+
+  auto another = HttpEgress{socket};
+  another.connect(HTTP_ENDPOINT, next, yield);
+  BOOST_CHECK_EQUAL(0, socket.available());
+}
+
+BOOST_AUTO_TEST_CASE(Egress_connect_Parked_Connection)
+{
+  auto next = net::makeEndpoint("parking"sv, "3128"sv);
+  auto buf = array<uint8_t, 1024>{};
+  auto parked = Socket{};
+  {
+    auto egress = HttpEgress{parked};
+    auto rejection = genRefuseResponse();
+    rejection.result(http::status::not_implemented);
+    rejection.content_length(0);
+    parked.fill({buf, serializeToBuffer(rejection, buf)});
+    egress.connect(HTTP_ENDPOINT, next, yield);
+    parked.flush(buf);
+
+    auto origin = genRelayReq("/"s);
+    egress.send({buf, serializeToBuffer(origin, buf)}, yield);
+    parked.flush(buf);
+    auto resp = genResponse();
+    parked.fill({buf, serializeToBuffer(resp, buf)});
+    egress.recv(buf, yield);
+  }
+
+  // Neither connected nor CONNECT sent with the parked one
+  auto socket = Socket{};
+  auto egress = HttpEgress{socket};
+  egress.connect(HTTP_ENDPOINT, next, yield);
+  BOOST_CHECK(egress.writable());
+
+  auto origin = genRelayReq("/"s);
+  egress.send({buf, serializeToBuffer(origin, buf)}, yield);
+  BOOST_CHECK_EQUAL(0, socket.available());
+  auto sent = parseFromBuffer<true, http::empty_body>({buf, parked.flush(buf)});
+  BOOST_CHECK_EQUAL("http://localhost/"s, sent.target());
+}
+
 BOOST_AUTO_TEST_CASE(Egress_recv_Tunnel)
 {
   auto buf = array<uint8_t, 1024>{};
@@ -0,0 +1,456 @@
+#define BOOST_TEST_MODULE pichi mux test
+
+#include "utils.hpp"
+#include <array>
+#include <boost/asio/io_context.hpp>
+#include <boost/test/unit_test.hpp>
+#include <pichi/net/helpers.hpp>
+#include <pichi/net/mux.hpp>
+#include <pichi/net/spawn.hpp>
+#include <vector>
+
+using namespace std;
+using namespace pichi;
+using namespace pichi::net;
+namespace asio = boost::asio;
+namespace sys = boost::system;
+
+using Frame = pair<MuxHeader, vector<uint8_t>>;
+
+/*
+ * Mux over a faked connection, whose received frames are dispatched by the test directly, and
+ *   whose sent frames are collected.
+ */
+class FakeMux : public Mux {
+protected:
+  void handshake(Yield) override {}
+
+  void read(MutableBuffer<uint8_t>, Yield yield) override
+  {
+    // Nothing arrives by reading until shut down
+    auto ec = sys::error_code{};
+    shut_.async_wait(yield[ec]);
+    throw sys::system_error{asio::error::eof};
+  }
+
+  void write(ConstBuffer<uint8_t> buf, Yield) override
+  {
+    sent_.insert(end(sent_), cbegin(buf), cend(buf));
+  }
+
+  void shutdown() override { shut_.cancel(); }
+
+public:
+  FakeMux(asio::io_context& io, bool client)
+    : Mux{io, client}, shut_{io, asio::steady_timer::time_point::max()}
+  {
+  }
+
+  using Mux::dispatch;
+
+  // The frames sent since the last call
+  vector<Frame> sent()
+  {
+    auto ret = vector<Frame>{};
+    for (auto p = ConstBuffer<uint8_t>{sent_}; p.size() > 0;) {
+      auto header = parseMuxHeader(p);
+      p = p + MUX_HEADER_SIZE;
+      ret.emplace_back(header, vector<uint8_t>{cbegin(p), cbegin(p) + header.length_});
+      p = p + header.length_;
+    }
+    sent_.clear();
+    return ret;
+  }
+
+private:
+  asio::steady_timer shut_;
+  vector<uint8_t> sent_ = {};
+};
+
+static auto const REMOTE = makeEndpoint("example.com"sv, 443);
+
+static void run(asio::io_context& io)
+{
+  io.restart();
+  io.poll();
+}
+
+static shared_ptr<FakeMux> makeServer(asio::io_context& io)
+{
+  auto mux = make_shared<FakeMux>(io, false);
+  mux->start();
+  run(io);
+  return mux;
+}
+
+static void syn(FakeMux& mux, uint32_t id)
+{
+  auto payload = array<uint8_t, 512>{};
+  auto len = serializeEndpoint(REMOTE, payload);
+  mux.dispatch({MuxCommand::SYN, static_cast<uint16_t>(len), id}, {payload, len});
+}
+
+static void psh(FakeMux& mux, uint32_t id, ConstBuffer<uint8_t> data)
+{
+  mux.dispatch({MuxCommand::PSH, static_cast<uint16_t>(data.size()), id}, data);
+}
+
+static void upd(FakeMux& mux, uint32_t id, uint32_t increment)
+{
+  auto payload = array<uint8_t, sizeof(uint32_t)>{};
+  hton(increment, payload);
+  mux.dispatch({MuxCommand::UPD, sizeof(uint32_t), id}, payload);
+}
+
+// Pushing the whole window to the stream, which isn't consumed yet
+static void fillWindow(FakeMux& mux, uint32_t id)
+{
+  auto data = vector<uint8_t>(MAX_FRAME_SIZE, 0x5a);
+  for (auto left = MUX_WINDOW; left > 0;) {
+    auto n = min(left, MAX_FRAME_SIZE);
+    psh(mux, id, {data, n});
+    left -= n;
+  }
+}
+
+static size_t pushed(vector<Frame> const& frames)
+{
+  auto ret = size_t{0};
+  for (auto&& [header, payload] : frames)
+    if (header.cmd_ == MuxCommand::PSH) ret += payload.size();
+  return ret;
+}
+
+BOOST_AUTO_TEST_SUITE(MUX)
+
+BOOST_AUTO_TEST_CASE(serializeMuxHeader_Layout)
+{
+  auto buf = array<uint8_t, MUX_HEADER_SIZE>{};
+  serializeMuxHeader({MuxCommand::PSH, 0x1234, 0x01020304}, buf);
+  auto expect = array<uint8_t, MUX_HEADER_SIZE>{0x00, 0x01, 0x12, 0x34, 0x01, 0x02, 0x03, 0x04};
+  BOOST_CHECK_EQUAL_COLLECTIONS(cbegin(expect), cend(expect), cbegin(buf), cend(buf));
+}
+
+BOOST_AUTO_TEST_CASE(serializeMuxHeader_Insufficient_Buffer)
+{
+  auto buf = array<uint8_t, MUX_HEADER_SIZE - 1>{};
+  BOOST_CHECK_EXCEPTION(serializeMuxHeader({MuxCommand::FIN, 0, 1}, buf), Exception,
+                        verifyException<PichiError::MISC>);
+}
+
+BOOST_AUTO_TEST_CASE(parseMuxHeader_Round_Trip)
+{
+  for (auto cmd : {MuxCommand::SYN, MuxCommand::PSH, MuxCommand::UPD, MuxCommand::FIN}) {
+    auto buf = array<uint8_t, MUX_HEADER_SIZE>{};
+    serializeMuxHeader({cmd, static_cast<uint16_t>(MAX_FRAME_SIZE), 0xffffffff}, buf);
+    auto header = parseMuxHeader(buf);
+    BOOST_CHECK(header.cmd_ == cmd);
+    BOOST_CHECK_EQUAL(header.length_, MAX_FRAME_SIZE);
+    BOOST_CHECK_EQUAL(header.id_, 0xffffffff);
+  }
+}
+
+BOOST_AUTO_TEST_CASE(parseMuxHeader_Invalid_Version)
+{
+  for (auto i = 1; i < 0x100; ++i) {
+    auto buf = array<uint8_t, MUX_HEADER_SIZE>{static_cast<uint8_t>(i), 0x01, 0x00, 0x00, 0x00,
+                                               0x00, 0x00, 0x01};
+    BOOST_CHECK_EXCEPTION(parseMuxHeader(buf), Exception, verifyException<PichiError::BAD_PROTO>);
+  }
+}
+
+BOOST_AUTO_TEST_CASE(parseMuxHeader_Invalid_Command)
+{
+  for (auto i = 4; i < 0x100; ++i) {
+    auto buf = array<uint8_t, MUX_HEADER_SIZE>{0x00, static_cast<uint8_t>(i), 0x00, 0x00, 0x00,
+                                               0x00, 0x00, 0x01};
+    BOOST_CHECK_EXCEPTION(parseMuxHeader(buf), Exception, verifyException<PichiError::BAD_PROTO>);
+  }
+}
+
+BOOST_AUTO_TEST_CASE(parseMuxHeader_Frame_Too_Large)
+{
+  auto buf = array<uint8_t, MUX_HEADER_SIZE>{};
+  serializeMuxHeader({MuxCommand::PSH, static_cast<uint16_t>(MAX_FRAME_SIZE + 1), 1}, buf);
+  BOOST_CHECK_EXCEPTION(parseMuxHeader(buf), Exception, verifyException<PichiError::BAD_PROTO>);
+}
+
+BOOST_AUTO_TEST_CASE(Mux_Accept_And_Deliver)
+{
+  auto io = asio::io_context{};
+  auto mux = makeServer(io);
+  auto done = false;
+
+  syn(*mux, 1);
+  spawn(io, [&](auto yield) {
+    auto stream = mux->accept(yield);
+    BOOST_REQUIRE(stream != nullptr);
+    auto ingress = MuxIngress{mux, stream};
+    BOOST_CHECK(ingress.readRemote(yield) == REMOTE);
+
+    auto buf = array<uint8_t, 16>{};
+    auto n = ingress.recv(buf, yield);
+    auto expect = str2vec("hello");
+    BOOST_CHECK_EQUAL_COLLECTIONS(cbegin(expect), cend(expect), cbegin(buf), cbegin(buf) + n);
+    done = true;
+  });
+  run(io);
+  BOOST_CHECK(!done);
+  BOOST_CHECK_EQUAL(mux->streams(), 1);
+
+  psh(*mux, 1, str2vec("hello"));
+  run(io);
+  BOOST_CHECK(done);
+}
+
+BOOST_AUTO_TEST_CASE(Mux_Accept_Frames_Of_Unknown_Stream)
+{
+  auto io = asio::io_context{};
+  auto mux = makeServer(io);
+
+  psh(*mux, 1, str2vec("hello"));
+  upd(*mux, 1, 1);
+  mux->dispatch({MuxCommand::FIN, 0, 1}, {});
+  BOOST_CHECK_EQUAL(mux->streams(), 0);
+}
+
+BOOST_AUTO_TEST_CASE(Mux_Accept_Duplicated_SYN)
+{
+  auto io = asio::io_context{};
+  auto mux = makeServer(io);
+
+  syn(*mux, 1);
+  BOOST_CHECK_EXCEPTION(syn(*mux, 1), Exception, verifyException<PichiError::BAD_PROTO>);
+}
+
+BOOST_AUTO_TEST_CASE(Mux_Accept_SYN_By_Client)
+{
+  auto io = asio::io_context{};
+  auto mux = make_shared<FakeMux>(io, true);
+  BOOST_CHECK_EXCEPTION(syn(*mux, 1), Exception, verifyException<PichiError::BAD_PROTO>);
+}
+
+BOOST_AUTO_TEST_CASE(Mux_Accept_Over_Max_Streams)
+{
+  auto io = asio::io_context{};
+  auto mux = makeServer(io);
+
+  for (auto i = uint32_t{1}; i <= MUX_MAX_STREAMS; ++i) syn(*mux, i);
+  syn(*mux, MUX_MAX_STREAMS + 1);
+  BOOST_CHECK_EQUAL(mux->streams(), MUX_MAX_STREAMS);
+
+  // Frames of the refused stream are dropped
+  psh(*mux, MUX_MAX_STREAMS + 1, str2vec("hello"));
+  run(io);
+  auto frames = mux->sent();
+  BOOST_REQUIRE_EQUAL(frames.size(), 1);
+  BOOST_CHECK(frames.front().first.cmd_ == MuxCommand::FIN);
+  BOOST_CHECK_EQUAL(frames.front().first.id_, MUX_MAX_STREAMS + 1);
+}
+
+BOOST_AUTO_TEST_CASE(Mux_Window_Receiving_Overflow)
+{
+  auto io = asio::io_context{};
+  auto mux = makeServer(io);
+
+  syn(*mux, 1);
+  fillWindow(*mux, 1);
+  BOOST_CHECK_EXCEPTION(psh(*mux, 1, str2vec("x")), Exception,
+                        verifyException<PichiError::BAD_PROTO>);
+}
+
+BOOST_AUTO_TEST_CASE(Mux_Window_Granting_Overflow)
+{
+  auto io = asio::io_context{};
+  auto mux = makeServer(io);
+
+  syn(*mux, 1);
+  BOOST_CHECK_EXCEPTION(upd(*mux, 1, 1), Exception, verifyException<PichiError::BAD_PROTO>);
+}
+
+BOOST_AUTO_TEST_CASE(Mux_Window_Invalid_UPD)
+{
+  auto io = asio::io_context{};
+  auto mux = makeServer(io);
+
+  syn(*mux, 1);
+  auto payload = array<uint8_t, 2>{};
+  BOOST_CHECK_EXCEPTION(mux->dispatch({MuxCommand::UPD, 2, 1}, payload), Exception,
+                        verifyException<PichiError::BAD_PROTO>);
+}
+
+BOOST_AUTO_TEST_CASE(Mux_Window_Sending_Waits_For_Credits)
+{
+  auto io = asio::io_context{};
+  auto mux = makeServer(io);
+  auto done = false;
+
+  syn(*mux, 1);
+  spawn(io, [&](auto yield) {
+    auto ingress = MuxIngress{mux, mux->accept(yield)};
+    ingress.send(vector<uint8_t>(MUX_WINDOW + 10, 0x5a), yield);
+    done = true;
+  });
+  run(io);
+  BOOST_CHECK(!done);
+  BOOST_CHECK_EQUAL(pushed(mux->sent()), MUX_WINDOW);
+
+  upd(*mux, 1, 10);
+  run(io);
+  BOOST_CHECK(done);
+  // The ingress is closed once destroyed
+  auto frames = mux->sent();
+  BOOST_CHECK_EQUAL(pushed(frames), 10);
+  BOOST_CHECK(frames.back().first.cmd_ == MuxCommand::FIN);
+}
+
+BOOST_AUTO_TEST_CASE(Mux_Window_Receiving_Grants_Credits)
+{
+  auto io = asio::io_context{};
+  auto mux = makeServer(io);
+  auto received = size_t{0};
+
+  syn(*mux, 1);
+  fillWindow(*mux, 1);
+  spawn(io, [&](auto yield) {
+    // Received without closing the stream
+    auto stream = mux->accept(yield);
+    auto buf = vector<uint8_t>(MAX_FRAME_SIZE);
+    while (received < MUX_WINDOW / 2) received += mux->recv(*stream, buf, yield);
+  });
+  run(io);
+
+  auto frames = mux->sent();
+  BOOST_REQUIRE_EQUAL(frames.size(), 1);
+  BOOST_CHECK(frames.front().first.cmd_ == MuxCommand::UPD);
+  BOOST_CHECK_EQUAL(ntoh<uint32_t>(frames.front().second), received);
+
+  // Only the credits granted are available again
+  auto data = vector<uint8_t>(MAX_FRAME_SIZE, 0x5a);
+  for (auto left = received; left > 0;) {
+    auto n = min(left, MAX_FRAME_SIZE);
+    psh(*mux, 1, {data, n});
+    left -= n;
+  }
+  BOOST_CHECK_EXCEPTION(psh(*mux, 1, str2vec("x")), Exception,
+                        verifyException<PichiError::BAD_PROTO>);
+}
+
+BOOST_AUTO_TEST_CASE(Mux_FIN_Received)
+{
+  auto io = asio::io_context{};
+  auto mux = makeServer(io);
+  auto done = false;
+
+  syn(*mux, 1);
+  psh(*mux, 1, str2vec("hello"));
+  mux->dispatch({MuxCommand::FIN, 0, 1}, {});
+  spawn(io, [&](auto yield) {
+    auto ingress = MuxIngress{mux, mux->accept(yield)};
+    auto buf = array<uint8_t, 16>{};
+    // The data received before FIN is still delivered
+    BOOST_CHECK_EQUAL(ingress.recv(buf, yield), 5);
+    BOOST_CHECK_EXCEPTION(ingress.recv(buf, yield), sys::system_error,
+                          [](auto&& e) { return e.code() == asio::error::eof; });
+    BOOST_CHECK_EXCEPTION(ingress.send(str2vec("hello"), yield), sys::system_error,
+                          verifyException<asio::error::broken_pipe>);
+    done = true;
+  });
+  run(io);
+  BOOST_CHECK(done);
+}
+
+BOOST_AUTO_TEST_CASE(Mux_FIN_Sent)
+{
+  auto io = asio::io_context{};
+  auto mux = makeServer(io);
+  auto done = false;
+
+  syn(*mux, 1);
+  spawn(io, [&](auto yield) {
+    auto ingress = MuxIngress{mux, mux->accept(yield)};
+    ingress.close();
+    BOOST_CHECK(!ingress.readable());
+    BOOST_CHECK(!ingress.writable());
+    auto buf = array<uint8_t, 16>{};
+    BOOST_CHECK_EXCEPTION(ingress.recv(buf, yield), sys::system_error,
+                          verifyException<asio::error::operation_aborted>);
+    done = true;
+  });
+  run(io);
+  BOOST_CHECK(done);
+  BOOST_CHECK_EQUAL(mux->streams(), 0);
+
+  auto frames = mux->sent();
+  BOOST_REQUIRE_EQUAL(frames.size(), 1);
+  BOOST_CHECK(frames.front().first.cmd_ == MuxCommand::FIN);
+  BOOST_CHECK_EQUAL(frames.front().first.id_, 1);
+  // Frames arriving later are dropped
+  psh(*mux, 1, str2vec("hello"));
+}
+
+BOOST_AUTO_TEST_CASE(Mux_Close_Tears_Down_Streams)
+{
+  auto io = asio::io_context{};
+  auto mux = makeServer(io);
+  auto received = false;
+  auto accepted = false;
+
+  syn(*mux, 1);
+  spawn(io, [&](auto yield) {
+    auto ingress = MuxIngress{mux, mux->accept(yield)};
+    auto buf = array<uint8_t, 16>{};
+    BOOST_CHECK_EXCEPTION(ingress.recv(buf, yield), sys::system_error,
+                          verifyException<asio::error::connection_reset>);
+    BOOST_CHECK(!ingress.readable());
+    received = true;
+  });
+  spawn(io, [&](auto yield) {
+    mux->accept(yield);
+    BOOST_CHECK(mux->accept(yield) == nullptr);
+    accepted = true;
+  });
+  run(io);
+  BOOST_CHECK(!received);
+  BOOST_CHECK(!accepted);
+
+  syn(*mux, 2);
+  mux->close();
+  run(io);
+  BOOST_CHECK(received);
+  BOOST_CHECK(accepted);
+  BOOST_CHECK(mux->closed());
+  BOOST_CHECK_EQUAL(mux->streams(), 0);
+}
+
+BOOST_AUTO_TEST_CASE(MuxClient_Acquire_Over_Max_Streams)
+{
+  auto io = asio::io_context{};
+  auto dialed = 0;
+  auto client = MuxClient{io, 2, [&io, &dialed](auto) {
+                            ++dialed;
+                            return make_shared<FakeMux>(io, true);
+                          }};
+  auto done = false;
+
+  spawn(io, [&](auto yield) {
+    auto streams = vector<Mux::StreamPtr>{};
+    for (auto i = 0; i < 2; ++i) {
+      auto mux = client.acquire(yield);
+      for (auto j = size_t{0}; j < MUX_MAX_STREAMS; ++j) streams.push_back(mux->open(REMOTE));
+      BOOST_CHECK_EXCEPTION(mux->open(REMOTE), Exception,
+                            verifyException<PichiError::CONN_FAILURE>);
+    }
+    BOOST_CHECK_EQUAL(dialed, 2);
+    BOOST_CHECK_EXCEPTION(client.acquire(yield), Exception,
+                          verifyException<PichiError::CONN_FAILURE>);
+    BOOST_CHECK_EQUAL(dialed, 2);
+    done = true;
+  });
+  run(io);
+  BOOST_CHECK(done);
+  client.close();
+  run(io);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
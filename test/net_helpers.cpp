@@ -16,13 +16,6 @@ namespace mpl = boost::mpl;
 namespace sys = boost::system;
 using EType = Endpoint::Type;
 
-static bool operator==(Endpoint const& lhs, Endpoint const& rhs)
-{
-  return lhs.type_ == rhs.type_ && lhs.host_ == rhs.host_ && lhs.port_ == rhs.port_;
-}
-
-static bool operator!=(Endpoint const& lhs, Endpoint const& rhs) { return !(lhs == rhs); }
-
 template <EType type> struct EHelper {
   static uint8_t const CHAR;
   static size_t const SIZE;
@@ -32,18 +25,17 @@ template <EType type> struct EHelper {
 template <> uint8_t const EHelper<EType::DOMAIN_NAME>::CHAR = 3;
 template <> size_t const EHelper<EType::DOMAIN_NAME>::SIZE = 7;
 template <>
-Endpoint const EHelper<EType::DOMAIN_NAME>::ENDPOINT = {EType::DOMAIN_NAME, string(CHAR, CHAR),
-                                                        "771"};
+Endpoint const EHelper<EType::DOMAIN_NAME>::ENDPOINT = makeEndpoint(string(CHAR, CHAR), 771);
 
 template <> uint8_t const EHelper<EType::IPV4>::CHAR = 1;
 template <> size_t const EHelper<EType::IPV4>::SIZE = 7;
-template <> Endpoint const EHelper<EType::IPV4>::ENDPOINT = {EType::IPV4, "1.1.1.1", "257"};
+template <> Endpoint const EHelper<EType::IPV4>::ENDPOINT = makeEndpoint("1.1.1.1"sv, 257);
 
 template <> uint8_t const EHelper<EType::IPV6>::CHAR = 4;
 template <> size_t const EHelper<EType::IPV6>::SIZE = 19;
 template <>
-Endpoint const EHelper<EType::IPV6>::ENDPOINT = {EType::IPV6, "404:404:404:404:404:404:404:404",
-                                                 "1028"};
+Endpoint const EHelper<EType::IPV6>::ENDPOINT = makeEndpoint("404:404:404:404:404:404:404:404"sv,
+                                                             1028);
 
 using Helpers = mpl::list<EHelper<EType::DOMAIN_NAME>, EHelper<EType::IPV4>, EHelper<EType::IPV6>>;
 using IntTypes =
@@ -118,58 +110,87 @@ BOOST_AUTO_TEST_CASE(serializeEndpoint_Empty_Endpoint)
 {
   auto buf = array<uint8_t, 1024>{};
   for (auto type : {EType::DOMAIN_NAME, EType::IPV4, EType::IPV6}) {
-    BOOST_CHECK_EXCEPTION(serializeEndpoint({type, "", ""}, buf), Exception,
+    auto endpoint = Endpoint{};
+    endpoint.type_ = type;
+    BOOST_CHECK_EXCEPTION(serializeEndpoint(endpoint, buf), Exception,
                           verifyException<PichiError::MISC>);
-    BOOST_CHECK_EXCEPTION(serializeEndpoint({type, "", "placeholder"}, buf), Exception,
-                          verifyException<PichiError::MISC>);
-    BOOST_CHECK_EXCEPTION(serializeEndpoint({type, "placeholder", ""}, buf), Exception,
+    endpoint.port_ = 80;
+    BOOST_CHECK_EXCEPTION(serializeEndpoint(endpoint, buf), Exception,
                           verifyException<PichiError::MISC>);
   }
 }
 
-BOOST_AUTO_TEST_CASE(serializeEndpoint_Invalid_Port_String)
+BOOST_AUTO_TEST_CASE(serializeEndpoint_Zero_Port)
 {
   auto buf = array<uint8_t, 1024>{};
-  BOOST_CHECK_EXCEPTION(serializeEndpoint({EType::DOMAIN_NAME, "placeholder", "invalid port"}, buf),
-                        invalid_argument,
-                        [](auto& e) { return string_view{e.what()}.find("stoi") != string::npos; });
-  BOOST_CHECK_EXCEPTION(serializeEndpoint({EType::IPV4, "127.0.0.1", "invalid port"}, buf),
-                        invalid_argument,
-                        [](auto& e) { return string_view{e.what()}.find("stoi") != string::npos; });
-  BOOST_CHECK_EXCEPTION(serializeEndpoint({EType::IPV6, "::1", "invalid port"}, buf),
-                        invalid_argument,
-                        [](auto& e) { return string_view{e.what()}.find("stoi") != string::npos; });
+  for (auto host : {"placeholder"sv, "127.0.0.1"sv, "::1"sv})
+    BOOST_CHECK_EXCEPTION(serializeEndpoint(makeEndpoint(host, 0), buf), Exception,
+                          verifyException<PichiError::MISC>);
 }
 
-BOOST_AUTO_TEST_CASE(serializeEndpoint_Invalid_Port_Range)
+BOOST_AUTO_TEST_CASE(serializeEndpoint_Inconsistent_Address)
 {
   auto buf = array<uint8_t, 1024>{};
-  BOOST_CHECK_EXCEPTION(serializeEndpoint({EType::DOMAIN_NAME, "placeholder", "-1"}, buf),
-                        Exception, verifyException<PichiError::MISC>);
-  BOOST_CHECK_EXCEPTION(serializeEndpoint({EType::DOMAIN_NAME, "placeholder", "0"}, buf), Exception,
+  auto v4 = makeEndpoint("1.1.1.1"sv, 80);
+  v4.type_ = EType::IPV6;
+  BOOST_CHECK_EXCEPTION(serializeEndpoint(v4, buf), Exception, verifyException<PichiError::MISC>);
+  auto v6 = makeEndpoint("::1"sv, 80);
+  v6.type_ = EType::IPV4;
+  BOOST_CHECK_EXCEPTION(serializeEndpoint(v6, buf), Exception, verifyException<PichiError::MISC>);
+}
+
+BOOST_AUTO_TEST_CASE(makeEndpoint_Invalid_Port_String)
+{
+  BOOST_CHECK_EXCEPTION(makeEndpoint("placeholder"sv, "invalid port"sv), Exception,
+                        verifyException<PichiError::MISC>);
+  BOOST_CHECK_EXCEPTION(makeEndpoint("placeholder"sv, ""sv), Exception,
+                        verifyException<PichiError::MISC>);
+  BOOST_CHECK_EXCEPTION(makeEndpoint("placeholder"sv, "80 "sv), Exception,
                         verifyException<PichiError::MISC>);
-  BOOST_CHECK_EXCEPTION(serializeEndpoint({EType::DOMAIN_NAME, "placeholder", "65536"}, buf),
-                        Exception, verifyException<PichiError::MISC>);
 }
 
-BOOST_AUTO_TEST_CASE(serializeEndpoint_Invalid_IP_Address)
+BOOST_AUTO_TEST_CASE(makeEndpoint_Invalid_Port_Range)
 {
-  auto buf = array<uint8_t, 1024>{};
-  BOOST_CHECK_EXCEPTION(serializeEndpoint({EType::IPV4, "::1", "80"}, buf), sys::system_error,
-                        verifyException<asio::error::invalid_argument>);
-  BOOST_CHECK_EXCEPTION(serializeEndpoint({EType::IPV4, "invalid ipv4 address", "80"}, buf),
-                        sys::system_error, verifyException<asio::error::invalid_argument>);
-  BOOST_CHECK_EXCEPTION(serializeEndpoint({EType::IPV6, "1.1.1.1", "80"}, buf), sys::system_error,
-                        verifyException<asio::error::invalid_argument>);
-  BOOST_CHECK_EXCEPTION(serializeEndpoint({EType::IPV6, "invalid ipv6 address", "80"}, buf),
-                        sys::system_error, verifyException<asio::error::invalid_argument>);
+  BOOST_CHECK_EXCEPTION(makeEndpoint("placeholder"sv, "-1"sv), Exception,
+                        verifyException<PichiError::MISC>);
+  BOOST_CHECK_EXCEPTION(makeEndpoint("placeholder"sv, "65536"sv), Exception,
+                        verifyException<PichiError::MISC>);
+  BOOST_CHECK_EQUAL(makeEndpoint("placeholder"sv, "65535"sv).port_, 65535);
 }
 
-BOOST_AUTO_TEST_CASE(serializeEndpoint_Invalid_Domain_Length)
+BOOST_AUTO_TEST_CASE(makeEndpoint_Invalid_Domain_Length)
 {
-  auto buf = array<uint8_t, 1024>{};
-  BOOST_CHECK_EXCEPTION(serializeEndpoint({EType::DOMAIN_NAME, string(0x100, 'a'), "80"}, buf),
-                        Exception, verifyException<PichiError::MISC>);
+  BOOST_CHECK_EXCEPTION(makeEndpoint(""sv, 80), Exception, verifyException<PichiError::MISC>);
+  BOOST_CHECK_EXCEPTION(makeEndpoint(string(0x100, 'a'), 80), Exception,
+                        verifyException<PichiError::MISC>);
+  BOOST_CHECK_EQUAL(makeEndpoint(string(0xff, 'a'), 80).size_, 0xff);
+}
+
+BOOST_AUTO_TEST_CASE(makeEndpoint_Address_Bytes)
+{
+  auto v4 = makeEndpoint("1.2.3.4"sv, 80);
+  auto v4Expt = array<uint8_t, 4>{1, 2, 3, 4};
+  BOOST_CHECK(v4.type_ == EType::IPV4);
+  BOOST_CHECK_EQUAL_COLLECTIONS(cbegin(v4Expt), cend(v4Expt), cbegin(v4.bytes()), cend(v4.bytes()));
+
+  auto v6 = makeEndpoint("fe80::1"sv, 80);
+  auto v6Expt = array<uint8_t, 16>{0xfe, 0x80};
+  v6Expt.back() = 1;
+  BOOST_CHECK(v6.type_ == EType::IPV6);
+  BOOST_CHECK_EQUAL_COLLECTIONS(cbegin(v6Expt), cend(v6Expt), cbegin(v6.bytes()), cend(v6.bytes()));
+
+  BOOST_CHECK(makeEndpoint(asio::ip::make_address("1.2.3.4"), 80) == v4);
+  BOOST_CHECK(makeEndpoint(asio::ip::make_address("fe80::1"), 80) == v6);
+}
+
+BOOST_AUTO_TEST_CASE(formatHost_Normal)
+{
+  BOOST_CHECK_EQUAL(formatHost(makeEndpoint("example.com"sv, 80)), "example.com");
+  BOOST_CHECK_EQUAL(formatHost(makeEndpoint("1.2.3.4"sv, 80)), "1.2.3.4");
+  BOOST_CHECK_EQUAL(formatHost(makeEndpoint("fe80::1"sv, 80)), "fe80::1");
+  BOOST_CHECK(toAddress(makeEndpoint("fe80::1"sv, 80)) == asio::ip::make_address("fe80::1"));
+  BOOST_CHECK_EXCEPTION(toAddress(makeEndpoint("example.com"sv, 80)), Exception,
+                        verifyException<PichiError::MISC>);
 }
 
 BOOST_AUTO_TEST_CASE_TEMPLATE(serializeEndpoint_Less_Buffer, Helper, Helpers)
@@ -196,12 +217,33 @@ BOOST_AUTO_TEST_CASE_TEMPLATE(serializeEndpoint_Normal, Helper, Helpers)
 
 BOOST_AUTO_TEST_CASE_TEMPLATE(parseEndpoint_Normal, Helper, Helpers)
 {
-  auto read = [size = size_t{0}](MutableBuffer<uint8_t> buf) mutable {
-    size += buf.size();
-    BOOST_CHECK_LE(size, Helper::SIZE);
-    fill_n(begin(buf), Helper::SIZE, Helper::CHAR);
+  auto buf = array<uint8_t, Helper::SIZE + 1>{};
+  fill_n(begin(buf), buf.size(), Helper::CHAR);
+  auto [endpoint, len] = parseEndpoint(buf);
+  BOOST_CHECK(Helper::ENDPOINT == endpoint);
+  BOOST_CHECK_EQUAL(Helper::SIZE, len);
+}
+
+BOOST_AUTO_TEST_CASE_TEMPLATE(endpointSize_Normal, Helper, Helpers)
+{
+  auto head = array<uint8_t, ENDPOINT_HEAD_SIZE>{};
+  fill_n(begin(head), head.size(), Helper::CHAR);
+  BOOST_CHECK_EQUAL(Helper::SIZE, endpointSize(head));
+  BOOST_CHECK_EXCEPTION(endpointSize({head, 1}), Exception, verifyException<PichiError::BAD_PROTO>);
+}
+
+BOOST_AUTO_TEST_CASE_TEMPLATE(readEndpoint_Normal, Helper, Helpers)
+{
+  auto reads = 0;
+  auto read = [&reads](MutableBuffer<uint8_t> buf) {
+    ++reads;
+    fill_n(begin(buf), buf.size(), Helper::CHAR);
   };
-  BOOST_CHECK(Helper::ENDPOINT == parseEndpoint(read));
+  auto buf = array<uint8_t, MAX_ADDRESS_SIZE>{};
+  auto [endpoint, len] = readEndpoint(buf, 0, read);
+  BOOST_CHECK(Helper::ENDPOINT == endpoint);
+  BOOST_CHECK_EQUAL(Helper::SIZE, len);
+  BOOST_CHECK_EQUAL(2, reads);
 }
 
 BOOST_AUTO_TEST_CASE(detectHostType_Normal)
@@ -217,4 +259,69 @@ BOOST_AUTO_TEST_CASE(detectHostType_Normal)
   BOOST_CHECK(EType::IPV6 == detectHostType("fe80::1"));
 }
 
+BOOST_AUTO_TEST_CASE(ChunkSizer_Grow_Until_Max)
+{
+  auto sizer = ChunkSizer{};
+  BOOST_CHECK_EQUAL(sizer.size(), MIN_CHUNK_SIZE);
+
+  for (auto i = size_t{1}; i < ChunkSizer::GROW_AFTER; ++i) sizer.update(sizer.size());
+  BOOST_CHECK_EQUAL(sizer.size(), MIN_CHUNK_SIZE);
+  sizer.update(sizer.size());
+  BOOST_CHECK_EQUAL(sizer.size(), MIN_CHUNK_SIZE * 2);
+
+  for (auto i = 0; i < 100; ++i) sizer.update(sizer.size());
+  BOOST_CHECK_EQUAL(sizer.size(), MAX_CHUNK_SIZE);
+}
+
+BOOST_AUTO_TEST_CASE(ChunkSizer_Stop_At_Frame)
+{
+  auto sizer = ChunkSizer{};
+  for (auto i = 0; i < 100; ++i) sizer.update(min(sizer.size(), MAX_FRAME_SIZE));
+  BOOST_CHECK_GE(sizer.size(), MAX_FRAME_SIZE);
+  BOOST_CHECK_LT(sizer.size(), MAX_FRAME_SIZE * 2);
+}
+
+BOOST_AUTO_TEST_CASE(ChunkSizer_Shrink_Until_Min)
+{
+  auto sizer = ChunkSizer{};
+  for (auto i = 0; i < 100; ++i) sizer.update(sizer.size());
+
+  for (auto i = size_t{1}; i < ChunkSizer::SHRINK_AFTER; ++i) sizer.update(1);
+  BOOST_CHECK_EQUAL(sizer.size(), MAX_CHUNK_SIZE);
+  sizer.update(1);
+  BOOST_CHECK_EQUAL(sizer.size(), MAX_CHUNK_SIZE / 2);
+
+  for (auto i = 0; i < 1000; ++i) sizer.update(1);
+  BOOST_CHECK_EQUAL(sizer.size(), MIN_CHUNK_SIZE);
+}
+
+BOOST_AUTO_TEST_CASE(ChunkSizer_Shallower_As_Growing)
+{
+  auto sizer = ChunkSizer{};
+  BOOST_CHECK_EQUAL(sizer.depth(), MAX_RELAY_DEPTH);
+
+  for (auto i = 0; i < 100; ++i) {
+    sizer.update(sizer.size());
+    BOOST_CHECK_GE(sizer.depth(), 2);
+    BOOST_CHECK_LE(sizer.depth(), MAX_RELAY_DEPTH);
+    BOOST_CHECK_LE(sizer.depth() * sizer.size(), MAX_RELAY_SIZE);
+  }
+  BOOST_CHECK_EQUAL(sizer.depth() * sizer.size(), MAX_RELAY_SIZE);
+}
+
+BOOST_AUTO_TEST_CASE(ChunkSizer_Steady_On_Moderate_Reads)
+{
+  auto sizer = ChunkSizer{};
+  for (auto i = 0; i < 4; ++i) sizer.update(sizer.size());
+  auto size = sizer.size();
+
+  // Interleaving reads neither filling nor sparse resets both streaks
+  for (auto i = 0; i < 100; ++i) {
+    sizer.update(size);
+    sizer.update(size / 2);
+    sizer.update(1);
+  }
+  BOOST_CHECK_EQUAL(sizer.size(), size);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
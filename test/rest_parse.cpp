@@ -77,6 +77,7 @@ static string toString(RuleVO const& rvo)
     v.AddMember("domain", toJson(begin(rvo.domain_), end(rvo.domain_), alloc), alloc);
   if (!rvo.country_.empty())
     v.AddMember("country", toJson(begin(rvo.country_), end(rvo.country_), alloc), alloc);
+  if (rvo.file_.has_value()) v.AddMember("file", toJson(*rvo.file_, alloc), alloc);
 
   return toString(v);
 }
@@ -101,11 +102,49 @@ static string toString(RouteVO const& rvo)
   return toString(v);
 }
 
+namespace pichi::net {
+
+// Found by ADL when comparing std::optional<SocketOptions>
+static bool operator==(SocketOptions const& lhs, SocketOptions const& rhs)
+{
+  return lhs.noDelay_ == rhs.noDelay_ && lhs.recvBuffer_ == rhs.recvBuffer_ &&
+         lhs.sendBuffer_ == rhs.sendBuffer_ && lhs.keepAlive_ == rhs.keepAlive_ &&
+         lhs.congestion_ == rhs.congestion_ && lhs.notSentLowat_ == rhs.notSentLowat_ &&
+         lhs.tos_ == rhs.tos_ && lhs.fastOpen_ == rhs.fastOpen_;
+}
+
+} // namespace pichi::net
+
+namespace pichi::api {
+
+// Found by ADL when comparing std::optional<AdmissionVO>
+static bool operator==(AdmissionVO const& lhs, AdmissionVO const& rhs)
+{
+  return lhs.sessions_ == rhs.sessions_ && lhs.handshakes_ == rhs.handshakes_ &&
+         lhs.rate_ == rhs.rate_;
+}
+
+// Found by ADL when comparing std::optional<PoolVO>
+static bool operator==(PoolVO const& lhs, PoolVO const& rhs)
+{
+  return lhs.size_ == rhs.size_ && lhs.idle_ == rhs.idle_;
+}
+
+// Found by ADL when comparing std::optional<HealthCheckVO>
+static bool operator==(HealthCheckVO const& lhs, HealthCheckVO const& rhs)
+{
+  return lhs.interval_ == rhs.interval_ && lhs.timeout_ == rhs.timeout_ &&
+         lhs.rise_ == rhs.rise_ && lhs.fall_ == rhs.fall_ && lhs.fallback_ == rhs.fallback_;
+}
+
+} // namespace pichi::api
+
 static bool operator==(IngressVO const& lhs, IngressVO const& rhs)
 {
   return lhs.type_ == rhs.type_ && lhs.bind_ == rhs.bind_ && lhs.port_ == rhs.port_ &&
          lhs.method_ == rhs.method_ && lhs.password_ == rhs.password_ && lhs.tls_ == rhs.tls_ &&
-         lhs.certFile_ == rhs.certFile_ && lhs.keyFile_ == rhs.keyFile_;
+         lhs.certFile_ == rhs.certFile_ && lhs.keyFile_ == rhs.keyFile_ &&
+         lhs.socket_ == rhs.socket_ && lhs.udp_ == rhs.udp_ && lhs.admission_ == rhs.admission_;
 }
 
 static bool operator==(EgressVO const& lhs, EgressVO const& rhs)
@@ -113,7 +152,30 @@ static bool operator==(EgressVO const& lhs, EgressVO const& rhs)
   return lhs.type_ == rhs.type_ && lhs.host_ == rhs.host_ && lhs.port_ == rhs.port_ &&
          lhs.method_ == rhs.method_ && lhs.password_ == rhs.password_ && lhs.mode_ == rhs.mode_ &&
          lhs.delay_ == rhs.delay_ && lhs.tls_ == rhs.tls_ && lhs.insecure_ == rhs.insecure_ &&
-         lhs.caFile_ == rhs.caFile_;
+         lhs.caFile_ == rhs.caFile_ && lhs.socket_ == rhs.socket_ && lhs.pool_ == rhs.pool_ &&
+         lhs.connections_ == rhs.connections_ && lhs.udp_ == rhs.udp_ &&
+         lhs.members_ == rhs.members_ && lhs.balance_ == rhs.balance_ &&
+         lhs.health_ == rhs.health_;
+}
+
+static Value socketOptionsJson()
+{
+  auto json = Value{};
+  json.SetObject();
+  json.AddMember("nodelay", true, alloc);
+  json.AddMember("recv_buffer", 262144, alloc);
+  json.AddMember("send_buffer", 131072, alloc);
+  json.AddMember("keepalive", 60, alloc);
+  json.AddMember("congestion", "bbr", alloc);
+  json.AddMember("notsent_lowat", 16384, alloc);
+  json.AddMember("tos", 16, alloc);
+  json.AddMember("fastopen", true, alloc);
+  return json;
+}
+
+static SocketOptions socketOptionsVO()
+{
+  return {true, 262144, 131072, 60, "bbr", 16384, 16, true};
 }
 
 static bool operator==(RuleVO const& lhs, RuleVO const& rhs)
@@ -123,7 +185,8 @@ static bool operator==(RuleVO const& lhs, RuleVO const& rhs)
          equal(begin(lhs.type_), end(lhs.type_), begin(rhs.type_), end(rhs.type_)) &&
          equal(begin(lhs.pattern_), end(lhs.pattern_), begin(rhs.pattern_), end(rhs.pattern_)) &&
          equal(begin(lhs.domain_), end(lhs.domain_), begin(rhs.domain_), end(rhs.domain_)) &&
-         equal(begin(lhs.country_), end(lhs.country_), begin(rhs.country_), end(rhs.country_));
+         equal(begin(lhs.country_), end(lhs.country_), begin(rhs.country_), end(rhs.country_)) &&
+         lhs.file_ == rhs.file_;
 }
 
 static bool operator==(RouteVO const& lhs, RouteVO const& rhs)
@@ -322,6 +385,58 @@ BOOST_AUTO_TEST_CASE(parse_IngressVO_Invalid_Port)
   BOOST_CHECK_EXCEPTION(parse<IngressVO>(huge), Exception, verifyException<PichiError::BAD_JSON>);
 }
 
+BOOST_AUTO_TEST_CASE(parse_IngressVO_Socket_Options)
+{
+  for (auto t : {AdapterType::HTTP, AdapterType::SOCKS5, AdapterType::SS}) {
+    auto json = defaultIngressJson(t);
+    json.AddMember("socket", socketOptionsJson(), alloc);
+    auto expect = defaultIngressVO(t);
+    expect.socket_ = socketOptionsVO();
+    BOOST_CHECK(expect == parse<IngressVO>(json));
+  }
+}
+
+BOOST_AUTO_TEST_CASE(parse_IngressVO_Socket_Options_Partial)
+{
+  auto json = defaultIngressJson(AdapterType::HTTP);
+  auto socket = Value{};
+  socket.SetObject();
+  socket.AddMember("nodelay", false, alloc);
+  json.AddMember("socket", socket, alloc);
+
+  auto fact = parse<IngressVO>(json);
+  BOOST_REQUIRE(fact.socket_.has_value());
+  BOOST_CHECK(fact.socket_->noDelay_ == false);
+  BOOST_CHECK(!fact.socket_->recvBuffer_.has_value());
+  BOOST_CHECK(!fact.socket_->congestion_.has_value());
+  BOOST_CHECK(!fact.socket_->tos_.has_value());
+}
+
+BOOST_AUTO_TEST_CASE(parse_IngressVO_Socket_Options_Invalid)
+{
+  auto invalid = [](auto&& key, auto&& value) {
+    auto json = defaultIngressJson(AdapterType::HTTP);
+    auto socket = socketOptionsJson();
+    socket[key] = value;
+    json.AddMember("socket", socket, alloc);
+    BOOST_CHECK_EXCEPTION(parse<IngressVO>(json), Exception,
+                          verifyException<PichiError::BAD_JSON>);
+  };
+  invalid("nodelay", 1);
+  invalid("recv_buffer", 0);
+  invalid("recv_buffer", -1);
+  invalid("send_buffer", "0");
+  invalid("keepalive", 65536);
+  invalid("congestion", "");
+  invalid("notsent_lowat", -1);
+  invalid("tos", 256);
+  invalid("fastopen", "true");
+
+  auto json = defaultIngressJson(AdapterType::HTTP);
+  json.AddMember("socket", true, alloc);
+  BOOST_CHECK_EXCEPTION(parse<IngressVO>(json), Exception, verifyException<PichiError::BAD_JSON>);
+}
+
 BOOST_AUTO_TEST_CASE(parse_Egress_Invalid_Str)
 {
   BOOST_CHECK_EXCEPTION(parse<EgressVO>("not a json"), Exception,
@@ -333,7 +448,7 @@ BOOST_AUTO_TEST_CASE(parse_Egress_Invalid_Str)
 BOOST_AUTO_TEST_CASE(parse_Egress_Default_Ones)
 {
   for (auto type : {AdapterType::DIRECT, AdapterType::HTTP, AdapterType::REJECT,
-                    AdapterType::SOCKS5, AdapterType::SS}) {
+                    AdapterType::SOCKS5, AdapterType::SS, AdapterType::GROUP}) {
     BOOST_CHECK(defaultEgressVO(type) == parse<EgressVO>(toString(defaultEgressJson(type))));
   }
 }
@@ -568,6 +683,303 @@ BOOST_AUTO_TEST_CASE(parse_Egress_SS_Additional_Fields)
   BOOST_CHECK(defaultEgressVO(AdapterType::SS) == parse<EgressVO>(json));
 }
 
+BOOST_AUTO_TEST_CASE(parse_Egress_Socket_Options)
+{
+  for (auto t : {AdapterType::DIRECT, AdapterType::HTTP, AdapterType::SOCKS5, AdapterType::SS}) {
+    auto json = defaultEgressJson(t);
+    json.AddMember("socket", socketOptionsJson(), alloc);
+    auto expect = defaultEgressVO(t);
+    expect.socket_ = socketOptionsVO();
+    BOOST_CHECK(expect == parse<EgressVO>(json));
+  }
+}
+
+BOOST_AUTO_TEST_CASE(parse_Egress_Reject_Socket_Options_Ignored)
+{
+  auto json = defaultEgressJson(AdapterType::REJECT);
+  json.AddMember("socket", true, alloc);
+  BOOST_CHECK(defaultEgressVO(AdapterType::REJECT) == parse<EgressVO>(json));
+}
+
+BOOST_AUTO_TEST_CASE(parse_Egress_Pool)
+{
+  for (auto t : {AdapterType::HTTP, AdapterType::SOCKS5, AdapterType::SS}) {
+    auto pool = Value{};
+    pool.SetObject();
+    pool.AddMember("size", 4, alloc);
+    pool.AddMember("idle", 30, alloc);
+    auto json = defaultEgressJson(t);
+    json.AddMember("pool", pool, alloc);
+    auto expect = defaultEgressVO(t);
+    expect.pool_ = PoolVO{4, 30};
+    BOOST_CHECK(expect == parse<EgressVO>(json));
+  }
+}
+
+BOOST_AUTO_TEST_CASE(parse_Egress_Pool_Default_Idle)
+{
+  auto pool = Value{};
+  pool.SetObject();
+  pool.AddMember("size", 1, alloc);
+  auto json = defaultEgressJson(AdapterType::SS);
+  json.AddMember("pool", pool, alloc);
+  auto fact = parse<EgressVO>(json);
+  BOOST_CHECK(fact.pool_.has_value());
+  BOOST_CHECK_EQUAL(fact.pool_->size_, 1);
+  BOOST_CHECK_EQUAL(fact.pool_->idle_, 60);
+}
+
+BOOST_AUTO_TEST_CASE(parse_Egress_Pool_Invalid)
+{
+  auto invalid = [](auto&& key, auto&& value) {
+    auto pool = Value{};
+    pool.SetObject();
+    pool.AddMember("size", 4, alloc);
+    pool[key] = value;
+    auto json = defaultEgressJson(AdapterType::SOCKS5);
+    json.AddMember("pool", pool, alloc);
+    BOOST_CHECK_EXCEPTION(parse<EgressVO>(json), Exception,
+                          verifyException<PichiError::BAD_JSON>);
+  };
+  invalid("size", 0);
+  invalid("size", 65);
+  invalid("size", "4");
+
+  auto idle = [](auto&& value) {
+    auto pool = Value{};
+    pool.SetObject();
+    pool.AddMember("size", 4, alloc);
+    pool.AddMember("idle", value, alloc);
+    auto json = defaultEgressJson(AdapterType::SOCKS5);
+    json.AddMember("pool", pool, alloc);
+    BOOST_CHECK_EXCEPTION(parse<EgressVO>(json), Exception,
+                          verifyException<PichiError::BAD_JSON>);
+  };
+  idle(0);
+  idle(3601);
+
+  auto json = defaultEgressJson(AdapterType::SOCKS5);
+  auto pool = Value{};
+  pool.SetObject();
+  json.AddMember("pool", pool, alloc);
+  BOOST_CHECK_EXCEPTION(parse<EgressVO>(json), Exception, verifyException<PichiError::BAD_JSON>);
+}
+
+BOOST_AUTO_TEST_CASE(parse_Egress_Direct_Pool_Ignored)
+{
+  for (auto t : {AdapterType::DIRECT, AdapterType::REJECT}) {
+    auto json = defaultEgressJson(t);
+    json.AddMember("pool", true, alloc);
+    BOOST_CHECK(defaultEgressVO(t) == parse<EgressVO>(json));
+  }
+}
+
+BOOST_AUTO_TEST_CASE(parse_SS_Udp)
+{
+  for (auto method : {"aes-128-gcm", "chacha20-ietf-poly1305"}) {
+    auto ingress = defaultIngressJson(AdapterType::SS);
+    ingress["method"] = toJson(method, alloc);
+    ingress["udp"] = true;
+    BOOST_CHECK(*parse<IngressVO>(ingress).udp_);
+
+    auto egress = defaultEgressJson(AdapterType::SS);
+    egress["method"] = toJson(method, alloc);
+    egress["udp"] = true;
+    BOOST_CHECK(*parse<EgressVO>(egress).udp_);
+  }
+
+  auto ingress = defaultIngressJson(AdapterType::SS);
+  ingress.RemoveMember("udp");
+  BOOST_CHECK(!*parse<IngressVO>(ingress).udp_);
+
+  auto egress = defaultEgressJson(AdapterType::SS);
+  egress.RemoveMember("udp");
+  BOOST_CHECK(!*parse<EgressVO>(egress).udp_);
+}
+
+BOOST_AUTO_TEST_CASE(parse_SS_Udp_Invalid)
+{
+  // Stream methods are never relayed over UDP
+  auto ingress = defaultIngressJson(AdapterType::SS);
+  ingress["udp"] = true;
+  BOOST_CHECK_EXCEPTION(parse<IngressVO>(ingress), Exception,
+                        verifyException<PichiError::BAD_JSON>);
+
+  auto egress = defaultEgressJson(AdapterType::SS);
+  egress["udp"] = true;
+  BOOST_CHECK_EXCEPTION(parse<EgressVO>(egress), Exception, verifyException<PichiError::BAD_JSON>);
+
+  egress["udp"] = "true";
+  BOOST_CHECK_EXCEPTION(parse<EgressVO>(egress), Exception, verifyException<PichiError::BAD_JSON>);
+}
+
+BOOST_AUTO_TEST_CASE(parse_Ingress_Mux)
+{
+  BOOST_CHECK(defaultIngressVO(AdapterType::MUX) ==
+              parse<IngressVO>(defaultIngressJson(AdapterType::MUX)));
+}
+
+BOOST_AUTO_TEST_CASE(parse_Egress_Mux)
+{
+  BOOST_CHECK(defaultEgressVO(AdapterType::MUX) ==
+              parse<EgressVO>(defaultEgressJson(AdapterType::MUX)));
+
+  auto json = defaultEgressJson(AdapterType::MUX);
+  json["connections"] = 16;
+  BOOST_CHECK_EQUAL(*parse<EgressVO>(json).connections_, 16);
+
+  json.RemoveMember("connections");
+  BOOST_CHECK_EQUAL(*parse<EgressVO>(json).connections_, 1);
+}
+
+BOOST_AUTO_TEST_CASE(parse_Egress_Mux_Invalid_Connections)
+{
+  auto invalid = [](auto&& connections) {
+    auto json = defaultEgressJson(AdapterType::MUX);
+    json["connections"] = connections;
+    BOOST_CHECK_EXCEPTION(parse<EgressVO>(json), Exception,
+                          verifyException<PichiError::BAD_JSON>);
+  };
+  invalid(0);
+  invalid(17);
+  invalid("1");
+}
+
+BOOST_AUTO_TEST_CASE(parse_Egress_Mux_Pool_Ignored)
+{
+  auto pool = Value{};
+  pool.SetObject();
+  pool.AddMember("size", 4, alloc);
+  auto json = defaultEgressJson(AdapterType::MUX);
+  json.AddMember("pool", pool, alloc);
+  BOOST_CHECK(defaultEgressVO(AdapterType::MUX) == parse<EgressVO>(json));
+}
+
+BOOST_AUTO_TEST_CASE(parse_Egress_Health)
+{
+  for (auto t : {AdapterType::HTTP, AdapterType::SOCKS5, AdapterType::SS}) {
+    auto health = Value{};
+    health.SetObject();
+    health.AddMember("interval", 30, alloc);
+    health.AddMember("timeout", 3, alloc);
+    health.AddMember("rise", 1, alloc);
+    health.AddMember("fall", 5, alloc);
+    health.AddMember("fallback", "direct", alloc);
+    auto json = defaultEgressJson(t);
+    json.AddMember("health", health, alloc);
+    auto expect = defaultEgressVO(t);
+    expect.health_ = HealthCheckVO{30, 3, 1, 5, "direct"};
+    BOOST_CHECK(expect == parse<EgressVO>(json));
+  }
+
+  auto health = Value{};
+  health.SetObject();
+  auto json = defaultEgressJson(AdapterType::SS);
+  json.AddMember("health", health, alloc);
+  auto expect = defaultEgressVO(AdapterType::SS);
+  expect.health_ = HealthCheckVO{10, 5, 2, 3};
+  BOOST_CHECK(expect == parse<EgressVO>(json));
+}
+
+BOOST_AUTO_TEST_CASE(parse_Egress_Health_Invalid)
+{
+  auto invalid = [](auto&& key, auto&& value) {
+    auto health = Value{};
+    health.SetObject();
+    health.AddMember(key, value, alloc);
+    auto json = defaultEgressJson(AdapterType::HTTP);
+    json.AddMember("health", health, alloc);
+    BOOST_CHECK_EXCEPTION(parse<EgressVO>(json), Exception,
+                          verifyException<PichiError::BAD_JSON>);
+  };
+  invalid("interval", 0);
+  invalid("interval", 3601);
+  invalid("timeout", 0);
+  invalid("timeout", 61);
+  invalid("rise", 0);
+  invalid("fall", 11);
+  invalid("fall", "3");
+  invalid("fallback", "");
+  invalid("fallback", 0);
+
+  auto json = defaultEgressJson(AdapterType::HTTP);
+  json.AddMember("health", true, alloc);
+  BOOST_CHECK_EXCEPTION(parse<EgressVO>(json), Exception, verifyException<PichiError::BAD_JSON>);
+}
+
+BOOST_AUTO_TEST_CASE(parse_Egress_Health_Ignored)
+{
+  for (auto t : {AdapterType::DIRECT, AdapterType::REJECT, AdapterType::MUX}) {
+    auto health = Value{};
+    health.SetObject();
+    auto json = defaultEgressJson(t);
+    json.AddMember("health", health, alloc);
+    BOOST_CHECK(defaultEgressVO(t) == parse<EgressVO>(json));
+  }
+}
+
+BOOST_AUTO_TEST_CASE(parse_Egress_Group)
+{
+  auto json = defaultEgressJson(AdapterType::GROUP);
+  json.RemoveMember("balance");
+  BOOST_CHECK(defaultEgressVO(AdapterType::GROUP) == parse<EgressVO>(json));
+
+  auto balances = vector<pair<string_view, Balance>>{{"round_robin", Balance::ROUND_ROBIN},
+                                                     {"least_sessions", Balance::LEAST_SESSIONS},
+                                                     {"latency", Balance::LATENCY},
+                                                     {"hash", Balance::HASH}};
+  for (auto&& [str, balance] : balances) {
+    json.RemoveMember("balance");
+    json.AddMember("balance", toJson(str, alloc), alloc);
+    BOOST_CHECK(*parse<EgressVO>(json).balance_ == balance);
+  }
+
+  // Only the members and the balance are meaningful
+  json = defaultEgressJson(AdapterType::GROUP);
+  json.AddMember("host", ph, alloc);
+  json.AddMember("port", 1, alloc);
+  json.AddMember("socket", socketOptionsJson(), alloc);
+  BOOST_CHECK(defaultEgressVO(AdapterType::GROUP) == parse<EgressVO>(json));
+}
+
+BOOST_AUTO_TEST_CASE(parse_Egress_Group_Invalid)
+{
+  auto json = defaultEgressJson(AdapterType::GROUP);
+  json.RemoveMember("members");
+  BOOST_CHECK_EXCEPTION(parse<EgressVO>(json), Exception, verifyException<PichiError::BAD_JSON>);
+
+  auto members = Value{};
+  members.SetArray();
+  json.AddMember("members", members, alloc);
+  BOOST_CHECK_EXCEPTION(parse<EgressVO>(json), Exception, verifyException<PichiError::BAD_JSON>);
+
+  json["members"].PushBack(1, alloc);
+  BOOST_CHECK_EXCEPTION(parse<EgressVO>(json), Exception, verifyException<PichiError::BAD_JSON>);
+
+  json["members"].SetArray();
+  for (auto i = 0; i < 65; ++i) json["members"].PushBack(ph, alloc);
+  BOOST_CHECK_EXCEPTION(parse<EgressVO>(json), Exception, verifyException<PichiError::BAD_JSON>);
+
+  json = defaultEgressJson(AdapterType::GROUP);
+  json["balance"] = "random";
+  BOOST_CHECK_EXCEPTION(parse<EgressVO>(json), Exception, verifyException<PichiError::BAD_JSON>);
+
+  // Only for the egresses
+  auto ingress = defaultIngressJson(AdapterType::HTTP);
+  ingress["type"] = "group";
+  BOOST_CHECK_EXCEPTION(parse<IngressVO>(ingress), Exception,
+                        verifyException<PichiError::BAD_JSON>);
+}
+
+BOOST_AUTO_TEST_CASE(parse_Egress_Connections_Ignored)
+{
+  for (auto t : {AdapterType::DIRECT, AdapterType::HTTP, AdapterType::SOCKS5, AdapterType::SS}) {
+    auto json = defaultEgressJson(t);
+    json.AddMember("connections", 4, alloc);
+    BOOST_CHECK(defaultEgressVO(t) == parse<EgressVO>(json));
+  }
+}
+
 BOOST_AUTO_TEST_CASE(parse_Egress_Invalid_Port)
 {
   decltype(auto) negative = "{\"name\":\"p\",\"type\":\"http\",\"bind\":\"p\",\"port\":-1}";
@@ -606,7 +1018,7 @@ BOOST_AUTO_TEST_CASE(parse_Rule_With_Fields)
   };
 
   auto range = origin;
-  range.range_.emplace_back(ph);
+  range.range_.emplace(ph);
   auto fact = parse<RuleVO>(generate("range", ph));
   BOOST_CHECK(range == fact);
 
@@ -621,12 +1033,12 @@ BOOST_AUTO_TEST_CASE(parse_Rule_With_Fields)
   BOOST_CHECK(type == fact);
 
   auto pattern = origin;
-  pattern.pattern_.emplace_back(ph);
+  pattern.pattern_.emplace(ph);
   fact = parse<RuleVO>(generate("pattern", ph));
   BOOST_CHECK(pattern == fact);
 
   auto domain = origin;
-  domain.domain_.emplace_back(ph);
+  domain.domain_.emplace(ph);
   fact = parse<RuleVO>(generate("domain", ph));
   BOOST_CHECK(domain == fact);
 
@@ -634,6 +1046,11 @@ BOOST_AUTO_TEST_CASE(parse_Rule_With_Fields)
   country.country_.emplace_back(ph);
   fact = parse<RuleVO>(generate("country", ph));
   BOOST_CHECK(country == fact);
+
+  auto file = origin;
+  file.file_ = ph;
+  fact = parse<RuleVO>(toString(file));
+  BOOST_CHECK(file == fact);
 }
 
 BOOST_AUTO_TEST_CASE(parse_Rule_With_Empty_Fields_Content)
@@ -642,7 +1059,7 @@ BOOST_AUTO_TEST_CASE(parse_Rule_With_Empty_Fields_Content)
   parse<RuleVO>(toString(origin));
 
   auto range = origin;
-  range.range_.emplace_back("");
+  range.range_.emplace("");
   BOOST_CHECK_EXCEPTION(parse<RuleVO>(toString(range)), Exception,
                         verifyException<PichiError::BAD_JSON>);
 
@@ -652,12 +1069,12 @@ BOOST_AUTO_TEST_CASE(parse_Rule_With_Empty_Fields_Content)
                         verifyException<PichiError::BAD_JSON>);
 
   auto pattern = origin;
-  pattern.pattern_.emplace_back("");
+  pattern.pattern_.emplace("");
   BOOST_CHECK_EXCEPTION(parse<RuleVO>(toString(pattern)), Exception,
                         verifyException<PichiError::BAD_JSON>);
 
   auto domain = origin;
-  domain.domain_.emplace_back("");
+  domain.domain_.emplace("");
   BOOST_CHECK_EXCEPTION(parse<RuleVO>(toString(domain)), Exception,
                         verifyException<PichiError::BAD_JSON>);
 
@@ -665,6 +1082,11 @@ BOOST_AUTO_TEST_CASE(parse_Rule_With_Empty_Fields_Content)
   country.country_.emplace_back("");
   BOOST_CHECK_EXCEPTION(parse<RuleVO>(toString(country)), Exception,
                         verifyException<PichiError::BAD_JSON>);
+
+  auto file = origin;
+  file.file_ = "";
+  BOOST_CHECK_EXCEPTION(parse<RuleVO>(toString(file)), Exception,
+                        verifyException<PichiError::BAD_JSON>);
 }
 
 BOOST_AUTO_TEST_CASE(parse_Rule_With_Superfluous_Field)
@@ -672,6 +1094,41 @@ BOOST_AUTO_TEST_CASE(parse_Rule_With_Superfluous_Field)
   BOOST_CHECK(RuleVO{} == parse<RuleVO>("{\"superfluous_field\":\"none\"}"));
 }
 
+BOOST_AUTO_TEST_CASE(parse_RulePatch_Invalid_Str)
+{
+  BOOST_CHECK_EXCEPTION(parse<RulePatchVO>("not a json"), Exception,
+                        verifyException<PichiError::BAD_JSON>);
+  BOOST_CHECK_EXCEPTION(parse<RulePatchVO>("[\"not a json object\"]"), Exception,
+                        verifyException<PichiError::BAD_JSON>);
+  BOOST_CHECK_EXCEPTION(parse<RulePatchVO>("{\"add\":[]}"), Exception,
+                        verifyException<PichiError::BAD_JSON>);
+}
+
+BOOST_AUTO_TEST_CASE(parse_RulePatch)
+{
+  auto add = RuleVO{{ph}, {}, {}, {ph}, {ph}};
+  auto remove = RuleVO{{}, {}, {}, {}, {ph}};
+  auto fact = parse<RulePatchVO>("{\"add\":" + toString(add) + ",\"remove\":" + toString(remove) +
+                                 "}");
+  BOOST_CHECK(fact.add_ == add);
+  BOOST_CHECK(fact.remove_ == remove);
+
+  fact = parse<RulePatchVO>("{}");
+  BOOST_CHECK(fact.add_ == RuleVO{});
+  BOOST_CHECK(fact.remove_ == RuleVO{});
+}
+
+BOOST_AUTO_TEST_CASE(parse_RulePatch_Unpatchable_Fields)
+{
+  for (auto&& rvo : {RuleVO{{}, {ph}}, RuleVO{{}, {}, {AdapterType::DIRECT}},
+                     RuleVO{{}, {}, {}, {}, {}, {ph}}, RuleVO{{}, {}, {}, {}, {}, {}, ph}}) {
+    BOOST_CHECK_EXCEPTION(parse<RulePatchVO>("{\"add\":" + toString(rvo) + "}"), Exception,
+                          verifyException<PichiError::BAD_JSON>);
+    BOOST_CHECK_EXCEPTION(parse<RulePatchVO>("{\"remove\":" + toString(rvo) + "}"), Exception,
+                          verifyException<PichiError::BAD_JSON>);
+  }
+}
+
 BOOST_AUTO_TEST_CASE(parse_Route_Invalid_Str)
 {
   BOOST_CHECK_EXCEPTION(parse<RouteVO>("not a json"), Exception,
@@ -746,4 +1203,103 @@ BOOST_AUTO_TEST_CASE(parse_Route)
   BOOST_CHECK(fact == expect);
 }
 
+BOOST_AUTO_TEST_CASE(parse_IngressVO_Admission)
+{
+  for (auto t : {AdapterType::HTTP, AdapterType::SOCKS5, AdapterType::SS, AdapterType::MUX}) {
+    auto admission = Value{};
+    admission.SetObject();
+    admission.AddMember("sessions", 1000, alloc);
+    admission.AddMember("handshakes", 100, alloc);
+    admission.AddMember("rate", 10, alloc);
+    auto json = defaultIngressJson(t);
+    json.AddMember("admission", admission, alloc);
+    auto expect = defaultIngressVO(t);
+    expect.admission_ = AdmissionVO{1000, 100, 10};
+    BOOST_CHECK(expect == parse<IngressVO>(json));
+  }
+
+  auto json = defaultIngressJson(AdapterType::HTTP);
+  json.AddMember("admission", true, alloc);
+  BOOST_CHECK_EXCEPTION(parse<IngressVO>(json), Exception, verifyException<PichiError::BAD_JSON>);
+}
+
+BOOST_AUTO_TEST_CASE(parse_Admission)
+{
+  auto empty = parse<AdmissionVO>("{}");
+  BOOST_CHECK(!empty.sessions_.has_value());
+  BOOST_CHECK(!empty.handshakes_.has_value());
+  BOOST_CHECK(!empty.rate_.has_value());
+
+  auto partial = parse<AdmissionVO>("{\"handshakes\": 64}");
+  BOOST_CHECK(!partial.sessions_.has_value());
+  BOOST_CHECK(partial.handshakes_ == 64u);
+  BOOST_CHECK(!partial.rate_.has_value());
+}
+
+BOOST_AUTO_TEST_CASE(parse_Admission_Invalid)
+{
+  BOOST_CHECK_EXCEPTION(parse<AdmissionVO>("[]"), Exception,
+                        verifyException<PichiError::BAD_JSON>);
+  BOOST_CHECK_EXCEPTION(parse<AdmissionVO>("{\"sessions\": 0}"), Exception,
+                        verifyException<PichiError::BAD_JSON>);
+  BOOST_CHECK_EXCEPTION(parse<AdmissionVO>("{\"handshakes\": -1}"), Exception,
+                        verifyException<PichiError::BAD_JSON>);
+  BOOST_CHECK_EXCEPTION(parse<AdmissionVO>("{\"rate\": \"10\"}"), Exception,
+                        verifyException<PichiError::BAD_JSON>);
+  BOOST_CHECK_EXCEPTION(parse<AdmissionVO>("{\"rate\": 4294967296}"), Exception,
+                        verifyException<PichiError::BAD_JSON>);
+}
+
+BOOST_AUTO_TEST_CASE(parse_Drain)
+{
+  BOOST_CHECK_EQUAL(parse<DrainVO>("{}").deadline_, 60);
+  BOOST_CHECK_EQUAL(parse<DrainVO>("{\"deadline\": 0}").deadline_, 0);
+  BOOST_CHECK_EQUAL(parse<DrainVO>("{\"deadline\": 3600}").deadline_, 3600);
+}
+
+BOOST_AUTO_TEST_CASE(parse_Drain_Invalid)
+{
+  BOOST_CHECK_EXCEPTION(parse<DrainVO>(""), Exception, verifyException<PichiError::BAD_JSON>);
+  BOOST_CHECK_EXCEPTION(parse<DrainVO>("[]"), Exception, verifyException<PichiError::BAD_JSON>);
+  BOOST_CHECK_EXCEPTION(parse<DrainVO>("{\"deadline\": -1}"), Exception,
+                        verifyException<PichiError::BAD_JSON>);
+  BOOST_CHECK_EXCEPTION(parse<DrainVO>("{\"deadline\": 3601}"), Exception,
+                        verifyException<PichiError::BAD_JSON>);
+}
+
+BOOST_AUTO_TEST_CASE(parse_Log_Invalid_Str)
+{
+  BOOST_CHECK_EXCEPTION(parse<LogVO>("not a json"), Exception,
+                        verifyException<PichiError::BAD_JSON>);
+  BOOST_CHECK_EXCEPTION(parse<LogVO>("[\"not a json object\"]"), Exception,
+                        verifyException<PichiError::BAD_JSON>);
+}
+
+BOOST_AUTO_TEST_CASE(parse_Log_Invalid_Fields)
+{
+  BOOST_CHECK_EXCEPTION(parse<LogVO>("{\"level\": \"verbose\"}"), Exception,
+                        verifyException<PichiError::BAD_JSON>);
+  BOOST_CHECK_EXCEPTION(parse<LogVO>("{\"level\": 0}"), Exception,
+                        verifyException<PichiError::BAD_JSON>);
+  BOOST_CHECK_EXCEPTION(parse<LogVO>("{\"format\": \"binary\"}"), Exception,
+                        verifyException<PichiError::BAD_JSON>);
+  BOOST_CHECK_EXCEPTION(parse<LogVO>("{\"limit\": -1}"), Exception,
+                        verifyException<PichiError::BAD_JSON>);
+  BOOST_CHECK_EXCEPTION(parse<LogVO>("{\"limit\": \"10\"}"), Exception,
+                        verifyException<PichiError::BAD_JSON>);
+}
+
+BOOST_AUTO_TEST_CASE(parse_Log)
+{
+  auto empty = parse<LogVO>("{}");
+  BOOST_CHECK(!empty.level_.has_value());
+  BOOST_CHECK(!empty.format_.has_value());
+  BOOST_CHECK(!empty.limit_.has_value());
+
+  auto full = parse<LogVO>("{\"level\": \"warn\", \"format\": \"json\", \"limit\": 0}");
+  BOOST_CHECK(full.level_ == log::Level::WARN);
+  BOOST_CHECK(full.format_ == log::Format::JSON);
+  BOOST_CHECK(full.limit_ == 0u);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
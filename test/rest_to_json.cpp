@@ -20,7 +20,9 @@ BOOST_AUTO_TEST_CASE(toJson_AdapterType)
                                                      {AdapterType::REJECT, "reject"},
                                                      {AdapterType::SOCKS5, "socks5"},
                                                      {AdapterType::HTTP, "http"},
-                                                     {AdapterType::SS, "ss"}};
+                                                     {AdapterType::SS, "ss"},
+                                                     {AdapterType::MUX, "mux"},
+                                                     {AdapterType::GROUP, "group"}};
   for_each(begin(map), end(map), [](auto&& pair) {
     auto fact = toJson(pair.first, alloc);
     BOOST_CHECK(fact.IsString());
@@ -174,6 +176,28 @@ BOOST_AUTO_TEST_CASE(toJson_IngressVO_SS_Mandatory_Fields)
   auto emptyPassword = origin;
   emptyPassword.password_->clear();
   BOOST_CHECK_EXCEPTION(toJson(emptyPassword, alloc), Exception, verifyException<PichiError::MISC>);
+
+  auto noUdp = origin;
+  noUdp.udp_.reset();
+  BOOST_CHECK_EXCEPTION(toJson(noUdp, alloc), Exception, verifyException<PichiError::MISC>);
+}
+
+BOOST_AUTO_TEST_CASE(toJson_SS_Udp)
+{
+  auto ingress = defaultIngressVO(AdapterType::SS);
+  ingress.method_ = CryptoMethod::AES_128_GCM;
+  ingress.udp_ = true;
+  auto json = toJson(ingress, alloc);
+  BOOST_CHECK(json["udp"].GetBool());
+
+  auto egress = defaultEgressVO(AdapterType::SS);
+  egress.method_ = CryptoMethod::AES_128_GCM;
+  egress.udp_ = true;
+  json = toJson(egress, alloc);
+  BOOST_CHECK(json["udp"].GetBool());
+
+  egress.udp_.reset();
+  BOOST_CHECK_EXCEPTION(toJson(egress, alloc), Exception, verifyException<PichiError::MISC>);
 }
 
 BOOST_AUTO_TEST_CASE(toJson_IngressVO_SS_Additional_Fields)
@@ -185,6 +209,66 @@ BOOST_AUTO_TEST_CASE(toJson_IngressVO_SS_Additional_Fields)
   BOOST_CHECK(defaultIngressJson(AdapterType::SS) == toJson(vo, alloc));
 }
 
+BOOST_AUTO_TEST_CASE(toJson_SocketOptions)
+{
+  auto empty = Value{};
+  empty.SetObject();
+  BOOST_CHECK(empty == toJson(SocketOptions{}, alloc));
+
+  auto expect = Value{};
+  expect.SetObject();
+  expect.AddMember("nodelay", true, alloc);
+  expect.AddMember("recv_buffer", 262144, alloc);
+  expect.AddMember("send_buffer", 131072, alloc);
+  expect.AddMember("keepalive", 0, alloc);
+  expect.AddMember("congestion", "bbr", alloc);
+  expect.AddMember("notsent_lowat", 16384, alloc);
+  expect.AddMember("tos", 16, alloc);
+  expect.AddMember("fastopen", false, alloc);
+  BOOST_CHECK(expect ==
+              toJson(SocketOptions{true, 262144, 131072, 0, "bbr", 16384, 16, false}, alloc));
+}
+
+BOOST_AUTO_TEST_CASE(toJson_IngressVO_Socket_Options)
+{
+  auto vo = defaultIngressVO(AdapterType::SS);
+  vo.socket_ = SocketOptions{};
+  vo.socket_->noDelay_ = true;
+
+  auto expect = defaultIngressJson(AdapterType::SS);
+  auto socket = Value{};
+  socket.SetObject();
+  socket.AddMember("nodelay", true, alloc);
+  expect.AddMember("socket", socket, alloc);
+  BOOST_CHECK(expect == toJson(vo, alloc));
+}
+
+BOOST_AUTO_TEST_CASE(toJson_IngressVO_Admission)
+{
+  auto vo = defaultIngressVO(AdapterType::HTTP);
+  vo.admission_ = AdmissionVO{};
+  vo.admission_->handshakes_ = 64;
+
+  auto expect = defaultIngressJson(AdapterType::HTTP);
+  auto admission = Value{};
+  admission.SetObject();
+  admission.AddMember("handshakes", 64, alloc);
+  expect.AddMember("admission", admission, alloc);
+  BOOST_CHECK(expect == toJson(vo, alloc));
+}
+
+BOOST_AUTO_TEST_CASE(toJson_Admission)
+{
+  auto expect = Value{};
+  expect.SetObject();
+  BOOST_CHECK(expect == toJson(AdmissionVO{}, alloc));
+
+  expect.AddMember("sessions", 1000, alloc);
+  expect.AddMember("handshakes", 100, alloc);
+  expect.AddMember("rate", 10, alloc);
+  BOOST_CHECK(expect == toJson(AdmissionVO{1000, 100, 10}, alloc));
+}
+
 BOOST_AUTO_TEST_CASE(toJson_IngressVO_Empty_Pack)
 {
   auto empty = unordered_map<string, IngressVO>{};
@@ -221,7 +305,7 @@ BOOST_AUTO_TEST_CASE(toJson_IngressVO_Pack)
 BOOST_AUTO_TEST_CASE(toJson_Egress_Default_Ones)
 {
   for (auto t : {AdapterType::DIRECT, AdapterType::REJECT, AdapterType::HTTP, AdapterType::SOCKS5,
-                 AdapterType::SS})
+                 AdapterType::SS, AdapterType::MUX, AdapterType::GROUP})
     BOOST_CHECK(defaultEgressJson(t) == toJson(defaultEgressVO(t), alloc));
 }
 
@@ -239,6 +323,82 @@ BOOST_AUTO_TEST_CASE(toJson_Egress_DIRECT_Additional_Fields)
   BOOST_CHECK(defaultEgressJson(AdapterType::DIRECT) == toJson(vo, alloc));
 }
 
+BOOST_AUTO_TEST_CASE(toJson_Egress_Pool)
+{
+  auto pool = Value{};
+  pool.SetObject();
+  pool.AddMember("size", 4, alloc);
+  pool.AddMember("idle", 60, alloc);
+
+  auto vo = defaultEgressVO(AdapterType::SS);
+  vo.pool_ = PoolVO{4, 60};
+  auto expect = defaultEgressJson(AdapterType::SS);
+  expect.AddMember("pool", pool, alloc);
+  BOOST_CHECK(expect == toJson(vo, alloc));
+
+  // Meaningless without a fixed next hop
+  auto direct = defaultEgressVO(AdapterType::DIRECT);
+  direct.pool_ = vo.pool_;
+  BOOST_CHECK(defaultEgressJson(AdapterType::DIRECT) == toJson(direct, alloc));
+}
+
+BOOST_AUTO_TEST_CASE(toJson_Egress_Health)
+{
+  auto health = Value{};
+  health.SetObject();
+  health.AddMember("interval", 10, alloc);
+  health.AddMember("timeout", 5, alloc);
+  health.AddMember("rise", 2, alloc);
+  health.AddMember("fall", 3, alloc);
+  health.AddMember("fallback", "direct", alloc);
+
+  auto vo = defaultEgressVO(AdapterType::HTTP);
+  vo.health_ = HealthCheckVO{10, 5, 2, 3, "direct"};
+  auto expect = defaultEgressJson(AdapterType::HTTP);
+  expect.AddMember("health", health, alloc);
+  BOOST_CHECK(expect == toJson(vo, alloc));
+
+  vo.health_->fallback_.reset();
+  BOOST_CHECK(!toJson(vo, alloc)["health"].HasMember("fallback"));
+}
+
+BOOST_AUTO_TEST_CASE(toJson_Egress_Group)
+{
+  auto vo = defaultEgressVO(AdapterType::GROUP);
+  vo.members_.push_back("direct");
+  vo.balance_ = Balance::HASH;
+  auto json = toJson(vo, alloc);
+  BOOST_CHECK_EQUAL(json["members"].Size(), 2);
+  BOOST_CHECK_EQUAL(json["members"][1].GetString(), "direct");
+  BOOST_CHECK_EQUAL(json["balance"].GetString(), "hash");
+
+  vo.balance_.reset();
+  BOOST_CHECK_EXCEPTION(toJson(vo, alloc), Exception, verifyException<PichiError::MISC>);
+
+  vo = defaultEgressVO(AdapterType::GROUP);
+  vo.members_.clear();
+  BOOST_CHECK_EXCEPTION(toJson(vo, alloc), Exception, verifyException<PichiError::MISC>);
+}
+
+BOOST_AUTO_TEST_CASE(toJson_Egress_Socket_Options)
+{
+  auto socket = Value{};
+  socket.SetObject();
+  socket.AddMember("congestion", "bbr", alloc);
+
+  auto vo = defaultEgressVO(AdapterType::DIRECT);
+  vo.socket_ = SocketOptions{};
+  vo.socket_->congestion_ = "bbr";
+  auto expect = defaultEgressJson(AdapterType::DIRECT);
+  expect.AddMember("socket", socket, alloc);
+  BOOST_CHECK(expect == toJson(vo, alloc));
+
+  // Meaningless for REJECT
+  auto reject = defaultEgressVO(AdapterType::REJECT);
+  reject.socket_ = vo.socket_;
+  BOOST_CHECK(defaultEgressJson(AdapterType::REJECT) == toJson(reject, alloc));
+}
+
 BOOST_AUTO_TEST_CASE(toJson_Egress_REJECT_Missing_Mode)
 {
   auto vo = defaultEgressVO(AdapterType::REJECT);
@@ -482,7 +642,7 @@ BOOST_AUTO_TEST_CASE(toJson_Rule_With_Fields)
   };
 
   auto range = RuleVO{};
-  range.range_.emplace_back(ph);
+  range.range_.emplace(ph);
   BOOST_CHECK(generate("range", ph) == toJson(range, alloc));
 
   auto ingress = RuleVO{};
@@ -494,11 +654,11 @@ BOOST_AUTO_TEST_CASE(toJson_Rule_With_Fields)
   BOOST_CHECK(generate("ingress_type", AdapterType::DIRECT) == toJson(type, alloc));
 
   auto pattern = RuleVO{};
-  pattern.pattern_.emplace_back(ph);
+  pattern.pattern_.emplace(ph);
   BOOST_CHECK(generate("pattern", ph) == toJson(pattern, alloc));
 
   auto domain = RuleVO{};
-  domain.domain_.emplace_back(ph);
+  domain.domain_.emplace(ph);
   BOOST_CHECK(generate("domain", ph) == toJson(domain, alloc));
 
   auto country = RuleVO{};
@@ -576,4 +736,111 @@ BOOST_AUTO_TEST_CASE(toJson_Route_With_Rules)
   BOOST_CHECK(expect == toJson(rvo, alloc));
 }
 
+BOOST_AUTO_TEST_CASE(toJson_Log_Missing_Fields)
+{
+  BOOST_CHECK_EXCEPTION(toJson(LogVO{}, alloc), Exception, verifyException<PichiError::MISC>);
+  BOOST_CHECK_EXCEPTION(toJson(LogVO{log::Level::INFO, log::Format::TEXT}, alloc), Exception,
+                        verifyException<PichiError::MISC>);
+}
+
+BOOST_AUTO_TEST_CASE(toJson_Log)
+{
+  auto expect = Value{};
+  expect.SetObject();
+  expect.AddMember("level", "error", alloc);
+  expect.AddMember("format", "json", alloc);
+  expect.AddMember("limit", 10, alloc);
+
+  BOOST_CHECK(expect == toJson(LogVO{log::Level::ERR, log::Format::JSON, 10}, alloc));
+}
+
+BOOST_AUTO_TEST_CASE(toJson_Counters)
+{
+  auto expect = Value{};
+  expect.SetObject();
+  expect.AddMember("bytes_in", 1, alloc);
+  expect.AddMember("bytes_out", 2, alloc);
+  expect.AddMember("active_sessions", 3, alloc);
+  expect.AddMember("total_sessions", 4, alloc);
+  expect.AddMember("handshake_failures", 5, alloc);
+  expect.AddMember("duplicated_ivs", 6, alloc);
+  expect.AddMember("reject_hits", 7, alloc);
+  expect.AddMember("shed_connections", 8, alloc);
+  expect.AddMember("truncated_datagrams", 9, alloc);
+
+  BOOST_CHECK(expect == toJson(CountersVO{1, 2, 3, 4, 5, 6, 7, 8, 9}, alloc));
+}
+
+BOOST_AUTO_TEST_CASE(toJson_Stats)
+{
+  auto counters = CountersVO{1, 2, 3, 4, 5, 6, 7};
+  auto named = Value{};
+  named.SetObject();
+  named.AddMember(ph, toJson(counters, alloc), alloc);
+  auto egresses = Value{};
+  egresses.SetObject();
+  auto rules = Value{};
+  rules.SetObject();
+  auto health = Value{};
+  health.SetObject();
+  health.AddMember("up", false, alloc);
+  health.AddMember("probes", 4, alloc);
+  health.AddMember("failures", 3, alloc);
+  health.AddMember("latency", 2000, alloc);
+  auto checked = Value{};
+  checked.SetObject();
+  checked.AddMember(ph, health, alloc);
+
+  auto expect = Value{};
+  expect.SetObject();
+  expect.AddMember("total", toJson(counters, alloc), alloc);
+  expect.AddMember("ingresses", named, alloc);
+  expect.AddMember("egresses", egresses, alloc);
+  expect.AddMember("rules", rules, alloc);
+  expect.AddMember("health", checked, alloc);
+
+  auto vo = StatsVO{counters, {{ph, counters}}};
+  vo.health_[ph] = HealthVO{false, 4, 3, 2000};
+  BOOST_CHECK(expect == toJson(vo, alloc));
+}
+
+BOOST_AUTO_TEST_CASE(toJson_Histogram)
+{
+  auto expect = Value{};
+  expect.SetObject();
+  expect.AddMember("count", 1, alloc);
+  expect.AddMember("mean", 2, alloc);
+  expect.AddMember("max", 3, alloc);
+  expect.AddMember("p50", 4, alloc);
+  expect.AddMember("p90", 5, alloc);
+  expect.AddMember("p99", 6, alloc);
+  expect.AddMember("p999", 7, alloc);
+
+  BOOST_CHECK(expect == toJson(HistogramVO{1, 2, 3, 4, 5, 6, 7}, alloc));
+}
+
+BOOST_AUTO_TEST_CASE(toJson_Latency)
+{
+  auto histogram = HistogramVO{1, 2, 3, 4, 5, 6, 7};
+  auto connect = Value{};
+  connect.SetObject();
+  connect.AddMember(ph, toJson(histogram, alloc), alloc);
+
+  auto expect = Value{};
+  expect.SetObject();
+  expect.AddMember("read_iv", toJson(histogram, alloc), alloc);
+  expect.AddMember("read_remote", toJson(HistogramVO{}, alloc), alloc);
+  expect.AddMember("resolve", toJson(HistogramVO{}, alloc), alloc);
+  expect.AddMember("route", toJson(HistogramVO{}, alloc), alloc);
+  expect.AddMember("connect", connect, alloc);
+  expect.AddMember("confirm", toJson(HistogramVO{}, alloc), alloc);
+  expect.AddMember("first_byte", toJson(histogram, alloc), alloc);
+
+  auto fact = LatencyVO{};
+  fact.readIV_ = histogram;
+  fact.connect_.emplace(ph, histogram);
+  fact.firstByte_ = histogram;
+  BOOST_CHECK(expect == toJson(fact, alloc));
+}
+
 BOOST_AUTO_TEST_SUITE_END()
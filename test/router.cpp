@@ -4,6 +4,7 @@
 #include <boost/asio/ip/tcp.hpp>
 #include <boost/test/unit_test.hpp>
 #include <pichi/api/router.hpp>
+#include <pichi/net/helpers.hpp>
 
 using namespace std;
 using namespace pichi;
@@ -94,6 +95,16 @@ BOOST_AUTO_TEST_CASE(Router_isUsed)
   BOOST_CHECK(router.isUsed(ph));
 }
 
+BOOST_AUTO_TEST_CASE(Router_isUsed_By_Egress_Name)
+{
+  auto router = Router{fn};
+  router.update("rule", {});
+  router.setRoute({"direct", {make_pair("rule", "egress")}});
+  BOOST_CHECK(router.isUsed("egress"));
+  BOOST_CHECK(router.isUsed("direct"));
+  BOOST_CHECK(!router.isUsed("rule"));
+}
+
 BOOST_AUTO_TEST_CASE(Router_Erase_Not_Existing)
 {
   auto router = Router{fn};
@@ -231,16 +242,71 @@ BOOST_AUTO_TEST_CASE(Router_update_Invalid_Type)
   BOOST_CHECK(begin(router) == end(router));
 }
 
+BOOST_AUTO_TEST_CASE(Router_update_Invalid_Pattern)
+{
+  auto router = Router{fn};
+  BOOST_CHECK_EXCEPTION(router.update(ph, {{}, {}, {}, {"("}}), Exception,
+                        verifyException<PichiError::SEMANTIC_ERROR>);
+  BOOST_CHECK(begin(router) == end(router));
+}
+
+BOOST_AUTO_TEST_CASE(Router_update_Invalid_Domain)
+{
+  auto router = Router{fn};
+  BOOST_CHECK_EXCEPTION(router.update(ph, {{}, {}, {}, {}, {".example.com"}}), Exception,
+                        verifyException<PichiError::SEMANTIC_ERROR>);
+  BOOST_CHECK(begin(router) == end(router));
+}
+
+BOOST_AUTO_TEST_CASE(Router_update_Rule_Used_By_Route)
+{
+  auto router = Router{fn};
+  router.update(ph, {{}, {}, {}, {}, {"example.com"}});
+  router.setRoute({{}, {make_pair(ph, ph)}});
+  BOOST_CHECK(router.route(net::makeEndpoint("example.com"sv, 443), ph,
+                           AdapterType::DIRECT)
+                  ->second == ph);
+
+  router.update(ph, {{}, {}, {}, {}, {"example.org"}});
+  BOOST_CHECK(router.route(net::makeEndpoint("example.com"sv, 443), ph,
+                           AdapterType::DIRECT)
+                  ->second == "direct"sv);
+  BOOST_CHECK(router.route(net::makeEndpoint("example.org"sv, 443), ph,
+                           AdapterType::DIRECT)
+                  ->second == ph);
+}
+
+BOOST_AUTO_TEST_CASE(Router_Matching_First_Rule)
+{
+  auto router = Router{fn};
+  router.update("0", {{}, {}, {}, {"^foo"}});
+  router.update("1", {{}, {}, {}, {}, {"example.com"}});
+  router.update("2", {{}, {ph}});
+  router.setRoute({{}, {make_pair("0", "0"), make_pair("1", "1"), make_pair("2", "2")}});
+
+  auto foo = net::makeEndpoint("foo.example.com"sv, 443);
+  auto bar = net::makeEndpoint("bar.example.com"sv, 443);
+  auto baz = net::makeEndpoint("baz.example.org"sv, 443);
+  BOOST_CHECK(router.route(foo, ph, AdapterType::DIRECT)->second == "0"sv);
+  BOOST_CHECK(router.route(bar, ph, AdapterType::DIRECT)->second == "1"sv);
+  BOOST_CHECK(router.route(baz, ph, AdapterType::DIRECT)->second == "2"sv);
+  BOOST_CHECK(router.route(baz, "NotMatched", AdapterType::DIRECT)->second == "direct"sv);
+
+  BOOST_CHECK(router.route(foo, ph, AdapterType::DIRECT)->first == "0"sv);
+  BOOST_CHECK(router.route(baz, ph, AdapterType::DIRECT)->first == "2"sv);
+  BOOST_CHECK(router.route(baz, "NotMatched", AdapterType::DIRECT)->first.empty());
+}
+
 BOOST_AUTO_TEST_CASE(Router_Matching_Range)
 {
   auto router = Router{fn};
   router.update(ph, {{"10.0.0.0/8", "fd00::/8"}});
   router.setRoute({{}, {make_pair(ph, ph)}});
 
-  BOOST_CHECK(router.route({}, ph, AdapterType::DIRECT, createRR("10.0.0.1")) == ph);
-  BOOST_CHECK(router.route({}, ph, AdapterType::DIRECT, createRR("fd00::1")) == ph);
-  BOOST_CHECK(router.route({}, ph, AdapterType::DIRECT, createRR("127.0.0.1")) == "direct");
-  BOOST_CHECK(router.route({}, ph, AdapterType::DIRECT, createRR("fe00::1")) == "direct");
+  BOOST_CHECK(router.route({}, ph, AdapterType::DIRECT, createRR("10.0.0.1")).second == ph);
+  BOOST_CHECK(router.route({}, ph, AdapterType::DIRECT, createRR("fd00::1")).second == ph);
+  BOOST_CHECK(router.route({}, ph, AdapterType::DIRECT, createRR("127.0.0.1")).second == "direct");
+  BOOST_CHECK(router.route({}, ph, AdapterType::DIRECT, createRR("fe00::1")).second == "direct");
 }
 
 BOOST_AUTO_TEST_CASE(Router_Matching_Ingress)
@@ -250,8 +316,8 @@ BOOST_AUTO_TEST_CASE(Router_Matching_Ingress)
   router.setRoute({{}, {make_pair(ph, ph)}});
 
   auto r = createRR("fe00::1");
-  BOOST_CHECK(router.route({}, ph, AdapterType::DIRECT, r) == ph);
-  BOOST_CHECK(router.route({}, "NotMatched", AdapterType::DIRECT, r) == "direct");
+  BOOST_CHECK(router.route({}, ph, AdapterType::DIRECT, r).second == ph);
+  BOOST_CHECK(router.route({}, "NotMatched", AdapterType::DIRECT, r).second == "direct");
 }
 
 BOOST_AUTO_TEST_CASE(Router_Matching_Type)
@@ -261,8 +327,8 @@ BOOST_AUTO_TEST_CASE(Router_Matching_Type)
   router.setRoute({{}, {make_pair(ph, ph)}});
 
   auto r = createRR("fe00::1");
-  BOOST_CHECK(router.route({}, ph, AdapterType::HTTP, r) == ph);
-  BOOST_CHECK(router.route({}, ph, AdapterType::DIRECT, r) == "direct");
+  BOOST_CHECK(router.route({}, ph, AdapterType::HTTP, r).second == ph);
+  BOOST_CHECK(router.route({}, ph, AdapterType::DIRECT, r).second == "direct");
 }
 
 BOOST_AUTO_TEST_CASE(Router_Matching_Pattern)
@@ -271,14 +337,29 @@ BOOST_AUTO_TEST_CASE(Router_Matching_Pattern)
   router.update(ph, {{}, {}, {}, {"^.*\\.example\\.com$"}});
   router.setRoute({{}, {make_pair(ph, ph)}});
 
-  auto r = createRR();
-  for (auto type :
-       {net::Endpoint::Type::DOMAIN_NAME, net::Endpoint::Type::IPV4, net::Endpoint::Type::IPV6}) {
-    BOOST_CHECK(router.route({type, "foo.example.com", ph}, ph, AdapterType::DIRECT, createRR()) ==
-                ph);
-    BOOST_CHECK(router.route({type, "fooexample.com", ph}, ph, AdapterType::DIRECT, createRR()) ==
-                "direct");
-  }
+  BOOST_CHECK(router.route(net::makeEndpoint("foo.example.com"sv, 443), ph, AdapterType::DIRECT,
+                           createRR())
+                  .second == ph);
+  BOOST_CHECK(router.route(net::makeEndpoint("fooexample.com"sv, 443), ph, AdapterType::DIRECT,
+                           createRR())
+                  .second == "direct");
+}
+
+BOOST_AUTO_TEST_CASE(Router_Matching_Pattern_Formatted_Address)
+{
+  auto router = Router{fn};
+  router.update(ph, {{}, {}, {}, {"^10\\.0\\.", "^fd00:"}});
+  router.setRoute({{}, {make_pair(ph, ph)}});
+
+  BOOST_CHECK(router.route(net::makeEndpoint("10.0.0.1"sv, 443), ph, AdapterType::DIRECT,
+                           createRR())
+                  .second == ph);
+  BOOST_CHECK(router.route(net::makeEndpoint("fd00::1"sv, 443), ph, AdapterType::DIRECT,
+                           createRR())
+                  .second == ph);
+  BOOST_CHECK(router.route(net::makeEndpoint("10.1.0.1"sv, 443), ph, AdapterType::DIRECT,
+                           createRR())
+                  .second == "direct");
 }
 
 BOOST_AUTO_TEST_CASE(Router_Matching_Domain)
@@ -287,10 +368,12 @@ BOOST_AUTO_TEST_CASE(Router_Matching_Domain)
   router.update(ph, {{}, {}, {}, {}, {"example.com"}});
   router.setRoute({{}, {make_pair(ph, ph)}});
 
-  BOOST_CHECK(router.route({net::Endpoint::Type::DOMAIN_NAME, "foo.example.com", ph}, ph,
-                           AdapterType::DIRECT, createRR()) == ph);
-  BOOST_CHECK(router.route({net::Endpoint::Type::DOMAIN_NAME, "fooexample.com", ph}, ph,
-                           AdapterType::DIRECT, createRR()) == "direct");
+  BOOST_CHECK(router.route(net::makeEndpoint("foo.example.com"sv, 443), ph,
+                           AdapterType::DIRECT, createRR())
+                  .second == ph);
+  BOOST_CHECK(router.route(net::makeEndpoint("fooexample.com"sv, 443), ph,
+                           AdapterType::DIRECT, createRR())
+                  .second == "direct");
 }
 
 BOOST_AUTO_TEST_CASE(Router_Matching_Domain_With_Invalid_Type)
@@ -299,10 +382,11 @@ BOOST_AUTO_TEST_CASE(Router_Matching_Domain_With_Invalid_Type)
   router.update(ph, {{}, {}, {}, {}, {"example.com"}});
   router.setRoute({{}, {make_pair(ph, ph)}});
 
-  BOOST_CHECK(router.route({net::Endpoint::Type::IPV4, "foo.example.com", ph}, ph,
-                           AdapterType::DIRECT, createRR()) == "direct");
-  BOOST_CHECK(router.route({net::Endpoint::Type::IPV6, "foo.example.com", ph}, ph,
-                           AdapterType::DIRECT, createRR()) == "direct");
+  BOOST_CHECK(router.route(net::makeEndpoint("127.0.0.1"sv, 443), ph, AdapterType::DIRECT,
+                           createRR())
+                  .second == "direct");
+  BOOST_CHECK(router.route(net::makeEndpoint("::1"sv, 443), ph, AdapterType::DIRECT, createRR())
+                  .second == "direct");
 }
 
 BOOST_AUTO_TEST_CASE(Router_Matching_Country)
@@ -311,10 +395,11 @@ BOOST_AUTO_TEST_CASE(Router_Matching_Country)
   router.update(ph, {{}, {}, {}, {}, {}, {"AU"}});
   router.setRoute({{}, {make_pair(ph, ph)}});
 
-  BOOST_CHECK(router.route({}, ph, AdapterType::DIRECT, createRR("1.1.1.1")) == ph);
-  BOOST_CHECK(router.route({}, ph, AdapterType::DIRECT, createRR("::ffff:1.1.1.1")) == ph);
-  BOOST_CHECK(router.route({}, ph, AdapterType::DIRECT, createRR("8.8.8.8")) == "direct");
-  BOOST_CHECK(router.route({}, ph, AdapterType::DIRECT, createRR("::ffff:8.8.8.8")) == "direct");
+  BOOST_CHECK(router.route({}, ph, AdapterType::DIRECT, createRR("1.1.1.1")).second == ph);
+  BOOST_CHECK(router.route({}, ph, AdapterType::DIRECT, createRR("::ffff:1.1.1.1")).second == ph);
+  BOOST_CHECK(router.route({}, ph, AdapterType::DIRECT, createRR("8.8.8.8")).second == "direct");
+  BOOST_CHECK(router.route({}, ph, AdapterType::DIRECT, createRR("::ffff:8.8.8.8")).second ==
+              "direct");
 }
 
 BOOST_AUTO_TEST_CASE(Router_Conditionally_Resolving_Default)
@@ -356,4 +441,171 @@ BOOST_AUTO_TEST_CASE(Router_Conditionally_Resolving_Necessary_Country)
   BOOST_CHECK(router.needResloving());
 }
 
+BOOST_AUTO_TEST_CASE(Router_Unresolved_Default)
+{
+  auto router = Router{fn};
+  BOOST_CHECK(router.route({}, ph, AdapterType::DIRECT)->second == "direct"sv);
+}
+
+BOOST_AUTO_TEST_CASE(Router_Unresolved_Name_Matched_Before_Range)
+{
+  auto router = Router{fn};
+  router.update("domain", {{}, {}, {}, {}, {"example.com"}});
+  router.update("range", {{"127.0.0.1/32"}});
+  router.setRoute({{}, {make_pair("domain", ph), make_pair("range", "direct")}});
+
+  BOOST_CHECK(router.route(net::makeEndpoint("foo.example.com"sv, 443), ph,
+                           AdapterType::DIRECT)
+                  ->second == ph);
+}
+
+BOOST_AUTO_TEST_CASE(Router_Unresolved_Range_Reached)
+{
+  auto router = Router{fn};
+  router.update("domain", {{}, {}, {}, {}, {"example.com"}});
+  router.update("range", {{"127.0.0.1/32"}});
+  router.setRoute({{}, {make_pair("domain", ph), make_pair("range", ph)}});
+
+  BOOST_CHECK(!router.route(net::makeEndpoint("localhost"sv, 443), ph,
+                            AdapterType::DIRECT)
+                   .has_value());
+  BOOST_CHECK(router.route(net::makeEndpoint("localhost"sv, 443), ph,
+                           AdapterType::DIRECT, createRR("127.0.0.1"))
+                  .second == ph);
+}
+
+BOOST_AUTO_TEST_CASE(Router_Unresolved_Name_Matched_In_Range_Rule)
+{
+  auto router = Router{fn};
+  router.update(ph, {{"127.0.0.1/32"}, {}, {}, {}, {"example.com"}});
+  router.setRoute({{}, {make_pair(ph, ph)}});
+
+  BOOST_CHECK(router.route(net::makeEndpoint("foo.example.com"sv, 443), ph,
+                           AdapterType::DIRECT)
+                  ->second == ph);
+  BOOST_CHECK(!router.route(net::makeEndpoint("localhost"sv, 443), ph,
+                            AdapterType::DIRECT)
+                   .has_value());
+}
+
+BOOST_AUTO_TEST_CASE(Router_patch_Not_Existing)
+{
+  auto router = Router{fn};
+  BOOST_CHECK_EXCEPTION(router.patch(ph, {{{}, {}, {}, {}, {"example.com"}}, {}}), Exception,
+                        verifyException<PichiError::SEMANTIC_ERROR>);
+}
+
+BOOST_AUTO_TEST_CASE(Router_patch_Invalid_Entries)
+{
+  auto router = Router{fn};
+  router.update(ph, {});
+  BOOST_CHECK_EXCEPTION(router.patch(ph, {{{"Invalid Range"}}, {}}), Exception,
+                        verifyException<PichiError::SEMANTIC_ERROR>);
+  BOOST_CHECK_EXCEPTION(router.patch(ph, {{{}, {}, {}, {"("}}, {}}), Exception,
+                        verifyException<PichiError::SEMANTIC_ERROR>);
+  BOOST_CHECK_EXCEPTION(router.patch(ph, {{{}, {}, {}, {}, {".com"}}, {}}), Exception,
+                        verifyException<PichiError::SEMANTIC_ERROR>);
+  BOOST_CHECK(router.begin()->second.range_.empty());
+}
+
+BOOST_AUTO_TEST_CASE(Router_patch_Invalid_Removed_Range)
+{
+  auto router = Router{fn};
+  router.update(ph, {{"10.0.0.0/8", "fd00::/8"}});
+  router.setRoute({{}, {make_pair(ph, ph)}});
+
+  BOOST_CHECK_EXCEPTION(router.patch(ph, {{{"192.168.0.0/16"}}, {{"10.0.0.0/8", "Invalid Range"}}}),
+                        Exception, verifyException<PichiError::SEMANTIC_ERROR>);
+  BOOST_CHECK((router.begin()->second.range_ == set<string>{"10.0.0.0/8", "fd00::/8"}));
+  BOOST_CHECK(router.route({}, ph, AdapterType::DIRECT, createRR("10.0.0.1")).second == ph);
+  BOOST_CHECK(router.route({}, ph, AdapterType::DIRECT, createRR("fd00::1")).second == ph);
+  BOOST_CHECK(router.route({}, ph, AdapterType::DIRECT, createRR("192.168.0.1")).second ==
+              "direct");
+}
+
+BOOST_AUTO_TEST_CASE(Router_patch_Rule_Not_Used_By_Route)
+{
+  auto router = Router{fn};
+  router.update(ph, {{"10.0.0.0/8"}, {}, {}, {}, {"example.com"}});
+  router.patch(ph, {{{"fd00::/8"}, {}, {}, {}, {"example.org"}}, {{"10.0.0.0/8"}}});
+
+  auto&& rule = router.begin()->second;
+  BOOST_CHECK(rule.range_ == set<string>{"fd00::/8"});
+  BOOST_CHECK((rule.domain_ == set<string>{"example.com", "example.org"}));
+  BOOST_CHECK(router.route(net::makeEndpoint("example.org"sv, 443), ph,
+                           AdapterType::DIRECT)
+                  ->second == "direct"sv);
+}
+
+BOOST_AUTO_TEST_CASE(Router_patch_Domain)
+{
+  auto router = Router{fn};
+  router.update(ph, {{}, {}, {}, {}, {"example.com"}});
+  router.setRoute({{}, {make_pair(ph, ph)}});
+
+  router.patch(ph, {{{}, {}, {}, {}, {"example.org"}}, {{}, {}, {}, {}, {"example.com"}}});
+  BOOST_CHECK(router.route(net::makeEndpoint("foo.example.com"sv, 443), ph,
+                           AdapterType::DIRECT)
+                  ->second == "direct"sv);
+  BOOST_CHECK(router.route(net::makeEndpoint("foo.example.org"sv, 443), ph,
+                           AdapterType::DIRECT)
+                  ->second == ph);
+}
+
+BOOST_AUTO_TEST_CASE(Router_patch_Pattern)
+{
+  auto router = Router{fn};
+  router.update("0", {{}, {}, {}, {"^foo"}});
+  router.update("1", {{}, {}, {}, {"^bar"}});
+  router.setRoute({{}, {make_pair("0", "0"), make_pair("1", "1")}});
+
+  router.patch("1", {{{}, {}, {}, {"^foo"}}, {}});
+  router.patch("0", {{}, {{}, {}, {}, {"^foo"}}});
+  BOOST_CHECK(router.route(net::makeEndpoint("foo.example.com"sv, 443), ph,
+                           AdapterType::DIRECT)
+                  ->second == "1"sv);
+  BOOST_CHECK(router.route(net::makeEndpoint("bar.example.com"sv, 443), ph,
+                           AdapterType::DIRECT)
+                  ->second == "1"sv);
+}
+
+BOOST_AUTO_TEST_CASE(Router_patch_Range)
+{
+  auto router = Router{fn};
+  router.update(ph, {{"10.0.0.0/8"}});
+  router.setRoute({{}, {make_pair(ph, ph)}});
+
+  router.patch(ph, {{{"fd00::/8"}}, {{"10.0.0.0/8"}}});
+  BOOST_CHECK(router.route({}, ph, AdapterType::DIRECT, createRR("10.0.0.1")).second == "direct");
+  BOOST_CHECK(router.route({}, ph, AdapterType::DIRECT, createRR("fd00::1")).second == ph);
+  BOOST_CHECK(router.needResloving());
+
+  router.patch(ph, {{}, {{"fd00::/8"}}});
+  BOOST_CHECK(router.route({}, ph, AdapterType::DIRECT, createRR("fd00::1")).second == "direct");
+  BOOST_CHECK(!router.needResloving());
+}
+
+BOOST_AUTO_TEST_CASE(Router_patch_Non_Canonical_Range)
+{
+  auto router = Router{fn};
+  router.update(ph, {{"10.0.0.1/8", "10.0.0.0/8", "fd00::1/8"}});
+  router.setRoute({{}, {make_pair(ph, ph)}});
+  BOOST_CHECK((router.begin()->second.range_ == set<string>{"10.0.0.0/8", "fd00::/8"}));
+
+  router.patch(ph, {{{"10.1.2.3/8"}}, {{"10.2.3.4/8", "fd00::2/8"}}});
+  BOOST_CHECK(router.begin()->second.range_ == set<string>{"10.0.0.0/8"});
+  BOOST_CHECK(router.route({}, ph, AdapterType::DIRECT, createRR("10.0.0.1")).second == ph);
+  BOOST_CHECK(router.route({}, ph, AdapterType::DIRECT, createRR("fd00::1")).second == "direct");
+
+  router.patch(ph, {{}, {{"10.255.255.255/8"}}});
+  BOOST_CHECK(router.begin()->second.range_.empty());
+  BOOST_CHECK(router.route({}, ph, AdapterType::DIRECT, createRR("10.0.0.1")).second == "direct");
+  BOOST_CHECK(!router.needResloving());
+
+  // Rebuilding from the rule agrees with the patched program
+  router.setRoute({{}, {make_pair(ph, ph)}});
+  BOOST_CHECK(router.route({}, ph, AdapterType::DIRECT, createRR("10.0.0.1")).second == "direct");
+  BOOST_CHECK(!router.needResloving());
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,130 @@
+#define BOOST_TEST_MODULE pichi rule set test
+
+#include "utils.hpp"
+#include <boost/asio/ip/address.hpp>
+#include <boost/asio/ip/tcp.hpp>
+#include <boost/test/unit_test.hpp>
+#include <fstream>
+#include <pichi/api/router.hpp>
+#include <pichi/api/rule_set.hpp>
+#include <pichi/net/helpers.hpp>
+
+using namespace std;
+using namespace pichi;
+using namespace pichi::api;
+namespace ip = boost::asio::ip;
+using ResolvedResults = ip::basic_resolver_results<ip::tcp>;
+
+static decltype(auto) fn = "geo.mmdb";
+static decltype(auto) rs = "test.rules";
+
+static void build(initializer_list<string_view> entries)
+{
+  auto builder = RuleSetBuilder{};
+  for (auto entry : entries) builder.add(entry);
+  builder.write(rs);
+}
+
+static bool match(RuleSet const& set, string_view address)
+{
+  return set.matchAddress(ip::make_address(string{address}));
+}
+
+static ResolvedResults createRR(string_view str)
+{
+  return ResolvedResults::create(ip::tcp::endpoint{ip::make_address(str), 443}, ph, ph);
+}
+
+BOOST_AUTO_TEST_SUITE(RULE_SET_TEST)
+
+BOOST_AUTO_TEST_CASE(RuleSetBuilder_Invalid_Entry)
+{
+  auto builder = RuleSetBuilder{};
+  BOOST_CHECK_EXCEPTION(builder.add(""), Exception, verifyException<PichiError::SEMANTIC_ERROR>);
+  BOOST_CHECK_EXCEPTION(builder.add(".example.com"), Exception,
+                        verifyException<PichiError::SEMANTIC_ERROR>);
+  BOOST_CHECK_EXCEPTION(builder.add("10.0.0.0/33"), Exception,
+                        verifyException<PichiError::SEMANTIC_ERROR>);
+}
+
+BOOST_AUTO_TEST_CASE(RuleSet_Invalid_File)
+{
+  BOOST_CHECK_EXCEPTION(RuleSet{"not-existing.rules"}, Exception,
+                        verifyException<PichiError::SEMANTIC_ERROR>);
+
+  ofstream{rs, ios::binary | ios::trunc} << "not a rule set file";
+  BOOST_CHECK_EXCEPTION(RuleSet{rs}, Exception, verifyException<PichiError::SEMANTIC_ERROR>);
+}
+
+BOOST_AUTO_TEST_CASE(RuleSet_Empty)
+{
+  build({});
+  auto set = RuleSet{rs};
+  BOOST_CHECK(!set.hasDomains());
+  BOOST_CHECK(!set.hasRanges());
+  BOOST_CHECK(!set.matchDomain("example.com"));
+  BOOST_CHECK(!match(set, "10.0.0.1"));
+  BOOST_CHECK(!match(set, "fd00::1"));
+}
+
+BOOST_AUTO_TEST_CASE(RuleSet_Domain)
+{
+  build({"example.com", "example.org", "example.com"});
+  auto set = RuleSet{rs};
+  BOOST_CHECK(set.hasDomains());
+  BOOST_CHECK(!set.hasRanges());
+  BOOST_CHECK(set.matchDomain("example.com"));
+  BOOST_CHECK(set.matchDomain("foo.example.com"));
+  BOOST_CHECK(set.matchDomain("bar.foo.example.org"));
+  BOOST_CHECK(!set.matchDomain("fooexample.com"));
+  BOOST_CHECK(!set.matchDomain("example.net"));
+  BOOST_CHECK(!set.matchDomain("com"));
+  BOOST_CHECK(!set.matchDomain(".example.com"));
+  BOOST_CHECK(!set.matchDomain(""));
+}
+
+BOOST_AUTO_TEST_CASE(RuleSet_Range)
+{
+  build({"10.0.0.0/8", "10.1.0.0/16", "192.168.1.1", "fd00::/8", "::1"});
+  auto set = RuleSet{rs};
+  BOOST_CHECK(!set.hasDomains());
+  BOOST_CHECK(set.hasRanges());
+  BOOST_CHECK(match(set, "10.0.0.0"));
+  BOOST_CHECK(match(set, "10.1.2.3"));
+  BOOST_CHECK(match(set, "10.255.255.255"));
+  BOOST_CHECK(!match(set, "11.0.0.0"));
+  BOOST_CHECK(!match(set, "9.255.255.255"));
+  BOOST_CHECK(match(set, "192.168.1.1"));
+  BOOST_CHECK(!match(set, "192.168.1.2"));
+  BOOST_CHECK(match(set, "fd00::1"));
+  BOOST_CHECK(match(set, "fdff:ffff:ffff:ffff:ffff:ffff:ffff:ffff"));
+  BOOST_CHECK(!match(set, "fe00::"));
+  BOOST_CHECK(match(set, "::1"));
+  BOOST_CHECK(!match(set, "::2"));
+}
+
+BOOST_AUTO_TEST_CASE(Router_Invalid_Rule_Set)
+{
+  auto router = Router{fn};
+  BOOST_CHECK_EXCEPTION(router.update(ph, {{}, {}, {}, {}, {}, {}, "not-existing.rules"}),
+                        Exception, verifyException<PichiError::SEMANTIC_ERROR>);
+  BOOST_CHECK(begin(router) == end(router));
+}
+
+BOOST_AUTO_TEST_CASE(Router_Matching_Rule_Set)
+{
+  build({"example.com", "10.0.0.0/8"});
+  auto router = Router{fn};
+  router.update(ph, {{}, {}, {}, {}, {}, {}, rs});
+  router.setRoute({{}, {make_pair(ph, ph)}});
+  BOOST_CHECK(router.needResloving());
+
+  auto domain = net::makeEndpoint("foo.example.com"sv, 443);
+  auto other = net::makeEndpoint("example.org"sv, 443);
+  BOOST_CHECK(router.route(domain, ph, AdapterType::DIRECT) == ph);
+  BOOST_CHECK(!router.route(other, ph, AdapterType::DIRECT).has_value());
+  BOOST_CHECK(router.route(other, ph, AdapterType::DIRECT, createRR("10.0.0.1")) == ph);
+  BOOST_CHECK(router.route(other, ph, AdapterType::DIRECT, createRR("11.0.0.1")) == "direct");
+}
+
+BOOST_AUTO_TEST_SUITE_END()
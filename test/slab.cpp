@@ -0,0 +1,110 @@
+#define BOOST_TEST_MODULE pichi slab test
+
+#include <array>
+#include <boost/asio/io_context.hpp>
+#include <boost/test/unit_test.hpp>
+#include <memory>
+#include <pichi/net/direct.hpp>
+#include <pichi/slab.hpp>
+#include <thread>
+#include <vector>
+
+using namespace std;
+using namespace pichi;
+namespace asio = boost::asio;
+
+BOOST_AUTO_TEST_SUITE(SLAB_TEST)
+
+BOOST_AUTO_TEST_CASE(allocate_Recycled_In_Same_Class)
+{
+  auto p = slab::allocate(slab::GRANULARITY + 1);
+  slab::deallocate(p, slab::GRANULARITY + 1);
+  auto cached = slab::cached();
+  BOOST_CHECK(slab::allocate(slab::GRANULARITY * 2) == p);
+  BOOST_CHECK_EQUAL(slab::cached(), cached - 1);
+  slab::deallocate(p, slab::GRANULARITY * 2);
+}
+
+BOOST_AUTO_TEST_CASE(allocate_Not_Recycled_In_Other_Class)
+{
+  auto p = slab::allocate(slab::GRANULARITY);
+  slab::deallocate(p, slab::GRANULARITY);
+  auto q = slab::allocate(slab::GRANULARITY + 1);
+  BOOST_CHECK(q != p);
+  slab::deallocate(q, slab::GRANULARITY + 1);
+}
+
+BOOST_AUTO_TEST_CASE(deallocate_Large_Not_Cached)
+{
+  auto cached = slab::cached();
+  slab::deallocate(slab::allocate(slab::MAX_SIZE + 1), slab::MAX_SIZE + 1);
+  BOOST_CHECK_EQUAL(slab::cached(), cached);
+}
+
+BOOST_AUTO_TEST_CASE(deallocate_Bounded_Free_List)
+{
+  auto blocks = vector<void*>(slab::MAX_FREE + 1);
+  for (auto&& block : blocks) block = slab::allocate(slab::MAX_SIZE);
+  auto cached = slab::cached();
+  for (auto&& block : blocks) slab::deallocate(block, slab::MAX_SIZE);
+  BOOST_CHECK_EQUAL(slab::cached(), cached + slab::MAX_FREE);
+}
+
+BOOST_AUTO_TEST_CASE(deallocate_Cached_By_Releasing_Thread)
+{
+  auto p = slab::allocate(slab::GRANULARITY);
+  auto cached = slab::cached();
+  auto released = size_t{0};
+  auto t = thread{[&]() {
+    auto before = slab::cached();
+    slab::deallocate(p, slab::GRANULARITY);
+    released = slab::cached() - before;
+  }};
+  t.join();
+  BOOST_CHECK_EQUAL(released, size_t{1});
+  BOOST_CHECK_EQUAL(slab::cached(), cached);
+}
+
+BOOST_AUTO_TEST_CASE(deallocate_After_Thread_Exiting)
+{
+  // Constructed before the lists, so destructed after them at the thread exit
+  struct Releasing {
+    ~Releasing()
+    {
+      slab::deallocate(p_, slab::GRANULARITY);
+      *cached_ = slab::cached();
+      slab::deallocate(slab::allocate(slab::GRANULARITY), slab::GRANULARITY);
+    }
+
+    void* p_;
+    size_t* cached_;
+  };
+
+  auto cached = slab::MAX_FREE;
+  auto t = thread{[&cached]() {
+    thread_local auto releasing = Releasing{nullptr, &cached};
+    releasing.p_ = slab::allocate(slab::GRANULARITY);
+    slab::deallocate(slab::allocate(slab::GRANULARITY * 2), slab::GRANULARITY * 2);
+  }};
+  t.join();
+  BOOST_CHECK_EQUAL(cached, size_t{0});
+}
+
+BOOST_AUTO_TEST_CASE(Adapter_Recycled)
+{
+  auto io = asio::io_context{};
+  auto adapter = make_unique<net::DirectAdapter>(io);
+  auto p = static_cast<void*>(adapter.get());
+  adapter.reset();
+  BOOST_CHECK(static_cast<void*>(make_unique<net::DirectAdapter>(io).get()) == p);
+}
+
+BOOST_AUTO_TEST_CASE(makeShared_Recycled)
+{
+  auto shared = slab::makeShared<array<uint8_t, 100>>();
+  auto p = static_cast<void*>(shared.get());
+  shared.reset();
+  BOOST_CHECK(static_cast<void*>(slab::makeShared<array<uint8_t, 100>>().get()) == p);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -122,7 +122,7 @@ BOOST_AUTO_TEST_CASE(readRemote_Request_With_Invalid_Version)
 BOOST_AUTO_TEST_CASE(readRemote_Request_With_Invalid_CMD)
 {
   for (auto i = 0; i < 0x100; ++i) {
-    if (i == 0x01) continue;
+    if (i == 0x01 || i == 0x03) continue;
     auto socket = Socket{};
     auto ingress = make_unique<Adapter>(socket, true);
 
@@ -191,8 +191,77 @@ BOOST_AUTO_TEST_CASE(readRemote_Correct)
   BOOST_CHECK_EQUAL(0x00, otects[1]);
 
   BOOST_CHECK(expect.type_ == fact.type_);
-  BOOST_CHECK_EQUAL(expect.host_, fact.host_);
+  BOOST_CHECK_EQUAL(net::formatHost(expect), net::formatHost(fact));
   BOOST_CHECK_EQUAL(expect.port_, fact.port_);
+  BOOST_CHECK(!ingress->associating());
+}
+
+BOOST_AUTO_TEST_CASE(readRemote_Following_Data_Left)
+{
+  auto socket = Socket{};
+  auto ingress = make_unique<Adapter>(socket, true);
+
+  socket.fill({
+      0x05, 0x01, 0x00,                                                     // Handshake
+      0x05,                                                                 // VER
+      0x01,                                                                 // CMD
+      0x00,                                                                 // RSV
+      0x03, 0x09, 'l', 'o', 'c', 'a', 'l', 'h', 'o', 's', 't', 0x01, 0xbb, // Endpoint
+      0xde, 0xad                                                            // Data
+  });
+
+  auto fact = ingress->readRemote(yield);
+  BOOST_CHECK(net::makeEndpoint("localhost"sv, 443) == fact);
+
+  auto data = array<uint8_t, 2>{};
+  BOOST_CHECK_EQUAL(data.size(), ingress->recv(data, yield));
+  BOOST_CHECK_EQUAL(0xde, data[0]);
+  BOOST_CHECK_EQUAL(0xad, data[1]);
+}
+
+BOOST_AUTO_TEST_CASE(readRemote_Udp_Associate)
+{
+  auto socket = Socket{};
+  auto ingress = make_unique<Adapter>(socket, true);
+
+  socket.fill({
+      0x05, 0x01, 0x00,                        // Handshake
+      0x05,                                    // VER
+      0x03,                                    // CMD
+      0x00,                                    // RSV
+      0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 // Endpoint
+  });
+
+  auto fact = ingress->readRemote(yield);
+  BOOST_CHECK(ingress->associating());
+  BOOST_CHECK_EQUAL("0.0.0.0", net::formatHost(fact));
+  BOOST_CHECK_EQUAL(0, fact.port_);
+}
+
+BOOST_AUTO_TEST_CASE(associate_Without_Request)
+{
+  auto socket = Socket{};
+  auto ingress = make_unique<Adapter>(socket, true);
+  BOOST_CHECK_EXCEPTION(ingress->associate(net::makeEndpoint("127.0.0.1"sv, "1080"sv), yield),
+                        Exception, verifyException<PichiError::MISC>);
+  BOOST_CHECK_EQUAL(0, socket.available());
+}
+
+BOOST_AUTO_TEST_CASE(associate)
+{
+  auto socket = Socket{};
+  auto ingress = make_unique<Adapter>(socket, true);
+  socket.fill({0x05, 0x01, 0x00, 0x05, 0x03, 0x00, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00});
+  ingress->readRemote(yield);
+  socket.flush(array<uint8_t, 2>{});
+
+  ingress->associate(net::makeEndpoint("127.0.0.1"sv, "1080"sv), yield);
+
+  auto expect = array<uint8_t, 10>{0x05, 0x00, 0x00, 0x01, 0x7f, 0x00, 0x00, 0x01, 0x04, 0x38};
+  auto fact = array<uint8_t, 10>{};
+  BOOST_CHECK_EQUAL(expect.size(), socket.available());
+  socket.flush(fact);
+  BOOST_CHECK_EQUAL_COLLECTIONS(cbegin(expect), cend(expect), cbegin(fact), cend(fact));
 }
 
 BOOST_AUTO_TEST_CASE(connect_Handshake_Invalid_Version)
@@ -247,6 +316,7 @@ BOOST_AUTO_TEST_CASE(connect_Reply_With_Invalid_Version)
 
     socket.fill({0x05, 0x00});
     socket.fill({static_cast<uint8_t>(i), 0x00, 0x00});
+    socket.fill({0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00});
     BOOST_CHECK_EXCEPTION(egress->connect(remote, {}, yield), Exception,
                           verifyException<PichiError::BAD_PROTO>);
 
@@ -269,6 +339,7 @@ BOOST_AUTO_TEST_CASE(connect_Reply_Connection_Failure)
 
     socket.fill({0x05, 0x00});
     socket.fill({0x05, static_cast<uint8_t>(i), 0x00});
+    socket.fill({0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00});
     BOOST_CHECK_EXCEPTION(egress->connect(remote, {}, yield), Exception,
                           verifyException<PichiError::CONN_FAILURE>);
 
@@ -291,6 +362,7 @@ BOOST_AUTO_TEST_CASE(connect_Reply_With_Invalid_RSV)
 
     socket.fill({0x05, 0x00});
     socket.fill({0x05, 0x00, static_cast<uint8_t>(i)});
+    socket.fill({0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00});
     BOOST_CHECK_EXCEPTION(egress->connect(remote, {}, yield), Exception,
                           verifyException<PichiError::BAD_PROTO>);
 
@@ -312,7 +384,7 @@ BOOST_AUTO_TEST_CASE(connect_Reply_Invalid_Endpoint)
 
   socket.fill({0x05, 0x00});
   socket.fill({0x05, 0x00, 0x00});
-  socket.fill({0x00});
+  socket.fill({0x00, 0x00});
   BOOST_CHECK_EXCEPTION(egress->connect(remote, {}, yield), Exception,
                         verifyException<PichiError::BAD_PROTO>);
 
@@ -356,16 +428,9 @@ BOOST_AUTO_TEST_CASE(confirm)
   BOOST_CHECK_EQUAL(0x00, buf[1]);
   BOOST_CHECK_EQUAL(0x00, buf[2]);
 
-  auto consumed = 0;
   auto len = socket.available();
   socket.flush({buf, len});
-  net::parseEndpoint([src = ConstBuffer<uint8_t>{buf, len}, &consumed](auto dst) mutable {
-    BOOST_CHECK(src.size() >= dst.size());
-    copy_n(cbegin(src), dst.size(), begin(dst));
-    src += dst.size();
-    consumed += dst.size();
-  });
-  BOOST_CHECK_EQUAL(len, consumed);
+  BOOST_CHECK_EQUAL(len, net::parseEndpoint({buf, len}).second);
 }
 
 BOOST_AUTO_TEST_CASE(disconnect)
@@ -381,16 +446,9 @@ BOOST_AUTO_TEST_CASE(disconnect)
   BOOST_CHECK_EQUAL(0x04, buf[1]);
   BOOST_CHECK_EQUAL(0x00, buf[2]);
 
-  auto consumed = 0;
   auto len = socket.available();
   socket.flush({buf, len});
-  net::parseEndpoint([src = ConstBuffer<uint8_t>{buf, len}, &consumed](auto dst) mutable {
-    BOOST_CHECK(src.size() >= dst.size());
-    copy_n(cbegin(src), dst.size(), begin(dst));
-    src += dst.size();
-    consumed += dst.size();
-  });
-  BOOST_CHECK_EQUAL(len, consumed);
+  BOOST_CHECK_EQUAL(len, net::parseEndpoint({buf, len}).second);
 }
 
 BOOST_AUTO_TEST_SUITE_END()
@@ -2,6 +2,7 @@
 
 #include "config.h"
 #include "utils.hpp"
+#include <algorithm>
 #include <array>
 #include <boost/mpl/list.hpp>
 #include <boost/test/unit_test.hpp>
@@ -10,6 +11,7 @@
 #include <pichi/net/ssaead.hpp>
 #include <pichi/net/ssstream.hpp>
 #include <pichi/test/socket.hpp>
+#include <vector>
 
 using namespace std;
 using namespace pichi;
@@ -130,10 +132,37 @@ BOOST_AUTO_TEST_CASE_TEMPLATE(readRemote, Ingress, Adapters)
   auto fact = ingress.readRemote(yield);
 
   BOOST_CHECK(expect.type_ == fact.type_);
-  BOOST_CHECK_EQUAL(expect.host_, fact.host_);
+  BOOST_CHECK_EQUAL(net::formatHost(expect), net::formatHost(fact));
   BOOST_CHECK_EQUAL(expect.port_, fact.port_);
 }
 
+BOOST_AUTO_TEST_CASE_TEMPLATE(readRemote_Payload_Left, Ingress, Adapters)
+{
+  auto psk = array<uint8_t, KEY_SIZE<Ingress::METHOD>>{};
+  fill_n(begin(psk), KEY_SIZE<Ingress::METHOD>, 0xff);
+
+  auto iv = array<uint8_t, IV_SIZE<Ingress::METHOD>>{};
+  fill_n(begin(iv), IV_SIZE<Ingress::METHOD>, 0xff);
+
+  auto encryptor = Encryptor<Ingress::METHOD>{psk, iv};
+  auto expect = net::makeEndpoint("localhost"sv, 443);
+  auto plain = array<uint8_t, 1024>{};
+  auto cipher = array<uint8_t, 1024>{};
+  auto len = net::serializeEndpoint(expect, plain);
+  fill_n(begin(plain) + len, 16, 0xde);
+
+  auto socket = Socket{};
+  auto ingress = Ingress{psk, socket, true};
+  socket.fill(iv);
+  socket.fill({cipher, encrypt<Ingress::METHOD>(encryptor, {plain, len + 16}, cipher)});
+
+  BOOST_CHECK(expect == ingress.readRemote(yield));
+
+  auto payload = array<uint8_t, 16>{};
+  BOOST_CHECK_EQUAL(payload.size(), ingress.recv(payload, yield));
+  BOOST_CHECK(all_of(cbegin(payload), cend(payload), [](auto c) { return c == 0xde; }));
+}
+
 BOOST_AUTO_TEST_CASE_TEMPLATE(confirm, Ingress, Adapters)
 {
   auto psk = array<uint8_t, KEY_SIZE<Ingress::METHOD>>{};
@@ -278,6 +307,35 @@ BOOST_AUTO_TEST_CASE_TEMPLATE(send_Egress, Egress, Adapters)
   BOOST_CHECK_EQUAL_COLLECTIONS(cbegin(expect), cend(expect), cbegin(fact), cend(fact));
 }
 
+BOOST_AUTO_TEST_CASE_TEMPLATE(send_Egress_Larger_Than_Frame, Egress, Adapters)
+{
+  auto psk = array<uint8_t, KEY_SIZE<Egress::METHOD>>{};
+  fill_n(begin(psk), KEY_SIZE<Egress::METHOD>, 0xff);
+
+  auto const FIRST = net::MAX_FRAME_SIZE;
+  auto const SECOND = size_t{1024};
+  auto plain = vector<uint8_t>(FIRST + SECOND, 0xee);
+  auto expect = vector<uint8_t>(cipherLength<Egress::METHOD>(FIRST) +
+                                cipherLength<Egress::METHOD>(SECOND));
+
+  auto socket = Socket{};
+  auto egress = Egress{psk, socket, true};
+
+  egress.send(plain, yield);
+  BOOST_CHECK_EQUAL(socket.available(), expect.size() + IV_SIZE<Egress::METHOD>);
+
+  auto iv = array<uint8_t, IV_SIZE<Egress::METHOD>>{};
+  BOOST_CHECK_EQUAL(IV_SIZE<Egress::METHOD>, socket.flush({iv, IV_SIZE<Egress::METHOD>}));
+  auto encryptor = Encryptor<Egress::METHOD>{psk, iv};
+  auto len = encrypt<Egress::METHOD>(encryptor, {plain, FIRST}, expect);
+  encrypt<Egress::METHOD>(encryptor, {plain.data() + FIRST, SECOND},
+                          {expect.data() + len, expect.size() - len});
+
+  auto fact = vector<uint8_t>(expect.size());
+  BOOST_CHECK_EQUAL(expect.size(), socket.flush(fact));
+  BOOST_CHECK_EQUAL_COLLECTIONS(cbegin(expect), cend(expect), cbegin(fact), cend(fact));
+}
+
 BOOST_AUTO_TEST_CASE_TEMPLATE(recv_Egress, Egress, Adapters)
 {
   auto psk = array<uint8_t, KEY_SIZE<Egress::METHOD>>{};
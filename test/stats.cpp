@@ -0,0 +1,160 @@
+#define BOOST_TEST_MODULE pichi stats test
+
+#include <algorithm>
+#include <boost/test/unit_test.hpp>
+#include <limits>
+#include <memory>
+#include <pichi/stats.hpp>
+#include <thread>
+
+using namespace std;
+using namespace pichi;
+using stats::Counter;
+using stats::Histogram;
+
+static uint64_t at(stats::Sample const& sample, Counter c)
+{
+  return sample.values_[static_cast<size_t>(c)];
+}
+
+static stats::Sample lookup(string_view ingress, string_view egress, string_view rule)
+{
+  auto samples = stats::collect();
+  auto it = find_if(cbegin(samples), cend(samples), [=](auto&& sample) {
+    return sample.ingress_ == ingress && sample.egress_ == egress && sample.rule_ == rule;
+  });
+  BOOST_REQUIRE(it != cend(samples));
+  return *it;
+}
+
+BOOST_AUTO_TEST_SUITE(STATS_TEST)
+
+BOOST_AUTO_TEST_CASE(counters_Same_Reference)
+{
+  auto& counters = stats::counters("same", "egress", "rule");
+  BOOST_CHECK(&counters == &stats::counters("same", "egress", "rule"));
+  BOOST_CHECK(&counters != &stats::counters("same", "egress"));
+  BOOST_CHECK(&counters != &stats::counters("same"));
+}
+
+BOOST_AUTO_TEST_CASE(collect_Single_Thread)
+{
+  auto& counters = stats::counters("single", "egress", "rule");
+  counters.add(Counter::BYTES_IN, 10);
+  counters.add(Counter::BYTES_OUT, 20);
+  counters.add(Counter::OPENED_SESSIONS);
+
+  auto sample = lookup("single", "egress", "rule");
+  BOOST_CHECK_EQUAL(at(sample, Counter::BYTES_IN), 10);
+  BOOST_CHECK_EQUAL(at(sample, Counter::BYTES_OUT), 20);
+  BOOST_CHECK_EQUAL(at(sample, Counter::OPENED_SESSIONS), 1);
+  BOOST_CHECK_EQUAL(at(sample, Counter::CLOSED_SESSIONS), 0);
+}
+
+BOOST_AUTO_TEST_CASE(collect_Multiple_Threads)
+{
+  stats::counters("multiple").add(Counter::HANDSHAKE_FAILURES);
+  auto threads = vector<thread>{};
+  for (auto i = 0; i < 4; ++i)
+    threads.emplace_back([]() {
+      auto& counters = stats::counters("multiple");
+      for (auto j = 0; j < 1000; ++j) counters.add(Counter::HANDSHAKE_FAILURES);
+    });
+  for (auto& t : threads) t.join();
+
+  // Shards of exited threads are still collected
+  BOOST_CHECK_EQUAL(at(lookup("multiple", "", ""), Counter::HANDSHAKE_FAILURES), 4001);
+}
+
+BOOST_AUTO_TEST_CASE(collect_Sorted)
+{
+  stats::counters("sorted", "b");
+  stats::counters("sorted", "a", "b");
+  stats::counters("sorted", "a", "a");
+
+  auto samples = stats::collect();
+  BOOST_CHECK(is_sorted(cbegin(samples), cend(samples), [](auto&& lhs, auto&& rhs) {
+    return tie(lhs.ingress_, lhs.egress_, lhs.rule_) < tie(rhs.ingress_, rhs.egress_, rhs.rule_);
+  }));
+}
+
+BOOST_AUTO_TEST_CASE(Histogram_index_Exact_For_Small_Values)
+{
+  for (auto i = uint64_t{0}; i < 2 * Histogram::SUB_SIZE; ++i) {
+    BOOST_CHECK_EQUAL(Histogram::index(i), i);
+    BOOST_CHECK_EQUAL(Histogram::upper(Histogram::index(i)), i);
+  }
+}
+
+BOOST_AUTO_TEST_CASE(Histogram_index_Relative_Error)
+{
+  for (auto value : {uint64_t{33}, uint64_t{1000}, uint64_t{123456}, uint64_t{1} << 35}) {
+    auto upper = Histogram::upper(Histogram::index(value));
+    BOOST_CHECK_LE(value, upper);
+    BOOST_CHECK_LE(upper - value, value / Histogram::SUB_SIZE);
+  }
+}
+
+BOOST_AUTO_TEST_CASE(Histogram_index_Monotonic)
+{
+  auto last = size_t{0};
+  for (auto value = uint64_t{1}; value < (uint64_t{1} << Histogram::MAX_BITS);
+       value = value * 3 / 2 + 1) {
+    auto i = Histogram::index(value);
+    BOOST_CHECK_GE(i, last);
+    BOOST_CHECK_LT(i, Histogram::SIZE);
+    last = i;
+  }
+  BOOST_CHECK_EQUAL(Histogram::index(numeric_limits<uint64_t>::max()), Histogram::SIZE - 1);
+}
+
+BOOST_AUTO_TEST_CASE(Histogram_summary_Empty)
+{
+  auto h = make_unique<Histogram>();
+  auto summary = h->summary();
+  BOOST_CHECK_EQUAL(summary.count_, 0);
+  BOOST_CHECK_EQUAL(summary.max_, 0);
+  BOOST_CHECK_EQUAL(summary.p999_, 0);
+}
+
+BOOST_AUTO_TEST_CASE(Histogram_summary)
+{
+  auto h = make_unique<Histogram>();
+  for (auto i = 1; i <= 1000; ++i) h->record(chrono::microseconds{i});
+
+  auto summary = h->summary();
+  BOOST_CHECK_EQUAL(summary.count_, 1000);
+  BOOST_CHECK_EQUAL(summary.mean_, 500);
+  BOOST_CHECK_EQUAL(summary.max_, 1000);
+  BOOST_CHECK_GE(summary.p50_, 500);
+  BOOST_CHECK_LE(summary.p50_, 500 + 500 / Histogram::SUB_SIZE);
+  BOOST_CHECK_GE(summary.p99_, 990);
+  BOOST_CHECK_LE(summary.p999_, 1000);
+}
+
+BOOST_AUTO_TEST_CASE(Histogram_reset)
+{
+  auto h = make_unique<Histogram>();
+  h->record(1s);
+  h->reset();
+  BOOST_CHECK_EQUAL(h->summary().count_, 0);
+  BOOST_CHECK_EQUAL(h->summary().max_, 0);
+}
+
+BOOST_AUTO_TEST_CASE(connecting_By_Egress)
+{
+  auto& h = stats::connecting("connecting");
+  BOOST_CHECK(&h == &stats::connecting("connecting"));
+  h.record(1ms);
+
+  auto summaries = stats::connectings();
+  auto it = find_if(cbegin(summaries), cend(summaries),
+                    [](auto&& item) { return item.first == "connecting"; });
+  BOOST_REQUIRE(it != cend(summaries));
+  BOOST_CHECK_EQUAL(it->second.count_, 1);
+
+  stats::resetHistograms();
+  BOOST_CHECK_EQUAL(stats::connecting("connecting").summary().count_, 0);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,253 @@
+#define BOOST_TEST_MODULE pichi udp test
+
+#include "utils.hpp"
+#include <algorithm>
+#include <array>
+#include <boost/asio/io_context.hpp>
+#include <boost/mpl/list.hpp>
+#include <boost/test/unit_test.hpp>
+#include <pichi/crypto/aead.hpp>
+#include <pichi/crypto/key.hpp>
+#include <pichi/net/helpers.hpp>
+#include <pichi/net/spawn.hpp>
+#include <pichi/net/ssudp.hpp>
+#include <pichi/net/udp.hpp>
+
+using namespace std;
+using namespace pichi;
+using namespace pichi::crypto;
+using namespace pichi::net;
+namespace asio = boost::asio;
+namespace mpl = boost::mpl;
+using udp = asio::ip::udp;
+
+using Codecs = mpl::list<SSAeadUdpCodec<CryptoMethod::AES_128_GCM>,
+                         SSAeadUdpCodec<CryptoMethod::AES_192_GCM>,
+                         SSAeadUdpCodec<CryptoMethod::AES_256_GCM>,
+                         SSAeadUdpCodec<CryptoMethod::CHACHA20_IETF_POLY1305>,
+                         SSAeadUdpCodec<CryptoMethod::XCHACHA20_IETF_POLY1305>>;
+
+template <CryptoMethod method> static vector<uint8_t> psk()
+{
+  auto key = vector<uint8_t>(KEY_SIZE<method>, 0);
+  generateKey(method, str2vec(ph), key);
+  return key;
+}
+
+static Datagram& plain(Datagram& d, size_t offset, size_t size)
+{
+  d.offset_ = offset;
+  d.size_ = size;
+  generate_n(begin(d.buf_) + offset, size, [i = uint8_t{0}]() mutable { return i++; });
+  return d;
+}
+
+BOOST_AUTO_TEST_SUITE(UDP)
+
+BOOST_AUTO_TEST_CASE(parseUdpHeader_Correct)
+{
+  auto buf = array<uint8_t, 13>{0x00, 0x00, 0x00, 0x01, 0x7f, 0x00, 0x00, 0x01, 0x00, 0x35,
+                                0xde, 0xad, 0xbe};
+  auto [endpoint, len] = parseUdpHeader(buf);
+  BOOST_CHECK(endpoint.type_ == Endpoint::Type::IPV4);
+  BOOST_CHECK_EQUAL(formatHost(endpoint), "127.0.0.1");
+  BOOST_CHECK_EQUAL(endpoint.port_, 53);
+  BOOST_CHECK_EQUAL(len, 10);
+}
+
+BOOST_AUTO_TEST_CASE(parseUdpHeader_Invalid_RSV)
+{
+  for (auto i = 1; i < 0x100; ++i) {
+    auto buf = array<uint8_t, 10>{static_cast<uint8_t>(i), 0x00, 0x00, 0x01, 0x7f, 0x00, 0x00,
+                                  0x01, 0x00, 0x35};
+    BOOST_CHECK_EXCEPTION(parseUdpHeader(buf), Exception, verifyException<PichiError::BAD_PROTO>);
+  }
+}
+
+BOOST_AUTO_TEST_CASE(parseUdpHeader_Fragment)
+{
+  for (auto i = 1; i < 0x100; ++i) {
+    auto buf = array<uint8_t, 10>{0x00, 0x00, static_cast<uint8_t>(i), 0x01, 0x7f, 0x00, 0x00,
+                                  0x01, 0x00, 0x35};
+    BOOST_CHECK_EXCEPTION(parseUdpHeader(buf), Exception, verifyException<PichiError::BAD_PROTO>);
+  }
+}
+
+BOOST_AUTO_TEST_CASE(parseUdpHeader_Truncated)
+{
+  auto buf = array<uint8_t, 9>{0x00, 0x00, 0x00, 0x01, 0x7f, 0x00, 0x00, 0x01, 0x00};
+  for (auto i = 0u; i <= buf.size(); ++i)
+    BOOST_CHECK_EXCEPTION(parseUdpHeader({buf, i}), Exception,
+                          verifyException<PichiError::BAD_PROTO>);
+}
+
+BOOST_AUTO_TEST_CASE(prependUdpHeader_Round_Trip)
+{
+  auto d = Datagram{};
+  d.offset_ = UDP_HEADER_ROOM;
+  d.size_ = 3;
+  d.buf_[UDP_HEADER_ROOM] = 0xde;
+  d.buf_[UDP_HEADER_ROOM + 1] = 0xad;
+  d.buf_[UDP_HEADER_ROOM + 2] = 0xbe;
+
+  prependUdpHeader(makeEndpoint("example.com", 443), d);
+  BOOST_CHECK_EQUAL(d.offset_ + d.size_, UDP_HEADER_ROOM + 3);
+
+  auto [endpoint, len] = parseUdpHeader(d.data());
+  BOOST_CHECK(endpoint.type_ == Endpoint::Type::DOMAIN_NAME);
+  BOOST_CHECK_EQUAL(endpoint.domain(), "example.com");
+  BOOST_CHECK_EQUAL(endpoint.port_, 443);
+  BOOST_CHECK_EQUAL(len + 3, d.size_);
+}
+
+BOOST_AUTO_TEST_CASE(prependUdpHeader_Insufficient_Room)
+{
+  auto d = Datagram{};
+  d.offset_ = 9;
+  BOOST_CHECK_EXCEPTION(prependUdpHeader(makeEndpoint("127.0.0.1", 53), d), Exception,
+                        verifyException<PichiError::MISC>);
+}
+
+BOOST_AUTO_TEST_CASE(DatagramBatch_Invalid)
+{
+  auto batch = DatagramBatch{};
+  auto other = DatagramBatch{2};
+  BOOST_CHECK_EQUAL(batch.size(), 0);
+  BOOST_CHECK_EXCEPTION(batch.drop(0), Exception, verifyException<PichiError::MISC>);
+  BOOST_CHECK_EXCEPTION(batch.moveTo(0, other), Exception, verifyException<PichiError::MISC>);
+  BOOST_CHECK_EXCEPTION(DatagramBatch{0}, Exception, verifyException<PichiError::MISC>);
+  BOOST_CHECK_EXCEPTION(DatagramBatch{DatagramBatch::CAPACITY + 1}, Exception,
+                        verifyException<PichiError::MISC>);
+}
+
+BOOST_AUTO_TEST_CASE(DatagramBatch_Receive_Truncated_Dropped)
+{
+  auto io = asio::io_context{};
+  auto loopback = asio::ip::make_address("127.0.0.1");
+  auto receiver = udp::socket{io, {loopback, 0}};
+  auto sender = udp::socket{io, {loopback, 0}};
+  for (auto size : {MAX_DATAGRAM_SIZE + 1, MAX_DATAGRAM_SIZE, size_t{5}})
+    sender.send_to(asio::buffer(vector<uint8_t>(size, 0x5a)), receiver.local_endpoint());
+
+  auto sizes = vector<size_t>{};
+  auto truncated = size_t{0};
+  spawn(io, [&](auto yield) {
+    auto batch = DatagramBatch{};
+    while (sizes.size() < 2) {
+      truncated += batch.receive(receiver, UDP_HEADER_ROOM, yield);
+      for (auto i = 0u; i < batch.size(); ++i) {
+        BOOST_CHECK_EQUAL(batch[i].offset_, UDP_HEADER_ROOM);
+        BOOST_CHECK(batch[i].peer_ == sender.local_endpoint());
+        sizes.push_back(batch[i].size_);
+      }
+    }
+  });
+  io.run();
+
+  auto expect = vector<size_t>{MAX_DATAGRAM_SIZE, 5};
+  BOOST_CHECK_EQUAL_COLLECTIONS(cbegin(expect), cend(expect), cbegin(sizes), cend(sizes));
+  BOOST_CHECK_EQUAL(truncated, 1);
+}
+
+BOOST_AUTO_TEST_CASE_TEMPLATE(SSUdpCodec_Round_Trip, Codec, Codecs)
+{
+  auto constexpr method = Codec::METHOD;
+  auto codec = Codec{psk<method>()};
+  for (auto size : {size_t{1}, size_t{64}, size_t{1400}, MAX_DATAGRAM_SIZE}) {
+    auto d = Datagram{};
+    plain(d, UDP_HEADER_ROOM, size);
+    auto expect = vector<uint8_t>{cbegin(d.data()), cend(d.data())};
+
+    codec.seal(d);
+    BOOST_CHECK_EQUAL(d.offset_, UDP_HEADER_ROOM - IV_SIZE<method>);
+    BOOST_CHECK_EQUAL(d.size_, IV_SIZE<method> + size + TAG_SIZE<method>);
+
+    codec.open(d);
+    BOOST_CHECK_EQUAL(d.offset_, UDP_HEADER_ROOM);
+    BOOST_CHECK_EQUAL(d.size_, size);
+    BOOST_CHECK_EQUAL_COLLECTIONS(cbegin(d.data()), cend(d.data()), cbegin(expect), cend(expect));
+  }
+}
+
+BOOST_AUTO_TEST_CASE_TEMPLATE(SSUdpCodec_Seal_Format, Codec, Codecs)
+{
+  auto constexpr method = Codec::METHOD;
+  auto key = psk<method>();
+  auto d = Datagram{};
+  plain(d, UDP_HEADER_ROOM, 64);
+  auto expect = vector<uint8_t>{cbegin(d.data()), cend(d.data())};
+
+  Codec{key}.seal(d);
+  auto decryptor = AeadDecryptor<method>{key};
+  decryptor.setIv({d.data(), IV_SIZE<method>});
+  auto fact = vector<uint8_t>(64, 0);
+  BOOST_CHECK_EQUAL(decryptor.decrypt(d.data() + IV_SIZE<method>, fact), 64);
+  BOOST_CHECK_EQUAL_COLLECTIONS(cbegin(fact), cend(fact), cbegin(expect), cend(expect));
+}
+
+BOOST_AUTO_TEST_CASE_TEMPLATE(SSUdpCodec_Fresh_Salt, Codec, Codecs)
+{
+  auto constexpr method = Codec::METHOD;
+  auto codec = Codec{psk<method>()};
+  auto d1 = Datagram{};
+  auto d2 = Datagram{};
+  codec.seal(plain(d1, UDP_HEADER_ROOM, 64));
+  codec.seal(plain(d2, UDP_HEADER_ROOM, 64));
+  BOOST_CHECK(!equal(cbegin(d1.data()), cend(d1.data()), cbegin(d2.data())));
+}
+
+BOOST_AUTO_TEST_CASE_TEMPLATE(SSUdpCodec_Open_Tampered, Codec, Codecs)
+{
+  auto constexpr method = Codec::METHOD;
+  auto codec = Codec{psk<method>()};
+  for (auto i : {size_t{0}, IV_SIZE<method>, IV_SIZE<method> + 64}) {
+    auto d = Datagram{};
+    codec.seal(plain(d, UDP_HEADER_ROOM, 64));
+    d.data().data()[i] ^= 0x01;
+    BOOST_CHECK_EXCEPTION(codec.open(d), Exception, verifyException<PichiError::CRYPTO_ERROR>);
+  }
+}
+
+BOOST_AUTO_TEST_CASE_TEMPLATE(SSUdpCodec_Open_Too_Short, Codec, Codecs)
+{
+  auto constexpr method = Codec::METHOD;
+  auto codec = Codec{psk<method>()};
+  auto d = Datagram{};
+  plain(d, 0, IV_SIZE<method> + TAG_SIZE<method>);
+  BOOST_CHECK_EXCEPTION(codec.open(d), Exception, verifyException<PichiError::BAD_PROTO>);
+}
+
+BOOST_AUTO_TEST_CASE_TEMPLATE(SSUdpCodec_Seal_Insufficient_Room, Codec, Codecs)
+{
+  auto constexpr method = Codec::METHOD;
+  auto codec = Codec{psk<method>()};
+  auto d = Datagram{};
+  BOOST_CHECK_EXCEPTION(codec.seal(plain(d, IV_SIZE<method> - 1, 64)), Exception,
+                        verifyException<PichiError::MISC>);
+  BOOST_CHECK_EXCEPTION(codec.seal(plain(d, UDP_HEADER_ROOM, d.buf_.size() - UDP_HEADER_ROOM)),
+                        Exception, verifyException<PichiError::MISC>);
+}
+
+BOOST_AUTO_TEST_CASE(makeSSUdpCodec_Stream_Method)
+{
+  BOOST_CHECK_EXCEPTION(makeSSUdpCodec(CryptoMethod::RC4_MD5, ph), Exception,
+                        verifyException<PichiError::SEMANTIC_ERROR>);
+  BOOST_CHECK_EXCEPTION(makeSSUdpCodec(CryptoMethod::CHACHA20_IETF, ph), Exception,
+                        verifyException<PichiError::SEMANTIC_ERROR>);
+  BOOST_CHECK(makeSSUdpCodec(CryptoMethod::AES_256_GCM, ph) != nullptr);
+}
+
+BOOST_AUTO_TEST_CASE(prependUdpAddress_Round_Trip)
+{
+  auto d = Datagram{};
+  plain(d, UDP_HEADER_ROOM, 3);
+  prependUdpAddress(makeEndpoint("::1", 8388), d);
+  BOOST_CHECK_EQUAL(d.offset_, UDP_HEADER_ROOM - 19);
+
+  auto [endpoint, len] = parseUdpAddress(d.data());
+  BOOST_CHECK(endpoint.type_ == Endpoint::Type::IPV6);
+  BOOST_CHECK_EQUAL(endpoint.port_, 8388);
+  BOOST_CHECK_EQUAL(len, 19);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
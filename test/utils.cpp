@@ -26,9 +26,10 @@ IngressVO defaultIngressVO(AdapterType type)
   switch (type) {
   case AdapterType::HTTP:
   case AdapterType::SOCKS5:
+  case AdapterType::MUX:
     return {type, ph, 1, {}, {}, false};
   case AdapterType::SS:
-    return {AdapterType::SS, ph, 1, CryptoMethod::RC4_MD5, ph};
+    return {AdapterType::SS, ph, 1, CryptoMethod::RC4_MD5, ph, {}, {}, {}, {}, false};
   default:
     BOOST_ERROR("Invalid type");
     return {};
@@ -54,6 +55,11 @@ Value defaultIngressJson(AdapterType type)
     v.AddMember("type", "ss", alloc);
     v.AddMember("method", "rc4-md5", alloc);
     v.AddMember("password", ph, alloc);
+    v.AddMember("udp", false, alloc);
+    break;
+  case AdapterType::MUX:
+    v.AddMember("type", "mux", alloc);
+    v.AddMember("tls", false, alloc);
     break;
   default:
     BOOST_ERROR("Invalid type");
@@ -73,7 +79,16 @@ EgressVO defaultEgressVO(AdapterType type)
   case AdapterType::SOCKS5:
     return {type, ph, 1, {}, {}, {}, {}, false};
   case AdapterType::SS:
-    return {AdapterType::SS, ph, 1, CryptoMethod::RC4_MD5, ph};
+    return {AdapterType::SS, ph, 1, CryptoMethod::RC4_MD5, ph, {}, {}, {}, {}, {}, {}, {}, {},
+            false};
+  case AdapterType::MUX:
+    return {AdapterType::MUX, ph, 1, {}, {}, {}, {}, false, {}, {}, {}, {}, 1};
+  case AdapterType::GROUP: {
+    auto vo = EgressVO{AdapterType::GROUP};
+    vo.members_ = {ph};
+    vo.balance_ = Balance::ROUND_ROBIN;
+    return vo;
+  }
   default:
     BOOST_ERROR("Invalid type");
     return {};
@@ -84,7 +99,7 @@ Value defaultEgressJson(AdapterType type)
 {
   auto v = Value{};
   v.SetObject();
-  if (type != AdapterType::DIRECT && type != AdapterType::REJECT) {
+  if (type != AdapterType::DIRECT && type != AdapterType::REJECT && type != AdapterType::GROUP) {
     v.AddMember("host", ph, alloc);
     v.AddMember("port", 1, alloc);
   }
@@ -109,7 +124,22 @@ Value defaultEgressJson(AdapterType type)
     v.AddMember("type", "ss", alloc);
     v.AddMember("method", "rc4-md5", alloc);
     v.AddMember("password", ph, alloc);
+    v.AddMember("udp", false, alloc);
     break;
+  case AdapterType::MUX:
+    v.AddMember("type", "mux", alloc);
+    v.AddMember("tls", false, alloc);
+    v.AddMember("connections", 1, alloc);
+    break;
+  case AdapterType::GROUP: {
+    v.AddMember("type", "group", alloc);
+    auto members = Value{};
+    members.SetArray();
+    members.PushBack(ph, alloc);
+    v.AddMember("members", members, alloc);
+    v.AddMember("balance", "round_robin", alloc);
+    break;
+  }
   default:
     BOOST_ERROR("Invalid type");
     break;